@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#include "distanceBatch.h"
+#include "geoData.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define DISTANCE_BATCH_X86
+#include <immintrin.h>
+#endif
+
+using geo::DistanceKernel;
+using geo::EARTH_RADIUS_METRES;
+using geo::FASTEST_SPEED_METRES_PER_SECOND;
+using std::invalid_argument;
+using std::pair;
+using std::span;
+
+namespace {
+    const float DEGREES_TO_RADIANS = std::numbers::pi_v<float> / 180.0f;
+    const float HALF_PI = std::numbers::pi_v<float> / 2.0f;
+    const float PI = std::numbers::pi_v<float>;
+
+    // Taylor coefficients of sin up to x^11. On [-pi/2, pi/2] the truncation error is below 6e-8.
+    const float SIN_C3 = -1.0f / 6.0f;
+    const float SIN_C5 = 1.0f / 120.0f;
+    const float SIN_C7 = -1.0f / 5040.0f;
+    const float SIN_C9 = 1.0f / 362880.0f;
+    const float SIN_C11 = -1.0f / 39916800.0f;
+
+    // Cephes asinf polynomial for |x| <= 0.5, relative error below 3e-7
+    const float ASIN_C0 = 1.6666752422e-1f;
+    const float ASIN_C1 = 7.4953002686e-2f;
+    const float ASIN_C2 = 4.5470025998e-2f;
+    const float ASIN_C3 = 2.4181311049e-2f;
+    const float ASIN_C4 = 4.2163199048e-2f;
+
+    // Per-origin terms, computed once per batch
+    struct Origin {
+        float lat;
+        float lon;
+        float cosLat;
+    };
+
+    Origin prepareOrigin(const pair<float, float> &origin) {
+        float lat = origin.first * DEGREES_TO_RADIANS;
+        return Origin{lat, origin.second * DEGREES_TO_RADIANS, std::cos(lat)};
+    }
+
+    void metresScalar(const Origin &origin, const float *lats, const float *lons, float *metres, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            double lat = lats[i] * DEGREES_TO_RADIANS;
+            double sinLat = std::sin((lat - origin.lat) * 0.5);
+            double sinLon = std::sin((lons[i] * DEGREES_TO_RADIANS - origin.lon) * 0.5);
+
+            double a = sinLat * sinLat + origin.cosLat * std::cos(lat) * sinLon * sinLon;
+            metres[i] = static_cast<float>(2.0 * EARTH_RADIUS_METRES * std::asin(std::sqrt(std::min(a, 1.0))));
+        }
+    }
+
+#ifdef DISTANCE_BATCH_X86
+    // MARK: AVX2
+
+    // sin(x) for x in [-pi/2, pi/2]
+    __attribute__((target("avx2,fma")))
+    inline __m256 sinAvx2(__m256 x) {
+        __m256 x2 = _mm256_mul_ps(x, x);
+
+        __m256 p = _mm256_set1_ps(SIN_C11);
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(SIN_C9));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(SIN_C7));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(SIN_C5));
+        p = _mm256_fmadd_ps(p, x2, _mm256_set1_ps(SIN_C3));
+
+        return _mm256_fmadd_ps(_mm256_mul_ps(p, x2), x, x);
+    }
+
+    // asin(z) for z in [0, 1]. Above 0.5, asin(z) = pi/2 - 2 asin(sqrt((1 - z) / 2)).
+    __attribute__((target("avx2,fma")))
+    inline __m256 asinAvx2(__m256 z) {
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 large = _mm256_cmp_ps(z, half, _CMP_GT_OQ);
+
+        __m256 reduced = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), z), half));
+        __m256 w = _mm256_blendv_ps(z, reduced, large);
+        __m256 w2 = _mm256_mul_ps(w, w);
+
+        __m256 p = _mm256_set1_ps(ASIN_C4);
+        p = _mm256_fmadd_ps(p, w2, _mm256_set1_ps(ASIN_C3));
+        p = _mm256_fmadd_ps(p, w2, _mm256_set1_ps(ASIN_C2));
+        p = _mm256_fmadd_ps(p, w2, _mm256_set1_ps(ASIN_C1));
+        p = _mm256_fmadd_ps(p, w2, _mm256_set1_ps(ASIN_C0));
+        __m256 result = _mm256_fmadd_ps(_mm256_mul_ps(p, w2), w, w);
+
+        __m256 folded = _mm256_fnmadd_ps(_mm256_set1_ps(2.0f), result, _mm256_set1_ps(HALF_PI));
+        return _mm256_blendv_ps(result, folded, large);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void metresAvx2(const Origin &origin, const float *lats, const float *lons, float *metres, size_t count) {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 toRadians = _mm256_set1_ps(DEGREES_TO_RADIANS);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 halfPi = _mm256_set1_ps(HALF_PI);
+        const __m256 pi = _mm256_set1_ps(PI);
+        const __m256 originLat = _mm256_set1_ps(origin.lat);
+        const __m256 originLon = _mm256_set1_ps(origin.lon);
+        const __m256 originCosLat = _mm256_set1_ps(origin.cosLat);
+        const __m256 diameter = _mm256_set1_ps(2.0f * EARTH_RADIUS_METRES);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for (size_t i = 0; i < count; i += 8) {
+            // The last partial vector is loaded and stored through a lane mask
+            int remaining = static_cast<int>(std::min<size_t>(count - i, 8));
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), lanes);
+
+            __m256 lat = _mm256_mul_ps(_mm256_maskload_ps(lats + i, mask), toRadians);
+            __m256 lon = _mm256_mul_ps(_mm256_maskload_ps(lons + i, mask), toRadians);
+
+            // Half the latitude difference is always within [-pi/2, pi/2]
+            __m256 sinLat = sinAvx2(_mm256_mul_ps(_mm256_sub_ps(lat, originLat), half));
+
+            // Half the longitude difference is within [-pi, pi]; sin^2 is symmetric around pi/2
+            __m256 halfLon = _mm256_andnot_ps(signMask, _mm256_mul_ps(_mm256_sub_ps(lon, originLon), half));
+            __m256 sinLon = sinAvx2(_mm256_min_ps(halfLon, _mm256_sub_ps(pi, halfLon)));
+
+            // cos(lat) = sin(pi/2 - |lat|)
+            __m256 cosLat = sinAvx2(_mm256_sub_ps(halfPi, _mm256_andnot_ps(signMask, lat)));
+            __m256 cosLats = _mm256_mul_ps(originCosLat, cosLat);
+
+            __m256 a = _mm256_fmadd_ps(cosLats, _mm256_mul_ps(sinLon, sinLon), _mm256_mul_ps(sinLat, sinLat));
+
+            // Haversine of the distance to the origin's antipode, which equals 1 - a without the cancellation
+            __m256 sinSumLat = sinAvx2(_mm256_mul_ps(_mm256_add_ps(lat, originLat), half));
+            __m256 cosLon = sinAvx2(_mm256_sub_ps(halfPi, halfLon));
+            __m256 antipodal = _mm256_fmadd_ps(cosLats, _mm256_mul_ps(cosLon, cosLon), _mm256_mul_ps(sinSumLat, sinSumLat));
+
+            __m256 far = _mm256_cmp_ps(a, half, _CMP_GT_OQ);
+            __m256 h = _mm256_min_ps(_mm256_max_ps(_mm256_blendv_ps(a, antipodal, far), _mm256_setzero_ps()), half);
+            __m256 angle = asinAvx2(_mm256_sqrt_ps(h));
+            angle = _mm256_blendv_ps(angle, _mm256_sub_ps(halfPi, angle), far);
+
+            _mm256_maskstore_ps(metres + i, mask, _mm256_mul_ps(diameter, angle));
+        }
+    }
+
+    // MARK: AVX-512
+
+    __attribute__((target("avx512f")))
+    inline __m512 sinAvx512(__m512 x) {
+        __m512 x2 = _mm512_mul_ps(x, x);
+
+        __m512 p = _mm512_set1_ps(SIN_C11);
+        p = _mm512_fmadd_ps(p, x2, _mm512_set1_ps(SIN_C9));
+        p = _mm512_fmadd_ps(p, x2, _mm512_set1_ps(SIN_C7));
+        p = _mm512_fmadd_ps(p, x2, _mm512_set1_ps(SIN_C5));
+        p = _mm512_fmadd_ps(p, x2, _mm512_set1_ps(SIN_C3));
+
+        return _mm512_fmadd_ps(_mm512_mul_ps(p, x2), x, x);
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512 asinAvx512(__m512 z) {
+        __m512 half = _mm512_set1_ps(0.5f);
+        __mmask16 large = _mm512_cmp_ps_mask(z, half, _CMP_GT_OQ);
+
+        __m512 reduced = _mm512_sqrt_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(1.0f), z), half));
+        __m512 w = _mm512_mask_blend_ps(large, z, reduced);
+        __m512 w2 = _mm512_mul_ps(w, w);
+
+        __m512 p = _mm512_set1_ps(ASIN_C4);
+        p = _mm512_fmadd_ps(p, w2, _mm512_set1_ps(ASIN_C3));
+        p = _mm512_fmadd_ps(p, w2, _mm512_set1_ps(ASIN_C2));
+        p = _mm512_fmadd_ps(p, w2, _mm512_set1_ps(ASIN_C1));
+        p = _mm512_fmadd_ps(p, w2, _mm512_set1_ps(ASIN_C0));
+        __m512 result = _mm512_fmadd_ps(_mm512_mul_ps(p, w2), w, w);
+
+        __m512 folded = _mm512_fnmadd_ps(_mm512_set1_ps(2.0f), result, _mm512_set1_ps(HALF_PI));
+        return _mm512_mask_blend_ps(large, result, folded);
+    }
+
+    __attribute__((target("avx512f")))
+    void metresAvx512(const Origin &origin, const float *lats, const float *lons, float *metres, size_t count) {
+        const __m512 toRadians = _mm512_set1_ps(DEGREES_TO_RADIANS);
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 halfPi = _mm512_set1_ps(HALF_PI);
+        const __m512 pi = _mm512_set1_ps(PI);
+        const __m512 originLat = _mm512_set1_ps(origin.lat);
+        const __m512 originLon = _mm512_set1_ps(origin.lon);
+        const __m512 originCosLat = _mm512_set1_ps(origin.cosLat);
+        const __m512 diameter = _mm512_set1_ps(2.0f * EARTH_RADIUS_METRES);
+
+        for (size_t i = 0; i < count; i += 16) {
+            size_t remaining = std::min<size_t>(count - i, 16);
+            __mmask16 mask = static_cast<__mmask16>((1u << remaining) - 1);
+
+            __m512 lat = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, lats + i), toRadians);
+            __m512 lon = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, lons + i), toRadians);
+
+            __m512 sinLat = sinAvx512(_mm512_mul_ps(_mm512_sub_ps(lat, originLat), half));
+
+            __m512 halfLon = _mm512_abs_ps(_mm512_mul_ps(_mm512_sub_ps(lon, originLon), half));
+            __m512 sinLon = sinAvx512(_mm512_min_ps(halfLon, _mm512_sub_ps(pi, halfLon)));
+
+            __m512 cosLat = sinAvx512(_mm512_sub_ps(halfPi, _mm512_abs_ps(lat)));
+            __m512 cosLats = _mm512_mul_ps(originCosLat, cosLat);
+
+            __m512 a = _mm512_fmadd_ps(cosLats, _mm512_mul_ps(sinLon, sinLon), _mm512_mul_ps(sinLat, sinLat));
+
+            __m512 sinSumLat = sinAvx512(_mm512_mul_ps(_mm512_add_ps(lat, originLat), half));
+            __m512 cosLon = sinAvx512(_mm512_sub_ps(halfPi, halfLon));
+            __m512 antipodal = _mm512_fmadd_ps(cosLats, _mm512_mul_ps(cosLon, cosLon), _mm512_mul_ps(sinSumLat, sinSumLat));
+
+            __mmask16 far = _mm512_cmp_ps_mask(a, half, _CMP_GT_OQ);
+            __m512 h = _mm512_min_ps(_mm512_max_ps(_mm512_mask_blend_ps(far, a, antipodal), _mm512_setzero_ps()), half);
+            __m512 angle = asinAvx512(_mm512_sqrt_ps(h));
+            angle = _mm512_mask_blend_ps(far, angle, _mm512_sub_ps(halfPi, angle));
+
+            _mm512_mask_storeu_ps(metres + i, mask, _mm512_mul_ps(diameter, angle));
+        }
+    }
+#endif
+
+    void checkSizes(size_t lats, size_t lons, size_t out) {
+        if (lats != lons || lats != out) {
+            throw invalid_argument("Batch distance spans must all have the same length");
+        }
+    }
+}
+
+bool geo::distanceKernelSupported(DistanceKernel kernel) {
+    switch (kernel) {
+        case DistanceKernel::Scalar:
+            return true;
+#ifdef DISTANCE_BATCH_X86
+        case DistanceKernel::Avx2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case DistanceKernel::Avx512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+DistanceKernel geo::bestDistanceKernel() {
+    static const DistanceKernel best = [] {
+        if (distanceKernelSupported(DistanceKernel::Avx512)) {
+            return DistanceKernel::Avx512;
+        }
+        if (distanceKernelSupported(DistanceKernel::Avx2)) {
+            return DistanceKernel::Avx2;
+        }
+        return DistanceKernel::Scalar;
+    }();
+
+    return best;
+}
+
+void geo::greatCircleMetresBatch(
+    pair<float, float> origin,
+    span<const float> lats,
+    span<const float> lons,
+    span<float> metres,
+    DistanceKernel kernel
+) {
+    checkSizes(lats.size(), lons.size(), metres.size());
+    Origin prepared = prepareOrigin(origin);
+
+    // Unsupported kernels fall back to the scalar loop rather than faulting
+    if (!distanceKernelSupported(kernel)) {
+        kernel = DistanceKernel::Scalar;
+    }
+
+    switch (kernel) {
+#ifdef DISTANCE_BATCH_X86
+        case DistanceKernel::Avx512:
+            metresAvx512(prepared, lats.data(), lons.data(), metres.data(), metres.size());
+            break;
+        case DistanceKernel::Avx2:
+            metresAvx2(prepared, lats.data(), lons.data(), metres.data(), metres.size());
+            break;
+#endif
+        default:
+            metresScalar(prepared, lats.data(), lons.data(), metres.data(), metres.size());
+            break;
+    }
+}
+
+void geo::distanceBatch(
+    pair<float, float> origin,
+    span<const float> lats,
+    span<const float> lons,
+    span<float> seconds,
+    DistanceKernel kernel
+) {
+    greatCircleMetresBatch(origin, lats, lons, seconds, kernel);
+
+    for (float &value : seconds) {
+        value *= 1.0f / FASTEST_SPEED_METRES_PER_SECOND;
+    }
+}
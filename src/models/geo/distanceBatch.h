@@ -0,0 +1,48 @@
+#pragma once
+
+#include <span>
+#include <utility>
+
+using std::pair;
+using std::span;
+
+namespace geo {
+    enum class DistanceKernel {
+        // Plain loop over the standard library functions. Reference for the vector kernels.
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+    // Whether the running CPU (and this build) can execute the kernel
+    bool distanceKernelSupported(DistanceKernel kernel);
+
+    // Fastest supported kernel, detected once on first use
+    DistanceKernel bestDistanceKernel();
+
+    /**
+    * Great circle distance in metres from origin to every (lats[i], lons[i]), written to metres[i].
+    * All three spans must have the same length.
+    *
+    * The vector kernels evaluate haversine with polynomial sin and asin approximations and
+    * stay within 0.5 m + 1e-5 relative of the scalar kernel for any pair of points. Beyond a
+    * quarter of the way around the globe they measure from the origin's antipode instead,
+    * which keeps single precision accurate near antipodal points.
+    */
+    void greatCircleMetresBatch(
+        pair<float, float> origin,
+        span<const float> lats,
+        span<const float> lons,
+        span<float> metres,
+        DistanceKernel kernel = bestDistanceKernel()
+    );
+
+    // Batch form of geo::distance: lower bound on the travel time in seconds to each point
+    void distanceBatch(
+        pair<float, float> origin,
+        span<const float> lats,
+        span<const float> lons,
+        span<float> seconds,
+        DistanceKernel kernel = bestDistanceKernel()
+    );
+}
@@ -0,0 +1,119 @@
+#include <algorithm>
+
+#include "exclusionOverlay.h"
+
+using geo::ExclusionOverlay;
+using geo::Graph;
+using std::pair;
+using std::vector;
+using utils::Bitset;
+using utils::MemoryResult;
+
+namespace {
+    // Even-odd ray casting in the (lat, lon) plane. Fine for city-sized areas
+    // that don't cross the antimeridian.
+    bool insidePolygon(const vector<pair<float, float>> &polygon, const pair<float, float> &point) {
+        bool inside = false;
+
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+            const auto &[latI, lonI] = polygon[i];
+            const auto &[latJ, lonJ] = polygon[j];
+
+            bool crosses = (lonI > point.second) != (lonJ > point.second);
+            if (crosses && point.first < (latJ - latI) * (point.second - lonI) / (lonJ - lonI) + latI) {
+                inside = !inside;
+            }
+        }
+
+        return inside;
+    }
+}
+
+ExclusionOverlay::ExclusionOverlay(const Graph &graph) : _graph(graph) {
+    _closedEntries = Bitset(graph.edges().numEntries());
+    _excludedNodes = Bitset(graph.size());
+}
+
+bool ExclusionOverlay::closeEdge(size_t fromNode, size_t toNode) {
+    // Parallel edges between the same pair of nodes are all closed.
+    // On a compressed graph, this closes the whole chain that contains the segment.
+    vector<size_t> entries = _graph.entriesTraversing(fromNode, toNode);
+
+    for (size_t entry : entries) {
+        _closedEntries.set(entry);
+    }
+
+    return !entries.empty();
+}
+
+void ExclusionOverlay::closeEntry(size_t entry) {
+    _closedEntries.set(entry);
+}
+
+void ExclusionOverlay::avoidPolygon(const vector<pair<float, float>> &polygon) {
+    if (polygon.size() < 3) {
+        return;
+    }
+
+    float minLat = polygon[0].first, maxLat = polygon[0].first;
+    float minLon = polygon[0].second, maxLon = polygon[0].second;
+
+    for (const auto &[lat, lon] : polygon) {
+        minLat = std::min(minLat, lat);
+        maxLat = std::max(maxLat, lat);
+        minLon = std::min(minLon, lon);
+        maxLon = std::max(maxLon, lon);
+    }
+
+    // The tree narrows the polygon down to its bounding box; only those nodes get the exact test
+    vector<size_t> candidates;
+    _graph.nodesInBox(minLat, minLon, maxLat, maxLon, candidates);
+
+    for (size_t node : candidates) {
+        if (insidePolygon(polygon, _graph.locationOf(node))) {
+            _excludedNodes.set(node);
+        }
+    }
+
+    foldNodeExclusions();
+}
+
+void ExclusionOverlay::avoidNode(size_t node) {
+    _excludedNodes.set(node);
+    foldNodeExclusions();
+}
+
+bool ExclusionOverlay::nodeExcluded(size_t node) const {
+    return _excludedNodes.test(node);
+}
+
+size_t ExclusionOverlay::numExcludedNodes() const {
+    return _excludedNodes.count();
+}
+
+size_t ExclusionOverlay::numClosedEntries() const {
+    return _closedEntries.count();
+}
+
+void ExclusionOverlay::foldNodeExclusions() {
+    for (size_t row = 0; row < _graph.size(); row++) {
+        auto [values, columns] = _graph.edges().valuesInRow(row);
+        size_t rowOffset = _graph.edges().rowOffset(row);
+
+        for (size_t i = 0; i < columns.num_items; i++) {
+            if (_excludedNodes.test(columns.items[i])) {
+                _closedEntries.set(rowOffset + i);
+                continue;
+            }
+
+            // A compressed chain also enters every shape node it skips
+            MemoryResult<const size_t> chain = _graph.chainOf(rowOffset + i);
+            for (size_t j = 0; j < chain.num_items; j++) {
+                if (_excludedNodes.test(chain.items[j])) {
+                    _closedEntries.set(rowOffset + i);
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/util/bitset.h"
+
+using geo::Graph;
+using std::pair;
+using std::vector;
+using utils::Bitset;
+
+namespace geo {
+    /**
+    * Query-time exclusions (road closures, avoid areas) layered over an immutable Graph.
+    * Closures are a bitset over the CsrMatrix entries, and avoid areas are rasterized once
+    * onto a node bitset and then folded into the entry bitset (every entry arriving at an
+    * excluded node is closed, as is every compressed chain passing through one).
+    * A search therefore needs exactly one bit test per relaxation.
+    * Searches may still start inside an avoid area, but never enter one.
+    * The graph must outlive the overlay.
+    */
+    class ExclusionOverlay {
+        public:
+        ExclusionOverlay(const Graph &graph);
+
+        // Close the directed road segment fromNode -> toNode, or the compressed chain containing it.
+        // Returns false if the graph has no such segment.
+        bool closeEdge(size_t fromNode, size_t toNode);
+
+        // Close a single matrix entry (see CsrMatrix::rowOffset)
+        void closeEntry(size_t entry);
+
+        // Avoid every node inside the polygon, given as (lat, lon) vertices.
+        // The polygon is closed implicitly; vertices should not repeat the first point.
+        void avoidPolygon(const vector<pair<float, float>> &polygon);
+
+        // Avoid a single node. Each call scans the matrix, so prefer avoidPolygon for areas.
+        void avoidNode(size_t node);
+
+        bool nodeExcluded(size_t node) const;
+        bool entryExcluded(size_t entry) const;
+
+        size_t numExcludedNodes() const;
+        size_t numClosedEntries() const;
+
+        private:
+        const Graph &_graph;
+        Bitset _closedEntries;
+        Bitset _excludedNodes;
+
+        // Close every entry that arrives at an excluded node. One pass over the matrix.
+        void foldNodeExclusions();
+    };
+
+    inline bool ExclusionOverlay::entryExcluded(size_t entry) const {
+        return _closedEntries.test(entry);
+    }
+}
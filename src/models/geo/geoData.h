@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cmath>
 #include <numbers>
 #include <set>
 #include <string>
@@ -13,43 +14,59 @@ using std::string;
 using std::vector;
 
 namespace geo {
+    // Secondary criteria of a road segment, used by multi-criteria routing
+    struct EdgeCriteria {
+        float lengthMetres = 0.0f;
+        bool toll = false;
+    };
+
     struct GraphNode {
-        pair<float, float> location;
+        // In double, as read from the JSON; a Graph keeps its nodes to the nearest microdegree
+        pair<double, double> location;
 
+        // Empty in routes, which only carry the locations they pass through
         string nodeId;
         vector<pair<string, float>> outboundAccessibleNodesWithTime;
+
+        // Parallel to outboundAccessibleNodesWithTime. May be left empty, in which case
+        // lengths default to the great circle distance and no edge is tolled.
+        vector<EdgeCriteria> outboundEdgeCriteria;
     };
 
+    constexpr float EARTH_RADIUS_METRES = 6371000.0f;
+
+    // https://en.wikipedia.org/wiki/Texas_State_Highway_130
+    // = 85 mph. Lower bounds on travel time assume nothing is faster than this.
+    constexpr float FASTEST_SPEED_METRES_PER_SECOND = 136.7942f / 3.6f;
+
+    // Walking pace, for the way between a location and the node it is snapped to
+    constexpr float WALKING_SPEED_METRES_PER_SECOND = 1.4f;
+
     inline float convertToRadians(const float angle) {
         return angle * (pi / 180);
     }
 
+    // Great circle distance between two (lat, lon) points in metres
     // Modified from https://github.com/AhiyaHiya/haversine/blob/master/source/haversine.cpp
-    inline float distance(
+    inline float greatCircleMetres(
         const pair<float, float> &loc1,
         const pair<float, float> &loc2
     ) {
-        const float earths_radius = 6371.0f;
-
         const float lat_delta = convertToRadians(loc2.first - loc1.first);
-        const float lon_delta = convertToRadians(loc2.second - loc2.second);
-
-        const float converted_lat1 = convertToRadians(loc1.first);
-        const float converted_lat2 = convertToRadians(loc2.first);
+        const float lon_delta = convertToRadians(loc2.second - loc1.second);
 
         const float a =
-            pow(sin(lat_delta / 2), 2) + cos(converted_lat1) * cos(converted_lat2) * pow(sin(lon_delta / 2), 2);
-
-        const float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-        const float d = earths_radius * c;
+            pow(sin(lat_delta / 2), 2) + cos(convertToRadians(loc1.first)) * cos(convertToRadians(loc2.first)) * pow(sin(lon_delta / 2), 2);
 
-        // https://en.wikipedia.org/wiki/Texas_State_Highway_130
-        // = 85 mph
-        float highestRoadLegalSpeedKps = 136.7942 / 60 / 60;
-
-        return d / highestRoadLegalSpeedKps;
+        return EARTH_RADIUS_METRES * 2 * atan2(sqrt(a), sqrt(1 - a));
     }
 
-    // convert our passed value to radians_t
-    
+    // Lower bound on the travel time in seconds between two points.
+    // Search code should prefer the precomputed bounds of TravelTimeHeuristic, which need no trigonometry.
+    inline float distance(
+        const pair<float, float> &loc1,
+        const pair<float, float> &loc2
+    ) {
+        return greatCircleMetres(loc1, loc2) / FASTEST_SPEED_METRES_PER_SECOND;
+    }
 }
\ No newline at end of file
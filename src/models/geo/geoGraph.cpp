@@ -1,119 +1,195 @@
+#include <algorithm>
+#include <cmath>
 #include <fstream>
-#include <functional>
+#include <limits>
 #include <stdexcept>
 #include <string>
-#include <queue>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
 
+#include "exclusionOverlay.h"
 #include "geoGraph.h"
+#include "models/linalg/components.h"
+#include "models/linalg/csrBuilder.h"
+#include "models/util/hilbert.h"
 
-using geo::distance;
+using geo::EdgeCriteria;
+using geo::ChainCompressionStats;
+using geo::EntryPosition;
+using geo::ExclusionOverlay;
 using geo::Graph;
+using geo::convertToRadians;
+using geo::greatCircleMetres;
 using geo::GraphNode;
+using geo::PhantomNode;
+using geo::RouteQuery;
+using geo::SnapCache;
+using geo::SnapCacheStats;
+using geo::SnapIndex;
+using geo::SearchSeed;
+using geo::SearchWorkspace;
+using geo::SegmentProjection;
+using geo::TravelTimeHeuristic;
+using geo::VertexOrder;
+using linalg::ComponentAnalysis;
+using linalg::CsrBuilder;
 using linalg::CsrMatrix;
-using linalg::MutableCsrMatrix;
+using linalg::DuplicatePolicy;
 using nlohmann::json;
-using std::greater;
 using std::cout;
 using std::endl;
+using std::function;
 using std::ifstream;
+using std::numeric_limits;
 using std::istream;
 using std::nullopt;
 using std::ofstream;
 using std::ostream;
 using std::optional;
 using std::pair;
-using std::priority_queue;
 using std::runtime_error;
+using std::span;
 using std::string;
 using std::to_string;
 using std::unordered_map;
-using std::unordered_set;
 using std::vector;
+using utils::hilbertIndex;
+using utils::MemoryResult;
+using utils::ThreadPool;
 
-using PriorityNode = pair<float, size_t>; // priority -> node
+namespace {
+    // Point of a route. Routes carry locations only, so every point has an empty node id.
+    GraphNode routePoint(pair<float, float> location) {
+        return GraphNode{location, "", {}, {}};
+    }
+
+    // Rank of each location along a Hilbert curve over the locations' bounding box, ties in input order
+    vector<size_t> hilbertRanks(const vector<double> &latitudes, const vector<double> &longitudes) {
+        size_t count = latitudes.size();
+        if (count == 0) {
+            return {};
+        }
+
+        auto [minLat, maxLat] = std::minmax_element(latitudes.begin(), latitudes.end());
+        auto [minLon, maxLon] = std::minmax_element(longitudes.begin(), longitudes.end());
+        float latScale = (*maxLat > *minLat) ? static_cast<float>(65535.0 / (*maxLat - *minLat)) : 0.0f;
+        float lonScale = (*maxLon > *minLon) ? static_cast<float>(65535.0 / (*maxLon - *minLon)) : 0.0f;
+
+        vector<pair<uint32_t, size_t>> keys(count);
+        for (size_t i = 0; i < count; i++) {
+            keys[i] = {hilbertIndex(latitudes[i], longitudes[i], *minLat, *minLon, latScale, lonScale), i};
+        }
+        std::sort(keys.begin(), keys.end());
+
+        vector<size_t> ranks(count);
+        for (size_t rank = 0; rank < count; rank++) {
+            ranks[keys[rank].second] = rank;
+        }
+
+        return ranks;
+    }
 
-Graph::Graph(const string &filename) {
+    // One workspace per thread, reused across queries and graphs (reset grows it as needed)
+    SearchWorkspace &threadWorkspace() {
+        static thread_local SearchWorkspace workspace;
+        return workspace;
+    }
+}
+
+Graph::Graph(const string &filename, VertexOrder order, ThreadPool *pool) {
     json j = loadFileAsJson(filename);
     vector<GraphNode> nodes = parseGraphNodes(j);
-    loadGraphFromNodes(nodes);
+    loadGraphFromNodes(nodes, order, pool);
 }
 
-Graph::Graph(vector<GraphNode> nodes) {
-    loadGraphFromNodes(nodes);
+Graph::Graph(vector<GraphNode> nodes, VertexOrder order, ThreadPool *pool) {
+    loadGraphFromNodes(nodes, order, pool);
 }
 
 optional<vector<GraphNode>> Graph::generateRoute(
     pair<float, float> origin,
-    pair<float, float> dest
-) {
-    // Step 1: Map coordinates to closest nodes
-    size_t nodeOrigin = _vertices.approximateNearestPoint(origin.first, origin.second);
-    size_t nodeDest = _vertices.approximateNearestPoint(dest.first, dest.second);
+    pair<float, float> dest,
+    const ExclusionOverlay *overlay
+) const {
+    return generateRoute(origin, dest, threadWorkspace(), overlay);
+}
 
-    // Step 2: Set up data structures
-    using NodeID = size_t;
-    unordered_map<NodeID, float> costSoFar;         // Distance from origin
-    unordered_map<NodeID, NodeID> cameFrom;         // For path reconstruction
-    unordered_set<NodeID> visited;
+optional<vector<GraphNode>> Graph::generateRoute(
+    pair<float, float> origin,
+    pair<float, float> dest,
+    SearchWorkspace &workspace,
+    const ExclusionOverlay *overlay
+) const {
+    // Step 1: Map coordinates onto the closest roads
+    optional<PhantomNode> phantomOrigin = snapToRoad(origin);
+    optional<PhantomNode> phantomDest = snapToRoad(dest);
 
-    // Priority queue: (priority, node)
-    priority_queue<PriorityNode, vector<PriorityNode>, greater<>> nodesToVisit;
-    nodesToVisit.emplace(distance(_vertices[nodeOrigin], _vertices[nodeDest]), nodeOrigin);
+    if (phantomOrigin.has_value() && phantomDest.has_value()) {
+        return generateRouteBetweenPhantoms(*phantomOrigin, *phantomDest, workspace, overlay);
+    }
 
-    costSoFar[nodeOrigin] = 0.0f;
-    cameFrom[nodeOrigin] = nodeOrigin;
+    // A graph without roads can only route from a node to itself
+    return generateRouteBetweenNodes(snapToNode(origin), snapToNode(dest), workspace, overlay);
+}
 
-    while (!nodesToVisit.empty()) {
-        PriorityNode current = nodesToVisit.top();
-        nodesToVisit.pop();
+optional<vector<GraphNode>> Graph::generateRouteBetweenNodes(
+    size_t nodeOrigin,
+    size_t nodeDest,
+    const ExclusionOverlay *overlay
+) const {
+    return generateRouteBetweenNodes(nodeOrigin, nodeDest, threadWorkspace(), overlay);
+}
 
-        NodeID currentNode = current.second;
+optional<vector<GraphNode>> Graph::generateRouteBetweenNodes(
+    size_t nodeOrigin,
+    size_t nodeDest,
+    SearchWorkspace &workspace,
+    const ExclusionOverlay *overlay
+) const {
+    // Different components: fail fast instead of exploring everything reachable from the origin
+    if (!mayReach(nodeOrigin, nodeDest)) {
+        return nullopt;
+    }
+
+    // Step 2: Set up data structures
+    workspace.reset(size());
+    workspace.update(nodeOrigin, 0.0f, nodeOrigin);
+    workspace.push(_heuristic.lowerBoundSeconds(nodeOrigin, nodeDest), nodeOrigin);
+
+    while (!workspace.frontierEmpty()) {
+        size_t currentNode = workspace.pop().second;
 
         if (currentNode == nodeDest) {
-            // Reconstruct path
             vector<GraphNode> path;
-            NodeID node = nodeDest;
-
-            while (node != nodeOrigin) {
-                const auto& baseNode = _vertices[node];
-                path.push_back(GraphNode{
-                    baseNode,
-                    "TODO_nodeId", // TODO: set real node ID
-                    {}
-                });
-                node = cameFrom[node];
-            }
-
-            const auto& originNode = _vertices[nodeOrigin];
-            path.push_back(GraphNode{
-                originNode,
-                "TODO_nodeId", // TODO: set real node ID
-                {}
-            });
-
-            reverse(path.begin(), path.end());
+            appendSearchPath(workspace, nodeOrigin, nodeDest, path);
             return path;
         }
 
-        if (visited.contains(currentNode)) {
+        // The heuristic is consistent, so a settled node never needs to be expanded again
+        if (workspace.settled(currentNode)) {
             continue;
         }
-        visited.insert(currentNode);
+        workspace.settle(currentNode);
 
         auto [distances, neighbors] = _edges.valuesInRow(currentNode);
+        size_t rowOffset = _edges.rowOffset(currentNode);
+        float currentCost = workspace.cost(currentNode);
 
         for (size_t i = 0; i < distances.num_items; ++i) {
-            NodeID neighbor = neighbors.items[i];
-            float edgeCost = distances.items[i];
-            float newCost = costSoFar[currentNode] + edgeCost;
+            if (overlay != nullptr && overlay->entryExcluded(rowOffset + i)) {
+                continue;
+            }
+
+            size_t neighbor = neighbors.items[i];
+            float newCost = currentCost + distances.items[i];
+
+            if (newCost < workspace.cost(neighbor)) {
+                if (!workspace.hasHeuristic(neighbor)) {
+                    workspace.setHeuristic(neighbor, _heuristic.lowerBoundSeconds(neighbor, nodeDest));
+                }
 
-            if (!costSoFar.contains(neighbor) || newCost < costSoFar[neighbor]) {
-                costSoFar[neighbor] = newCost;
-                float priority = newCost + distance(_vertices[neighbor], _vertices[nodeDest]); // A* priority = cost + heuristic
-                nodesToVisit.emplace(priority, neighbor);
-                cameFrom[neighbor] = currentNode;
+                workspace.update(neighbor, newCost, currentNode, rowOffset + i);
+                workspace.push(newCost + workspace.heuristic(neighbor), neighbor); // A* priority = cost + heuristic
             }
         }
     }
@@ -122,6 +198,826 @@ optional<vector<GraphNode>> Graph::generateRoute(
     return nullopt;
 }
 
+optional<vector<GraphNode>> Graph::generateRouteFromCandidates(
+    pair<float, float> origin,
+    pair<float, float> dest,
+    size_t candidates,
+    SearchWorkspace &workspace,
+    const ExclusionOverlay *overlay,
+    float snapSecondsPerMetre
+) const {
+    vector<SearchSeed> sources = snapCandidates(origin, candidates, snapSecondsPerMetre);
+    vector<SearchSeed> targets = snapCandidates(dest, candidates, snapSecondsPerMetre);
+
+    bool mayArrive = false;
+    for (const SearchSeed &source : sources) {
+        for (const SearchSeed &target : targets) {
+            mayArrive = mayArrive || mayReach(source.node, target.node);
+        }
+    }
+
+    if (!mayArrive) {
+        return nullopt;
+    }
+
+    float bestSeconds = numeric_limits<float>::infinity();
+    optional<size_t> target = searchBetweenSeeds(sources, targets, bestSeconds, workspace, overlay);
+
+    if (!target.has_value()) {
+        return nullopt;
+    }
+
+    size_t end = targets[*target].node;
+    size_t start = end;
+    while (workspace.parent(start) != start) {
+        start = workspace.parent(start);
+    }
+
+    vector<GraphNode> path;
+    appendSearchPath(workspace, start, end, path);
+    return path;
+}
+
+optional<vector<GraphNode>> Graph::generateRouteBetweenPhantoms(
+    const PhantomNode &origin,
+    const PhantomNode &dest,
+    SearchWorkspace &workspace,
+    const ExclusionOverlay *overlay
+) const {
+    // The origin's road leads on to the target of each of its entries, and the destination's road
+    // is entered from the source of each of its entries
+    vector<SearchSeed> sources;
+    vector<SearchSeed> targets;
+    vector<const EntryPosition *> sourcePositions;
+    vector<const EntryPosition *> targetPositions;
+
+    for (const EntryPosition *position : {&origin.forward, &origin.backward}) {
+        if (position->entry != NO_ENTRY && (overlay == nullptr || !overlay->entryExcluded(position->entry))) {
+            float seconds = (1.0f - position->fraction) * _edges.valueOfEntry(position->entry);
+            sources.push_back(SearchSeed{_edges.columnOfEntry(position->entry), seconds});
+            sourcePositions.push_back(position);
+        }
+    }
+
+    for (const EntryPosition *position : {&dest.forward, &dest.backward}) {
+        if (position->entry != NO_ENTRY && (overlay == nullptr || !overlay->entryExcluded(position->entry))) {
+            float seconds = position->fraction * _edges.valueOfEntry(position->entry);
+            targets.push_back(SearchSeed{_edges.rowOfEntry(position->entry), seconds});
+            targetPositions.push_back(position);
+        }
+    }
+
+    // Driving straight along the shared road, if the destination is ahead of the origin
+    float bestSeconds = numeric_limits<float>::infinity();
+    const EntryPosition *directFrom = nullptr;
+    const EntryPosition *directTo = nullptr;
+    bool mayArrive = false;
+
+    for (const EntryPosition *from : sourcePositions) {
+        for (const EntryPosition *to : targetPositions) {
+            if (from->entry == to->entry && from->fraction <= to->fraction) {
+                float seconds = (to->fraction - from->fraction) * _edges.valueOfEntry(from->entry);
+
+                if (seconds < bestSeconds) {
+                    bestSeconds = seconds;
+                    directFrom = from;
+                    directTo = to;
+                }
+            }
+        }
+    }
+
+    for (const SearchSeed &source : sources) {
+        for (const SearchSeed &target : targets) {
+            mayArrive = mayArrive || mayReach(source.node, target.node);
+        }
+    }
+
+    optional<size_t> target = nullopt;
+    if (mayArrive) {
+        target = searchBetweenSeeds(sources, targets, bestSeconds, workspace, overlay);
+    }
+
+    if (!target.has_value() && directFrom == nullptr) {
+        return nullopt;
+    }
+
+    vector<GraphNode> path;
+    path.push_back(routePoint(origin.location));
+
+    if (target.has_value()) {
+        size_t end = targets[*target].node;
+        size_t start = end;
+        while (workspace.parent(start) != start) {
+            start = workspace.parent(start);
+        }
+
+        // The fastest of the origin's positions leading to the node the route starts from
+        size_t source = sources.size();
+        for (size_t i = 0; i < sources.size(); i++) {
+            if (sources[i].node == start && (source == sources.size() || sources[i].seconds < sources[source].seconds)) {
+                source = i;
+            }
+        }
+
+        const EntryPosition *from = sourcePositions[source];
+        for (size_t i = from->hop + 1; i <= chainOf(from->entry).num_items; i++) {
+            path.push_back(routePoint(locationOf(pathNode(from->entry, i))));
+        }
+
+        appendSearchPath(workspace, start, end, path);
+
+        const EntryPosition *to = targetPositions[*target];
+        for (size_t i = 1; i <= to->hop; i++) {
+            path.push_back(routePoint(locationOf(pathNode(to->entry, i))));
+        }
+    } else {
+        for (size_t i = directFrom->hop + 1; i <= directTo->hop; i++) {
+            path.push_back(routePoint(locationOf(pathNode(directFrom->entry, i))));
+        }
+    }
+
+    path.push_back(routePoint(dest.location));
+    return path;
+}
+
+optional<size_t> Graph::searchBetweenSeeds(
+    span<const SearchSeed> sources,
+    span<const SearchSeed> targets,
+    float &bestSeconds,
+    SearchWorkspace &workspace,
+    const ExclusionOverlay *overlay
+) const {
+    workspace.reset(size());
+
+    // The fastest any target could still be reached from the node. A minimum of consistent bounds
+    // is consistent, so settled nodes never need to be expanded again.
+    auto heuristic = [&](size_t node) {
+        if (!workspace.hasHeuristic(node)) {
+            float bound = numeric_limits<float>::infinity();
+            for (const SearchSeed &target : targets) {
+                bound = std::min(bound, _heuristic.lowerBoundSeconds(node, target.node) + target.seconds);
+            }
+            workspace.setHeuristic(node, bound);
+        }
+
+        return workspace.heuristic(node);
+    };
+
+    for (const SearchSeed &source : sources) {
+        if (source.seconds < workspace.cost(source.node)) {
+            workspace.update(source.node, source.seconds, source.node);
+            workspace.push(source.seconds + heuristic(source.node), source.node);
+        }
+    }
+
+    optional<size_t> best = nullopt;
+
+    while (!workspace.frontierEmpty()) {
+        auto [priority, currentNode] = workspace.pop();
+
+        // Every route through the rest of the frontier takes at least its priority
+        if (priority >= bestSeconds) {
+            break;
+        }
+
+        if (workspace.settled(currentNode)) {
+            continue;
+        }
+        workspace.settle(currentNode);
+
+        float currentCost = workspace.cost(currentNode);
+
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (targets[i].node == currentNode && currentCost + targets[i].seconds < bestSeconds) {
+                bestSeconds = currentCost + targets[i].seconds;
+                best = i;
+            }
+        }
+
+        auto [distances, neighbors] = _edges.valuesInRow(currentNode);
+        size_t rowOffset = _edges.rowOffset(currentNode);
+
+        for (size_t i = 0; i < distances.num_items; ++i) {
+            if (overlay != nullptr && overlay->entryExcluded(rowOffset + i)) {
+                continue;
+            }
+
+            size_t neighbor = neighbors.items[i];
+            float newCost = currentCost + distances.items[i];
+
+            if (newCost < workspace.cost(neighbor)) {
+                workspace.update(neighbor, newCost, currentNode, rowOffset + i);
+                workspace.push(newCost + heuristic(neighbor), neighbor);
+            }
+        }
+    }
+
+    return best;
+}
+
+void Graph::appendSearchPath(const SearchWorkspace &workspace, size_t start, size_t end, vector<GraphNode> &path) const {
+    // The path is built backwards from the end, then turned around
+    size_t first = path.size();
+    size_t node = end;
+
+    while (node != start) {
+        path.push_back(routePoint(locationOf(node)));
+
+        // The skipped shape nodes go in reverse too
+        MemoryResult<const size_t> chain = chainOf(workspace.parentEntry(node));
+        for (size_t i = chain.num_items; i > 0; i--) {
+            path.push_back(routePoint(locationOf(chain.items[i - 1])));
+        }
+
+        node = workspace.parent(node);
+    }
+
+    path.push_back(routePoint(locationOf(start)));
+
+    reverse(path.begin() + first, path.end());
+}
+
+vector<optional<vector<GraphNode>>> Graph::routeBatch(
+    span<const RouteQuery> queries,
+    ThreadPool &pool,
+    const ExclusionOverlay *overlay
+) const {
+    vector<optional<vector<GraphNode>>> routes(queries.size());
+    vector<SearchWorkspace> workspaces(pool.size());
+
+    pool.parallelFor(queries.size(), [&](size_t slot, size_t index) {
+        routes[index] = generateRoute(queries[index].origin, queries[index].dest, workspaces[slot], overlay);
+    });
+
+    return routes;
+}
+
+void Graph::boundedOneToMany(
+    size_t origin,
+    const vector<size_t> &targets,
+    float maxCost,
+    SearchWorkspace &workspace,
+    vector<float> &costs,
+    const ExclusionOverlay *overlay
+) const {
+    costs.assign(targets.size(), numeric_limits<float>::infinity());
+    size_t targetsRemaining = targets.size();
+
+    workspace.reset(size());
+    workspace.update(origin, 0.0f, origin);
+    workspace.push(0.0f, origin);
+
+    while (!workspace.frontierEmpty() && targetsRemaining > 0) {
+        auto [currentCost, currentNode] = workspace.pop();
+
+        if (currentCost > maxCost) {
+            break;
+        }
+
+        if (workspace.settled(currentNode)) {
+            continue;
+        }
+        workspace.settle(currentNode);
+
+        // Targets may repeat, so every matching slot is filled
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (targets[i] == currentNode) {
+                costs[i] = currentCost;
+                targetsRemaining--;
+            }
+        }
+
+        auto [distances, neighbors] = _edges.valuesInRow(currentNode);
+        size_t rowOffset = _edges.rowOffset(currentNode);
+
+        for (size_t i = 0; i < distances.num_items; ++i) {
+            if (overlay != nullptr && overlay->entryExcluded(rowOffset + i)) {
+                continue;
+            }
+
+            size_t neighbor = neighbors.items[i];
+            float newCost = currentCost + distances.items[i];
+
+            if (newCost <= maxCost && newCost < workspace.cost(neighbor)) {
+                workspace.update(neighbor, newCost, currentNode);
+                workspace.push(newCost, neighbor);
+            }
+        }
+    }
+}
+
+void Graph::isochrone(
+    size_t origin,
+    float maxCost,
+    SearchWorkspace &workspace,
+    vector<pair<size_t, float>> &reached,
+    const ExclusionOverlay *overlay
+) const {
+    workspace.reset(size());
+    workspace.update(origin, 0.0f, origin);
+    workspace.push(0.0f, origin);
+
+    while (!workspace.frontierEmpty()) {
+        auto [currentCost, currentNode] = workspace.pop();
+
+        if (currentCost > maxCost) {
+            break;
+        }
+
+        if (workspace.settled(currentNode)) {
+            continue;
+        }
+        workspace.settle(currentNode);
+        reached.emplace_back(currentNode, currentCost);
+
+        auto [distances, neighbors] = _edges.valuesInRow(currentNode);
+        size_t rowOffset = _edges.rowOffset(currentNode);
+
+        for (size_t i = 0; i < distances.num_items; ++i) {
+            if (overlay != nullptr && overlay->entryExcluded(rowOffset + i)) {
+                continue;
+            }
+
+            size_t neighbor = neighbors.items[i];
+            float newCost = currentCost + distances.items[i];
+
+            if (newCost <= maxCost && newCost < workspace.cost(neighbor)) {
+                workspace.update(neighbor, newCost, currentNode);
+                workspace.push(newCost, neighbor);
+            }
+        }
+    }
+}
+
+size_t Graph::size() const {
+    return _vertices.size();
+}
+
+const CsrMatrix &Graph::edges() const {
+    return _edges;
+}
+
+float Graph::edgeLengthMetres(size_t entry) const {
+    return _edgeLengths[entry];
+}
+
+uint8_t Graph::edgeTolls(size_t entry) const {
+    return _edgeTolls[entry];
+}
+
+const TravelTimeHeuristic &Graph::heuristic() const {
+    return _heuristic;
+}
+
+pair<float, float> Graph::locationOf(size_t node) const {
+    return _vertices[_pointOfNode[node]];
+}
+
+size_t Graph::nodeOfInput(size_t index) const {
+    return _nodeOfPoint[_vertices.getNewIndex(index)];
+}
+
+void Graph::nodesInBox(float minLatitude, float minLongitude, float maxLatitude, float maxLongitude, vector<size_t> &result) const {
+    size_t first = result.size();
+    _vertices.pointsInBox(minLatitude, minLongitude, maxLatitude, maxLongitude, result);
+
+    for (size_t i = first; i < result.size(); i++) {
+        result[i] = _nodeOfPoint[result[i]];
+    }
+}
+
+bool Graph::mayReach(size_t nodeOrigin, size_t nodeDest) const {
+    uint32_t originComponent = _componentIds[nodeOrigin];
+    uint32_t destComponent = _componentIds[nodeDest];
+
+    if (originComponent == destComponent) {
+        return true;
+    }
+
+    return originComponent < destComponent
+        && _weakComponentIds[originComponent] == _weakComponentIds[destComponent];
+}
+
+size_t Graph::snapToNode(pair<float, float> location, bool preferLargestComponent) const {
+    return _nodeSnaps.findOrCompute(location, preferLargestComponent, [&] {
+        return snapToNodeUncached(location, preferLargestComponent);
+    });
+}
+
+size_t Graph::snapToNodeUncached(pair<float, float> location, bool preferLargestComponent) const {
+    size_t nearest = nearestChainEnd(nearestNode(location), location);
+
+    if (!preferLargestComponent || _componentIds[nearest] == _largestComponent) {
+        return nearest;
+    }
+
+    // Grow a box around the location until it holds a node of the largest component
+    // that is closer than the box's half-width, so nothing outside the box can beat it
+    pair<float, float> nearestLocation = locationOf(nearest);
+    float halfWidth = std::max({
+        std::abs(nearestLocation.first - location.first),
+        std::abs(nearestLocation.second - location.second),
+        0.001f
+    });
+
+    vector<size_t> candidates;
+
+    while (halfWidth < 360.0f) {
+        candidates.clear();
+        nodesInBox(
+            location.first - halfWidth, location.second - halfWidth,
+            location.first + halfWidth, location.second + halfWidth,
+            candidates
+        );
+
+        size_t best = nearest;
+        float bestDistance = numeric_limits<float>::max();
+
+        for (size_t candidate : candidates) {
+            if (_componentIds[candidate] != _largestComponent || isShapeNode(candidate)) {
+                continue;
+            }
+
+            auto [lat, lon] = locationOf(candidate);
+            float distanceSquared = (lat - location.first) * (lat - location.first)
+                + (lon - location.second) * (lon - location.second);
+
+            if (distanceSquared < bestDistance) {
+                bestDistance = distanceSquared;
+                best = candidate;
+            }
+        }
+
+        if (bestDistance <= halfWidth * halfWidth) {
+            return best;
+        }
+
+        halfWidth *= 2;
+    }
+
+    return nearest;
+}
+
+optional<PhantomNode> Graph::snapToRoad(pair<float, float> location, bool preferLargestComponent) const {
+    return _roadSnaps.findOrCompute(location, preferLargestComponent, [&] {
+        return snapToRoadUncached(location, preferLargestComponent);
+    });
+}
+
+optional<PhantomNode> Graph::snapToRoadUncached(pair<float, float> location, bool preferLargestComponent) const {
+    function<bool(size_t)> accept = nullptr;
+    if (preferLargestComponent) {
+        accept = [this](size_t segment) {
+            return _componentIds[_segmentNodes[segment * 2]] == _largestComponent
+                && _componentIds[_segmentNodes[segment * 2 + 1]] == _largestComponent;
+        };
+    }
+
+    optional<SegmentProjection> projection = _segments.nearest(location, accept);
+    if (!projection.has_value()) {
+        return nullopt;
+    }
+
+    size_t fromNode = _segmentNodes[projection->segment * 2];
+    size_t toNode = _segmentNodes[projection->segment * 2 + 1];
+
+    PhantomNode phantom;
+    phantom.location = projection->location;
+    phantom.snapMetres = projection->metres;
+    phantom.forward = positionOnHop(fromNode, toNode, projection->fraction);
+    phantom.backward = positionOnHop(toNode, fromNode, 1.0f - projection->fraction);
+
+    return phantom;
+}
+
+optional<PhantomNode> Graph::snapOntoChain(size_t node, pair<float, float> location) const {
+    if (!isShapeNode(node)) {
+        return nullopt;
+    }
+
+    size_t entry = _chainOfNode[node];
+    MemoryResult<const size_t> chain = chainOf(entry);
+    size_t index = std::find(chain.items, chain.items + chain.num_items, node) - chain.items + 1;
+
+    // Project in a plane around the location, with longitudes scaled to match latitudes
+    float lonScale = std::cos(convertToRadians(location.first));
+    size_t bestFrom = node;
+    size_t bestTo = node;
+    float bestFraction = 0.0f;
+    float bestDistance = numeric_limits<float>::infinity();
+    pair<float, float> bestPoint = locationOf(node);
+
+    for (size_t hop : {index - 1, index}) {
+        size_t fromNode = pathNode(entry, hop);
+        size_t toNode = pathNode(entry, hop + 1);
+        auto [fromLat, fromLon] = locationOf(fromNode);
+        auto [toLat, toLon] = locationOf(toNode);
+
+        float dy = toLat - fromLat;
+        float dx = (toLon - fromLon) * lonScale;
+        float lengthSquared = dx * dx + dy * dy;
+        float fraction = 0.0f;
+
+        if (lengthSquared > 0.0f) {
+            fraction = ((location.first - fromLat) * dy + (location.second - fromLon) * lonScale * dx) / lengthSquared;
+            fraction = std::clamp(fraction, 0.0f, 1.0f);
+        }
+
+        pair<float, float> point = {fromLat + fraction * (toLat - fromLat), fromLon + fraction * (toLon - fromLon)};
+        float offsetLat = point.first - location.first;
+        float offsetLon = (point.second - location.second) * lonScale;
+        float distance = offsetLat * offsetLat + offsetLon * offsetLon;
+
+        if (distance < bestDistance) {
+            bestFrom = fromNode;
+            bestTo = toNode;
+            bestFraction = fraction;
+            bestDistance = distance;
+            bestPoint = point;
+        }
+    }
+
+    PhantomNode phantom;
+    phantom.location = bestPoint;
+    phantom.snapMetres = greatCircleMetres(location, bestPoint);
+    phantom.forward = positionOnHop(bestFrom, bestTo, bestFraction);
+    phantom.backward = positionOnHop(bestTo, bestFrom, 1.0f - bestFraction);
+
+    return phantom;
+}
+
+ChainCompressionStats Graph::compressChains() {
+    ChainCompressionStats stats;
+    stats.entriesBefore = _edges.numEntries();
+    stats.entriesAfter = _edges.numEntries();
+
+    if (_chainOffsets.size() > 0) {
+        return stats;
+    }
+
+    size_t numNodes = size();
+    CsrMatrix reversed = _edges.transpose();
+
+    // A node passes traffic straight through if it has one way in and a different way out,
+    // or if it sits on a two-way road whose two neighbors are exactly its predecessors
+    vector<uint8_t> passThrough(numNodes, 0);
+
+    for (size_t node = 0; node < numNodes; node++) {
+        auto [outTimes, out] = _edges.valuesInRow(node);
+        auto [inTimes, in] = reversed.valuesInRow(node);
+
+        if (out.num_items != in.num_items) {
+            continue;
+        }
+
+        if (out.num_items == 1) {
+            passThrough[node] = in.items[0] != out.items[0] && in.items[0] != node && out.items[0] != node;
+        } else if (out.num_items == 2) {
+            size_t a = out.items[0], b = out.items[1];
+            bool distinct = a != b && a != node && b != node;
+            bool sameNeighbors = (in.items[0] == a && in.items[1] == b) || (in.items[0] == b && in.items[1] == a);
+            passThrough[node] = distinct && sameNeighbors;
+        }
+    }
+
+    vector<uint16_t> values;
+    vector<size_t> cols;
+    vector<size_t> rowPtr;
+    vector<float> lengths;
+    vector<uint8_t> tolls;
+    vector<size_t> chainOffsets;
+    vector<size_t> chainNodes;
+    vector<uint8_t> absorbed;
+
+    // Walk every chain from each node that is kept. Nodes that have to be kept after all
+    // (overflowing chains, closed loops of shape nodes) are demoted and the walk is redone.
+    bool demoted = true;
+
+    while (demoted) {
+        demoted = false;
+        values.clear();
+        cols.clear();
+        rowPtr.assign(1, 0);
+        lengths.clear();
+        tolls.clear();
+        chainOffsets.assign(1, 0);
+        chainNodes.clear();
+        absorbed.assign(numNodes, 0);
+
+        for (size_t row = 0; row < numNodes; row++) {
+            if (!passThrough[row]) {
+                auto [times, neighbors] = _edges.valuesInRow(row);
+                size_t rowOffset = _edges.rowOffset(row);
+
+                for (size_t i = 0; i < neighbors.num_items; i++) {
+                    uint32_t seconds = times.items[i];
+                    float metres = _edgeLengths[rowOffset + i];
+                    uint32_t tollCount = _edgeTolls[rowOffset + i];
+                    size_t previous = row;
+                    size_t current = neighbors.items[i];
+
+                    while (passThrough[current]) {
+                        // Leave by the way that doesn't lead back to where we came from
+                        auto [nextTimes, nextNeighbors] = _edges.valuesInRow(current);
+                        size_t way = (nextNeighbors.num_items == 2 && nextNeighbors.items[0] == previous) ? 1 : 0;
+                        size_t next = _edges.rowOffset(current) + way;
+                        uint32_t nextSeconds = seconds + nextTimes.items[way];
+
+                        if (nextSeconds > numeric_limits<uint16_t>::max()) {
+                            passThrough[current] = 0;
+                            demoted = true;
+                            break;
+                        }
+
+                        chainNodes.push_back(current);
+                        absorbed[current] = 1;
+
+                        seconds = nextSeconds;
+                        metres += _edgeLengths[next];
+                        tollCount += _edgeTolls[next];
+                        previous = current;
+                        current = nextNeighbors.items[way];
+                    }
+
+                    values.push_back(static_cast<uint16_t>(seconds));
+                    cols.push_back(current);
+                    lengths.push_back(metres);
+                    tolls.push_back(static_cast<uint8_t>(std::min<uint32_t>(tollCount, numeric_limits<uint8_t>::max())));
+                    chainOffsets.push_back(chainNodes.size());
+                }
+            }
+
+            rowPtr.push_back(values.size());
+        }
+
+        // Loops made only of shape nodes can't be reached from a kept node
+        for (size_t node = 0; node < numNodes; node++) {
+            if (passThrough[node] && !absorbed[node]) {
+                passThrough[node] = 0;
+                demoted = true;
+            }
+        }
+    }
+
+    vector<size_t> chainOfNode(numNodes, NO_CHAIN);
+    for (size_t entry = 0; entry < values.size(); entry++) {
+        for (size_t i = chainOffsets[entry]; i < chainOffsets[entry + 1]; i++) {
+            chainOfNode[chainNodes[i]] = entry;
+        }
+    }
+
+    _edges = CsrMatrix(numNodes, numNodes, values, cols, rowPtr);
+    _edgeLengths = ListWithSize<float>(lengths);
+    _edgeTolls = ListWithSize<uint8_t>(tolls);
+    _chainOffsets = ListWithSize<size_t>(chainOffsets);
+    _chainNodes = ListWithSize<size_t>(chainNodes);
+    _chainOfNode = ListWithSize<size_t>(chainOfNode);
+
+    // Shape nodes no longer snap to themselves, and phantoms sit on the new entries
+    _nodeSnaps.clear();
+    _roadSnaps.clear();
+
+    for (size_t node = 0; node < numNodes; node++) {
+        stats.shapeNodes += passThrough[node];
+    }
+    stats.entriesAfter = _edges.numEntries();
+
+    return stats;
+}
+
+bool Graph::isShapeNode(size_t node) const {
+    return _chainOfNode.size() > 0 && _chainOfNode[node] != NO_CHAIN;
+}
+
+MemoryResult<const size_t> Graph::chainOf(size_t entry) const {
+    if (_chainOffsets.size() == 0) {
+        return MemoryResult<const size_t>{0, nullptr};
+    }
+
+    size_t start = _chainOffsets[entry];
+    return MemoryResult<const size_t>{_chainOffsets[entry + 1] - start, _chainNodes.data() + start};
+}
+
+vector<size_t> Graph::entriesTraversing(size_t fromNode, size_t toNode) const {
+    vector<size_t> result;
+
+    // An entry of fromNode's own row only contains the hop if it arrives at toNode directly
+    auto [values, columns] = _edges.valuesInRow(fromNode);
+    size_t rowOffset = _edges.rowOffset(fromNode);
+
+    for (size_t i = 0; i < columns.num_items; i++) {
+        if (columns.items[i] == toNode && chainOf(rowOffset + i).num_items == 0) {
+            result.push_back(rowOffset + i);
+        }
+    }
+
+    if (!isShapeNode(fromNode) && !isShapeNode(toNode)) {
+        return result;
+    }
+
+    // Otherwise the hop lies inside a chain. Both directions of a two-way road start at one of the
+    // two ends of the known chain, so only those two rows need to be searched.
+    size_t knownEntry = _chainOfNode[isShapeNode(fromNode) ? fromNode : toNode];
+    size_t ends[2] = {_edges.rowOfEntry(knownEntry), _edges.columnOfEntry(knownEntry)};
+
+    for (size_t end = 0; end < 2; end++) {
+        if (end == 1 && ends[1] == ends[0]) {
+            break;
+        }
+
+        auto [endValues, endColumns] = _edges.valuesInRow(ends[end]);
+        size_t endOffset = _edges.rowOffset(ends[end]);
+
+        for (size_t i = 0; i < endColumns.num_items; i++) {
+            MemoryResult<const size_t> chain = chainOf(endOffset + i);
+            size_t previous = ends[end];
+
+            for (size_t j = 0; j <= chain.num_items; j++) {
+                size_t next = j < chain.num_items ? chain.items[j] : endColumns.items[i];
+
+                if (previous == fromNode && next == toNode && chain.num_items > 0) {
+                    result.push_back(endOffset + i);
+                    break;
+                }
+
+                previous = next;
+            }
+        }
+    }
+
+    return result;
+}
+
+size_t Graph::nearestChainEnd(size_t node, pair<float, float> location) const {
+    if (!isShapeNode(node)) {
+        return node;
+    }
+
+    size_t entry = _chainOfNode[node];
+    size_t ends[2] = {_edges.rowOfEntry(entry), _edges.columnOfEntry(entry)};
+    float distanceSquared[2];
+
+    for (size_t end = 0; end < 2; end++) {
+        auto [lat, lon] = locationOf(ends[end]);
+        distanceSquared[end] = (lat - location.first) * (lat - location.first)
+            + (lon - location.second) * (lon - location.second);
+    }
+
+    return distanceSquared[0] <= distanceSquared[1] ? ends[0] : ends[1];
+}
+
+size_t Graph::pathNode(size_t entry, size_t index) const {
+    if (index == 0) {
+        return _edges.rowOfEntry(entry);
+    }
+
+    MemoryResult<const size_t> chain = chainOf(entry);
+    return index <= chain.num_items ? chain.items[index - 1] : _edges.columnOfEntry(entry);
+}
+
+EntryPosition Graph::positionOnHop(size_t fromNode, size_t toNode, float along) const {
+    EntryPosition position;
+
+    for (size_t entry : entriesTraversing(fromNode, toNode)) {
+        if (position.entry == NO_ENTRY || _edges.valueOfEntry(entry) < _edges.valueOfEntry(position.entry)) {
+            position.entry = entry;
+        }
+    }
+
+    if (position.entry == NO_ENTRY) {
+        return position;
+    }
+
+    size_t numHops = chainOf(position.entry).num_items + 1;
+    if (numHops == 1) {
+        position.fraction = along;
+        return position;
+    }
+
+    // Travel time is shared out between the hops of a chain by their length
+    float before = 0.0f;
+    float total = 0.0f;
+    float hopMetres = 0.0f;
+
+    for (size_t hop = 0; hop < numHops; hop++) {
+        size_t hopFrom = pathNode(position.entry, hop);
+        size_t hopTo = pathNode(position.entry, hop + 1);
+        float metres = greatCircleMetres(locationOf(hopFrom), locationOf(hopTo));
+
+        if (hopFrom == fromNode && hopTo == toNode) {
+            position.hop = hop;
+            before = total;
+            hopMetres = metres;
+        }
+
+        total += metres;
+    }
+
+    position.fraction = (total > 0.0f) ? (before + along * hopMetres) / total : 0.0f;
+    return position;
+}
+
 json Graph::loadFileAsJson(const string& filename) {
     ifstream file(filename);
     if (!file.is_open()) {
@@ -152,8 +1048,8 @@ vector<GraphNode> Graph::parseGraphNodes(const json& j) {
         if (nodeJson.contains("location")) {
             const auto& loc = nodeJson["location"];
             if (loc.contains("lat") && loc.contains("lng")) {
-                node.location.first = loc["lat"].get<float>();
-                node.location.second = loc["lng"].get<float>();
+                node.location.first = loc["lat"].get<double>();
+                node.location.second = loc["lng"].get<double>();
             }
         }
 
@@ -164,6 +1060,16 @@ vector<GraphNode> Graph::parseGraphNodes(const json& j) {
                     string neighborId = to_string(neighbor["node_id"].get<size_t>());
                     float transitTimeSec = neighbor["transit_time_sec"].get<float>();
                     node.outboundAccessibleNodesWithTime.emplace_back(neighborId, transitTimeSec);
+
+                    // Secondary criteria are optional; missing lengths are filled in from the coordinates later
+                    EdgeCriteria criteria;
+                    if (neighbor.contains("length_m")) {
+                        criteria.lengthMetres = neighbor["length_m"].get<float>();
+                    }
+                    if (neighbor.contains("toll")) {
+                        criteria.toll = neighbor["toll"].get<bool>();
+                    }
+                    node.outboundEdgeCriteria.push_back(criteria);
                 }
             }
         }
@@ -174,47 +1080,327 @@ vector<GraphNode> Graph::parseGraphNodes(const json& j) {
     return graphNodes;
 }
 
-void Graph::loadGraphFromNodes(vector<GraphNode> nodes) {
+void Graph::loadGraphFromNodes(vector<GraphNode> nodes, VertexOrder order, ThreadPool *pool) {
     unordered_map<string, size_t> nodeIdToIndex = unordered_map<string, size_t>();
 
     for (size_t i = 0; i < nodes.size(); i++) {
         nodeIdToIndex[nodes[i].nodeId] = i;
     }
 
-    vector<pair<float, float>> node_locations = vector<pair<float, float>>();
-    for (GraphNode node: nodes) {
-        node_locations.push_back(node.location);
+    // In double, so the tree's microdegrees keep the precision of the input
+    vector<double> latitudes = vector<double>(nodes.size());
+    vector<double> longitudes = vector<double>(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        latitudes[i] = nodes[i].location.first;
+        longitudes[i] = nodes[i].location.second;
     }
 
-    _vertices = Dim2Tree(node_locations);
-    MutableCsrMatrix edge_construction = MutableCsrMatrix(nodes.size(), nodes.size()); 
+    _vertices = Dim2Tree(latitudes, longitudes, pool);
+
+    // Node id of each input node, and of each of the tree's points
+    vector<size_t> nodeOfInput(nodes.size());
+    if (order == VertexOrder::Hilbert) {
+        nodeOfInput = hilbertRanks(latitudes, longitudes);
+    } else {
+        for (size_t i = 0; i < nodes.size(); i++) {
+            nodeOfInput[i] = _vertices.getNewIndex(i);
+        }
+    }
+
+    // The tree has already checked that there are at most 2^32 points
+    _nodeOfPoint = ListWithSize<uint32_t>(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        _nodeOfPoint[_vertices.getNewIndex(i)] = static_cast<uint32_t>(nodeOfInput[i]);
+    }
+
+    buildPointOfNode();
+
+    size_t numEdges = 0;
+    for (const GraphNode &node : nodes) {
+        numEdges += node.outboundAccessibleNodesWithTime.size();
+    }
+
+    CsrBuilder edge_construction = CsrBuilder(nodes.size(), nodes.size());
+    edge_construction.reserve(numEdges);
 
     for (size_t i = 0; i < nodes.size(); i++) {
         for (const auto& [connectedVertexId, transitTimeSec] : nodes[i].outboundAccessibleNodesWithTime) {
-            size_t departNodeId = _vertices.getNewIndex(i);
-            size_t arriveNodeId = _vertices.getNewIndex(nodeIdToIndex[connectedVertexId]);
+            size_t departNodeId = nodeOfInput[i];
+            size_t arriveNodeId = nodeOfInput[nodeIdToIndex[connectedVertexId]];
 
-            uint16_t transitTimeSeconds = static_cast<uint16_t>(transitTimeSec);
-            if (transitTimeSeconds <= 0) transitTimeSeconds = 1;  // avoid 0 cost
+            // Rounded up: the heuristic assumes no edge is faster than its speed bound
+            float roundedSeconds = std::ceil(transitTimeSec);
+            uint16_t transitTimeSeconds = (roundedSeconds >= 1.0f)
+                ? static_cast<uint16_t>(std::min(roundedSeconds, static_cast<float>(numeric_limits<uint16_t>::max())))
+                : 1;  // avoid 0 cost
 
             edge_construction.addEntry(departNodeId, arriveNodeId, transitTimeSeconds);
         }
     }
 
-    _edges = CsrMatrix(edge_construction);
+    _edges = edge_construction.build(false, DuplicatePolicy::Keep, pool);
+
+    // Each row of the matrix holds exactly one node's neighbors, in list order
+    vector<float> edgeLengths(_edges.numEntries());
+    vector<uint8_t> edgeTolls(_edges.numEntries(), 0);
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const GraphNode &node = nodes[i];
+        size_t rowOffset = _edges.rowOffset(nodeOfInput[i]);
+        bool hasCriteria = node.outboundEdgeCriteria.size() == node.outboundAccessibleNodesWithTime.size();
+
+        for (size_t j = 0; j < node.outboundAccessibleNodesWithTime.size(); j++) {
+            const GraphNode &neighbor = nodes[nodeIdToIndex[node.outboundAccessibleNodesWithTime[j].first]];
+            float lengthMetres = hasCriteria ? node.outboundEdgeCriteria[j].lengthMetres : 0.0f;
+
+            if (lengthMetres <= 0.0f) {
+                lengthMetres = greatCircleMetres(node.location, neighbor.location);
+            }
+
+            edgeLengths[rowOffset + j] = lengthMetres;
+            edgeTolls[rowOffset + j] = hasCriteria && node.outboundEdgeCriteria[j].toll;
+        }
+    }
+
+    _edgeLengths = ListWithSize<float>(edgeLengths);
+    _edgeTolls = ListWithSize<uint8_t>(edgeTolls);
+
+    _heuristic = TravelTimeHeuristic(_vertices, span<const uint32_t>(_nodeOfPoint.data(), _nodeOfPoint.size()));
+    analyzeConnectivity(pool);
+    buildSegments(pool);
+}
+
+void Graph::analyzeConnectivity(ThreadPool *pool) {
+    ComponentAnalysis analysis = linalg::analyzeComponents(_edges, pool);
+
+    _componentIds = ListWithSize<uint32_t>(analysis.componentOf);
+    _componentSizes = ListWithSize<uint32_t>(analysis.componentSize);
+    _weakComponentIds = ListWithSize<uint32_t>(analysis.weakComponentOf);
+    _largestComponent = analysis.largestComponent;
+}
+
+void Graph::buildPointOfNode() {
+    _pointOfNode = ListWithSize<uint32_t>(_nodeOfPoint.size());
+
+    for (size_t point = 0; point < _nodeOfPoint.size(); point++) {
+        _pointOfNode[_nodeOfPoint[point]] = static_cast<uint32_t>(point);
+    }
+}
+
+pair<vector<float>, vector<float>> Graph::vertexLocations() const {
+    vector<float> latitudes(size());
+    vector<float> longitudes(size());
+
+    for (size_t node = 0; node < size(); node++) {
+        std::tie(latitudes[node], longitudes[node]) = locationOf(node);
+    }
+
+    return {latitudes, longitudes};
+}
+
+void Graph::buildGrid() {
+    auto [latitudes, longitudes] = vertexLocations();
+    _grid = SpatialGrid(latitudes, longitudes);
+}
+
+void Graph::buildSphere() {
+    auto [latitudes, longitudes] = vertexLocations();
+    _sphere = SphereIndex(latitudes, longitudes);
+}
+
+void Graph::buildSegments(ThreadPool *pool) {
+    vector<pair<float, float>> starts;
+    vector<pair<float, float>> ends;
+    vector<size_t> segmentNodes;
+
+    for (size_t entry = 0; entry < _edges.numEntries(); entry++) {
+        size_t numHops = chainOf(entry).num_items + 1;
+
+        for (size_t hop = 0; hop < numHops; hop++) {
+            size_t fromNode = pathNode(entry, hop);
+            size_t toNode = pathNode(entry, hop + 1);
+
+            // Both directions of a two-way road share the segment leaving the lower node
+            if (fromNode == toNode || (fromNode > toNode && !entriesTraversing(toNode, fromNode).empty())) {
+                continue;
+            }
+
+            starts.push_back(locationOf(fromNode));
+            ends.push_back(locationOf(toNode));
+            segmentNodes.push_back(fromNode);
+            segmentNodes.push_back(toNode);
+        }
+    }
+
+    _segments = SegmentIndex(starts, ends, pool);
+    _segmentNodes = ListWithSize<size_t>(segmentNodes);
+}
+
+size_t Graph::nearestNode(pair<float, float> location) const {
+    if (_snapIndex == SnapIndex::Grid) {
+        return _grid.originalIndex(_grid.nearestPoint(location.first, location.second));
+    }
+
+    if (_snapIndex == SnapIndex::Sphere) {
+        return _sphere.nearest(location);
+    }
+
+    return _nodeOfPoint[_vertices.nearestPoint(location.first, location.second)];
+}
+
+void Graph::nearestNodes(pair<float, float> location, size_t k, vector<size_t> &result) const {
+    if (_snapIndex == SnapIndex::Grid) {
+        size_t first = result.size();
+        _grid.kNearest(location.first, location.second, k, result);
+
+        for (size_t i = first; i < result.size(); i++) {
+            result[i] = _grid.originalIndex(result[i]);
+        }
+        return;
+    }
+
+    if (_snapIndex == SnapIndex::Sphere) {
+        _sphere.kNearest(location, k, result);
+        return;
+    }
+
+    size_t first = result.size();
+    _vertices.kNearest(location.first, location.second, k, result);
+
+    for (size_t i = first; i < result.size(); i++) {
+        result[i] = _nodeOfPoint[result[i]];
+    }
+}
+
+vector<SearchSeed> Graph::snapCandidates(pair<float, float> location, size_t k, float secondsPerMetre) const {
+    vector<size_t> nearest;
+    nearestNodes(location, k, nearest);
+
+    vector<SearchSeed> seeds;
+    for (size_t node : nearest) {
+        size_t candidate = nearestChainEnd(node, location);
+
+        bool seen = std::any_of(seeds.begin(), seeds.end(), [candidate](const SearchSeed &seed) {
+            return seed.node == candidate;
+        });
+
+        if (!seen) {
+            seeds.push_back(SearchSeed{candidate, greatCircleMetres(location, locationOf(candidate)) * secondsPerMetre});
+        }
+    }
+
+    return seeds;
+}
+
+void Graph::setSnapIndex(SnapIndex index) {
+    if (index == SnapIndex::Grid && _grid.size() != size()) {
+        buildGrid();
+    }
+
+    if (index == SnapIndex::Sphere && _sphere.size() != size()) {
+        buildSphere();
+    }
+
+    // Indices may break ties between equally near nodes differently
+    if (index != _snapIndex) {
+        _nodeSnaps.clear();
+    }
+
+    _snapIndex = index;
+}
+
+SnapIndex Graph::snapIndex() const {
+    return _snapIndex;
+}
+
+void Graph::setSnapCacheSize(size_t slots) {
+    _nodeSnaps = SnapCache<size_t>(slots);
+    _roadSnaps = SnapCache<optional<PhantomNode>>(slots);
+}
+
+SnapCacheStats Graph::snapCacheStats() const {
+    SnapCacheStats nodeStats = _nodeSnaps.stats();
+    SnapCacheStats roadStats = _roadSnaps.stats();
+
+    SnapCacheStats stats;
+    stats.hits = nodeStats.hits + roadStats.hits;
+    stats.misses = nodeStats.misses + roadStats.misses;
+    stats.capacity = nodeStats.capacity + roadStats.capacity;
+    return stats;
 }
 
 namespace geo {
     istream &operator>>(istream &input, Graph &graph) {
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        input.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        input.read(reinterpret_cast<char*>(&version), sizeof(version));
+
+        if (magic != GRAPH_FILE_MAGIC || version != GRAPH_FORMAT_VERSION) {
+            throw runtime_error(format("Not a version {} graph file; regenerate it with graphJsonToBinary", GRAPH_FORMAT_VERSION));
+        }
+
         input >> graph._vertices;
+        input >> graph._nodeOfPoint;
         input >> graph._edges;
+        input >> graph._edgeLengths;
+        input >> graph._edgeTolls;
+        input >> graph._componentIds;
+        input >> graph._componentSizes;
+        input >> graph._weakComponentIds;
+        input >> graph._chainOffsets;
+        input >> graph._chainNodes;
+        input >> graph._chainOfNode;
+        input >> graph._segments;
+        input >> graph._segmentNodes;
+        input.read(reinterpret_cast<char*>(&graph._snapIndex), sizeof(graph._snapIndex));
+
+        graph.buildPointOfNode();
+        graph._heuristic = TravelTimeHeuristic(graph._vertices, span<const uint32_t>(graph._nodeOfPoint.data(), graph._nodeOfPoint.size()));
+
+        // Built from no points rather than default constructed, which trips a false
+        // -Wstringop-overflow in GCC 12's inlining of the copy
+        graph._grid = SpatialGrid(span<const float>(), span<const float>());
+        if (graph._snapIndex == SnapIndex::Grid) {
+            graph.buildGrid();
+        }
+
+        graph._sphere = SphereIndex();
+        if (graph._snapIndex == SnapIndex::Sphere) {
+            graph.buildSphere();
+        }
+
+        graph._nodeSnaps.clear();
+        graph._roadSnaps.clear();
+
+        graph._largestComponent = 0;
+        for (uint32_t component = 0; component < graph._componentSizes.size(); component++) {
+            if (graph._componentSizes[component] > graph._componentSizes[graph._largestComponent]) {
+                graph._largestComponent = component;
+            }
+        }
 
         return input;
     }
 
     ostream &operator<<(ostream &output, const Graph &graph) {
+        output.write(reinterpret_cast<const char*>(&GRAPH_FILE_MAGIC), sizeof(GRAPH_FILE_MAGIC));
+        output.write(reinterpret_cast<const char*>(&GRAPH_FORMAT_VERSION), sizeof(GRAPH_FORMAT_VERSION));
+
         output << graph._vertices;
+        output << graph._nodeOfPoint;
         output << graph._edges;
+        output << graph._edgeLengths;
+        output << graph._edgeTolls;
+        output << graph._componentIds;
+        output << graph._componentSizes;
+        output << graph._weakComponentIds;
+        output << graph._chainOffsets;
+        output << graph._chainNodes;
+        output << graph._chainOfNode;
+        output << graph._segments;
+        output << graph._segmentNodes;
+        output.write(reinterpret_cast<const char*>(&graph._snapIndex), sizeof(graph._snapIndex));
 
         return output;
     }
@@ -1,48 +1,414 @@
 #pragma once
 
 #include <iostream>
+#include <limits>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "external/nlohmann/json.hpp"
 #include "models/geo/geoData.h"
+#include "models/geo/heuristic.h"
+#include "models/geo/searchWorkspace.h"
+#include "models/geo/segmentIndex.h"
+#include "models/geo/snapCache.h"
+#include "models/geo/sphereIndex.h"
 #include "models/linalg/csr.h"
 #include "models/util/dim2Tree.h"
+#include "models/util/spatialGrid.h"
+#include "models/util/threadPool.h"
 
 using geo::GraphNode;
+using geo::SearchWorkspace;
+using geo::SegmentIndex;
+using geo::SnapCache;
+using geo::SnapCacheStats;
+using geo::TravelTimeHeuristic;
 using linalg::CsrMatrix;
 using nlohmann::json;
 using std::istream;
+using std::numeric_limits;
 using std::optional;
 using std::ostream;
+using std::span;
 using std::string;
 using std::vector;
 using utils::Dim2Tree;
+using utils::ListWithSize;
+using utils::MemoryResult;
+using utils::SpatialGrid;
+using utils::ThreadPool;
 
 namespace geo {
+    class ExclusionOverlay;
+
+    constexpr size_t NO_CHAIN = numeric_limits<size_t>::max();
+    constexpr size_t NO_ENTRY = numeric_limits<size_t>::max();
+
+    // Slots in each snap cache of a graph that serves queries (see Graph::setSnapCacheSize).
+    // The two caches take about 1.8 MB together.
+    constexpr size_t SERVING_SNAP_CACHE_SLOTS = 1 << 14;
+
+    // Saved graphs start with this tag and version. The version goes up whenever the layout of
+    // a saved graph changes, and files of any other version must be regenerated from the JSON.
+    constexpr uint32_t GRAPH_FILE_MAGIC = 0x48505247;  // "GRPH"
+    constexpr uint32_t GRAPH_FORMAT_VERSION = 2;
+
+    struct ChainCompressionStats {
+        size_t shapeNodes = 0;
+        size_t entriesBefore = 0;
+        size_t entriesAfter = 0;
+    };
+
+    // Index used to snap locations to nodes. Tree is built and saved with every graph, and also
+    // holds the node locations. Grid may be faster in dense regions (see selectSnapIndex). Sphere
+    // ranks nodes by great circle distance instead of distance in degrees, which matters at high
+    // latitudes and across the antimeridian. Grid and Sphere keep their own copies of the
+    // locations, so they are only built once selected and are rebuilt on load rather than saved.
+    enum class SnapIndex : uint8_t {
+        Tree,
+        Grid,
+        Sphere
+    };
+
+    // Numbering of a graph's nodes. Searches touch a node's row of the matrix, its workspace slots and
+    // its heuristic vector, all by node id, so nodes that are near each other on the map should be
+    // near each other in memory.
+    enum class VertexOrder : uint8_t {
+        // Ids follow the Dim2Tree's order of the nodes, as graphs were numbered before: neighbours on
+        // the map are usually far apart below the top few levels of the tree
+        Tree,
+
+        // Ids follow a Hilbert curve over the graph's bounding box, so most roads join nodes with
+        // nearby ids
+        Hilbert
+    };
+
+    struct RouteQuery {
+        pair<float, float> origin;
+        pair<float, float> dest;
+    };
+
+    // A point part-way along an entry: on hop `hop` of the entry's expanded path (hop 0 leaves the
+    // entry's source, and a compressed chain has one more hop than it skips nodes), with `fraction`
+    // of the entry's travel time behind it
+    struct EntryPosition {
+        size_t entry = NO_ENTRY;
+        size_t hop = 0;
+        float fraction = 0.0f;
+    };
+
+    // A location snapped onto a road rather than onto a node (see Graph::snapToRoad)
+    struct PhantomNode {
+        // The location's projection onto the road, and how far it was moved to get there
+        pair<float, float> location = {0.0f, 0.0f};
+        float snapMetres = 0.0f;
+
+        // The position along the road, and along its opposite direction. backward.entry is
+        // NO_ENTRY on a one-way road.
+        EntryPosition forward;
+        EntryPosition backward;
+    };
+
+    // Where a search starts or ends: a node, and the seconds it takes to reach it from the start of
+    // the route (for a source) or to reach the end of the route from it (for a target)
+    struct SearchSeed {
+        size_t node;
+        float seconds;
+    };
+
+    /**
+    * Road graph: node locations in a Dim2Tree and travel times in a CsrMatrix.
+    * Nodes are numbered by a VertexOrder, independently of the Dim2Tree's own order of its points.
+    * Once built (and compressed, if at all), a Graph is immutable. Every const method is safe
+    * to call from many threads on one shared Graph; per-query state lives in a SearchWorkspace
+    * (or a ParetoWorkspace etc.) owned by the caller, or a thread-local one for the overloads
+    * that don't take a workspace.
+    */
     class Graph {
         public:
         Graph() = default;
-        Graph(const string &filename);
-        Graph(vector<GraphNode> nodes);
 
+        // The node locations, edges and segment index are built on the pool's workers if there is
+        // a pool, and on the calling thread otherwise
+        Graph(const string &filename, VertexOrder order = VertexOrder::Hilbert, ThreadPool *pool = nullptr);
+        Graph(vector<GraphNode> nodes, VertexOrder order = VertexOrder::Hilbert, ThreadPool *pool = nullptr);
+
+        // Origin and destination are snapped onto roads (see snapToRoad), and the route starts and
+        // ends at their projections. Searches skip every entry closed by the overlay, if one is given.
         optional<vector<GraphNode>> generateRoute(
             pair<float, float> origin,
-            pair<float, float> dest
-        );
+            pair<float, float> dest,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Same as above, with caller-provided search state instead of a thread-local one
+        optional<vector<GraphNode>> generateRoute(
+            pair<float, float> origin,
+            pair<float, float> dest,
+            SearchWorkspace &workspace,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Same as generateRoute, from any of the nodes nearest the origin to any of the nodes nearest
+        // the destination (as many of each as candidates), in one search from all of the origin's
+        // candidates to all of the destination's. Each candidate adds its great circle distance from the location
+        // at snapSecondsPerMetre to the route's time, so a farther node is only chosen if it saves
+        // more driving than that. The route runs between the chosen nodes.
+        optional<vector<GraphNode>> generateRouteFromCandidates(
+            pair<float, float> origin,
+            pair<float, float> dest,
+            size_t candidates,
+            SearchWorkspace &workspace,
+            const ExclusionOverlay *overlay = nullptr,
+            float snapSecondsPerMetre = 1.0f / WALKING_SPEED_METRES_PER_SECOND
+        ) const;
+
+        // Same as generateRoute, for origin and destination that are already snapped onto roads.
+        // The search starts from both ends of the origin's road (one, on a one-way road) at the
+        // time it takes to drive there, and ends at either end of the destination's road. If the
+        // destination lies ahead of the origin on the same road, it may be driven to directly.
+        optional<vector<GraphNode>> generateRouteBetweenPhantoms(
+            const PhantomNode &origin,
+            const PhantomNode &dest,
+            SearchWorkspace &workspace,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Same as generateRoute, for origin and destination that are already graph nodes
+        optional<vector<GraphNode>> generateRouteBetweenNodes(
+            size_t nodeOrigin,
+            size_t nodeDest,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Same as above, with caller-provided search state instead of a thread-local one
+        optional<vector<GraphNode>> generateRouteBetweenNodes(
+            size_t nodeOrigin,
+            size_t nodeDest,
+            SearchWorkspace &workspace,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Route every query on the pool's workers, one workspace per worker, against this one graph.
+        // Results are in query order.
+        vector<optional<vector<GraphNode>>> routeBatch(
+            span<const RouteQuery> queries,
+            ThreadPool &pool,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
         void dump(const string &filename);
 
+        // Travel time from origin to each of the targets, written to costs in target order.
+        // Targets that cannot be reached within maxCost seconds get infinity.
+        // The search stops as soon as every target is settled or the frontier passes maxCost.
+        // Entries closed by the overlay, if one is given, are skipped.
+        void boundedOneToMany(
+            size_t origin,
+            const vector<size_t> &targets,
+            float maxCost,
+            SearchWorkspace &workspace,
+            vector<float> &costs,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Every node reachable from origin within maxCost seconds, with its travel time, appended to
+        // reached in order of increasing time. Shape nodes of a compressed graph are not reported.
+        void isochrone(
+            size_t origin,
+            float maxCost,
+            SearchWorkspace &workspace,
+            vector<pair<size_t, float>> &reached,
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        size_t size() const;
+
+        // Travel times in seconds, one row per node. A compressed chain is a single entry.
+        const CsrMatrix &edges() const;
+
+        // Length in metres and number of toll roads of an entry of edges()
+        float edgeLengthMetres(size_t entry) const;
+        uint8_t edgeTolls(size_t entry) const;
+
+        // Lower bounds on the distance and travel time between nodes, for A*
+        const TravelTimeHeuristic &heuristic() const;
+
+        // Location of a node
+        pair<float, float> locationOf(size_t node) const;
+
+        // Id of the node at this position of the list the graph was built from
+        size_t nodeOfInput(size_t index) const;
+
+        // Every node inside the box (inclusive on all sides), appended to result in no particular order
+        void nodesInBox(float minLatitude, float minLongitude, float maxLatitude, float maxLongitude, vector<size_t> &result) const;
+
+        // O(1) reachability pre-check from the component analysis. False means no route can exist:
+        // the nodes are in different weak components, or dest's strong component comes before
+        // origin's in the topological order of the condensation. True means a route may exist.
+        bool mayReach(size_t nodeOrigin, size_t nodeDest) const;
+
+        // Nearest node to the location. With preferLargestComponent, the nearest node in the largest
+        // strongly connected component is returned instead, so routes don't start on an island or stub.
+        // Shape nodes of a compressed graph are never returned; they snap to the nearer end of their chain.
+        // Once setSnapCacheSize turns caching on, results are cached by the location's cell of
+        // about 1 m (see SnapCache).
+        size_t snapToNode(pair<float, float> location, bool preferLargestComponent = false) const;
+
+        // Nearest point on any road, from the segment index. Unlike snapToNode, a location beside the
+        // middle of a long road lands on that road rather than on whichever node is nearest, which
+        // may be on another road entirely. With preferLargestComponent, only roads inside the largest
+        // strongly connected component are considered. Returns nullopt for a graph without roads.
+        // Results are cached like snapToNode's.
+        optional<PhantomNode> snapToRoad(pair<float, float> location, bool preferLargestComponent = false) const;
+
+        // The location projected onto the nearer of the two hops through a shape node, as a point on
+        // the road like snapToRoad's. Lets callers that find nodes by location stop partway along a
+        // compressed chain rather than only at its ends. nullopt if the node isn't a shape node.
+        optional<PhantomNode> snapOntoChain(size_t node, pair<float, float> location) const;
+
+        // Choose the index snapToNode uses, building it if needed. Set it before sharing the graph
+        // between threads.
+        void setSnapIndex(SnapIndex index);
+        SnapIndex snapIndex() const;
+
+        // Resize the caches of snapToNode and snapToRoad to about this many slots each, dropping
+        // what they hold; 0 turns caching off. Caching is off until this is called. A cached
+        // result is the one for the first location seen in its cell, so it is only worth
+        // turning on to serve repeated queries. Set it before sharing the graph between threads.
+        void setSnapCacheSize(size_t slots);
+
+        // Hits and misses of both snap caches together since the graph was loaded or last changed
+        SnapCacheStats snapCacheStats() const;
+
+        // Collapse chains of shape nodes into single entries. A shape node has exactly one way in and
+        // one way out, or is part of a two-way road with exactly two distinct neighbors. Each chain
+        // becomes one entry with the summed time, length and toll count, and the nodes it skips are
+        // kept per entry so routes can be expanded again. Shape nodes keep their ids and locations but
+        // lose their rows. Chains whose time would overflow a matrix value are split.
+        // Must run before any overlay is built over the graph; a graph is only compressed once.
+        ChainCompressionStats compressChains();
+
+        // True for nodes that were folded into a chain by compressChains
+        bool isShapeNode(size_t node) const;
+
+        // Nodes skipped by an entry, in travel order. Empty unless the entry is a compressed chain.
+        // Do not manually clean up the result of this call.
+        MemoryResult<const size_t> chainOf(size_t entry) const;
+
+        // Every entry whose expanded path contains the hop fromNode -> toNode
+        vector<size_t> entriesTraversing(size_t fromNode, size_t toNode) const;
+
+        // Binary save and load. Loading throws runtime_error, and leaves the graph as it was, for a
+        // file without the current GRAPH_FORMAT_VERSION.
         friend istream &operator>>(istream &input, Graph &graph);
         friend ostream &operator<<(ostream &output, const Graph &graph);
 
         // These fields should be treated as private outside of unit tests
+        // Node locations, in the tree's own order: point p of the tree is node _nodeOfPoint[p]. The
+        // tree holds the only copy of the locations; locationOf decodes them through _pointOfNode,
+        // the inverse of _nodeOfPoint, which is rebuilt on load.
         Dim2Tree _vertices;
+        ListWithSize<uint32_t> _nodeOfPoint = ListWithSize<uint32_t>(0);
+        ListWithSize<uint32_t> _pointOfNode = ListWithSize<uint32_t>(0);
+
         // Each edge length is a timestamp
         CsrMatrix _edges;
 
+        // Secondary edge criteria, parallel to the entries of _edges (see CsrMatrix::rowOffset)
+        ListWithSize<float> _edgeLengths = ListWithSize<float>(0);
+        ListWithSize<uint8_t> _edgeTolls = ListWithSize<uint8_t>(0);
+
+        // Strongly connected component of each node, numbered in topological order (see linalg::analyzeComponents)
+        ListWithSize<uint32_t> _componentIds = ListWithSize<uint32_t>(0);
+
+        // Per strongly connected component: node count and weak component
+        ListWithSize<uint32_t> _componentSizes = ListWithSize<uint32_t>(0);
+        ListWithSize<uint32_t> _weakComponentIds = ListWithSize<uint32_t>(0);
+        uint32_t _largestComponent = 0;
+
+        // A* lower bounds by node id, rebuilt from _vertices on load
+        TravelTimeHeuristic _heuristic;
+
+        // The same locations as _vertices, with node ids as input indices. Empty unless
+        // SnapIndex::Grid is selected; rebuilt on load if it was.
+        SpatialGrid _grid;
+        SnapIndex _snapIndex = SnapIndex::Tree;
+
+        // The same locations as unit vectors, with node ids as input indices. Empty unless
+        // SnapIndex::Sphere is selected; rebuilt on load if it was.
+        SphereIndex _sphere;
+
+        // Every hop between consecutive nodes of an expanded entry, with both directions of a two-way
+        // road sharing one segment. Segment s runs from node _segmentNodes[2s] to _segmentNodes[2s + 1].
+        // Compressing chains changes no hops, so the index is only built with the graph.
+        SegmentIndex _segments;
+        ListWithSize<size_t> _segmentNodes = ListWithSize<size_t>(0);
+
+        // Snapping results by location, cleared whenever the graph is loaded or changed. Never saved;
+        // a copied graph starts with empty caches of the same size.
+        mutable SnapCache<size_t> _nodeSnaps = SnapCache<size_t>();
+        mutable SnapCache<optional<PhantomNode>> _roadSnaps = SnapCache<optional<PhantomNode>>();
+
+        // Compressed chains: the nodes skipped by entry e are _chainNodes[_chainOffsets[e], _chainOffsets[e + 1]).
+        // Both are empty for a graph that was never compressed.
+        ListWithSize<size_t> _chainOffsets = ListWithSize<size_t>(0);
+        ListWithSize<size_t> _chainNodes = ListWithSize<size_t>(0);
+
+        // For each shape node, one entry whose chain contains it. NO_CHAIN for every other node.
+        ListWithSize<size_t> _chainOfNode = ListWithSize<size_t>(0);
+
         private:
-        void loadGraphFromNodes(vector<GraphNode> nodes);
+        void loadGraphFromNodes(vector<GraphNode> nodes, VertexOrder order, ThreadPool *pool);
+        void buildPointOfNode();
+        void analyzeConnectivity(ThreadPool *pool);
+        void buildGrid();
+        void buildSphere();
+        void buildSegments(ThreadPool *pool);
+
+        // Node i of an entry's expanded path: its source, the nodes its chain skips, then its target
+        size_t pathNode(size_t entry, size_t index) const;
+
+        // Position on the fastest entry traversing the hop fromNode -> toNode, along of the way (by
+        // length) from fromNode to toNode. The entry is NO_ENTRY if no entry traverses the hop.
+        EntryPosition positionOnHop(size_t fromNode, size_t toNode, float along) const;
+
+        // A* from the sources to the target that gives the fastest route (see SearchSeed). Only routes
+        // faster than bestSeconds are searched for. If one is found, bestSeconds is lowered to its time
+        // and its target's index is returned; the route is left in the workspace's parents, back to a
+        // source that is its own parent.
+        optional<size_t> searchBetweenSeeds(
+            span<const SearchSeed> sources,
+            span<const SearchSeed> targets,
+            float &bestSeconds,
+            SearchWorkspace &workspace,
+            const ExclusionOverlay *overlay
+        ) const;
+
+        // Append the nodes of the search's route from start to end, with compressed chains expanded
+        void appendSearchPath(const SearchWorkspace &workspace, size_t start, size_t end, vector<GraphNode> &path) const;
+
+        // Node locations as separate latitude and longitude arrays, by node id
+        pair<vector<float>, vector<float>> vertexLocations() const;
+
+        // snapToNode and snapToRoad without the caches
+        size_t snapToNodeUncached(pair<float, float> location, bool preferLargestComponent) const;
+        optional<PhantomNode> snapToRoadUncached(pair<float, float> location, bool preferLargestComponent) const;
+
+        // Nearest node to the location, from the index chosen by _snapIndex
+        size_t nearestNode(pair<float, float> location) const;
+
+        // The k nodes nearest the location, closest first, from the index chosen by _snapIndex
+        void nearestNodes(pair<float, float> location, size_t k, vector<size_t> &result) const;
+
+        // The k nodes nearest the location as search seeds, each costing its distance from the
+        // location at secondsPerMetre. Shape nodes are replaced by the nearer end of their chain,
+        // so there may be fewer than k.
+        vector<SearchSeed> snapCandidates(pair<float, float> location, size_t k, float secondsPerMetre) const;
+
+        // The chain end (entry source or target) closest to the location, for a shape node
+        size_t nearestChainEnd(size_t node, pair<float, float> location) const;
         json loadFileAsJson(const string &filename);
         vector<GraphNode> parseGraphNodes(const json &j);
     };
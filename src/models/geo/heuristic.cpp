@@ -0,0 +1,46 @@
+#include <cmath>
+#include <numbers>
+#include <vector>
+
+#include "heuristic.h"
+
+using geo::TravelTimeHeuristic;
+using std::array;
+using std::pair;
+using std::vector;
+using utils::Dim2Tree;
+using utils::ListWithSize;
+using utils::microdegreesToDegrees;
+
+array<float, 3> geo::unitVector(const pair<double, double> &location) {
+    const double degrees = std::numbers::pi / 180.0;
+    double lat = location.first * degrees;
+    double lon = location.second * degrees;
+
+    return {
+        static_cast<float>(std::cos(lat) * std::cos(lon)),
+        static_cast<float>(std::cos(lat) * std::sin(lon)),
+        static_cast<float>(std::sin(lat))
+    };
+}
+
+TravelTimeHeuristic::TravelTimeHeuristic(const Dim2Tree &vertices, span<const uint32_t> nodeOfPoint) {
+    vector<float> unitVectors(3 * vertices.size());
+
+    // From the stored microdegrees, which keep the input to about 0.1 m, rather than the float
+    // degrees operator[] decodes them to, which are only good to about a metre
+    for (size_t point = 0; point < vertices.size(); point++) {
+        size_t node = nodeOfPoint.empty() ? point : nodeOfPoint[point];
+        auto [lat, lon] = vertices.microdegrees(point);
+        array<float, 3> unit = unitVector({microdegreesToDegrees(lat), microdegreesToDegrees(lon)});
+        unitVectors[3 * node] = unit[0];
+        unitVectors[3 * node + 1] = unit[1];
+        unitVectors[3 * node + 2] = unit[2];
+    }
+
+    _unitVectors = ListWithSize<float>(unitVectors);
+}
+
+size_t TravelTimeHeuristic::size() const {
+    return _unitVectors.size() / 3;
+}
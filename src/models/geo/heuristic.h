@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <utility>
+
+#include "models/geo/geoData.h"
+#include "models/util/dim2Tree.h"
+#include "models/util/listWithSize.h"
+
+using std::array;
+using std::pair;
+using std::span;
+using utils::Dim2Tree;
+using utils::ListWithSize;
+
+namespace geo {
+    // Point on the unit sphere for a (lat, lon) location in degrees.
+    // Computed in double precision, so each component is within half a float ulp.
+    array<float, 3> unitVector(const pair<double, double> &location);
+
+    /**
+    * Trig-free lower bounds for A* and friends. Every vertex is stored once as a 3D unit vector,
+    * so a bound is a vector difference, a dot product and a square root.
+    *
+    * The chord between two points on the sphere is never longer than the arc, so
+    * EARTH_RADIUS_METRES * chord is a lower bound on the great circle distance, and dividing by
+    * FASTEST_SPEED_METRES_PER_SECOND gives a lower bound on the travel time. The time bound is
+    * admissible and consistent as long as no edge is faster than that speed.
+    */
+    class TravelTimeHeuristic {
+        public:
+        TravelTimeHeuristic() = default;
+
+        // One unit vector per vertex. Point p of the tree is vertex nodeOfPoint[p], or vertex p if
+        // nodeOfPoint is empty.
+        TravelTimeHeuristic(const Dim2Tree &vertices, span<const uint32_t> nodeOfPoint = {});
+
+        float lowerBoundMetres(size_t from, size_t to) const;
+        float lowerBoundSeconds(size_t from, size_t to) const;
+
+        size_t size() const;
+
+        private:
+        // Covers the float rounding of the stored unit vectors (well under a metre on the chord)
+        static constexpr float ROUNDING_SLACK_METRES = 2.0f;
+
+        // Format: [node0_x, node0_y, node0_z, node1_x, ...]
+        ListWithSize<float> _unitVectors = ListWithSize<float>(0);
+    };
+
+    inline float TravelTimeHeuristic::lowerBoundMetres(size_t from, size_t to) const {
+        const float *a = _unitVectors.data() + 3 * from;
+        const float *b = _unitVectors.data() + 3 * to;
+
+        // Differencing first keeps short chords accurate, unlike 2 - 2 * dot(a, b)
+        float dx = a[0] - b[0];
+        float dy = a[1] - b[1];
+        float dz = a[2] - b[2];
+        float chord = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+        return std::max(EARTH_RADIUS_METRES * chord - ROUNDING_SLACK_METRES, 0.0f);
+    }
+
+    inline float TravelTimeHeuristic::lowerBoundSeconds(size_t from, size_t to) const {
+        return lowerBoundMetres(from, to) * (1.0f / FASTEST_SPEED_METRES_PER_SECOND);
+    }
+}
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+
+#include "distanceBatch.h"
+#include "mapMatcher.h"
+
+using geo::EARTH_RADIUS_METRES;
+using geo::EntryPosition;
+using geo::FASTEST_SPEED_METRES_PER_SECOND;
+using geo::GpsTrace;
+using geo::greatCircleMetresBatch;
+using geo::Graph;
+using geo::MapMatcher;
+using geo::MapMatchOptions;
+using geo::MapMatchResult;
+using geo::MapMatchStats;
+using geo::NO_ENTRY;
+using geo::PhantomNode;
+using geo::SearchSeed;
+using geo::SearchWorkspace;
+using linalg::CsrMatrix;
+using std::optional;
+using std::pair;
+using std::vector;
+using utils::ThreadPool;
+
+namespace {
+    // Equirectangular approximation. Accurate to well under a metre at the
+    // distances between consecutive pings, and much cheaper than haversine.
+    float metresBetween(const pair<float, float> &loc1, const pair<float, float> &loc2) {
+        const float degreesToRadians = std::numbers::pi_v<float> / 180.0f;
+
+        float meanLat = (loc1.first + loc2.first) * 0.5f * degreesToRadians;
+        float dLat = (loc2.first - loc1.first) * degreesToRadians;
+        float dLon = (loc2.second - loc1.second) * degreesToRadians * std::cos(meanLat);
+
+        return EARTH_RADIUS_METRES * std::sqrt(dLat * dLat + dLon * dLon);
+    }
+}
+
+double MapMatchStats::pointsPerSecond() const {
+    if (seconds <= 0.0) {
+        return 0.0;
+    }
+
+    return points / seconds;
+}
+
+double MapMatchStats::pointsPerSecondPerCore() const {
+    if (threads == 0) {
+        return 0.0;
+    }
+
+    return pointsPerSecond() / threads;
+}
+
+MapMatcher::MapMatcher(const Graph &graph, MapMatchOptions options) : _graph(graph), _options(options) {}
+
+vector<MapMatcher::Candidate> MapMatcher::findCandidates(const pair<float, float> &ping) const {
+    vector<Candidate> candidates;
+
+    // Box around the ping that contains every point within maxCandidateDistanceMetres
+    const float metresPerDegree = EARTH_RADIUS_METRES * std::numbers::pi_v<float> / 180.0f;
+    float latRadius = _options.maxCandidateDistanceMetres / metresPerDegree;
+    float lonRadius = latRadius / std::max(0.01f, std::cos(ping.first * std::numbers::pi_v<float> / 180.0f));
+
+    vector<size_t> pool;
+    _graph.nodesInBox(
+        ping.first - latRadius, ping.second - lonRadius,
+        ping.first + latRadius, ping.second + lonRadius,
+        pool
+    );
+
+    vector<float> lats(pool.size()), lons(pool.size()), distances(pool.size());
+    for (size_t i = 0; i < pool.size(); i++) {
+        auto [lat, lon] = _graph.locationOf(pool[i]);
+        lats[i] = lat;
+        lons[i] = lon;
+    }
+
+    greatCircleMetresBatch(ping, lats, lons, distances);
+
+    const CsrMatrix &edges = _graph.edges();
+
+    // Nearest first, so a point on a chain is reported as the nearest of the shape nodes that give it
+    vector<size_t> order(pool.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&distances](size_t a, size_t b) {
+        return distances[a] < distances[b];
+    });
+
+    for (size_t i : order) {
+        size_t node = pool[i];
+        float metres = distances[i];
+        Candidate candidate{node, 0.0f, {}, {}, {}};
+
+        // Shape nodes of a compressed graph have no edges of their own to route over, so the ping
+        // is moved onto the chain instead. Neighbouring shape nodes may give the same point.
+        optional<PhantomNode> road = _graph.snapOntoChain(node, ping);
+
+        if (road.has_value()) {
+            bool seen = std::any_of(candidates.begin(), candidates.end(), [&road](const Candidate &other) {
+                return other.positions[0].entry == road->forward.entry && other.positions[0].fraction == road->forward.fraction
+                    && other.positions[1].entry == road->backward.entry;
+            });
+
+            if (seen) {
+                continue;
+            }
+
+            metres = road->snapMetres;
+            candidate.positions[0] = road->forward;
+            candidate.positions[1] = road->backward;
+
+            for (const EntryPosition &position : candidate.positions) {
+                if (position.entry != NO_ENTRY) {
+                    float seconds = edges.valueOfEntry(position.entry);
+                    candidate.sources.push_back(SearchSeed{edges.columnOfEntry(position.entry), (1.0f - position.fraction) * seconds});
+                    candidate.targets.push_back(SearchSeed{edges.rowOfEntry(position.entry), position.fraction * seconds});
+                }
+            }
+        } else {
+            candidate.sources.push_back(SearchSeed{node, 0.0f});
+            candidate.targets.push_back(SearchSeed{node, 0.0f});
+        }
+
+        if (metres <= _options.maxCandidateDistanceMetres) {
+            float normalized = metres / _options.gpsSigmaMetres;
+            candidate.emissionCost = 0.5f * normalized * normalized;
+            candidates.push_back(std::move(candidate));
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.emissionCost < b.emissionCost;
+    });
+
+    if (candidates.size() > _options.maxCandidates) {
+        candidates.resize(_options.maxCandidates);
+    }
+
+    return candidates;
+}
+
+void MapMatcher::transitionCosts(
+    const Candidate &from,
+    const vector<Candidate> &to,
+    float maxCost,
+    SearchWorkspace &workspace,
+    vector<float> &costs
+) const {
+    const float infinity = numeric_limits<float>::infinity();
+    const CsrMatrix &edges = _graph.edges();
+    costs.assign(to.size(), infinity);
+
+    // Driving straight along a shared entry, to a point ahead on it
+    for (size_t j = 0; j < to.size(); j++) {
+        for (const EntryPosition &start : from.positions) {
+            for (const EntryPosition &end : to[j].positions) {
+                if (start.entry != NO_ENTRY && start.entry == end.entry && start.fraction <= end.fraction) {
+                    costs[j] = std::min(costs[j], (end.fraction - start.fraction) * edges.valueOfEntry(start.entry));
+                }
+            }
+        }
+    }
+
+    vector<size_t> targets;
+    for (const Candidate &candidate : to) {
+        for (const SearchSeed &target : candidate.targets) {
+            targets.push_back(target.node);
+        }
+    }
+
+    vector<float> routeCosts;
+    for (const SearchSeed &source : from.sources) {
+        if (source.seconds > maxCost) {
+            continue;
+        }
+
+        _graph.boundedOneToMany(source.node, targets, maxCost - source.seconds, workspace, routeCosts);
+
+        size_t k = 0;
+        for (size_t j = 0; j < to.size(); j++) {
+            for (const SearchSeed &target : to[j].targets) {
+                costs[j] = std::min(costs[j], source.seconds + routeCosts[k++] + target.seconds);
+            }
+        }
+    }
+
+    for (float &cost : costs) {
+        if (cost > maxCost) {
+            cost = infinity;
+        }
+    }
+}
+
+MapMatchResult MapMatcher::match(const GpsTrace &trace, SearchWorkspace &workspace) const {
+    const float infinity = numeric_limits<float>::infinity();
+
+    MapMatchResult result;
+    result.nodes.assign(trace.size(), UNMATCHED);
+
+    // Viterbi lattice: for each ping, its candidates, their best path cost,
+    // and the candidate index at the previous live ping that produced it
+    vector<vector<Candidate>> candidates(trace.size());
+    vector<vector<float>> costs(trace.size());
+    vector<vector<size_t>> backPointers(trace.size());
+    vector<size_t> previousPing(trace.size(), UNMATCHED);
+
+    // Walk back from the cheapest state at the given ping and record the matched nodes
+    auto backtrack = [&](size_t ping) {
+        const vector<float> &finalCosts = costs[ping];
+        size_t candidate = std::min_element(finalCosts.begin(), finalCosts.end()) - finalCosts.begin();
+        result.cost += finalCosts[candidate];
+
+        while (ping != UNMATCHED && candidate != UNMATCHED) {
+            result.nodes[ping] = candidates[ping][candidate].node;
+            candidate = backPointers[ping][candidate];
+            ping = previousPing[ping];
+        }
+    };
+
+    vector<float> routeCosts;
+    size_t previous = UNMATCHED;
+
+    for (size_t t = 0; t < trace.size(); t++) {
+        candidates[t] = findCandidates(trace[t]);
+
+        // Pings far from any road are skipped; the HMM continues from the last live ping
+        if (candidates[t].empty()) {
+            continue;
+        }
+
+        const vector<Candidate> &current = candidates[t];
+        costs[t].assign(current.size(), infinity);
+        backPointers[t].assign(current.size(), UNMATCHED);
+
+        if (previous != UNMATCHED) {
+            float straightSeconds = metresBetween(trace[previous], trace[t]) / FASTEST_SPEED_METRES_PER_SECOND;
+            float searchBound = straightSeconds * _options.maxDetourFactor + _options.searchSlackSeconds;
+
+            for (size_t i = 0; i < candidates[previous].size(); i++) {
+                float previousCost = costs[previous][i];
+
+                if (previousCost == infinity) {
+                    continue;
+                }
+
+                transitionCosts(candidates[previous][i], current, searchBound, workspace, routeCosts);
+
+                for (size_t j = 0; j < current.size(); j++) {
+                    if (routeCosts[j] == infinity) {
+                        continue;
+                    }
+
+                    float detourSeconds = std::max(0.0f, routeCosts[j] - straightSeconds);
+                    float cost = previousCost + detourSeconds / _options.detourBetaSeconds + current[j].emissionCost;
+
+                    if (cost < costs[t][j]) {
+                        costs[t][j] = cost;
+                        backPointers[t][j] = i;
+                    }
+                }
+            }
+
+            previousPing[t] = previous;
+        }
+
+        bool alive = std::any_of(costs[t].begin(), costs[t].end(), [&](float cost) {
+            return cost != infinity;
+        });
+
+        // No candidate is reachable from the previous ping: close the current
+        // segment and restart the HMM from this ping
+        if (!alive) {
+            if (previous != UNMATCHED) {
+                backtrack(previous);
+                result.breaks++;
+            }
+
+            for (size_t j = 0; j < current.size(); j++) {
+                costs[t][j] = current[j].emissionCost;
+                backPointers[t][j] = UNMATCHED;
+            }
+
+            previousPing[t] = UNMATCHED;
+        }
+
+        previous = t;
+    }
+
+    if (previous != UNMATCHED) {
+        backtrack(previous);
+    }
+
+    return result;
+}
+
+vector<MapMatchResult> MapMatcher::matchBatch(const vector<GpsTrace> &traces, ThreadPool *pool, MapMatchStats *stats) const {
+    vector<MapMatchResult> results(traces.size());
+    size_t numSlots = (pool == nullptr) ? 1 : pool->size();
+    vector<SearchWorkspace> workspaces(numSlots);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Traces vary wildly in length; parallelFor hands them out one at a time rather than in static ranges
+    if (pool == nullptr) {
+        for (size_t i = 0; i < traces.size(); i++) {
+            results[i] = match(traces[i], workspaces[0]);
+        }
+    } else {
+        pool->parallelFor(traces.size(), [&](size_t slot, size_t index) {
+            results[index] = match(traces[index], workspaces[slot]);
+        });
+    }
+
+    if (stats != nullptr) {
+        stats->traces = traces.size();
+        stats->points = 0;
+        for (const GpsTrace &trace : traces) {
+            stats->points += trace.size();
+        }
+
+        stats->threads = numSlots;
+        stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return results;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/searchWorkspace.h"
+#include "models/util/threadPool.h"
+
+using geo::EntryPosition;
+using geo::Graph;
+using geo::SearchSeed;
+using geo::SearchWorkspace;
+using std::numeric_limits;
+using std::pair;
+using std::vector;
+using utils::ThreadPool;
+
+namespace geo {
+    // A GPS trace is an ordered list of (lat, lon) pings from a single vehicle
+    using GpsTrace = vector<pair<float, float>>;
+
+    // Marks a ping that could not be matched to the road network
+    constexpr size_t UNMATCHED = numeric_limits<size_t>::max();
+
+    struct MapMatchOptions {
+        // Maximum number of candidate nodes considered for each ping
+        size_t maxCandidates = 4;
+
+        // Candidates further than this from the ping (in metres) are discarded
+        float maxCandidateDistanceMetres = 200.0f;
+
+        // Standard deviation of the GPS noise, in metres
+        float gpsSigmaMetres = 10.0f;
+
+        // Scale (in seconds) of the penalty for routes that detour relative to the straight line between pings
+        float detourBetaSeconds = 30.0f;
+
+        // Transition searches are bounded by maxDetourFactor * straight line time + searchSlackSeconds
+        float maxDetourFactor = 4.0f;
+        float searchSlackSeconds = 60.0f;
+    };
+
+    struct MapMatchResult {
+        // One entry per ping: the matched graph node, or UNMATCHED. A ping matched partway along a
+        // compressed chain gets the shape node it was matched near.
+        vector<size_t> nodes;
+
+        // Negative log likelihood of the matched path, summed over the HMM segments
+        float cost = 0.0f;
+
+        // Number of times the HMM had to restart because no transition was possible
+        size_t breaks = 0;
+    };
+
+    struct MapMatchStats {
+        size_t traces = 0;
+        size_t points = 0;
+        size_t threads = 0;
+        double seconds = 0.0;
+
+        double pointsPerSecond() const;
+        double pointsPerSecondPerCore() const;
+    };
+
+    /**
+    * HMM map matcher. Candidate nodes for each ping come from the graph's Dim2Tree,
+    * and transition costs from bounded one-to-many searches on the CsrMatrix.
+    * A Viterbi pass picks the most likely sequence of nodes. Near a shape node of a compressed
+    * graph, the candidate is the ping's projection onto the chain (see Graph::snapOntoChain), and
+    * searches to and from it run through the ends of the chain's entries.
+    * The graph must outlive the matcher and must not be modified while matching.
+    */
+    class MapMatcher {
+        public:
+        MapMatcher(const Graph &graph, MapMatchOptions options = MapMatchOptions());
+
+        // Match a single trace. The workspace is reused across all transition searches.
+        MapMatchResult match(const GpsTrace &trace, SearchWorkspace &workspace) const;
+
+        // Match many traces on the pool's workers, one workspace per worker, or on the calling
+        // thread without a pool. Results are in the same order as the input.
+        vector<MapMatchResult> matchBatch(
+            const vector<GpsTrace> &traces,
+            ThreadPool *pool = nullptr,
+            MapMatchStats *stats = nullptr
+        ) const;
+
+        private:
+        struct Candidate {
+            size_t node;
+            float emissionCost;
+
+            // Where searches from and to the candidate start and end. A node is its own seed; a
+            // point on a chain leads on to the targets of its entries, and is reached from their sources.
+            vector<SearchSeed> sources;
+            vector<SearchSeed> targets;
+
+            // The point's positions along its entries, for a point on a chain
+            EntryPosition positions[2];
+        };
+
+        const Graph &_graph;
+        MapMatchOptions _options;
+
+        vector<Candidate> findCandidates(const pair<float, float> &ping) const;
+
+        // Seconds to drive from one candidate to the next, if it can be done within maxCost.
+        // One search per source of from, to every target of the candidates. Written to costs in candidate order.
+        void transitionCosts(
+            const Candidate &from,
+            const vector<Candidate> &to,
+            float maxCost,
+            SearchWorkspace &workspace,
+            vector<float> &costs
+        ) const;
+    };
+}
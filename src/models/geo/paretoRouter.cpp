@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "paretoRouter.h"
+
+using geo::FASTEST_SPEED_METRES_PER_SECOND;
+using geo::Graph;
+using geo::ParetoOptions;
+using geo::ParetoResult;
+using geo::ParetoRoute;
+using geo::ParetoRouter;
+using geo::ParetoWorkspace;
+using geo::SearchWorkspace;
+using std::greater;
+using std::invalid_argument;
+using std::numeric_limits;
+using std::pair;
+using std::vector;
+using utils::MemoryResult;
+
+namespace {
+    const uint32_t NO_LABEL = numeric_limits<uint32_t>::max();
+
+    // a weakly dominates b: no worse in any of the first N criteria.
+    // N is 2 or 3, so the loop is fully unrolled.
+    template <size_t N>
+    inline bool dominates(const float *a, const float *b) {
+        bool result = a[0] <= b[0];
+        for (size_t i = 1; i < N; i++) {
+            result &= a[i] <= b[i];
+        }
+
+        return result;
+    }
+}
+
+void ParetoWorkspace::reset(size_t numNodes) {
+    if (_bagStamp.size() < numNodes) {
+        _bagStamp.resize(numNodes, 0);
+        _bagHead.resize(numNodes);
+        _lowerBoundStamp.resize(numNodes, 0);
+        _lowerBound.resize(numNodes);
+    }
+
+    _generation++;
+
+    if (_generation == 0) {
+        std::fill(_bagStamp.begin(), _bagStamp.end(), 0);
+        std::fill(_lowerBoundStamp.begin(), _lowerBoundStamp.end(), 0);
+        _generation = 1;
+    }
+
+    _labels.clear();
+    _frontier.clear();
+}
+
+uint32_t ParetoWorkspace::bagHead(size_t node) const {
+    if (_bagStamp[node] != _generation) {
+        return NO_LABEL;
+    }
+
+    return _bagHead[node];
+}
+
+void ParetoWorkspace::setBagHead(size_t node, uint32_t label) {
+    _bagStamp[node] = _generation;
+    _bagHead[node] = label;
+}
+
+bool ParetoWorkspace::hasLowerBound(size_t node) const {
+    return _lowerBoundStamp[node] == _generation;
+}
+
+ParetoRouter::ParetoRouter(const Graph &graph, ParetoOptions options) : _graph(graph), _options(options) {
+    if (options.numCriteria != 2 && options.numCriteria != 3) {
+        throw invalid_argument(format("ParetoRouter supports 2 or 3 criteria, not {}", options.numCriteria));
+    }
+}
+
+ParetoResult ParetoRouter::route(pair<float, float> origin, pair<float, float> dest, ParetoWorkspace &workspace) const {
+    size_t originNode = _graph.snapToNode(origin);
+    size_t destNode = _graph.snapToNode(dest);
+
+    return routeBetweenNodes(originNode, destNode, workspace);
+}
+
+ParetoResult ParetoRouter::routeBetweenNodes(size_t originNode, size_t destNode, ParetoWorkspace &workspace) const {
+    if (_options.numCriteria == 2) {
+        return search<2>(originNode, destNode, workspace);
+    }
+
+    return search<3>(originNode, destNode, workspace);
+}
+
+pair<float, float> ParetoRouter::lowerBound(size_t node, size_t destNode, ParetoWorkspace &workspace) const {
+    if (!workspace.hasLowerBound(node)) {
+        // Roads are never shorter than the chord, and never faster than the speed bound
+        float metres = _graph.heuristic().lowerBoundMetres(node, destNode);
+
+        workspace._lowerBoundStamp[node] = workspace._generation;
+        workspace._lowerBound[node] = {metres / FASTEST_SPEED_METRES_PER_SECOND, metres};
+    }
+
+    return workspace._lowerBound[node];
+}
+
+template <size_t N>
+ParetoResult ParetoRouter::search(size_t originNode, size_t destNode, ParetoWorkspace &workspace) const {
+    using Label = ParetoWorkspace::Label;
+
+    ParetoResult result;
+    workspace.reset(_graph.size());
+
+    // The fastest route anchors the time limit, and tells us early if dest is unreachable
+    _graph.boundedOneToMany(originNode, {destNode}, numeric_limits<float>::infinity(), workspace._search, workspace._fastest);
+    float fastest = workspace._fastest[0];
+
+    if (fastest == numeric_limits<float>::infinity()) {
+        return result;
+    }
+
+    float timeLimit = fastest * (1.0f + _options.maxTimeSlack);
+
+    ObjectPool<Label> &labels = workspace._labels;
+    auto &frontier = workspace._frontier;
+
+    auto bagDominates = [&](size_t node, const float *cost) {
+        for (uint32_t l = workspace.bagHead(node); l != NO_LABEL; l = labels[l].nextInBag) {
+            if (dominates<N>(labels[l].cost, cost)) {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    // Unlink the labels at node that the new cost dominates. They stay in the
+    // frontier but are skipped when popped.
+    auto removeDominated = [&](size_t node, const float *cost) {
+        uint32_t previous = NO_LABEL;
+
+        for (uint32_t l = workspace.bagHead(node); l != NO_LABEL; l = labels[l].nextInBag) {
+            if (dominates<N>(cost, labels[l].cost)) {
+                labels[l].dominated = true;
+
+                if (previous == NO_LABEL) {
+                    workspace.setBagHead(node, labels[l].nextInBag);
+                } else {
+                    labels[previous].nextInBag = labels[l].nextInBag;
+                }
+            } else {
+                previous = l;
+            }
+        }
+    };
+
+    uint32_t originLabel = labels.allocate();
+    labels[originLabel] = Label{{0.0f, 0.0f, 0.0f}, originNode, 0, NO_LABEL, NO_LABEL, false};
+    workspace.setBagHead(originNode, originLabel);
+    frontier.emplace_back(0.0f, originLabel);
+
+    // Labels are expanded in order of time plus its lower bound. The bound is admissible but not
+    // necessarily consistent, so a label can still be dominated after it has been expanded;
+    // dominated labels are unlinked from their bag, which keeps the final destination bag exact.
+    while (!frontier.empty() && !result.truncated) {
+        std::pop_heap(frontier.begin(), frontier.end(), greater<>());
+        uint32_t current = frontier.back().second;
+        frontier.pop_back();
+
+        if (labels[current].dominated || labels[current].node == destNode) {
+            continue;
+        }
+
+        size_t currentNode = labels[current].node;
+        auto [times, neighbors] = _graph.edges().valuesInRow(currentNode);
+        size_t rowOffset = _graph.edges().rowOffset(currentNode);
+
+        for (size_t i = 0; i < times.num_items; i++) {
+            size_t neighbor = neighbors.items[i];
+            const float *currentCost = labels[current].cost;
+
+            float cost[3] = {
+                currentCost[0] + times.items[i],
+                currentCost[1] + _graph.edgeLengthMetres(rowOffset + i),
+                currentCost[2] + _graph.edgeTolls(rowOffset + i)
+            };
+
+            auto [secondsBound, metresBound] = lowerBound(neighbor, destNode, workspace);
+            float bounded[3] = {cost[0] + secondsBound, cost[1] + metresBound, cost[2]};
+
+            if (bounded[0] > timeLimit) {
+                continue;
+            }
+
+            // Target pruning: the label cannot lead anywhere better than a route already found
+            if (bagDominates(destNode, bounded) || bagDominates(neighbor, cost)) {
+                continue;
+            }
+
+            if (labels.size() >= _options.maxLabels) {
+                result.truncated = true;
+                break;
+            }
+
+            removeDominated(neighbor, cost);
+
+            uint32_t label = labels.allocate();
+            labels[label] = Label{{cost[0], cost[1], cost[2]}, neighbor, rowOffset + i, current, workspace.bagHead(neighbor), false};
+            workspace.setBagHead(neighbor, label);
+
+            frontier.emplace_back(bounded[0], label);
+            std::push_heap(frontier.begin(), frontier.end(), greater<>());
+        }
+    }
+
+    for (uint32_t l = workspace.bagHead(destNode); l != NO_LABEL; l = labels[l].nextInBag) {
+        ParetoRoute route;
+        route.criteria = {labels[l].cost[0], labels[l].cost[1], labels[l].cost[2]};
+
+        for (uint32_t step = l; step != NO_LABEL; step = labels[step].parent) {
+            route.nodes.push_back(labels[step].node);
+
+            if (labels[step].parent != NO_LABEL) {
+                MemoryResult<const size_t> chain = _graph.chainOf(labels[step].entry);
+                for (size_t i = chain.num_items; i > 0; i--) {
+                    route.nodes.push_back(chain.items[i - 1]);
+                }
+            }
+        }
+
+        std::reverse(route.nodes.begin(), route.nodes.end());
+        result.routes.push_back(route);
+    }
+
+    std::sort(result.routes.begin(), result.routes.end(), [](const ParetoRoute &a, const ParetoRoute &b) {
+        return a.criteria.seconds < b.criteria.seconds;
+    });
+
+    result.labelsCreated = labels.size();
+    return result;
+}
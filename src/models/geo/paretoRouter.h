@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/searchWorkspace.h"
+#include "models/util/objectPool.h"
+
+using geo::Graph;
+using geo::SearchWorkspace;
+using std::pair;
+using std::vector;
+using utils::ObjectPool;
+
+namespace geo {
+    // Cost of a route under each criterion
+    struct RouteCriteria {
+        float seconds = 0.0f;
+        float metres = 0.0f;
+
+        // Number of tolled segments on the route
+        float tolls = 0.0f;
+    };
+
+    struct ParetoRoute {
+        vector<size_t> nodes;
+        RouteCriteria criteria;
+    };
+
+    struct ParetoResult {
+        // Pareto-optimal routes, fastest first
+        vector<ParetoRoute> routes;
+
+        // Set when the query hit ParetoOptions::maxLabels. The routes are then only
+        // the non-dominated routes found so far.
+        bool truncated = false;
+        size_t labelsCreated = 0;
+    };
+
+    struct ParetoOptions {
+        // 2 trades off time against distance, 3 also minimizes the number of tolled segments
+        size_t numCriteria = 3;
+
+        // Routes more than this fraction slower than the fastest route are pruned.
+        // No length limit is needed: a route slower and longer than the fastest one is dominated anyway.
+        float maxTimeSlack = 0.5f;
+
+        // Hard cap on the labels created by a single query, to bound interactive latency
+        size_t maxLabels = 1 << 22;
+    };
+
+    /**
+    * Per-query state for ParetoRouter. Labels live in a pooled allocator and
+    * per-node bags are invalidated through a generation counter, so the
+    * workspace can be reused across queries without reallocating.
+    * A workspace must not be shared between threads.
+    */
+    class ParetoWorkspace {
+        public:
+        ParetoWorkspace() = default;
+
+        private:
+        friend class ParetoRouter;
+
+        struct Label {
+            float cost[3];
+            size_t node;
+
+            // Matrix entry from the parent, to expand compressed chains
+            size_t entry;
+            uint32_t parent;
+            uint32_t nextInBag;
+            bool dominated;
+        };
+
+        void reset(size_t numNodes);
+        uint32_t bagHead(size_t node) const;
+        void setBagHead(size_t node, uint32_t label);
+
+        // Cached lower bounds on (seconds, metres) from a node to the query's destination
+        bool hasLowerBound(size_t node) const;
+
+        ObjectPool<Label> _labels = ObjectPool<Label>();
+        vector<pair<float, uint32_t>> _frontier = vector<pair<float, uint32_t>>();
+
+        uint32_t _generation = 0;
+        vector<uint32_t> _bagStamp = vector<uint32_t>();
+        vector<uint32_t> _bagHead = vector<uint32_t>();
+        vector<uint32_t> _lowerBoundStamp = vector<uint32_t>();
+        vector<pair<float, float>> _lowerBound = vector<pair<float, float>>();
+
+        // Used for the fastest-route search that sets the time limit
+        SearchWorkspace _search = SearchWorkspace();
+        vector<float> _fastest = vector<float>();
+    };
+
+    /**
+    * Multi-criteria label-setting router over travel time, length and tolls.
+    * Each node keeps a bag of mutually non-dominated labels. Labels are pruned when they
+    * exceed the time slack, or when their cost plus a geometric lower bound
+    * is dominated by a label already at the destination.
+    * The graph must outlive the router.
+    */
+    class ParetoRouter {
+        public:
+        // Throws invalid_argument unless options.numCriteria is 2 or 3
+        ParetoRouter(const Graph &graph, ParetoOptions options = ParetoOptions());
+
+        ParetoResult route(pair<float, float> origin, pair<float, float> dest, ParetoWorkspace &workspace) const;
+        ParetoResult routeBetweenNodes(size_t originNode, size_t destNode, ParetoWorkspace &workspace) const;
+
+        private:
+        const Graph &_graph;
+        ParetoOptions _options;
+
+        template <size_t N>
+        ParetoResult search(size_t originNode, size_t destNode, ParetoWorkspace &workspace) const;
+
+        pair<float, float> lowerBound(size_t node, size_t destNode, ParetoWorkspace &workspace) const;
+    };
+}
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "queryExecutor.h"
+
+using geo::ExecutorOptions;
+using geo::ExecutorStats;
+using geo::QueryExecutor;
+using std::lock_guard;
+using std::unique_lock;
+
+namespace {
+    // The executor and worker the current thread belongs to, so nested submissions stay local
+    thread_local const QueryExecutor *currentExecutor = nullptr;
+    thread_local size_t currentWorker = 0;
+
+    // Best effort: affinity is a hint, and failure to set it is not an error
+    void pinCurrentThread(size_t cpu) {
+        size_t numCpus = std::max(1u, std::thread::hardware_concurrency());
+        cpu %= numCpus;
+
+#if defined(_WIN32)
+        if (cpu < 8 * sizeof(DWORD_PTR)) {
+            SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+        }
+#elif defined(__linux__)
+        if (cpu < CPU_SETSIZE) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#else
+        (void) cpu;
+#endif
+    }
+}
+
+void QueryExecutor::LatencyHistogram::add(double latencyMs) {
+    size_t bucket = 0;
+    if (latencyMs > LATENCY_FLOOR_MS) {
+        double position = std::ceil(std::log2(latencyMs / LATENCY_FLOOR_MS) * BUCKETS_PER_DOUBLING);
+        bucket = static_cast<size_t>(std::min(position, static_cast<double>(NUM_BUCKETS - 1)));
+    }
+
+    counts[bucket]++;
+    count++;
+    totalMs += latencyMs;
+    maxMs = std::max(maxMs, latencyMs);
+}
+
+void QueryExecutor::LatencyHistogram::merge(const LatencyHistogram &other) {
+    for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+        counts[bucket] += other.counts[bucket];
+    }
+
+    count += other.count;
+    totalMs += other.totalMs;
+    maxMs = std::max(maxMs, other.maxMs);
+}
+
+double QueryExecutor::LatencyHistogram::percentile(double fraction) const {
+    size_t rank = std::min(count - 1, static_cast<size_t>(fraction * count));
+    size_t seen = 0;
+    size_t bucket = 0;
+
+    while (bucket + 1 < NUM_BUCKETS && seen + counts[bucket] <= rank) {
+        seen += counts[bucket];
+        bucket++;
+    }
+
+    // The last bucket is open-ended, and no bucket's edge is beyond the largest latency seen
+    double edge = LATENCY_FLOOR_MS * std::exp2(static_cast<double>(bucket) / BUCKETS_PER_DOUBLING);
+    return (bucket + 1 == NUM_BUCKETS) ? maxMs : std::min(edge, maxMs);
+}
+
+double ExecutorStats::tasksPerSecond() const {
+    return seconds > 0.0 ? tasksCompleted / seconds : 0.0;
+}
+
+QueryExecutor::QueryExecutor(const Graph &graph, ExecutorOptions options) : _graph(graph), _options(options) {
+    size_t numThreads = options.numThreads;
+    if (numThreads == 0) {
+        numThreads = std::max(1u, thread::hardware_concurrency());
+    }
+
+    _statsStart = std::chrono::steady_clock::now();
+
+    // Create every worker before starting any, since thieves index into _workers
+    for (size_t i = 0; i < numThreads; i++) {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+
+    for (size_t i = 0; i < numThreads; i++) {
+        _workers[i]->runner = thread(&QueryExecutor::workerLoop, this, i);
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    wait();
+
+    {
+        lock_guard<mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wake.notify_all();
+
+    for (unique_ptr<Worker> &worker : _workers) {
+        worker->runner.join();
+    }
+}
+
+void QueryExecutor::post(Task task) {
+    enqueue(new Job{std::move(task), std::chrono::steady_clock::now()});
+}
+
+future<optional<vector<GraphNode>>> QueryExecutor::route(RouteQuery query, const ExclusionOverlay *overlay) {
+    return submit([query, overlay](const Graph &graph, SearchWorkspace &workspace) {
+        return graph.generateRoute(query.origin, query.dest, workspace, overlay);
+    });
+}
+
+future<vector<float>> QueryExecutor::matrix(vector<size_t> origins, vector<size_t> targets, float maxCost) {
+    struct MatrixJob {
+        vector<size_t> origins;
+        vector<size_t> targets;
+        float maxCost;
+
+        vector<float> costs;
+        atomic<size_t> remaining;
+        atomic<bool> failed = false;
+        promise<vector<float>> result;
+    };
+
+    auto job = std::make_shared<MatrixJob>();
+    job->origins = std::move(origins);
+    job->targets = std::move(targets);
+    job->maxCost = maxCost;
+    job->costs.resize(job->origins.size() * job->targets.size());
+    job->remaining = job->origins.size();
+
+    future<vector<float>> result = job->result.get_future();
+    if (job->origins.empty()) {
+        job->result.set_value(vector<float>());
+        return result;
+    }
+
+    // Rows write disjoint slices of costs; whichever row finishes last publishes the matrix
+    for (size_t row = 0; row < job->origins.size(); row++) {
+        post([job, row](const Graph &graph, SearchWorkspace &workspace) {
+            try {
+                vector<float> costs;
+                graph.boundedOneToMany(job->origins[row], job->targets, job->maxCost, workspace, costs);
+                std::copy(costs.begin(), costs.end(), job->costs.begin() + row * job->targets.size());
+            } catch (...) {
+                if (!job->failed.exchange(true)) {
+                    job->result.set_exception(std::current_exception());
+                }
+            }
+
+            if (--job->remaining == 0 && !job->failed) {
+                job->result.set_value(std::move(job->costs));
+            }
+        });
+    }
+
+    return result;
+}
+
+future<vector<pair<size_t, float>>> QueryExecutor::isochrone(size_t origin, float maxSeconds, const ExclusionOverlay *overlay) {
+    return submit([origin, maxSeconds, overlay](const Graph &graph, SearchWorkspace &workspace) {
+        vector<pair<size_t, float>> reached;
+        graph.isochrone(origin, maxSeconds, workspace, reached, overlay);
+        return reached;
+    });
+}
+
+future<size_t> QueryExecutor::snap(pair<float, float> location, bool preferLargestComponent) {
+    return submit([location, preferLargestComponent](const Graph &graph, SearchWorkspace &) {
+        return graph.snapToNode(location, preferLargestComponent);
+    });
+}
+
+void QueryExecutor::wait() {
+    unique_lock<mutex> lock(_doneMutex);
+    _done.wait(lock, [this] { return _unfinished.load() == 0; });
+}
+
+size_t QueryExecutor::size() const {
+    return _workers.size();
+}
+
+ExecutorStats QueryExecutor::stats() const {
+    ExecutorStats stats;
+    stats.threads = _workers.size();
+
+    LatencyHistogram latencies;
+    for (const unique_ptr<Worker> &worker : _workers) {
+        lock_guard<mutex> lock(worker->statsMutex);
+        latencies.merge(worker->latencies);
+        stats.tasksFailed += worker->failed;
+        stats.steals += worker->steals.load();
+    }
+
+    {
+        lock_guard<mutex> lock(_statsStartMutex);
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _statsStart).count();
+    }
+
+    stats.snapCacheHitRate = _graph.snapCacheStats().hitRate();
+
+    stats.tasksCompleted = latencies.count;
+    if (latencies.count == 0) {
+        return stats;
+    }
+
+    stats.meanLatencyMs = latencies.totalMs / latencies.count;
+    stats.p50LatencyMs = latencies.percentile(0.50);
+    stats.p99LatencyMs = latencies.percentile(0.99);
+    stats.maxLatencyMs = latencies.maxMs;
+
+    return stats;
+}
+
+void QueryExecutor::resetStats() {
+    for (unique_ptr<Worker> &worker : _workers) {
+        lock_guard<mutex> lock(worker->statsMutex);
+        worker->latencies = LatencyHistogram();
+        worker->failed = 0;
+        worker->steals = 0;
+    }
+
+    lock_guard<mutex> lock(_statsStartMutex);
+    _statsStart = std::chrono::steady_clock::now();
+}
+
+void QueryExecutor::workerLoop(size_t index) {
+    currentExecutor = this;
+    currentWorker = index;
+
+    if (_options.pinThreads) {
+        pinCurrentThread(index);
+    }
+
+    Worker &worker = *_workers[index];
+
+    while (true) {
+        Job *job = nullptr;
+
+        // Own deque first (newest work, warmest cache), then the injection queue, then other workers
+        if (!worker.deque.pop(job) && !takeInjected(job) && !stealFor(index, job)) {
+            unique_lock<mutex> lock(_sleepMutex);
+            _wake.wait(lock, [this] { return _stopping || _queued.load() > 0; });
+
+            if (_stopping && _queued.load() <= 0) {
+                return;
+            }
+
+            continue;
+        }
+
+        _queued--;
+
+        bool failed = false;
+        try {
+            job->run(_graph, worker.workspace);
+        } catch (...) {
+            failed = true;
+        }
+
+        double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->submitted).count();
+        delete job;
+
+        {
+            lock_guard<mutex> lock(worker.statsMutex);
+            worker.latencies.add(latencyMs);
+            worker.failed += failed;
+        }
+
+        if (--_unfinished == 0) {
+            lock_guard<mutex> lock(_doneMutex);
+            _done.notify_all();
+        }
+    }
+}
+
+bool QueryExecutor::takeInjected(Job *&job) {
+    lock_guard<mutex> lock(_injectedMutex);
+    if (_injected.empty()) {
+        return false;
+    }
+
+    job = _injected.front();
+    _injected.pop_front();
+    return true;
+}
+
+bool QueryExecutor::stealFor(size_t thief, Job *&job) {
+    size_t numWorkers = _workers.size();
+    if (numWorkers < 2) {
+        return false;
+    }
+
+    // Start at a random victim so thieves don't all hammer worker 0
+    static thread_local std::minstd_rand generator(static_cast<unsigned>(thief) + 1);
+    size_t start = generator() % numWorkers;
+
+    for (size_t i = 0; i < numWorkers; i++) {
+        size_t victim = (start + i) % numWorkers;
+        if (victim == thief) {
+            continue;
+        }
+
+        if (_workers[victim]->deque.steal(job)) {
+            _workers[thief]->steals++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void QueryExecutor::enqueue(Job *job) {
+    _unfinished++;
+
+    if (currentExecutor == this) {
+        _workers[currentWorker]->deque.push(job);
+    } else {
+        lock_guard<mutex> lock(_injectedMutex);
+        _injected.push_back(job);
+    }
+
+    // Taking the sleep lock orders the increment before any worker's predicate check, so no wakeup is lost
+    {
+        lock_guard<mutex> lock(_sleepMutex);
+        _queued++;
+    }
+    _wake.notify_one();
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/searchWorkspace.h"
+#include "models/util/workStealingDeque.h"
+
+using geo::Graph;
+using geo::GraphNode;
+using geo::RouteQuery;
+using geo::SearchWorkspace;
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::function;
+using std::future;
+using std::invoke_result_t;
+using std::mutex;
+using std::numeric_limits;
+using std::optional;
+using std::pair;
+using std::promise;
+using std::shared_ptr;
+using std::thread;
+using std::unique_ptr;
+using std::vector;
+using utils::WorkStealingDeque;
+
+namespace geo {
+    struct ExecutorOptions {
+        // Number of worker threads, or 0 for the hardware concurrency
+        size_t numThreads = 0;
+
+        // Pin worker i to logical CPU i (modulo the CPU count), where the platform allows it
+        bool pinThreads = false;
+    };
+
+    // Counters since the executor was created or resetStats was called.
+    // Latency runs from submission to the end of the task, so it includes queueing. Percentiles
+    // come from a histogram and are rounded up to its bucket edges, about 9% apart.
+    struct ExecutorStats {
+        size_t threads = 0;
+        size_t tasksCompleted = 0;
+        size_t tasksFailed = 0;
+        size_t steals = 0;
+        double seconds = 0.0;
+
+        double meanLatencyMs = 0.0;
+        double p50LatencyMs = 0.0;
+        double p99LatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+
+        // Of the graph's snap caches, since the graph was loaded; resetStats leaves it alone
+        double snapCacheHitRate = 0.0;
+
+        double tasksPerSecond() const;
+    };
+
+    /**
+    * Work-stealing executor for queries against one shared, immutable Graph.
+    * Each worker owns a Chase-Lev deque and a SearchWorkspace that stays with it for its whole
+    * life. Tasks submitted from outside go through a shared injection queue; tasks submitted
+    * from inside a task go to the worker's own deque. Idle workers steal from the others,
+    * so long cross-country routes and short local ones balance across cores on their own.
+    *
+    * Destroying the executor waits for every submitted task. The graph must outlive it.
+    */
+    class QueryExecutor {
+        public:
+        using Task = function<void(const Graph &graph, SearchWorkspace &workspace)>;
+
+        QueryExecutor(const Graph &graph, ExecutorOptions options = ExecutorOptions());
+        ~QueryExecutor();
+
+        QueryExecutor(const QueryExecutor &other) = delete;
+        QueryExecutor &operator=(const QueryExecutor &other) = delete;
+
+        // Callback style: run the task on some worker. Exceptions escaping the task are counted
+        // in ExecutorStats::tasksFailed and otherwise dropped, so report errors from inside the task.
+        void post(Task task);
+
+        // Future style: run task(graph, workspace) on some worker and return its result.
+        // Exceptions are delivered through the future.
+        template <typename F>
+        auto submit(F task) -> future<invoke_result_t<F &, const Graph &, SearchWorkspace &>>;
+
+        // Snap both ends onto roads and route between them (see Graph::generateRoute)
+        future<optional<vector<GraphNode>>> route(RouteQuery query, const ExclusionOverlay *overlay = nullptr);
+
+        // Travel times from every origin to every target node, row-major (one row per origin).
+        // Pairs not reachable within maxCost are infinity. Each row runs as its own task.
+        future<vector<float>> matrix(
+            vector<size_t> origins,
+            vector<size_t> targets,
+            float maxCost = numeric_limits<float>::infinity()
+        );
+
+        // Nodes reachable from origin within maxSeconds (see Graph::isochrone)
+        future<vector<pair<size_t, float>>> isochrone(size_t origin, float maxSeconds, const ExclusionOverlay *overlay = nullptr);
+
+        future<size_t> snap(pair<float, float> location, bool preferLargestComponent = false);
+
+        // Block until every task submitted so far (including tasks they submitted) has finished
+        void wait();
+
+        size_t size() const;
+
+        ExecutorStats stats() const;
+        void resetStats();
+
+        private:
+        struct Job {
+            Task run;
+            std::chrono::steady_clock::time_point submitted;
+        };
+
+        // Latencies in buckets that grow 2^(1/8) wide each, from LATENCY_FLOOR_MS up to about 18 minutes, so
+        // the stats take the same memory however long the executor runs
+        struct LatencyHistogram {
+            static constexpr double LATENCY_FLOOR_MS = 0.001;
+            static constexpr size_t BUCKETS_PER_DOUBLING = 8;
+            static constexpr size_t NUM_BUCKETS = 30 * BUCKETS_PER_DOUBLING + 1;
+
+            size_t counts[NUM_BUCKETS] = {};
+            size_t count = 0;
+            double totalMs = 0.0;
+            double maxMs = 0.0;
+
+            void add(double latencyMs);
+            void merge(const LatencyHistogram &other);
+
+            // Upper edge of the bucket holding the latency at this fraction of the sorted latencies
+            double percentile(double fraction) const;
+        };
+
+        struct Worker {
+            WorkStealingDeque<Job *> deque;
+            SearchWorkspace workspace;
+            thread runner;
+
+            mutable mutex statsMutex;
+            LatencyHistogram latencies;
+            size_t failed = 0;
+            atomic<size_t> steals = 0;
+        };
+
+        const Graph &_graph;
+        ExecutorOptions _options;
+        vector<unique_ptr<Worker>> _workers = vector<unique_ptr<Worker>>();
+
+        // Tasks submitted from outside the workers
+        mutex _injectedMutex;
+        deque<Job *> _injected = deque<Job *>();
+
+        // Jobs waiting in any queue (may briefly dip below zero) and jobs not yet finished
+        atomic<int64_t> _queued = 0;
+        atomic<size_t> _unfinished = 0;
+
+        mutex _sleepMutex;
+        condition_variable _wake;
+        bool _stopping = false;
+
+        mutex _doneMutex;
+        condition_variable _done;
+
+        mutable mutex _statsStartMutex;
+        std::chrono::steady_clock::time_point _statsStart;
+
+        void workerLoop(size_t index);
+        bool takeInjected(Job *&job);
+        bool stealFor(size_t thief, Job *&job);
+        void enqueue(Job *job);
+    };
+
+    template <typename F>
+    auto QueryExecutor::submit(F task) -> future<invoke_result_t<F &, const Graph &, SearchWorkspace &>> {
+        using Result = invoke_result_t<F &, const Graph &, SearchWorkspace &>;
+
+        auto result = std::make_shared<promise<Result>>();
+        future<Result> resultFuture = result->get_future();
+
+        post([result, task = std::move(task)](const Graph &graph, SearchWorkspace &workspace) mutable {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    task(graph, workspace);
+                    result->set_value();
+                } else {
+                    result->set_value(task(graph, workspace));
+                }
+            } catch (...) {
+                result->set_exception(std::current_exception());
+            }
+        });
+
+        return resultFuture;
+    }
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <limits>
+
+#include "searchWorkspace.h"
+
+using geo::PriorityNode;
+using geo::SearchWorkspace;
+using std::greater;
+using std::numeric_limits;
+
+SearchWorkspace::SearchWorkspace(size_t numNodes) {
+    reset(numNodes);
+}
+
+void SearchWorkspace::reset(size_t numNodes) {
+    if (_reachedStamp.size() < numNodes) {
+        _reachedStamp.resize(numNodes, 0);
+        _settledStamp.resize(numNodes, 0);
+        _cost.resize(numNodes);
+        _parent.resize(numNodes);
+        _parentEntry.resize(numNodes);
+        _heuristicStamp.resize(numNodes, 0);
+        _heuristic.resize(numNodes);
+    }
+
+    _generation++;
+
+    // On wraparound, old stamps could alias the new generation
+    if (_generation == 0) {
+        std::fill(_reachedStamp.begin(), _reachedStamp.end(), 0);
+        std::fill(_settledStamp.begin(), _settledStamp.end(), 0);
+        std::fill(_heuristicStamp.begin(), _heuristicStamp.end(), 0);
+        _generation = 1;
+    }
+
+    _frontier.clear();
+}
+
+bool SearchWorkspace::reached(size_t node) const {
+    return _reachedStamp[node] == _generation;
+}
+
+bool SearchWorkspace::settled(size_t node) const {
+    return _settledStamp[node] == _generation;
+}
+
+float SearchWorkspace::cost(size_t node) const {
+    if (!reached(node)) {
+        return numeric_limits<float>::infinity();
+    }
+
+    return _cost[node];
+}
+
+size_t SearchWorkspace::parent(size_t node) const {
+    return _parent[node];
+}
+
+size_t SearchWorkspace::parentEntry(size_t node) const {
+    return _parentEntry[node];
+}
+
+void SearchWorkspace::update(size_t node, float cost, size_t parent, size_t parentEntry) {
+    _reachedStamp[node] = _generation;
+    _cost[node] = cost;
+    _parent[node] = parent;
+    _parentEntry[node] = parentEntry;
+}
+
+void SearchWorkspace::settle(size_t node) {
+    _settledStamp[node] = _generation;
+}
+
+bool SearchWorkspace::hasHeuristic(size_t node) const {
+    return _heuristicStamp[node] == _generation;
+}
+
+float SearchWorkspace::heuristic(size_t node) const {
+    return _heuristic[node];
+}
+
+void SearchWorkspace::setHeuristic(size_t node, float value) {
+    _heuristicStamp[node] = _generation;
+    _heuristic[node] = value;
+}
+
+void SearchWorkspace::push(float priority, size_t node) {
+    _frontier.emplace_back(priority, node);
+    std::push_heap(_frontier.begin(), _frontier.end(), greater<>());
+}
+
+PriorityNode SearchWorkspace::pop() {
+    std::pop_heap(_frontier.begin(), _frontier.end(), greater<>());
+    PriorityNode top = _frontier.back();
+    _frontier.pop_back();
+
+    return top;
+}
+
+bool SearchWorkspace::frontierEmpty() const {
+    return _frontier.empty();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using std::greater;
+using std::pair;
+using std::vector;
+
+namespace geo {
+    using PriorityNode = pair<float, size_t>; // priority -> node
+
+    /**
+    * Per-query search state for graph searches.
+    * Arrays are sized to the graph once and invalidated lazily through a generation counter,
+    * so a single workspace can serve many searches without clearing or hashing.
+    * A workspace must not be shared between threads; give each worker its own.
+    */
+    class SearchWorkspace {
+        public:
+        SearchWorkspace() = default;
+        SearchWorkspace(size_t numNodes);
+
+        // Start a new search over a graph with numNodes vertices
+        void reset(size_t numNodes);
+
+        // Whether the node has been assigned a cost in the current search
+        bool reached(size_t node) const;
+
+        // Whether the node has been popped from the frontier in the current search
+        bool settled(size_t node) const;
+
+        // Cost so far, or infinity if the node was not reached
+        float cost(size_t node) const;
+        size_t parent(size_t node) const;
+
+        // Matrix entry used to arrive from the parent, if the search passed one to update
+        size_t parentEntry(size_t node) const;
+
+        void update(size_t node, float cost, size_t parent, size_t parentEntry = 0);
+        void settle(size_t node);
+
+        // Per-query heuristic cache, so each node's bound is computed at most once per search
+        bool hasHeuristic(size_t node) const;
+        float heuristic(size_t node) const;
+        void setHeuristic(size_t node, float value);
+
+        // Frontier operations. The frontier keeps its capacity between searches.
+        void push(float priority, size_t node);
+        PriorityNode pop();
+        bool frontierEmpty() const;
+
+        private:
+        uint32_t _generation = 0;
+
+        // A node is reached when _reachedStamp[node] == _generation
+        vector<uint32_t> _reachedStamp = vector<uint32_t>();
+        vector<uint32_t> _settledStamp = vector<uint32_t>();
+        vector<float> _cost = vector<float>();
+        vector<size_t> _parent = vector<size_t>();
+        vector<size_t> _parentEntry = vector<size_t>();
+
+        vector<uint32_t> _heuristicStamp = vector<uint32_t>();
+        vector<float> _heuristic = vector<float>();
+
+        // Binary min-heap on priority
+        vector<PriorityNode> _frontier = vector<PriorityNode>();
+    };
+}
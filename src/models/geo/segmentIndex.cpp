@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+#include "geoData.h"
+#include "models/util/hilbert.h"
+#include "segmentIndex.h"
+
+using geo::convertToRadians;
+using geo::greatCircleMetres;
+using geo::SegmentIndex;
+using geo::SegmentProjection;
+using std::greater;
+using std::invalid_argument;
+using std::nullopt;
+using std::numeric_limits;
+using std::priority_queue;
+using std::vector;
+using utils::hilbertIndex;
+
+namespace {
+    const size_t BLOCK_SIZE = 4096;
+
+    // Run body(first, last) over [0, count) in blocks, on the pool's workers if there is a pool
+    void forEachBlock(size_t count, ThreadPool *pool, const function<void(size_t first, size_t last)> &body) {
+        size_t numBlocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        if (pool == nullptr || numBlocks < 2) {
+            body(0, count);
+            return;
+        }
+
+        pool->parallelFor(numBlocks, [&](size_t, size_t block) {
+            body(block * BLOCK_SIZE, std::min(count, (block + 1) * BLOCK_SIZE));
+        });
+    }
+
+    // Sort one run per worker, then merge neighbouring runs in pairs until one is left
+    void sortKeys(vector<uint64_t> &keys, ThreadPool *pool) {
+        size_t numRuns = (pool == nullptr) ? 1 : pool->size();
+
+        if (numRuns < 2 || keys.size() < 2 * BLOCK_SIZE) {
+            std::sort(keys.begin(), keys.end());
+            return;
+        }
+
+        size_t count = keys.size();
+        size_t runSize = (count + numRuns - 1) / numRuns;
+
+        pool->parallelFor(numRuns, [&](size_t, size_t run) {
+            std::sort(keys.begin() + std::min(count, run * runSize), keys.begin() + std::min(count, (run + 1) * runSize));
+        });
+
+        for (size_t width = runSize; width < count; width *= 2) {
+            size_t numMerges = (count + 2 * width - 1) / (2 * width);
+
+            pool->parallelFor(numMerges, [&](size_t, size_t merge) {
+                size_t first = merge * 2 * width;
+                std::inplace_merge(keys.begin() + first, keys.begin() + std::min(count, first + width),
+                                   keys.begin() + std::min(count, first + 2 * width));
+            });
+        }
+    }
+
+    // Box over the four-float boxes [first, last), written to box
+    void coverBoxes(const float *boxes, size_t first, size_t last, float *box) {
+        box[0] = box[1] = numeric_limits<float>::infinity();
+        box[2] = box[3] = -numeric_limits<float>::infinity();
+
+        for (size_t i = first; i < last; i++) {
+            box[0] = std::min(box[0], boxes[i * 4]);
+            box[1] = std::min(box[1], boxes[i * 4 + 1]);
+            box[2] = std::max(box[2], boxes[i * 4 + 2]);
+            box[3] = std::max(box[3], boxes[i * 4 + 3]);
+        }
+    }
+}
+
+SegmentIndex::SegmentIndex(span<const pair<float, float>> starts, span<const pair<float, float>> ends, ThreadPool *pool) {
+    if (starts.size() != ends.size()) {
+        throw invalid_argument("SegmentIndex start and end arrays must have the same length");
+    }
+
+    if (starts.size() > numeric_limits<uint32_t>::max()) {
+        throw invalid_argument(format("A SegmentIndex can't hold {} segments", starts.size()));
+    }
+
+    size_t numSegments = starts.size();
+    if (numSegments == 0) {
+        return;
+    }
+
+    // Spread the curve over the box of the segments' centres
+    float minLat = numeric_limits<float>::infinity(), maxLat = -minLat;
+    float minLon = numeric_limits<float>::infinity(), maxLon = -minLon;
+
+    for (size_t i = 0; i < numSegments; i++) {
+        float lat = (starts[i].first + ends[i].first) / 2;
+        float lon = (starts[i].second + ends[i].second) / 2;
+        minLat = std::min(minLat, lat);
+        maxLat = std::max(maxLat, lat);
+        minLon = std::min(minLon, lon);
+        maxLon = std::max(maxLon, lon);
+    }
+
+    float latScale = (maxLat > minLat) ? 65535.0f / (maxLat - minLat) : 0.0f;
+    float lonScale = (maxLon > minLon) ? 65535.0f / (maxLon - minLon) : 0.0f;
+
+    // Sort by curve position (high half) and keep the input index (low half)
+    vector<uint64_t> keys(numSegments);
+    forEachBlock(numSegments, pool, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            uint32_t code = hilbertIndex((starts[i].first + ends[i].first) / 2, (starts[i].second + ends[i].second) / 2,
+                                         minLat, minLon, latScale, lonScale);
+            keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+        }
+    });
+    sortKeys(keys, pool);
+
+    _segments = ListWithSize<float>(numSegments * 4);
+    _originals = ListWithSize<uint32_t>(numSegments);
+    vector<float> segmentBoxes(numSegments * 4);
+
+    forEachBlock(numSegments, pool, [&](size_t first, size_t last) {
+        for (size_t position = first; position < last; position++) {
+            uint32_t original = static_cast<uint32_t>(keys[position]);
+            auto [startLat, startLon] = starts[original];
+            auto [endLat, endLon] = ends[original];
+
+            _originals[position] = original;
+            _segments[position * 4] = startLat;
+            _segments[position * 4 + 1] = startLon;
+            _segments[position * 4 + 2] = endLat;
+            _segments[position * 4 + 3] = endLon;
+
+            segmentBoxes[position * 4] = std::min(startLat, endLat);
+            segmentBoxes[position * 4 + 1] = std::min(startLon, endLon);
+            segmentBoxes[position * 4 + 2] = std::max(startLat, endLat);
+            segmentBoxes[position * 4 + 3] = std::max(startLon, endLon);
+        }
+    });
+
+    vector<size_t> levels = {0};
+    size_t levelSize = numSegments;
+    do {
+        levelSize = (levelSize + NODE_SIZE - 1) / NODE_SIZE;
+        levels.push_back(levels.back() + levelSize);
+    } while (levelSize > 1);
+
+    _levels = ListWithSize<size_t>(levels);
+    _boxes = ListWithSize<float>(levels.back() * 4);
+
+    // Each level covers the one below, starting from the segments themselves
+    const float *below = segmentBoxes.data();
+    size_t belowSize = numSegments;
+
+    for (size_t level = 0; level + 1 < levels.size(); level++) {
+        float *boxes = _boxes.data() + levels[level] * 4;
+
+        forEachBlock(levels[level + 1] - levels[level], pool, [&](size_t first, size_t last) {
+            for (size_t node = first; node < last; node++) {
+                coverBoxes(below, node * NODE_SIZE, std::min(belowSize, (node + 1) * NODE_SIZE), boxes + node * 4);
+            }
+        });
+
+        below = boxes;
+        belowSize = levels[level + 1] - levels[level];
+    }
+}
+
+optional<SegmentProjection> SegmentIndex::nearest(pair<float, float> location, const function<bool(size_t)> &accept) const {
+    if (_originals.size() == 0) {
+        return nullopt;
+    }
+
+    // Degrees of longitude are scaled to the length of degrees of latitude at the query
+    auto [queryLat, queryLon] = location;
+    float lonScale = std::cos(convertToRadians(queryLat));
+
+    auto boxDistance = [&](size_t node) {
+        const float *box = _boxes.data() + node * 4;
+        float dLat = std::max({box[0] - queryLat, 0.0f, queryLat - box[2]});
+        float dLon = std::max({box[1] - queryLon, 0.0f, queryLon - box[3]}) * lonScale;
+        return dLat * dLat + dLon * dLon;
+    };
+
+    size_t numLevels = _levels.size() - 1;
+    size_t best = numeric_limits<size_t>::max();
+    float bestDistance = numeric_limits<float>::infinity();
+    float bestFraction = 0.0f;
+
+    // Best first over the nodes, by the distance to their boxes
+    using NodeDistance = pair<float, size_t>;
+    priority_queue<NodeDistance, vector<NodeDistance>, greater<NodeDistance>> frontier;
+    frontier.push({boxDistance(_levels[numLevels - 1]), _levels[numLevels - 1]});
+
+    while (!frontier.empty() && frontier.top().first < bestDistance) {
+        size_t node = frontier.top().second;
+        frontier.pop();
+
+        size_t level = 0;
+        while (node >= _levels[level + 1]) {
+            level++;
+        }
+
+        size_t index = node - _levels[level];
+
+        if (level > 0) {
+            size_t childLevelSize = _levels[level] - _levels[level - 1];
+            for (size_t child = index * NODE_SIZE; child < std::min(childLevelSize, (index + 1) * NODE_SIZE); child++) {
+                float distance = boxDistance(_levels[level - 1] + child);
+                if (distance < bestDistance) {
+                    frontier.push({distance, _levels[level - 1] + child});
+                }
+            }
+
+            continue;
+        }
+
+        for (size_t segment = index * NODE_SIZE; segment < std::min(_originals.size(), (index + 1) * NODE_SIZE); segment++) {
+            const float *ends = _segments.data() + segment * 4;
+            float startY = ends[0] - queryLat;
+            float startX = (ends[1] - queryLon) * lonScale;
+            float dY = ends[2] - ends[0];
+            float dX = (ends[3] - ends[1]) * lonScale;
+
+            // Foot of the perpendicular from the query, clamped to the segment
+            float lengthSquared = dX * dX + dY * dY;
+            float fraction = (lengthSquared > 0.0f) ? std::clamp(-(startX * dX + startY * dY) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+            float y = startY + fraction * dY;
+            float x = startX + fraction * dX;
+            float distance = x * x + y * y;
+
+            if (distance < bestDistance && (!accept || accept(_originals[segment]))) {
+                best = segment;
+                bestDistance = distance;
+                bestFraction = fraction;
+            }
+        }
+    }
+
+    if (best == numeric_limits<size_t>::max()) {
+        return nullopt;
+    }
+
+    const float *ends = _segments.data() + best * 4;
+    pair<float, float> projected = {
+        ends[0] + bestFraction * (ends[2] - ends[0]),
+        ends[1] + bestFraction * (ends[3] - ends[1])
+    };
+
+    return SegmentProjection{_originals[best], bestFraction, projected, greatCircleMetres(location, projected)};
+}
+
+size_t SegmentIndex::size() const {
+    return _originals.size();
+}
+
+size_t SegmentIndex::memoryBytes() const {
+    return _segments.size() * sizeof(float) + _originals.size() * sizeof(uint32_t)
+        + _boxes.size() * sizeof(float) + _levels.size() * sizeof(size_t);
+}
+
+namespace geo {
+    istream &operator>>(istream &input, SegmentIndex &index) {
+        input >> index._segments;
+        input >> index._originals;
+        input >> index._boxes;
+        input >> index._levels;
+
+        return input;
+    }
+
+    ostream &operator<<(ostream &output, const SegmentIndex &index) {
+        output << index._segments;
+        output << index._originals;
+        output << index._boxes;
+        output << index._levels;
+
+        return output;
+    }
+}
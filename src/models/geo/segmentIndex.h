@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include "models/util/listWithSize.h"
+#include "models/util/threadPool.h"
+
+using std::function;
+using std::istream;
+using std::optional;
+using std::ostream;
+using std::pair;
+using std::span;
+using utils::ListWithSize;
+using utils::ThreadPool;
+
+namespace geo {
+    // Closest point of a segment to a location
+    struct SegmentProjection {
+        size_t segment;
+
+        // Position of the point along the segment, from 0 at its start to 1 at its end
+        float fraction;
+        pair<float, float> location;
+
+        // Great circle distance from the location to the point
+        float metres;
+    };
+
+    /**
+    * Packed Hilbert R-tree over line segments, for snapping a location onto the nearest point of a
+    * road rather than onto its nearest node. Segments are sorted by the Hilbert index of their
+    * centres and packed NODE_SIZE to a leaf; each level above packs NODE_SIZE boxes of the level
+    * below. The tree is a few flat arrays with no pointers, built bottom up one level at a time.
+    *
+    * Distances are compared in a plane around the query, with longitudes scaled by the cosine of
+    * its latitude, which is accurate to centimetres at snapping range. Segments crossing the
+    * antimeridian are not supported.
+    *
+    * Queries return input indices.
+    */
+    class SegmentIndex {
+        public:
+        static constexpr size_t NODE_SIZE = 16;
+
+        SegmentIndex() = default;
+
+        // Segment i runs from starts[i] to ends[i]. Boxes, sorting and packing run on the pool, if one is given.
+        SegmentIndex(span<const pair<float, float>> starts, span<const pair<float, float>> ends, ThreadPool *pool = nullptr);
+
+        // The segment closest to the location among those accept returns true for (all, if accept is
+        // empty), or nullopt if there is none
+        optional<SegmentProjection> nearest(pair<float, float> location, const function<bool(size_t segment)> &accept = nullptr) const;
+
+        size_t size() const;
+
+        // Bytes held by the index's arrays
+        size_t memoryBytes() const;
+
+        friend istream &operator>>(istream &input, SegmentIndex &index);
+        friend ostream &operator<<(ostream &output, const SegmentIndex &index);
+
+        private:
+        // Segments in packed order, four floats each: start latitude and longitude, end latitude and longitude
+        ListWithSize<float> _segments = ListWithSize<float>(0);
+
+        // Input index of each packed segment
+        ListWithSize<uint32_t> _originals = ListWithSize<uint32_t>(0);
+
+        // Bounding boxes of the tree's nodes, four floats each: min latitude and longitude, max
+        // latitude and longitude. Leaves come first and the root last.
+        ListWithSize<float> _boxes = ListWithSize<float>(0);
+
+        // The nodes of level l are [_levels[l], _levels[l + 1]), leaves at level 0. Node i of level l
+        // covers nodes (or, for leaves, segments) [i * NODE_SIZE, (i + 1) * NODE_SIZE) of the level below.
+        ListWithSize<size_t> _levels = ListWithSize<size_t>(0);
+    };
+
+    istream &operator>>(istream &input, SegmentIndex &index);
+    ostream &operator<<(ostream &output, const SegmentIndex &index);
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+using std::atomic;
+using std::optional;
+using std::pair;
+using std::unique_ptr;
+
+namespace geo {
+    // Counters since the cache was created or last cleared
+    struct SnapCacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t capacity = 0;
+
+        double hitRate() const {
+            return (hits + misses == 0) ? 0.0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    /**
+    * Bounded, concurrent cache of snapping results, keyed by the cell of a grid of about 1 m that
+    * holds the location. Requests from a fixed set of addresses land in the same cells every time,
+    * so they skip the index descent after the first.
+    *
+    * Open addressing over a power-of-2 table: a key lives in one of the PROBE_LIMIT slots after its
+    * hash, and once those are full a new key evicts one of them. Each slot is a seqlock. Reads take
+    * no lock and never wait; a read that overlaps a write to its slot counts as a miss. A write
+    * that finds its slot being written by another thread is dropped.
+    *
+    * Any location in a cell gets the result cached for the first location snapped in it, which is
+    * at most about 1.5 m away. Value is copied as bytes, so it must be trivially copy constructible
+    * and destructible (like pair<float, float>, which isn't trivially copyable).
+    */
+    template <typename Value>
+    class SnapCache {
+        static_assert(std::is_trivially_copy_constructible_v<Value> && std::is_trivially_destructible_v<Value>,
+                      "SnapCache values must be trivially copy constructible and destructible");
+
+        public:
+        static constexpr size_t PROBE_LIMIT = 8;
+
+        // Cells are 1e-5 degrees on a side: 1.1 m of latitude, and less of longitude away from the equator
+        static constexpr double CELLS_PER_DEGREE = 1e5;
+
+        // Never stored. cellKey returns it for locations that can't be cached.
+        static constexpr uint64_t NO_KEY = UINT64_MAX;
+
+        // capacity is rounded up to a power of 2. A cache of capacity 0 stores nothing.
+        SnapCache(size_t capacity = 0);
+
+        // Copies are empty, with the same capacity
+        SnapCache(const SnapCache &other);
+        SnapCache &operator=(const SnapCache &other);
+
+        // Key of the cell holding the location. option tells apart snaps of one location with
+        // different settings. NO_KEY for locations that aren't finite.
+        static uint64_t cellKey(pair<float, float> location, bool option = false);
+
+        // The value cached for the location's cell, or compute() (which is then cached).
+        // compute runs outside any lock, and may run for the same cell on several threads at once.
+        template <typename F>
+        Value findOrCompute(pair<float, float> location, bool option, F compute);
+
+        // The value cached for the key, if there is one
+        optional<Value> find(uint64_t key) const;
+
+        // Cache a value for the key, unless another thread is writing to the slot it would take
+        void insert(uint64_t key, const Value &value);
+
+        // Drop every value and reset the counters. Safe to call during reads, which may still
+        // return values from before the call until it returns.
+        void clear();
+
+        SnapCacheStats stats() const;
+
+        private:
+        static constexpr size_t VALUE_WORDS = (sizeof(Value) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        struct Slot {
+            // Odd while a write is in progress
+            atomic<uint64_t> sequence = 0;
+            atomic<uint64_t> key = NO_KEY;
+            atomic<uint64_t> words[VALUE_WORDS] = {};
+        };
+
+        size_t _mask = 0;
+        unique_ptr<Slot[]> _slots = nullptr;
+
+        alignas(64) atomic<size_t> _hits = 0;
+        alignas(64) atomic<size_t> _misses = 0;
+
+        static uint64_t hash(uint64_t key);
+        void write(Slot &slot, uint64_t key, const Value &value);
+    };
+
+    template <typename Value>
+    SnapCache<Value>::SnapCache(size_t capacity) {
+        if (capacity == 0) {
+            return;
+        }
+
+        size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+
+        _mask = rounded - 1;
+        _slots = std::make_unique<Slot[]>(rounded);
+    }
+
+    template <typename Value>
+    SnapCache<Value>::SnapCache(const SnapCache &other) : SnapCache(other.stats().capacity) {}
+
+    template <typename Value>
+    SnapCache<Value> &SnapCache<Value>::operator=(const SnapCache &other) {
+        if (this != &other) {
+            size_t capacity = other.stats().capacity;
+            _mask = (capacity == 0) ? 0 : capacity - 1;
+            _slots = (capacity == 0) ? nullptr : std::make_unique<Slot[]>(capacity);
+            _hits.store(0, std::memory_order_relaxed);
+            _misses.store(0, std::memory_order_relaxed);
+        }
+
+        return *this;
+    }
+
+    template <typename Value>
+    uint64_t SnapCache<Value>::cellKey(pair<float, float> location, bool option) {
+        if (!std::isfinite(location.first) || !std::isfinite(location.second)) {
+            return NO_KEY;
+        }
+
+        // 31 bits of latitude cell above 31 bits of longitude cell above the option, all offset to be
+        // unsigned. Valid coordinates need 25 and 26 bits; anything beyond is clamped.
+        const double limit = (1 << 30) - 1;
+        auto cell = [limit](float degrees) {
+            double index = std::clamp(std::floor(degrees * CELLS_PER_DEGREE), -limit, limit);
+            return static_cast<uint64_t>(static_cast<int64_t>(index) + (1 << 30));
+        };
+
+        return (cell(location.first) << 32) | (cell(location.second) << 1) | static_cast<uint64_t>(option);
+    }
+
+    template <typename Value>
+    template <typename F>
+    Value SnapCache<Value>::findOrCompute(pair<float, float> location, bool option, F compute) {
+        uint64_t key = cellKey(location, option);
+        if (_slots == nullptr || key == NO_KEY) {
+            return compute();
+        }
+
+        optional<Value> cached = find(key);
+        if (cached.has_value()) {
+            _hits.fetch_add(1, std::memory_order_relaxed);
+            return *cached;
+        }
+
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        Value value = compute();
+        insert(key, value);
+        return value;
+    }
+
+    template <typename Value>
+    optional<Value> SnapCache<Value>::find(uint64_t key) const {
+        if (_slots == nullptr || key == NO_KEY) {
+            return std::nullopt;
+        }
+
+        size_t home = hash(key) & _mask;
+
+        for (size_t probe = 0; probe < PROBE_LIMIT && probe <= _mask; probe++) {
+            const Slot &slot = _slots[(home + probe) & _mask];
+
+            uint64_t before = slot.sequence.load(std::memory_order_acquire);
+            uint64_t slotKey = slot.key.load(std::memory_order_relaxed);
+
+            // Slots only empty all at once, so an empty one ends the probe sequence
+            if (slotKey == NO_KEY && (before & 1) == 0) {
+                return std::nullopt;
+            }
+
+            if (slotKey != key) {
+                continue;
+            }
+
+            uint64_t words[VALUE_WORDS];
+            for (size_t i = 0; i < VALUE_WORDS; i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+
+            // The copy is only whole if no write started or finished while it was taken
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((before & 1) != 0 || slot.sequence.load(std::memory_order_relaxed) != before) {
+                return std::nullopt;
+            }
+
+            // The bytes implicitly create a Value, which has an implicit lifetime
+            alignas(Value) unsigned char bytes[sizeof(Value)];
+            std::memcpy(bytes, words, sizeof(Value));
+            return *std::launder(reinterpret_cast<const Value *>(bytes));
+        }
+
+        return std::nullopt;
+    }
+
+    template <typename Value>
+    void SnapCache<Value>::insert(uint64_t key, const Value &value) {
+        if (_slots == nullptr || key == NO_KEY) {
+            return;
+        }
+
+        uint64_t keyHash = hash(key);
+        size_t home = keyHash & _mask;
+        size_t probes = (PROBE_LIMIT < _mask + 1) ? PROBE_LIMIT : _mask + 1;
+
+        // The key's own slot or the first empty one, otherwise evict one picked by the hash's high bits
+        for (size_t probe = 0; probe < probes; probe++) {
+            Slot &slot = _slots[(home + probe) & _mask];
+            uint64_t slotKey = slot.key.load(std::memory_order_relaxed);
+
+            if (slotKey == key || slotKey == NO_KEY) {
+                write(slot, key, value);
+                return;
+            }
+        }
+
+        write(_slots[(home + (keyHash >> 32) % probes) & _mask], key, value);
+    }
+
+    template <typename Value>
+    void SnapCache<Value>::clear() {
+        if (_slots != nullptr) {
+            for (size_t i = 0; i <= _mask; i++) {
+                Slot &slot = _slots[i];
+
+                // Unlike an insert, a clear can't skip a slot that is being written
+                uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+                while ((sequence & 1) != 0
+                       || !slot.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire)) {
+                    sequence = slot.sequence.load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_release);
+                slot.key.store(NO_KEY, std::memory_order_relaxed);
+                slot.sequence.store(sequence + 2, std::memory_order_release);
+            }
+        }
+
+        _hits.store(0, std::memory_order_relaxed);
+        _misses.store(0, std::memory_order_relaxed);
+    }
+
+    template <typename Value>
+    SnapCacheStats SnapCache<Value>::stats() const {
+        SnapCacheStats stats;
+        stats.hits = _hits.load(std::memory_order_relaxed);
+        stats.misses = _misses.load(std::memory_order_relaxed);
+        stats.capacity = (_slots == nullptr) ? 0 : _mask + 1;
+        return stats;
+    }
+
+    template <typename Value>
+    uint64_t SnapCache<Value>::hash(uint64_t key) {
+        // Fibonacci hashing, with the high bits folded down since the mask keeps the low ones
+        key *= 0x9E3779B97F4A7C15ull;
+        return key ^ (key >> 29);
+    }
+
+    template <typename Value>
+    void SnapCache<Value>::write(Slot &slot, uint64_t key, const Value &value) {
+        uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) != 0
+            || !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) {
+            return;
+        }
+
+        uint64_t words[VALUE_WORDS] = {};
+        std::memcpy(words, &value, sizeof(Value));
+
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.key.store(key, std::memory_order_relaxed);
+        for (size_t i = 0; i < VALUE_WORDS; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+}
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+
+#include "geoData.h"
+#include "heuristic.h"
+#include "sphereIndex.h"
+
+using geo::SphereIndex;
+using std::array;
+using std::invalid_argument;
+using std::pair;
+using std::span;
+using std::vector;
+
+SphereIndex::SphereIndex(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool) {
+    if (latitudes.size() != longitudes.size()) {
+        throw invalid_argument("SphereIndex latitude and longitude arrays must have the same length");
+    }
+
+    vector<array<float, 3>> unitVectors(latitudes.size());
+    for (size_t i = 0; i < latitudes.size(); i++) {
+        unitVectors[i] = unitVector({latitudes[i], longitudes[i]});
+    }
+
+    _tree = KdTree<3>(unitVectors, pool);
+}
+
+size_t SphereIndex::nearest(pair<float, float> location) const {
+    return _tree.payload(_tree.nearestPoint(unitVector(location)));
+}
+
+void SphereIndex::kNearest(pair<float, float> location, size_t k, vector<size_t> &result) const {
+    size_t first = result.size();
+    _tree.kNearest(unitVector(location), k, result);
+
+    for (size_t i = first; i < result.size(); i++) {
+        result[i] = _tree.payload(result[i]);
+    }
+}
+
+void SphereIndex::withinMetres(pair<float, float> location, float metres, vector<size_t> &result) const {
+    // Chord of the arc, on the unit sphere. Arcs of half the circumference or more cover everything.
+    double angle = std::min(static_cast<double>(metres) / EARTH_RADIUS_METRES, std::numbers::pi);
+    float chord = static_cast<float>(2.0 * std::sin(angle / 2.0));
+
+    size_t first = result.size();
+    _tree.pointsWithinRadius(unitVector(location), chord, result);
+
+    for (size_t i = first; i < result.size(); i++) {
+        result[i] = _tree.payload(result[i]);
+    }
+}
+
+size_t SphereIndex::size() const {
+    return _tree.size();
+}
+
+size_t SphereIndex::memoryBytes() const {
+    return _tree.memoryBytes();
+}
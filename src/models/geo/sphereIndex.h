@@ -0,0 +1,49 @@
+#pragma once
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "models/util/kdTree.h"
+#include "models/util/threadPool.h"
+
+using std::pair;
+using std::span;
+using std::vector;
+using utils::KdTree;
+using utils::ThreadPool;
+
+namespace geo {
+    /**
+    * Nearest neighbour index over locations on the sphere. Each location is stored as its unit
+    * vector (see unitVector) in a 3D KdTree. The chord between two unit vectors grows with the
+    * great circle distance between them, so the nearest by chord is the nearest on the sphere:
+    * unlike Dim2Tree's plane of degrees, answers stay right at high latitudes and across the
+    * antimeridian, and a query needs trig only for its own unit vector.
+    *
+    * Queries return input indices.
+    */
+    class SphereIndex {
+        public:
+        SphereIndex() = default;
+        SphereIndex(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool = nullptr);
+
+        // Nearest location by great circle distance. The index must not be empty.
+        size_t nearest(pair<float, float> location) const;
+
+        // The k nearest locations, closest first (fewer if the index is smaller), appended to result
+        void kNearest(pair<float, float> location, size_t k, vector<size_t> &result) const;
+
+        // All locations within metres of the location by great circle distance (inclusive),
+        // appended to result in no particular order
+        void withinMetres(pair<float, float> location, float metres, vector<size_t> &result) const;
+
+        size_t size() const;
+
+        // Bytes held by the index's arrays
+        size_t memoryBytes() const;
+
+        private:
+        KdTree<3> _tree;
+    };
+}
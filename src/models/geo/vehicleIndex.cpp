@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "exclusionOverlay.h"
+#include "geoData.h"
+#include "vehicleIndex.h"
+
+using geo::ExclusionOverlay;
+using geo::greatCircleMetres;
+using geo::NearbyVehicle;
+using geo::VehicleIndex;
+using geo::VehicleIndexOptions;
+using std::invalid_argument;
+using std::lock_guard;
+using std::out_of_range;
+using std::unique_lock;
+
+VehicleIndex::VehicleIndex(const Graph &graph, size_t maxVehicles, VehicleIndexOptions options)
+    : _graph(graph),
+      _options(options),
+      _reversed(graph.edges().transpose()),
+      _firstAtNode(graph.size()),
+      _nodeOfVehicle(maxVehicles),
+      _stripes(LOCK_STRIPES) {
+    if (maxVehicles >= NO_VEHICLE) {
+        throw invalid_argument(format("A VehicleIndex can't hold {} vehicles", maxVehicles));
+    }
+
+    // Entries of each reversed row are ordered by the row they came from (see CsrMatrix::transpose),
+    // so walking the graph's rows in order visits them in the same order
+    _forwardEntries = ListWithSize<size_t>(_graph.edges().numEntries());
+    vector<size_t> next(_graph.size());
+    for (size_t node = 0; node < _graph.size(); node++) {
+        next[node] = _reversed.rowOffset(node);
+    }
+
+    for (size_t row = 0; row < _graph.size(); row++) {
+        auto [times, neighbors] = _graph.edges().valuesInRow(row);
+        size_t rowOffset = _graph.edges().rowOffset(row);
+
+        for (size_t i = 0; i < neighbors.num_items; i++) {
+            _forwardEntries[next[neighbors.items[i]]++] = rowOffset + i;
+        }
+    }
+
+    for (atomic<uint32_t> &first : _firstAtNode) {
+        first.store(NO_VEHICLE, std::memory_order_relaxed);
+    }
+
+    for (atomic<size_t> &node : _nodeOfVehicle) {
+        node.store(NOT_PLACED, std::memory_order_relaxed);
+    }
+
+    _nextAtNode = vector<uint32_t>(maxVehicles, NO_VEHICLE);
+    _previousAtNode = vector<uint32_t>(maxVehicles, NO_VEHICLE);
+    _snappedAt = vector<pair<float, float>>(maxVehicles);
+}
+
+bool VehicleIndex::update(size_t vehicle, pair<float, float> location) {
+    if (vehicle >= _snappedAt.size()) {
+        throw out_of_range(format("Vehicle {} is out of range for a VehicleIndex of {} vehicles", vehicle, _snappedAt.size()));
+    }
+
+    size_t current = _nodeOfVehicle[vehicle].load(std::memory_order_relaxed);
+    if (current != NOT_PLACED && greatCircleMetres(_snappedAt[vehicle], location) < _options.resnapMetres) {
+        return false;
+    }
+
+    size_t node = _graph.snapToNode(location, _options.preferLargestComponent);
+    _snappedAt[vehicle] = location;
+
+    if (node != current) {
+        moveVehicle(static_cast<uint32_t>(vehicle), current, node);
+    }
+
+    return true;
+}
+
+size_t VehicleIndex::updateBatch(span<const size_t> vehicles, span<const pair<float, float>> locations, ThreadPool &pool) {
+    if (vehicles.size() != locations.size()) {
+        throw invalid_argument("VehicleIndex batch vehicles and locations must have the same length");
+    }
+
+    atomic<size_t> snapped = 0;
+    pool.parallelFor(vehicles.size(), [&](size_t, size_t index) {
+        if (update(vehicles[index], locations[index])) {
+            snapped.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    return snapped;
+}
+
+bool VehicleIndex::remove(size_t vehicle) {
+    if (vehicle >= _snappedAt.size()) {
+        throw out_of_range(format("Vehicle {} is out of range for a VehicleIndex of {} vehicles", vehicle, _snappedAt.size()));
+    }
+
+    size_t current = _nodeOfVehicle[vehicle].load(std::memory_order_relaxed);
+    if (current == NOT_PLACED) {
+        return false;
+    }
+
+    moveVehicle(static_cast<uint32_t>(vehicle), current, NOT_PLACED);
+    return true;
+}
+
+size_t VehicleIndex::nodeOf(size_t vehicle) const {
+    if (vehicle >= _snappedAt.size()) {
+        throw out_of_range(format("Vehicle {} is out of range for a VehicleIndex of {} vehicles", vehicle, _snappedAt.size()));
+    }
+
+    return _nodeOfVehicle[vehicle].load(std::memory_order_relaxed);
+}
+
+size_t VehicleIndex::size() const {
+    return _numPlaced.load(std::memory_order_relaxed);
+}
+
+void VehicleIndex::nearestByDriveTime(
+    pair<float, float> incident,
+    size_t k,
+    SearchWorkspace &workspace,
+    vector<NearbyVehicle> &result,
+    float maxSeconds,
+    const ExclusionOverlay *overlay
+) const {
+    size_t incidentNode = _graph.snapToNode(incident, _options.preferLargestComponent);
+    nearestByDriveTimeToNode(incidentNode, k, workspace, result, maxSeconds, overlay);
+}
+
+void VehicleIndex::nearestByDriveTimeToNode(
+    size_t incidentNode,
+    size_t k,
+    SearchWorkspace &workspace,
+    vector<NearbyVehicle> &result,
+    float maxSeconds,
+    const ExclusionOverlay *overlay
+) const {
+    size_t first = result.size();
+    if (k == 0) {
+        return;
+    }
+
+    // Dijkstra from the incident over the reversed graph: the cost of a node is its travel time
+    // to the incident, so vehicles are found in order of how soon they can get there
+    workspace.reset(_graph.size());
+    workspace.update(incidentNode, 0.0f, incidentNode);
+    workspace.push(0.0f, incidentNode);
+
+    while (!workspace.frontierEmpty() && result.size() - first < k) {
+        auto [currentCost, currentNode] = workspace.pop();
+
+        if (currentCost > maxSeconds) {
+            break;
+        }
+
+        if (workspace.settled(currentNode)) {
+            continue;
+        }
+        workspace.settle(currentNode);
+
+        if (_firstAtNode[currentNode].load(std::memory_order_relaxed) != NO_VEHICLE) {
+            collectVehicles(currentNode, currentCost, first, k, result);
+        }
+
+        auto [times, sources] = _reversed.valuesInRow(currentNode);
+        size_t rowOffset = _reversed.rowOffset(currentNode);
+
+        for (size_t i = 0; i < times.num_items; ++i) {
+            if (overlay != nullptr && overlay->entryExcluded(_forwardEntries[rowOffset + i])) {
+                continue;
+            }
+
+            size_t source = sources.items[i];
+            float newCost = currentCost + times.items[i];
+
+            if (newCost <= maxSeconds && newCost < workspace.cost(source)) {
+                workspace.update(source, newCost, currentNode);
+                workspace.push(newCost, source);
+            }
+        }
+    }
+}
+
+void VehicleIndex::moveVehicle(uint32_t vehicle, size_t from, size_t to) {
+    // Lock both stripes in a fixed order, so concurrent moves can't deadlock
+    size_t fromStripe = (from == NOT_PLACED) ? LOCK_STRIPES : from % LOCK_STRIPES;
+    size_t toStripe = (to == NOT_PLACED) ? LOCK_STRIPES : to % LOCK_STRIPES;
+    size_t lowStripe = std::min(fromStripe, toStripe);
+    size_t highStripe = std::max(fromStripe, toStripe);
+
+    unique_lock<mutex> lowLock;
+    unique_lock<mutex> highLock;
+    if (lowStripe < LOCK_STRIPES) {
+        lowLock = unique_lock<mutex>(_stripes[lowStripe]);
+    }
+    if (highStripe < LOCK_STRIPES && highStripe != lowStripe) {
+        highLock = unique_lock<mutex>(_stripes[highStripe]);
+    }
+
+    if (from != NOT_PLACED) {
+        uint32_t previous = _previousAtNode[vehicle];
+        uint32_t next = _nextAtNode[vehicle];
+
+        if (previous == NO_VEHICLE) {
+            _firstAtNode[from].store(next, std::memory_order_relaxed);
+        } else {
+            _nextAtNode[previous] = next;
+        }
+
+        if (next != NO_VEHICLE) {
+            _previousAtNode[next] = previous;
+        }
+    }
+
+    if (to != NOT_PLACED) {
+        uint32_t next = _firstAtNode[to].load(std::memory_order_relaxed);
+        _previousAtNode[vehicle] = NO_VEHICLE;
+        _nextAtNode[vehicle] = next;
+
+        if (next != NO_VEHICLE) {
+            _previousAtNode[next] = vehicle;
+        }
+        _firstAtNode[to].store(vehicle, std::memory_order_relaxed);
+    } else {
+        _previousAtNode[vehicle] = NO_VEHICLE;
+        _nextAtNode[vehicle] = NO_VEHICLE;
+    }
+
+    _nodeOfVehicle[vehicle].store(to, std::memory_order_relaxed);
+
+    if (from == NOT_PLACED) {
+        _numPlaced.fetch_add(1, std::memory_order_relaxed);
+    } else if (to == NOT_PLACED) {
+        _numPlaced.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void VehicleIndex::collectVehicles(size_t node, float seconds, size_t first, size_t k,
+                                   vector<NearbyVehicle> &result) const {
+    lock_guard<mutex> lock(_stripes[node % LOCK_STRIPES]);
+
+    for (uint32_t vehicle = _firstAtNode[node].load(std::memory_order_relaxed);
+         vehicle != NO_VEHICLE && result.size() - first < k;
+         vehicle = _nextAtNode[vehicle]) {
+        bool found = std::any_of(result.begin() + first, result.end(), [vehicle](const NearbyVehicle &nearby) {
+            return nearby.vehicle == vehicle;
+        });
+
+        if (!found) {
+            result.push_back({vehicle, seconds});
+        }
+    }
+}
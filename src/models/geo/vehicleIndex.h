@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/searchWorkspace.h"
+#include "models/linalg/csr.h"
+#include "models/util/threadPool.h"
+
+using geo::Graph;
+using geo::SearchWorkspace;
+using linalg::CsrMatrix;
+using std::atomic;
+using std::mutex;
+using std::numeric_limits;
+using std::pair;
+using std::span;
+using std::vector;
+using utils::ListWithSize;
+using utils::ThreadPool;
+
+namespace geo {
+    class ExclusionOverlay;
+
+    // Node of a vehicle that isn't placed on the graph
+    constexpr size_t NOT_PLACED = numeric_limits<size_t>::max();
+
+    struct VehicleIndexOptions {
+        // A vehicle is snapped again only once it is this far (in metres) from where it was last snapped
+        float resnapMetres = 30.0f;
+
+        // Snap vehicles and incidents into the largest strongly connected component (see Graph::snapToNode)
+        bool preferLargestComponent = true;
+    };
+
+    struct NearbyVehicle {
+        size_t vehicle;
+
+        // Travel time from the vehicle's node to the incident's node
+        float seconds;
+    };
+
+    /**
+    * Live positions of a fleet of vehicles, snapped to graph nodes, for dispatch: which vehicles
+    * can reach an incident soonest. A query is one search from the incident over the reversed
+    * graph (the transposed CsrMatrix), which stops once k vehicles have been found on settled
+    * nodes, so its cost depends on how far away the vehicles are rather than on the fleet size.
+    *
+    * Each node heads an intrusive list of the vehicles on it. The lists are guarded by a fixed set
+    * of striped locks; the searches only take one for nodes that have a vehicle, which they see
+    * from an atomic list head. Updates of different vehicles and queries may all run concurrently.
+    * Updates of one vehicle must not overlap.
+    *
+    * The graph must outlive the index and must not be modified while it is in use.
+    */
+    class VehicleIndex {
+        public:
+        // Vehicle ids are 0 to maxVehicles - 1
+        VehicleIndex(const Graph &graph, size_t maxVehicles, VehicleIndexOptions options = VehicleIndexOptions());
+
+        // Report a vehicle's position. It is snapped to a node when first placed, and again only
+        // once it has moved resnapMetres from where it was last snapped. Returns whether it was snapped.
+        bool update(size_t vehicle, pair<float, float> location);
+
+        // Same for many vehicles, on the pool's workers. A vehicle may appear at most once.
+        // Returns the number of vehicles that were snapped.
+        size_t updateBatch(span<const size_t> vehicles, span<const pair<float, float>> locations, ThreadPool &pool);
+
+        // Take a vehicle off the graph. Returns false if it wasn't placed.
+        bool remove(size_t vehicle);
+
+        // Node the vehicle is snapped to, or NOT_PLACED
+        size_t nodeOf(size_t vehicle) const;
+
+        // Number of vehicles placed
+        size_t size() const;
+
+        // The k vehicles that can reach the incident soonest, closest first, appended to result.
+        // Fewer are returned if fewer can reach it within maxSeconds. The incident is snapped
+        // like a vehicle. Entries closed by the overlay, if one is given, are skipped.
+        // A vehicle that moves while the search runs may be missed, or found where it was before.
+        void nearestByDriveTime(
+            pair<float, float> incident,
+            size_t k,
+            SearchWorkspace &workspace,
+            vector<NearbyVehicle> &result,
+            float maxSeconds = numeric_limits<float>::infinity(),
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        // Same as nearestByDriveTime, for an incident that is already a graph node
+        void nearestByDriveTimeToNode(
+            size_t incidentNode,
+            size_t k,
+            SearchWorkspace &workspace,
+            vector<NearbyVehicle> &result,
+            float maxSeconds = numeric_limits<float>::infinity(),
+            const ExclusionOverlay *overlay = nullptr
+        ) const;
+
+        static constexpr size_t LOCK_STRIPES = 256;
+
+        private:
+        static constexpr uint32_t NO_VEHICLE = numeric_limits<uint32_t>::max();
+
+        const Graph &_graph;
+        VehicleIndexOptions _options;
+
+        // The graph with every entry reversed, and for each of its entries the entry of the graph
+        // it was made from, for the overlay
+        CsrMatrix _reversed;
+        ListWithSize<size_t> _forwardEntries = ListWithSize<size_t>(0);
+
+        // First vehicle on each node, or NO_VEHICLE. Read without a lock by the searches.
+        vector<atomic<uint32_t>> _firstAtNode;
+
+        // Doubly linked lists of the vehicles on each node, guarded by the node's stripe
+        vector<uint32_t> _nextAtNode = vector<uint32_t>();
+        vector<uint32_t> _previousAtNode = vector<uint32_t>();
+
+        vector<atomic<size_t>> _nodeOfVehicle;
+
+        // Where each vehicle was last snapped. Only touched by updates of that vehicle.
+        vector<pair<float, float>> _snappedAt = vector<pair<float, float>>();
+
+        atomic<size_t> _numPlaced = 0;
+
+        // Lock guarding the lists of the nodes n with n % LOCK_STRIPES == i
+        mutable vector<mutex> _stripes;
+
+        // Move a vehicle between node lists. Either node may be NOT_PLACED.
+        void moveVehicle(uint32_t vehicle, size_t from, size_t to);
+
+        // Append the vehicles on a settled node to result, up to k since first, skipping any that
+        // were already found at another node
+        void collectVehicles(size_t node, float seconds, size_t first, size_t k, vector<NearbyVehicle> &result) const;
+    };
+}
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <utility>
+
+#include "components.h"
+#include "models/util/threadPool.h"
+
+using linalg::ComponentAnalysis;
+using linalg::CsrMatrix;
+using std::atomic;
+using std::condition_variable;
+using std::deque;
+using std::lock_guard;
+using std::mutex;
+using std::numeric_limits;
+using std::pair;
+using std::unique_lock;
+using std::vector;
+using utils::ThreadPool;
+
+namespace {
+    // Sets smaller than this are finished with a sequential Tarjan pass
+    const size_t TARJAN_CUTOFF = 4096;
+
+    // Color of the nodes trim() has already given a component. No task ever has it.
+    const uint32_t TRIMMED_COLOR = numeric_limits<uint32_t>::max();
+
+    // A set of nodes that all share the same color, and may contain several components
+    struct Task {
+        vector<size_t> nodes;
+        uint32_t color;
+    };
+
+    class ForwardBackwardSolver {
+        public:
+        ForwardBackwardSolver(const CsrMatrix &forward, ThreadPool *pool);
+
+        // Returns the component of every node. Component ids are in discovery order.
+        vector<uint32_t> solve(uint32_t &numComponents);
+
+        private:
+        const CsrMatrix &_forward;
+        CsrMatrix _backward;
+        ThreadPool *_pool;
+        size_t _numNodes;
+
+        // Tasks own disjoint sets of nodes and only ever write their own nodes. Reads of
+        // neighboring nodes can race with other tasks, but colors are never reused, so such
+        // nodes can never be mistaken for one of the current task's colors.
+        vector<atomic<uint32_t>> _color;
+        vector<uint32_t> _component;
+        atomic<uint32_t> _nextColor = 1;
+        atomic<uint32_t> _nextComponent = 0;
+
+        // Tarjan scratch space, indexed by node
+        vector<uint32_t> _tarjanIndex;
+        vector<uint32_t> _tarjanLow;
+        vector<uint8_t> _onStack;
+
+        mutex _mutex;
+        condition_variable _wake;
+        deque<Task> _tasks;
+        size_t _activeTasks = 0;
+
+        vector<size_t> trim();
+        void worker();
+        void submit(Task task);
+        void splitAroundPivot(const Task &task);
+        void tarjan(const Task &task);
+    };
+
+    ForwardBackwardSolver::ForwardBackwardSolver(const CsrMatrix &forward, ThreadPool *pool)
+        : _forward(forward), _backward(forward.transpose()), _color(forward.numRows()) {
+        _pool = pool;
+        _numNodes = forward.numRows();
+        _component = vector<uint32_t>(_numNodes, numeric_limits<uint32_t>::max());
+        _tarjanIndex = vector<uint32_t>(_numNodes, 0);
+        _tarjanLow = vector<uint32_t>(_numNodes, 0);
+        _onStack = vector<uint8_t>(_numNodes, 0);
+    }
+
+    vector<uint32_t> ForwardBackwardSolver::solve(uint32_t &numComponents) {
+        vector<size_t> remaining = trim();
+
+        if (!remaining.empty()) {
+            _tasks.push_back(Task{remaining, 0});
+        }
+
+        // Every slot runs one worker, which returns once the task queue has drained for good
+        if (_pool == nullptr) {
+            worker();
+        } else {
+            _pool->parallelFor(_pool->size(), [this](size_t, size_t) {
+                worker();
+            });
+        }
+
+        numComponents = _nextComponent;
+        return _component;
+    }
+
+    // Nodes with no incoming or no outgoing edges (among the nodes left) are their own component.
+    // On road graphs this peels off dead ends and one-way stubs before the expensive searches.
+    vector<size_t> ForwardBackwardSolver::trim() {
+        vector<size_t> inDegree(_numNodes);
+        vector<size_t> outDegree(_numNodes);
+        vector<uint8_t> removed(_numNodes, 0);
+        vector<size_t> queue;
+
+        for (size_t node = 0; node < _numNodes; node++) {
+            outDegree[node] = _forward.valuesInRow(node).second.num_items;
+            inDegree[node] = _backward.valuesInRow(node).second.num_items;
+
+            if (inDegree[node] == 0 || outDegree[node] == 0) {
+                removed[node] = 1;
+                queue.push_back(node);
+            }
+        }
+
+        while (!queue.empty()) {
+            size_t node = queue.back();
+            queue.pop_back();
+            _component[node] = _nextComponent++;
+            _color[node].store(TRIMMED_COLOR, std::memory_order_relaxed);
+
+            auto successors = _forward.valuesInRow(node).second;
+            for (size_t i = 0; i < successors.num_items; i++) {
+                size_t next = successors.items[i];
+                if (!removed[next] && --inDegree[next] == 0) {
+                    removed[next] = 1;
+                    queue.push_back(next);
+                }
+            }
+
+            auto predecessors = _backward.valuesInRow(node).second;
+            for (size_t i = 0; i < predecessors.num_items; i++) {
+                size_t previous = predecessors.items[i];
+                if (!removed[previous] && --outDegree[previous] == 0) {
+                    removed[previous] = 1;
+                    queue.push_back(previous);
+                }
+            }
+        }
+
+        vector<size_t> remaining;
+        for (size_t node = 0; node < _numNodes; node++) {
+            if (!removed[node]) {
+                remaining.push_back(node);
+            }
+        }
+
+        return remaining;
+    }
+
+    void ForwardBackwardSolver::worker() {
+        while (true) {
+            Task task;
+
+            {
+                unique_lock<mutex> lock(_mutex);
+                _wake.wait(lock, [this]() {
+                    return !_tasks.empty() || _activeTasks == 0;
+                });
+
+                if (_tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+                _activeTasks++;
+            }
+
+            if (task.nodes.size() < TARJAN_CUTOFF) {
+                tarjan(task);
+            } else {
+                splitAroundPivot(task);
+            }
+
+            lock_guard<mutex> lock(_mutex);
+            _activeTasks--;
+
+            if (_activeTasks == 0 && _tasks.empty()) {
+                _wake.notify_all();
+            }
+        }
+    }
+
+    void ForwardBackwardSolver::submit(Task task) {
+        lock_guard<mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+        _wake.notify_one();
+    }
+
+    void ForwardBackwardSolver::splitAroundPivot(const Task &task) {
+        const uint32_t color = task.color;
+        const uint32_t forwardColor = _nextColor++;
+        const uint32_t backwardColor = _nextColor++;
+        const uint32_t componentColor = _nextColor++;
+
+        size_t pivot = task.nodes[task.nodes.size() / 2];
+        vector<size_t> stack = {pivot};
+        _color[pivot].store(forwardColor, std::memory_order_relaxed);
+
+        // Forward: everything the pivot reaches
+        while (!stack.empty()) {
+            size_t node = stack.back();
+            stack.pop_back();
+
+            auto successors = _forward.valuesInRow(node).second;
+            for (size_t i = 0; i < successors.num_items; i++) {
+                size_t next = successors.items[i];
+                if (_color[next].load(std::memory_order_relaxed) == color) {
+                    _color[next].store(forwardColor, std::memory_order_relaxed);
+                    stack.push_back(next);
+                }
+            }
+        }
+
+        // Backward: everything that reaches the pivot. Nodes reached both ways form its component.
+        _color[pivot].store(componentColor, std::memory_order_relaxed);
+        stack.push_back(pivot);
+
+        while (!stack.empty()) {
+            size_t node = stack.back();
+            stack.pop_back();
+
+            auto predecessors = _backward.valuesInRow(node).second;
+            for (size_t i = 0; i < predecessors.num_items; i++) {
+                size_t previous = predecessors.items[i];
+                uint32_t previousColor = _color[previous].load(std::memory_order_relaxed);
+
+                if (previousColor == forwardColor) {
+                    _color[previous].store(componentColor, std::memory_order_relaxed);
+                    stack.push_back(previous);
+                } else if (previousColor == color) {
+                    _color[previous].store(backwardColor, std::memory_order_relaxed);
+                    stack.push_back(previous);
+                }
+            }
+        }
+
+        Task forwardOnly{{}, forwardColor};
+        Task backwardOnly{{}, backwardColor};
+        Task unreached{{}, color};
+        uint32_t component = _nextComponent++;
+
+        for (size_t node : task.nodes) {
+            uint32_t nodeColor = _color[node].load(std::memory_order_relaxed);
+
+            if (nodeColor == componentColor) {
+                _component[node] = component;
+            } else if (nodeColor == forwardColor) {
+                forwardOnly.nodes.push_back(node);
+            } else if (nodeColor == backwardColor) {
+                backwardOnly.nodes.push_back(node);
+            } else {
+                unreached.nodes.push_back(node);
+            }
+        }
+
+        for (Task *subtask : {&forwardOnly, &backwardOnly, &unreached}) {
+            if (!subtask->nodes.empty()) {
+                submit(std::move(*subtask));
+            }
+        }
+    }
+
+    // Iterative Tarjan restricted to the nodes of the task's color
+    void ForwardBackwardSolver::tarjan(const Task &task) {
+        uint32_t counter = 0;
+        vector<size_t> componentStack;
+        vector<pair<size_t, size_t>> callStack; // node -> next neighbor to visit
+
+        auto visit = [&](size_t node) {
+            counter++;
+            _tarjanIndex[node] = counter;
+            _tarjanLow[node] = counter;
+            _onStack[node] = 1;
+            componentStack.push_back(node);
+            callStack.emplace_back(node, 0);
+        };
+
+        for (size_t root : task.nodes) {
+            if (_tarjanIndex[root] != 0) {
+                continue;
+            }
+
+            visit(root);
+
+            while (!callStack.empty()) {
+                size_t node = callStack.back().first;
+                size_t position = callStack.back().second;
+                auto successors = _forward.valuesInRow(node).second;
+
+                if (position < successors.num_items) {
+                    callStack.back().second++;
+                    size_t next = successors.items[position];
+
+                    if (_color[next].load(std::memory_order_relaxed) != task.color) {
+                        continue;
+                    }
+
+                    if (_tarjanIndex[next] == 0) {
+                        visit(next);
+                    } else if (_onStack[next]) {
+                        _tarjanLow[node] = std::min(_tarjanLow[node], _tarjanIndex[next]);
+                    }
+
+                    continue;
+                }
+
+                callStack.pop_back();
+
+                if (!callStack.empty()) {
+                    size_t parent = callStack.back().first;
+                    _tarjanLow[parent] = std::min(_tarjanLow[parent], _tarjanLow[node]);
+                }
+
+                if (_tarjanLow[node] == _tarjanIndex[node]) {
+                    uint32_t component = _nextComponent++;
+                    size_t member;
+
+                    do {
+                        member = componentStack.back();
+                        componentStack.pop_back();
+                        _onStack[member] = 0;
+                        _component[member] = component;
+                    } while (member != node);
+                }
+            }
+        }
+    }
+
+    uint32_t findRoot(vector<uint32_t> &parent, uint32_t node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+
+        return node;
+    }
+}
+
+ComponentAnalysis linalg::analyzeComponents(const CsrMatrix &adjacency, ThreadPool *pool) {
+    size_t numNodes = adjacency.numRows();
+    uint32_t numComponents = 0;
+    vector<uint32_t> rawComponent = ForwardBackwardSolver(adjacency, pool).solve(numComponents);
+
+    // Condensation graph, one row per component (duplicate edges are harmless)
+    vector<size_t> condensationPtr(numComponents + 1, 0);
+    for (size_t node = 0; node < numNodes; node++) {
+        auto successors = adjacency.valuesInRow(node).second;
+        for (size_t i = 0; i < successors.num_items; i++) {
+            if (rawComponent[successors.items[i]] != rawComponent[node]) {
+                condensationPtr[rawComponent[node] + 1]++;
+            }
+        }
+    }
+
+    std::partial_sum(condensationPtr.begin(), condensationPtr.end(), condensationPtr.begin());
+
+    vector<uint32_t> condensation(condensationPtr[numComponents]);
+    vector<size_t> next(condensationPtr.begin(), condensationPtr.end() - 1);
+    vector<uint32_t> inDegree(numComponents, 0);
+
+    for (size_t node = 0; node < numNodes; node++) {
+        auto successors = adjacency.valuesInRow(node).second;
+        for (size_t i = 0; i < successors.num_items; i++) {
+            uint32_t from = rawComponent[node];
+            uint32_t to = rawComponent[successors.items[i]];
+
+            if (from != to) {
+                condensation[next[from]++] = to;
+                inDegree[to]++;
+            }
+        }
+    }
+
+    // Kahn's algorithm gives the topological numbering
+    vector<uint32_t> rank(numComponents);
+    vector<uint32_t> ready;
+    uint32_t nextRank = 0;
+
+    for (uint32_t component = 0; component < numComponents; component++) {
+        if (inDegree[component] == 0) {
+            ready.push_back(component);
+        }
+    }
+
+    while (!ready.empty()) {
+        uint32_t component = ready.back();
+        ready.pop_back();
+        rank[component] = nextRank++;
+
+        for (size_t i = condensationPtr[component]; i < condensationPtr[component + 1]; i++) {
+            if (--inDegree[condensation[i]] == 0) {
+                ready.push_back(condensation[i]);
+            }
+        }
+    }
+
+    // Weak components: union-find over the condensation edges
+    vector<uint32_t> unionParent(numComponents);
+    std::iota(unionParent.begin(), unionParent.end(), 0);
+
+    for (uint32_t component = 0; component < numComponents; component++) {
+        for (size_t i = condensationPtr[component]; i < condensationPtr[component + 1]; i++) {
+            uint32_t a = findRoot(unionParent, component);
+            uint32_t b = findRoot(unionParent, condensation[i]);
+            unionParent[std::max(a, b)] = std::min(a, b);
+        }
+    }
+
+    ComponentAnalysis analysis;
+    analysis.componentOf = vector<uint32_t>(numNodes);
+    analysis.componentSize = vector<uint32_t>(numComponents, 0);
+    analysis.weakComponentOf = vector<uint32_t>(numComponents);
+
+    for (size_t node = 0; node < numNodes; node++) {
+        uint32_t component = rank[rawComponent[node]];
+        analysis.componentOf[node] = component;
+        analysis.componentSize[component]++;
+    }
+
+    for (uint32_t component = 0; component < numComponents; component++) {
+        analysis.weakComponentOf[rank[component]] = findRoot(unionParent, component);
+    }
+
+    if (numComponents > 0) {
+        analysis.largestComponent = std::max_element(analysis.componentSize.begin(), analysis.componentSize.end())
+            - analysis.componentSize.begin();
+    }
+
+    return analysis;
+}
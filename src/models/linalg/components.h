@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "models/linalg/csr.h"
+#include "models/util/threadPool.h"
+
+using linalg::CsrMatrix;
+using std::vector;
+using utils::ThreadPool;
+
+namespace linalg {
+    // Connectivity of the directed graph described by a square adjacency matrix
+    struct ComponentAnalysis {
+        // Strongly connected component of each node. Components are numbered in a
+        // topological order of the condensation: an edge from component a to component b implies a <= b.
+        vector<uint32_t> componentOf;
+
+        // Number of nodes in each strongly connected component
+        vector<uint32_t> componentSize;
+
+        // Weakly connected component of each strongly connected component
+        vector<uint32_t> weakComponentOf;
+
+        // Strongly connected component with the most nodes
+        uint32_t largestComponent = 0;
+    };
+
+    /**
+    * Strongly connected components by parallel forward-backward coloring.
+    * Nodes without incoming or outgoing edges are trimmed first. The remaining nodes are split
+    * around a pivot into the pivot's component, its forward-only, backward-only and unreached
+    * sets, and those sets are processed as independent tasks by the pool's workers.
+    * Small sets fall back to an iterative Tarjan pass.
+    *
+    * @param pool Workers for the tasks, or nullptr to run them all on the calling thread
+    */
+    ComponentAnalysis analyzeComponents(const CsrMatrix &adjacency, ThreadPool *pool = nullptr);
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "csr.h"
@@ -47,6 +48,20 @@ CsrMatrix::CsrMatrix(const MutableCsrMatrix &mutableMatrix) {
     _row_ptr = ListWithSize<size_t>(mutableMatrix._row_ptr);
 }
 
+CsrMatrix::CsrMatrix(
+    size_t rows,
+    size_t cols,
+    const vector<uint16_t> &values,
+    const vector<size_t> &colIndices,
+    const vector<size_t> &rowPtr
+) {
+    _rows = rows;
+    _cols = cols;
+    _values = ListWithSize<uint16_t>(values);
+    _col_indices = ListWithSize<size_t>(colIndices);
+    _row_ptr = ListWithSize<size_t>(rowPtr);
+}
+
 uint16_t CsrMatrix::operator()(const size_t row, const size_t col) const {
     size_t row_start = _row_ptr[row];
     size_t next_row_start = _row_ptr[row + 1];
@@ -84,19 +99,84 @@ namespace linalg {
     }
 }
 
-pair<MemoryResult<uint16_t>, MemoryResult<size_t>> CsrMatrix::valuesInRow(size_t row) const {
+pair<MemoryResult<const uint16_t>, MemoryResult<const size_t>> CsrMatrix::valuesInRow(size_t row) const {
     size_t row_start = _row_ptr[row];
     size_t next_row_start = _row_ptr[row + 1];
 
-    uint16_t *row_start_ref_val = _values.data() + row_start;
-    size_t *row_start_ref_col = _col_indices.data() + row_start;
+    const uint16_t *row_start_ref_val = _values.data() + row_start;
+    const size_t *row_start_ref_col = _col_indices.data() + row_start;
 
-    MemoryResult values = MemoryResult<uint16_t>(next_row_start - row_start, row_start_ref_val);
-    MemoryResult columns = MemoryResult<size_t>(next_row_start - row_start, row_start_ref_col);
+    MemoryResult values = MemoryResult<const uint16_t>(next_row_start - row_start, row_start_ref_val);
+    MemoryResult columns = MemoryResult<const size_t>(next_row_start - row_start, row_start_ref_col);
 
     return {values, columns};
 }
 
+size_t CsrMatrix::rowOffset(size_t row) const {
+    return _row_ptr[row];
+}
+
+size_t CsrMatrix::rowOfEntry(size_t entry) const {
+    // Last row starting at or before the entry. Empty rows share their start with the next row.
+    const size_t *begin = _row_ptr.data();
+    const size_t *end = begin + _row_ptr.size();
+    return std::upper_bound(begin, end, entry) - begin - 1;
+}
+
+size_t CsrMatrix::columnOfEntry(size_t entry) const {
+    return _col_indices[entry];
+}
+
+uint16_t CsrMatrix::valueOfEntry(size_t entry) const {
+    return _values[entry];
+}
+
+size_t CsrMatrix::numEntries() const {
+    return _values.size();
+}
+
+size_t CsrMatrix::numRows() const {
+    return _rows;
+}
+
+size_t CsrMatrix::numCols() const {
+    return _cols;
+}
+
+CsrMatrix CsrMatrix::transpose() const {
+    CsrMatrix result;
+    result._rows = _cols;
+    result._cols = _rows;
+
+    // Counting sort of the entries by column
+    vector<size_t> rowptr(_cols + 1, 0);
+    for (size_t i = 0; i < _col_indices.size(); i++) {
+        rowptr[_col_indices[i] + 1]++;
+    }
+
+    for (size_t col = 0; col < _cols; col++) {
+        rowptr[col + 1] += rowptr[col];
+    }
+
+    vector<uint16_t> data(_values.size());
+    vector<size_t> cols(_values.size());
+    vector<size_t> next(rowptr.begin(), rowptr.end() - 1);
+
+    for (size_t row = 0; row < _rows; row++) {
+        for (size_t i = _row_ptr[row]; i < _row_ptr[row + 1]; i++) {
+            size_t position = next[_col_indices[i]]++;
+            data[position] = _values[i];
+            cols[position] = row;
+        }
+    }
+
+    result._values = ListWithSize<uint16_t>(data);
+    result._col_indices = ListWithSize<size_t>(cols);
+    result._row_ptr = ListWithSize<size_t>(rowptr);
+
+    return result;
+}
+
 size_t CsrMatrix::getMemorySize() const {
     size_t values_size = _values.size() * sizeof(uint16_t);
     size_t col_indices_size = _col_indices.size() * sizeof(size_t);
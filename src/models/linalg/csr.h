@@ -14,6 +14,8 @@ using utils::ListWithSize;
 using utils::MemoryResult;
 
 namespace linalg {
+    // Each addEntry shifts every later entry, so building a matrix this way is quadratic.
+    // Graphs are built with a CsrBuilder instead.
     class MutableCsrMatrix {
         public:
         // Input is of the form matrix[row[col]]
@@ -50,6 +52,15 @@ namespace linalg {
         // Construct from a MutableCsrMatrix by copying its data
         CsrMatrix(const MutableCsrMatrix &mutableMatrix);
 
+        // Construct directly from CSR arrays. rowPtr must have rows + 1 entries.
+        CsrMatrix(
+            size_t rows,
+            size_t cols,
+            const vector<uint16_t> &values,
+            const vector<size_t> &colIndices,
+            const vector<size_t> &rowPtr
+        );
+
         // Element access: matrix(row, col)
         uint16_t operator()(size_t row, size_t col) const;
         friend istream &operator>>(istream &input, CsrMatrix &matrix);
@@ -58,7 +69,27 @@ namespace linalg {
         // Do not manually clean up the result of this call.
         // Doing so will result in undefined behavior
         // The first result is the column and the second is the index
-        pair<MemoryResult<uint16_t>, MemoryResult<size_t>> valuesInRow(size_t row) const;
+        pair<MemoryResult<const uint16_t>, MemoryResult<const size_t>> valuesInRow(size_t row) const;
+
+        // Position of the row's first entry in the value arrays.
+        // Entry i of valuesInRow(row) is entry rowOffset(row) + i of the matrix,
+        // which lets callers keep extra per-entry columns alongside the matrix.
+        size_t rowOffset(size_t row) const;
+
+        // Row, column and value of a single entry. rowOfEntry is a binary search over the row pointers.
+        size_t rowOfEntry(size_t entry) const;
+        size_t columnOfEntry(size_t entry) const;
+        uint16_t valueOfEntry(size_t entry) const;
+
+        // Total number of stored (non-zero) entries
+        size_t numEntries() const;
+
+        size_t numRows() const;
+        size_t numCols() const;
+
+        // Transposed copy of the matrix. For a graph adjacency matrix, this is the graph with every edge reversed.
+        // Within each row of the result, entries are ordered by their row in this matrix.
+        CsrMatrix transpose() const;
         
         // Calculate and return the memory size of the CSR matrix in bytes
         size_t getMemorySize() const;
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "csrBuilder.h"
+
+using linalg::CsrBuilder;
+using linalg::CsrMatrix;
+using linalg::DuplicatePolicy;
+using std::function;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+using utils::ThreadPool;
+
+namespace {
+    // Blocks of fewer entries than this aren't worth handing to another worker
+    const size_t MIN_BLOCK_ENTRIES = 1 << 16;
+
+    // Run body(slot, index) for every index in [0, count), on the pool's workers if there is a pool
+    void forEachIndex(size_t count, ThreadPool *pool, const function<void(size_t slot, size_t index)> &body) {
+        if (pool == nullptr || count < 2) {
+            for (size_t index = 0; index < count; index++) {
+                body(0, index);
+            }
+
+            return;
+        }
+
+        pool->parallelFor(count, body);
+    }
+
+    uint16_t combine(uint16_t kept, uint16_t value, DuplicatePolicy duplicates) {
+        if (duplicates == DuplicatePolicy::Min) {
+            return std::min(kept, value);
+        }
+
+        return static_cast<uint16_t>(std::min<uint32_t>(static_cast<uint32_t>(kept) + value, UINT16_MAX));
+    }
+}
+
+CsrBuilder::CsrBuilder(size_t rows, size_t cols) {
+    _rows = rows;
+    _cols = cols;
+}
+
+void CsrBuilder::reserve(size_t entries) {
+    _rowIndices.reserve(entries);
+    _colIndices.reserve(entries);
+    _values.reserve(entries);
+}
+
+void CsrBuilder::addEntry(size_t row, size_t col, uint16_t value) {
+    if (row >= _rows || col >= _cols) {
+        throw out_of_range(format("Entry ({}, {}) is outside a {} x {} matrix", row, col, _rows, _cols));
+    }
+
+    _rowIndices.push_back(row);
+    _colIndices.push_back(col);
+    _values.push_back(value);
+}
+
+size_t CsrBuilder::numEntries() const {
+    return _values.size();
+}
+
+CsrMatrix CsrBuilder::build(bool sortRows, DuplicatePolicy duplicates, ThreadPool *pool) {
+    size_t numEntries = _values.size();
+    bool merge = duplicates != DuplicatePolicy::Keep;
+    sortRows = sortRows || merge;
+
+    size_t rowsPerBucket = std::max<size_t>(1, (_rows + NUM_BUCKETS - 1) / NUM_BUCKETS);
+    size_t numBuckets = (_rows + rowsPerBucket - 1) / rowsPerBucket;
+
+    size_t numBlocks = (pool == nullptr) ? 1 : std::clamp<size_t>(numEntries / MIN_BLOCK_ENTRIES, 1, pool->size());
+    size_t blockSize = (numEntries + numBlocks - 1) / numBlocks;
+
+    // Entries of each bucket in each block
+    vector<size_t> blockCounts(numBlocks * numBuckets, 0);
+
+    forEachIndex(numBlocks, pool, [&](size_t, size_t block) {
+        size_t *counts = blockCounts.data() + block * numBuckets;
+        size_t last = std::min(numEntries, (block + 1) * blockSize);
+
+        for (size_t i = block * blockSize; i < last; i++) {
+            counts[_rowIndices[i] / rowsPerBucket]++;
+        }
+    });
+
+    // Buckets in order, and within each bucket the blocks in order, which keeps the scatter stable
+    vector<size_t> bucketStart(numBuckets + 1, 0);
+    size_t position = 0;
+
+    for (size_t bucket = 0; bucket < numBuckets; bucket++) {
+        bucketStart[bucket] = position;
+
+        for (size_t block = 0; block < numBlocks; block++) {
+            size_t count = blockCounts[block * numBuckets + bucket];
+            blockCounts[block * numBuckets + bucket] = position;
+            position += count;
+        }
+    }
+
+    bucketStart[numBuckets] = position;
+
+    // Columns and values go straight to their bucket's part of the matrix. Rows only need their
+    // offset within the bucket from here on.
+    vector<size_t> colIndices(numEntries);
+    vector<uint16_t> values(numEntries);
+    vector<uint32_t> bucketRows(numEntries);
+
+    forEachIndex(numBlocks, pool, [&](size_t, size_t block) {
+        size_t *next = blockCounts.data() + block * numBuckets;
+        size_t last = std::min(numEntries, (block + 1) * blockSize);
+
+        for (size_t i = block * blockSize; i < last; i++) {
+            size_t bucket = _rowIndices[i] / rowsPerBucket;
+            size_t target = next[bucket]++;
+
+            colIndices[target] = _colIndices[i];
+            values[target] = _values[i];
+            bucketRows[target] = static_cast<uint32_t>(_rowIndices[i] - bucket * rowsPerBucket);
+        }
+    });
+
+    vector<size_t>().swap(_rowIndices);
+    vector<size_t>().swap(_colIndices);
+    vector<uint16_t>().swap(_values);
+    vector<size_t>().swap(blockCounts);
+
+    // Sort each bucket by row, then sort and merge its rows. Merged buckets keep their entries at the
+    // front of their part of the matrix and are moved together afterwards.
+    size_t numSlots = (pool == nullptr) ? 1 : pool->size();
+    vector<vector<size_t>> slotRowEnds(numSlots);
+    vector<vector<pair<size_t, uint16_t>>> slotEntries(numSlots);
+
+    vector<size_t> rowPtr(_rows + 1, 0);
+    vector<size_t> bucketKept(numBuckets, 0);
+
+    forEachIndex(numBuckets, pool, [&](size_t slot, size_t bucket) {
+        size_t first = bucketStart[bucket];
+        size_t last = bucketStart[bucket + 1];
+        size_t firstRow = bucket * rowsPerBucket;
+        size_t numRows = std::min(rowsPerBucket, _rows - firstRow);
+
+        vector<size_t> &rowEnds = slotRowEnds[slot];
+        rowEnds.assign(numRows + 1, 0);
+        for (size_t i = first; i < last; i++) {
+            rowEnds[bucketRows[i] + 1]++;
+        }
+
+        for (size_t row = 0; row < numRows; row++) {
+            rowEnds[row + 1] += rowEnds[row];
+        }
+
+        vector<pair<size_t, uint16_t>> &entries = slotEntries[slot];
+        entries.resize(last - first);
+        for (size_t i = first; i < last; i++) {
+            entries[rowEnds[bucketRows[i]]++] = {colIndices[i], values[i]};
+        }
+
+        // rowEnds[row] now holds the end of the row
+        size_t write = first;
+        size_t rowBegin = 0;
+
+        for (size_t row = 0; row < numRows; row++) {
+            size_t rowEnd = rowEnds[row];
+            size_t rowStart = write;
+            rowPtr[firstRow + row] = rowStart;
+
+            if (sortRows) {
+                std::stable_sort(entries.begin() + rowBegin, entries.begin() + rowEnd, [](const auto &a, const auto &b) {
+                    return a.first < b.first;
+                });
+            }
+
+            for (size_t k = rowBegin; k < rowEnd; k++) {
+                auto [col, value] = entries[k];
+
+                if (merge && write > rowStart && colIndices[write - 1] == col) {
+                    values[write - 1] = combine(values[write - 1], value, duplicates);
+                } else {
+                    colIndices[write] = col;
+                    values[write] = value;
+                    write++;
+                }
+            }
+
+            rowBegin = rowEnd;
+        }
+
+        bucketKept[bucket] = write - first;
+    });
+
+    vector<uint32_t>().swap(bucketRows);
+    slotEntries.clear();
+
+    // Close the gaps left by merged entries. Every bucket moves towards the front, so one pass in order is safe.
+    size_t kept = 0;
+    for (size_t bucket = 0; bucket < numBuckets; bucket++) {
+        size_t first = bucketStart[bucket];
+        size_t shift = first - kept;
+
+        if (shift > 0) {
+            std::copy(colIndices.begin() + first, colIndices.begin() + first + bucketKept[bucket], colIndices.begin() + kept);
+            std::copy(values.begin() + first, values.begin() + first + bucketKept[bucket], values.begin() + kept);
+
+            size_t lastRow = std::min(_rows, (bucket + 1) * rowsPerBucket);
+            for (size_t row = bucket * rowsPerBucket; row < lastRow; row++) {
+                rowPtr[row] -= shift;
+            }
+        }
+
+        kept += bucketKept[bucket];
+    }
+
+    colIndices.resize(kept);
+    values.resize(kept);
+    rowPtr[_rows] = kept;
+
+    return CsrMatrix(_rows, _cols, values, colIndices, rowPtr);
+}
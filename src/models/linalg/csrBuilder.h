@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "models/linalg/csr.h"
+#include "models/util/threadPool.h"
+
+using linalg::CsrMatrix;
+using std::vector;
+using utils::ThreadPool;
+
+namespace linalg {
+    // What build() does with several entries at the same row and column
+    enum class DuplicatePolicy : uint8_t {
+        Keep,   // Keep all of them
+        Min,    // Keep one, with the smallest value
+        Sum     // Keep one, with the sum of the values, saturating at UINT16_MAX
+    };
+
+    /**
+    * Builds a CsrMatrix from (row, column, value) triples added in any order, in time linear in the
+    * number of entries. Use it over MutableCsrMatrix for anything bigger than a test matrix.
+    *
+    * build() is a counting sort in two stable passes. The entries are first scattered into buckets of
+    * adjacent rows, one block of entries per worker, then each bucket is sorted by row on its own. The
+    * counters are per bucket rather than per row, so they stay small however big the matrix gets.
+    * At its peak, during the first scatter, build() holds the triples, the matrix's arrays and 4 more
+    * bytes per entry.
+    */
+    class CsrBuilder {
+        public:
+        static constexpr size_t NUM_BUCKETS = 4096;
+
+        CsrBuilder(size_t rows, size_t cols);
+
+        // Room for this many entries in total, so adding them doesn't regrow the triples
+        void reserve(size_t entries);
+
+        // Throws out_of_range if the row or column is outside the matrix
+        void addEntry(size_t row, size_t col, uint16_t value);
+
+        size_t numEntries() const;
+
+        // Matrix of the entries added so far, sorted on the pool if there is one. The builder is left empty.
+        // Within a row, entries keep the order they were added in unless sortRows orders them by column.
+        // Min and Sum sort the rows too, to bring entries at the same column together.
+        CsrMatrix build(bool sortRows = false, DuplicatePolicy duplicates = DuplicatePolicy::Keep, ThreadPool *pool = nullptr);
+
+        private:
+        size_t _rows = 0;
+        size_t _cols = 0;
+
+        vector<size_t> _rowIndices = vector<size_t>();
+        vector<size_t> _colIndices = vector<size_t>();
+        vector<uint16_t> _values = vector<uint16_t>();
+    };
+}
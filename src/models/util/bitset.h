@@ -0,0 +1,68 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace utils {
+    // Dynamically sized bitset packed into 64-bit words.
+    // Unlike vector<bool>, test() compiles down to a single load, shift and mask.
+    class Bitset {
+        public:
+        Bitset() = default;
+        Bitset(size_t numBits);
+
+        void set(size_t index);
+        void reset(size_t index);
+        bool test(size_t index) const;
+
+        // Clear every bit without changing the size
+        void clear();
+
+        // Number of set bits
+        size_t count() const;
+        size_t size() const;
+
+        private:
+        size_t _numBits = 0;
+        vector<uint64_t> _words = vector<uint64_t>();
+    };
+
+    inline Bitset::Bitset(size_t numBits) {
+        _numBits = numBits;
+        _words = vector<uint64_t>((numBits + 63) / 64, 0);
+    }
+
+    inline void Bitset::set(size_t index) {
+        _words[index >> 6] |= uint64_t(1) << (index & 63);
+    }
+
+    inline void Bitset::reset(size_t index) {
+        _words[index >> 6] &= ~(uint64_t(1) << (index & 63));
+    }
+
+    inline bool Bitset::test(size_t index) const {
+        return (_words[index >> 6] >> (index & 63)) & 1;
+    }
+
+    inline void Bitset::clear() {
+        for (uint64_t &word : _words) {
+            word = 0;
+        }
+    }
+
+    inline size_t Bitset::count() const {
+        size_t total = 0;
+        for (uint64_t word : _words) {
+            total += std::popcount(word);
+        }
+
+        return total;
+    }
+
+    inline size_t Bitset::size() const {
+        return _numBits;
+    }
+}
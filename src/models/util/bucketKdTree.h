@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "models/util/threadPool.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BUCKET_KD_TREE_SSE
+#include <immintrin.h>
+#endif
+
+using std::array;
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::span;
+using std::vector;
+using utils::ThreadPool;
+
+namespace utils {
+    /**
+    * 2D KD-tree with bucketed leaves, an alternative layout to Dim2Tree with the same query API.
+    * Internal nodes hold only a split value, in an implicit heap of (numLeaves - 1) floats that
+    * stays in cache even for very large trees. Points live in leaves of at most LeafSize points.
+    * Each leaf is one contiguous block, all its latitudes followed by all its longitudes, scanned
+    * four points at a time with SIMD, so a query reads a few adjacent cache lines at the bottom
+    * instead of one line per level.
+    *
+    * Indices returned by queries are positions in the leaf arrays; getNewIndex maps an input
+    * index to its position, like Dim2Tree.
+    */
+    template <size_t LeafSize>
+    class BucketKdTree {
+        public:
+        static_assert(LeafSize >= 4 && LeafSize % 4 == 0, "Leaves are scanned in blocks of 4 points");
+
+        BucketKdTree() = default;
+        BucketKdTree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool = nullptr);
+
+        // Nearest point by Euclidean distance in degrees. The tree must not be empty.
+        size_t nearestPoint(float latitude, float longitude) const;
+
+        // Indices are appended to result
+        void pointsWithinRadius(float latitude, float longitude, float radius, vector<size_t> &result) const;
+        void pointsInBox(float minLatitude, float minLongitude,
+                         float maxLatitude, float maxLongitude,
+                         vector<size_t> &result) const;
+
+        size_t getNewIndex(size_t nodeIndex) const;
+        pair<float, float> operator[](size_t index) const;
+
+        size_t size() const;
+        size_t numLeaves() const;
+
+        // Bytes held by the tree's arrays
+        size_t memoryBytes() const;
+
+        private:
+        // Pending subtree for the iterative searches. Depths on the stack strictly increase, so
+        // it never holds more entries than the tree has levels.
+        struct PendingSubtree {
+            size_t nodeIndex;
+            float planeDistance;
+        };
+
+        // A subtree still to be built: points [start, end) of the permutation under nodeIndex
+        struct BuildRange {
+            size_t start;
+            size_t end;
+            size_t depth;
+            size_t nodeIndex;
+        };
+
+        static constexpr size_t MAX_PENDING_SUBTREES = 64;
+
+        // Depth of the leaves; internal nodes at depth d split on dimension d % 2
+        size_t _depth = 0;
+
+        // Split value of each internal node, in heap order
+        vector<float> _splits = vector<float>();
+
+        // Leaf i holds positions [_leafStarts[i], _leafStarts[i + 1])
+        vector<size_t> _leafStarts = vector<size_t>();
+
+        // Leaf i's block starts at 2 * _leafStarts[i]: its latitudes, then its longitudes
+        vector<float> _coordinates = vector<float>();
+
+        // Position of each input point
+        vector<size_t> _positions = vector<size_t>();
+
+        pair<BuildRange, BuildRange> split(span<const float> lats, span<const float> lons,
+                                           vector<size_t> &indices, const BuildRange &range);
+
+        // Update best and bestIndex with the points of one leaf
+        void scanLeaf(size_t leaf, float latitude, float longitude, float &best, size_t &bestIndex) const;
+
+        size_t leafOf(size_t nodeIndex) const;
+        bool isLeaf(size_t nodeIndex) const;
+
+        // Leaf holding a position
+        size_t leafAt(size_t position) const;
+    };
+
+    template <size_t LeafSize>
+    BucketKdTree<LeafSize>::BucketKdTree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool) {
+        if (latitudes.size() != longitudes.size()) {
+            throw invalid_argument("BucketKdTree latitude and longitude arrays must have the same length");
+        }
+
+        size_t numPoints = latitudes.size();
+
+        // A power of two number of leaves, each filled to between half and all of LeafSize
+        size_t leaves = std::bit_ceil(std::max<size_t>(1, (numPoints + LeafSize - 1) / LeafSize));
+        _depth = std::countr_zero(leaves);
+        _splits = vector<float>(leaves - 1);
+        _leafStarts = vector<size_t>(leaves + 1, numPoints);
+        _leafStarts[0] = 0;
+
+        vector<size_t> indices(numPoints);
+        for (size_t i = 0; i < numPoints; i++) {
+            indices[i] = i;
+        }
+
+        // Halve ranges one level at a time; the ranges within a level are disjoint, so they can
+        // be split in parallel
+        vector<BuildRange> level = {{0, numPoints, 0, 0}};
+        for (size_t depth = 0; depth < _depth; depth++) {
+            vector<pair<BuildRange, BuildRange>> children(level.size());
+            auto splitOne = [&](size_t, size_t i) {
+                children[i] = split(latitudes, longitudes, indices, level[i]);
+            };
+
+            if (pool != nullptr && level.size() > 1) {
+                pool->parallelFor(level.size(), splitOne);
+            } else {
+                for (size_t i = 0; i < level.size(); i++) {
+                    splitOne(0, i);
+                }
+            }
+
+            vector<BuildRange> nextLevel;
+            nextLevel.reserve(2 * level.size());
+            for (const auto &[left, right] : children) {
+                nextLevel.push_back(left);
+                nextLevel.push_back(right);
+            }
+
+            level = std::move(nextLevel);
+        }
+
+        for (size_t leaf = 0; leaf < level.size(); leaf++) {
+            _leafStarts[leaf] = level[leaf].start;
+        }
+
+        _coordinates = vector<float>(2 * numPoints);
+        _positions = vector<size_t>(numPoints);
+
+        for (size_t leaf = 0; leaf < leaves; leaf++) {
+            size_t start = _leafStarts[leaf];
+            size_t count = _leafStarts[leaf + 1] - start;
+
+            for (size_t position = start; position < start + count; position++) {
+                _coordinates[start + position] = latitudes[indices[position]];
+                _coordinates[start + count + position] = longitudes[indices[position]];
+                _positions[indices[position]] = position;
+            }
+        }
+    }
+
+    template <size_t LeafSize>
+    pair<typename BucketKdTree<LeafSize>::BuildRange, typename BucketKdTree<LeafSize>::BuildRange>
+    BucketKdTree<LeafSize>::split(span<const float> lats, span<const float> lons,
+                                  vector<size_t> &indices, const BuildRange &range) {
+        span<const float> axis = (range.depth % 2 == 0) ? lats : lons;
+        size_t middle = range.start + (range.end - range.start) / 2;
+
+        // Left holds values <= the split and right values >= it
+        float splitValue = std::numeric_limits<float>::infinity();
+        if (middle < range.end) {
+            std::nth_element(indices.begin() + range.start, indices.begin() + middle, indices.begin() + range.end,
+                             [axis](size_t a, size_t b) { return axis[a] < axis[b]; });
+            splitValue = axis[indices[middle]];
+        }
+
+        _splits[range.nodeIndex] = splitValue;
+
+        return {
+            {range.start, middle, range.depth + 1, 2 * range.nodeIndex + 1},
+            {middle, range.end, range.depth + 1, 2 * range.nodeIndex + 2}
+        };
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::nearestPoint(float latitude, float longitude) const {
+        if (size() == 0) {
+            throw out_of_range("Nearest point query on an empty BucketKdTree");
+        }
+
+        float best = std::numeric_limits<float>::infinity();
+        size_t bestIndex = 0;
+
+        array<PendingSubtree, MAX_PENDING_SUBTREES> pending;
+        size_t numPending = 0;
+        pending[numPending++] = {0, 0.0f};
+
+        while (numPending > 0) {
+            PendingSubtree subtree = pending[--numPending];
+            if (subtree.planeDistance > best) {
+                continue;
+            }
+
+            // Descend towards the query, deferring the far side of every split
+            size_t nodeIndex = subtree.nodeIndex;
+            while (!isLeaf(nodeIndex)) {
+                size_t depth = std::bit_width(nodeIndex + 1) - 1;
+                float planeDist = ((depth % 2 == 0) ? latitude : longitude) - _splits[nodeIndex];
+
+                size_t nearChild = planeDist < 0 ? 2 * nodeIndex + 1 : 2 * nodeIndex + 2;
+                size_t farChild = planeDist < 0 ? 2 * nodeIndex + 2 : 2 * nodeIndex + 1;
+
+                if (planeDist * planeDist <= best) {
+                    pending[numPending++] = {farChild, planeDist * planeDist};
+                }
+
+                nodeIndex = nearChild;
+            }
+
+            scanLeaf(leafOf(nodeIndex), latitude, longitude, best, bestIndex);
+        }
+
+        return bestIndex;
+    }
+
+    template <size_t LeafSize>
+    void BucketKdTree<LeafSize>::scanLeaf(size_t leaf, float latitude, float longitude, float &best, size_t &bestIndex) const {
+        size_t start = _leafStarts[leaf];
+        size_t count = _leafStarts[leaf + 1] - start;
+        const float *lats = _coordinates.data() + 2 * start;
+        const float *lons = lats + count;
+        size_t i = 0;
+
+#ifdef BUCKET_KD_TREE_SSE
+        __m128 lat = _mm_set1_ps(latitude);
+        __m128 lon = _mm_set1_ps(longitude);
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 dLat = _mm_sub_ps(_mm_loadu_ps(lats + i), lat);
+            __m128 dLon = _mm_sub_ps(_mm_loadu_ps(lons + i), lon);
+            __m128 dist = _mm_add_ps(_mm_mul_ps(dLat, dLat), _mm_mul_ps(dLon, dLon));
+
+            // Most blocks hold nothing closer, so test the whole block before looking at lanes
+            int closer = _mm_movemask_ps(_mm_cmplt_ps(dist, _mm_set1_ps(best)));
+            if (closer == 0) {
+                continue;
+            }
+
+            alignas(16) float dists[4];
+            _mm_store_ps(dists, dist);
+            for (size_t lane = 0; lane < 4; lane++) {
+                if (dists[lane] < best) {
+                    best = dists[lane];
+                    bestIndex = start + i + lane;
+                }
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            float dLat = lats[i] - latitude;
+            float dLon = lons[i] - longitude;
+            float dist = dLat * dLat + dLon * dLon;
+
+            if (dist < best) {
+                best = dist;
+                bestIndex = start + i;
+            }
+        }
+    }
+
+    template <size_t LeafSize>
+    void BucketKdTree<LeafSize>::pointsWithinRadius(float latitude, float longitude, float radius, vector<size_t> &result) const {
+        // The radius query is the box query around the circle, filtered
+        size_t first = result.size();
+        pointsInBox(latitude - radius, longitude - radius, latitude + radius, longitude + radius, result);
+
+        float radiusSquared = radius * radius;
+        auto outside = std::remove_if(result.begin() + first, result.end(), [&](size_t position) {
+            auto [lat, lon] = (*this)[position];
+            return (lat - latitude) * (lat - latitude) + (lon - longitude) * (lon - longitude) > radiusSquared;
+        });
+        result.erase(outside, result.end());
+    }
+
+    template <size_t LeafSize>
+    void BucketKdTree<LeafSize>::pointsInBox(float minLatitude, float minLongitude,
+                                             float maxLatitude, float maxLongitude,
+                                             vector<size_t> &result) const {
+        if (size() == 0) {
+            return;
+        }
+
+        array<size_t, MAX_PENDING_SUBTREES> pending;
+        size_t numPending = 0;
+        pending[numPending++] = 0;
+
+        while (numPending > 0) {
+            size_t nodeIndex = pending[--numPending];
+
+            // Walk down one path, deferring the other child whenever the box straddles the split
+            while (!isLeaf(nodeIndex)) {
+                size_t depth = std::bit_width(nodeIndex + 1) - 1;
+                float splitValue = _splits[nodeIndex];
+                bool searchLeft = ((depth % 2 == 0) ? minLatitude : minLongitude) <= splitValue;
+                bool searchRight = ((depth % 2 == 0) ? maxLatitude : maxLongitude) >= splitValue;
+
+                if (searchLeft && searchRight) {
+                    pending[numPending++] = 2 * nodeIndex + 2;
+                    nodeIndex = 2 * nodeIndex + 1;
+                } else if (searchLeft) {
+                    nodeIndex = 2 * nodeIndex + 1;
+                } else {
+                    nodeIndex = 2 * nodeIndex + 2;
+                }
+            }
+
+            size_t leaf = leafOf(nodeIndex);
+            size_t start = _leafStarts[leaf];
+            size_t count = _leafStarts[leaf + 1] - start;
+            const float *lats = _coordinates.data() + 2 * start;
+            const float *lons = lats + count;
+
+            for (size_t i = 0; i < count; i++) {
+                if (lats[i] >= minLatitude && lats[i] <= maxLatitude && lons[i] >= minLongitude && lons[i] <= maxLongitude) {
+                    result.push_back(start + i);
+                }
+            }
+        }
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::getNewIndex(size_t nodeIndex) const {
+        return _positions[nodeIndex];
+    }
+
+    template <size_t LeafSize>
+    pair<float, float> BucketKdTree<LeafSize>::operator[](size_t index) const {
+        if (index >= size()) {
+            throw out_of_range("Attempt to access a point past the end of a BucketKdTree");
+        }
+
+        size_t leaf = leafAt(index);
+        size_t start = _leafStarts[leaf];
+        size_t count = _leafStarts[leaf + 1] - start;
+
+        return {_coordinates[start + index], _coordinates[start + count + index]};
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::size() const {
+        return _positions.size();
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::numLeaves() const {
+        return _splits.size() + 1;
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::memoryBytes() const {
+        return _splits.size() * sizeof(float) + _leafStarts.size() * sizeof(size_t)
+            + _coordinates.size() * sizeof(float) + _positions.size() * sizeof(size_t);
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::leafOf(size_t nodeIndex) const {
+        return nodeIndex - _splits.size();
+    }
+
+    template <size_t LeafSize>
+    bool BucketKdTree<LeafSize>::isLeaf(size_t nodeIndex) const {
+        return nodeIndex >= _splits.size();
+    }
+
+    template <size_t LeafSize>
+    size_t BucketKdTree<LeafSize>::leafAt(size_t position) const {
+        // Empty leaves share their start with the next one, so take the last leaf starting at or before position
+        return std::upper_bound(_leafStarts.begin(), _leafStarts.end() - 1, position) - _leafStarts.begin() - 1;
+    }
+}
@@ -1,120 +1,439 @@
+#include <array>
+#include <bit>
+#include <stdexcept>
+
 #include "dim2Tree.h"
+#include "models/util/morton.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define DIM2TREE_SSE
+#include <immintrin.h>
+#endif
 
+using std::array;
+using std::invalid_argument;
 using std::istream;
 using std::ostream;
+using utils::clampToMicrodegrees;
 using utils::Dim2Tree;
+using utils::KdSearch;
 using utils::ListWithSize;
+using utils::MICRODEGREES_PER_DEGREE;
+using utils::mortonIndex;
+using utils::TreeLayout;
 
-Dim2Tree::Dim2Tree(vector<pair<float, float>> points) {
-    // Initialize the tree with the appropriate size
-    // We need 2 floats per point (lat, lon)
-    _points = ListWithSize<float>(points.size() * 2);
-    
-    // We need 1 ints per node (original index)
-    _metadata = ListWithSize<size_t>(points.size());
-    
-    // Create a vector of indices to track the original positions
-    vector<size_t> indices(points.size());
-    for (size_t i = 0; i < points.size(); i++) {
-        indices[i] = i;
+namespace {
+    constexpr size_t GROUP_LANES = 4;
+
+    // Squared distances in square microdegrees, as in the scalar searches
+    using Distance = KdSearch<2, int32_t>::Distance;
+
+    // Query location in microdegrees
+    KdSearch<2, int32_t>::Point microdegreePoint(float latitude, float longitude) {
+        return {clampToMicrodegrees(latitude), clampToMicrodegrees(longitude)};
     }
-    
-    // Build the KD-Tree recursively
-    buildTree(points, indices, 0, points.size(), 0, 0);
+
+    // Latitudes and longitudes of (lat, lon) points, as separate arrays
+    template <typename Coordinate>
+    pair<vector<Coordinate>, vector<Coordinate>> splitPoints(const vector<pair<Coordinate, Coordinate>> &points) {
+        vector<Coordinate> lats(points.size());
+        vector<Coordinate> lons(points.size());
+
+        for (size_t i = 0; i < points.size(); i++) {
+            lats[i] = points[i].first;
+            lons[i] = points[i].second;
+        }
+
+        return {lats, lons};
+    }
+
+    // Squared group spread, relative to the largest squared nearest distance, beyond which
+    // nearestGroup searches each query on its own
+    constexpr Distance SPREAD_FACTOR = 1.0;
+
+    // Far side of a split deferred by a group traversal, by heap index
+    struct PendingGroupSubtree {
+        size_t nodeIndex;
+        size_t depth;
+        int32_t splitValue;
+        bool isRight;
+    };
+
+    // Stable LSD radix sort on the upper 32 bits, a byte at a time
+    void radixSortByHighHalf(vector<uint64_t> &keys) {
+        vector<uint64_t> scratch(keys.size());
+
+        for (size_t shift = 32; shift < 64; shift += 8) {
+            array<size_t, 257> offsets = {};
+            for (uint64_t key : keys) {
+                offsets[((key >> shift) & 0xFF) + 1]++;
+            }
+
+            for (size_t digit = 1; digit < offsets.size(); digit++) {
+                offsets[digit] += offsets[digit - 1];
+            }
+
+            for (uint64_t key : keys) {
+                scratch[offsets[(key >> shift) & 0xFF]++] = key;
+            }
+
+            keys.swap(scratch);
+        }
+    }
+
+    // Update every lane's best distance and index with one tree node. The differences fit in an
+    // int32_t (see microdegrees.h), and convert to double exactly.
+    void visitLanes(const int32_t *queryLats, const int32_t *queryLons, int32_t nodeLat, int32_t nodeLon,
+                    size_t nodeIndex, Distance *best, size_t *bestIndex) {
+#ifdef DIM2TREE_SSE
+        __m128i lat = _mm_set1_epi32(nodeLat);
+        __m128i lon = _mm_set1_epi32(nodeLon);
+
+        // Two lanes per vector of doubles
+        for (size_t lane = 0; lane < GROUP_LANES; lane += 2) {
+            __m128d dLat = _mm_cvtepi32_pd(_mm_sub_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(queryLats + lane)), lat));
+            __m128d dLon = _mm_cvtepi32_pd(_mm_sub_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(queryLons + lane)), lon));
+            __m128d dist = _mm_add_pd(_mm_mul_pd(dLat, dLat), _mm_mul_pd(dLon, dLon));
+
+            __m128d previous = _mm_load_pd(best + lane);
+            unsigned closer = _mm_movemask_pd(_mm_cmplt_pd(dist, previous));
+            _mm_store_pd(best + lane, _mm_min_pd(dist, previous));
+
+            while (closer != 0) {
+                bestIndex[lane + std::countr_zero(closer)] = nodeIndex;
+                closer &= closer - 1;
+            }
+        }
+#else
+        for (size_t lane = 0; lane < GROUP_LANES; lane++) {
+            Distance dLat = static_cast<Distance>(queryLats[lane] - nodeLat);
+            Distance dLon = static_cast<Distance>(queryLons[lane] - nodeLon);
+            Distance dist = dLat * dLat + dLon * dLon;
+
+            if (dist < best[lane]) {
+                best[lane] = dist;
+                bestIndex[lane] = nodeIndex;
+            }
+        }
+#endif
+    }
+
+    // Number of lanes whose query value is below the split
+    size_t lanesBelow(const int32_t *queryValues, int32_t splitValue) {
+#ifdef DIM2TREE_SSE
+        __m128i split = _mm_set1_epi32(splitValue);
+        size_t below = 0;
+
+        for (size_t lane = 0; lane < GROUP_LANES; lane += 4) {
+            __m128i query = _mm_load_si128(reinterpret_cast<const __m128i *>(queryValues + lane));
+            below += std::popcount(static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(query, split)))));
+        }
+
+        return below;
+#else
+        size_t below = 0;
+        for (size_t lane = 0; lane < GROUP_LANES; lane++) {
+            below += queryValues[lane] < splitValue;
+        }
+        return below;
+#endif
+    }
+
+    // Whether any lane's nearest point could lie on the given side of a split
+    bool anyLaneReaches(const int32_t *queryValues, int32_t splitValue, bool isRight, const Distance *best) {
+#ifdef DIM2TREE_SSE
+        __m128i split = _mm_set1_epi32(splitValue);
+        __m128d zero = _mm_setzero_pd();
+        int reaches = 0;
+
+        for (size_t lane = 0; lane < GROUP_LANES; lane += 2) {
+            __m128i query = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(queryValues + lane));
+            __m128i difference = isRight ? _mm_sub_epi32(split, query) : _mm_sub_epi32(query, split);
+            __m128d gap = _mm_max_pd(_mm_cvtepi32_pd(difference), zero);
+            reaches |= _mm_movemask_pd(_mm_cmple_pd(_mm_mul_pd(gap, gap), _mm_load_pd(best + lane)));
+        }
+
+        return reaches != 0;
+#else
+        for (size_t lane = 0; lane < GROUP_LANES; lane++) {
+            Distance gap = std::max(static_cast<Distance>(isRight ? splitValue - queryValues[lane] : queryValues[lane] - splitValue), Distance(0));
+            if (gap * gap <= best[lane]) {
+                return true;
+            }
+        }
+
+        return false;
+#endif
+    }
+}
+
+Dim2Tree::Dim2Tree(const vector<pair<double, double>> &points, ThreadPool *pool, TreeLayout layout) : _layout(layout) {
+    auto [lats, lons] = splitPoints(points);
+    buildTree<double>(lats, lons, pool);
+    applyLayout();
 }
 
-size_t Dim2Tree::buildTree(vector<pair<float, float>>& points, 
-                          vector<size_t>& indices,
-                          size_t start, size_t end, 
-                          size_t depth, size_t nodeIndex) {
+Dim2Tree::Dim2Tree(const vector<pair<float, float>> &points, ThreadPool *pool, TreeLayout layout) : _layout(layout) {
+    auto [lats, lons] = splitPoints(points);
+    buildTree<float>(lats, lons, pool);
+    applyLayout();
+}
 
-    if (start >= end) {
-        return 0; // Empty subtree
+Dim2Tree::Dim2Tree(span<const double> latitudes, span<const double> longitudes, ThreadPool *pool, TreeLayout layout)
+    : _layout(layout) {
+    if (latitudes.size() != longitudes.size()) {
+        throw invalid_argument("Dim2Tree latitude and longitude arrays must have the same length");
     }
-    
-    // Choose axis based on depth (cycle through dimensions)
-    int axis = depth % 2;
-    
-    // Sort points along the chosen axis
-    std::sort(indices.begin() + start, indices.begin() + end,
-              [&points, axis](size_t a, size_t b) {
-                  if (axis == 0) {
-                      return points[a].first < points[b].first;
-                  } else {
-                      return points[a].second < points[b].second;
-                  }
-              });
-
-    size_t medianIdx = start + computeLeftSubtreeSize(nodeIndex);
-    size_t originalIndex = indices[medianIdx];
-    
-    // Store the point and metadata
-    _points[nodeIndex * 2] = points[originalIndex].first;      // Latitude
-    _points[nodeIndex * 2 + 1] = points[originalIndex].second; // Longitude
-    _metadata[originalIndex] = nodeIndex;                  // Original index
-    
-    // Recursively build subtrees
-    size_t leftNodes = 0;
-    size_t rightNodes = 0;
-    
-    // Build left subtree if there are points to the left of median
-    if (start < medianIdx) {
-        leftNodes = buildTree(points, indices, start, medianIdx, depth + 1, leftChild(nodeIndex));
+
+    buildTree(latitudes, longitudes, pool);
+    applyLayout();
+}
+
+Dim2Tree::Dim2Tree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool, TreeLayout layout)
+    : _layout(layout) {
+    if (latitudes.size() != longitudes.size()) {
+        throw invalid_argument("Dim2Tree latitude and longitude arrays must have the same length");
     }
-    
-    // Build right subtree if there are points to the right of median
-    if (medianIdx + 1 < end) {
-        rightNodes = buildTree(points, indices, medianIdx + 1, end, depth + 1, rightChild(nodeIndex));
+
+    buildTree(latitudes, longitudes, pool);
+    applyLayout();
+}
+
+template <typename Coordinate>
+void Dim2Tree::buildTree(span<const Coordinate> lats, span<const Coordinate> lons, ThreadPool *pool) {
+    // Check the range up front, so nothing throws on the pool's threads
+    if (lats.size() > static_cast<size_t>(std::numeric_limits<uint32_t>::max()) + 1) {
+        throw invalid_argument(format("Dim2Tree of {} points can't number them in 32 bits", lats.size()));
     }
+
+    for (size_t i = 0; i < lats.size(); i++) {
+        if (!(std::abs(lats[i]) <= MAX_FIXED_POINT_DEGREES && std::abs(lons[i]) <= MAX_FIXED_POINT_DEGREES)) {
+            throw invalid_argument(format("Dim2Tree point {} is outside the fixed point range", i));
+        }
+    }
+
+    // Initialize the tree with the appropriate size
+    // We need 2 fixed point values per point (lat, lon)
+    _points = ListWithSize<int32_t>(lats.size() * 2);
     
-    // Return total number of nodes in this subtree (including this node)
-    return 1 + leftNodes + rightNodes;
+    // We need 1 int per node (its slot, by original index)
+    _metadata = ListWithSize<uint32_t>(lats.size());
+
+    // Nodes are written from several threads, but never the same one twice
+    int32_t *points = _points.data();
+    uint32_t *metadata = _metadata.data();
+    array<span<const Coordinate>, 2> columns = {lats, lons};
+
+    // Rounding to microdegrees keeps the order along each axis, so the splits still hold
+    buildKdHeap(columns, pool, [&](size_t nodeIndex, size_t originalIndex) {
+        points[nodeIndex * 2] = toMicrodegrees(lats[originalIndex]);      // Latitude
+        points[nodeIndex * 2 + 1] = toMicrodegrees(lons[originalIndex]);  // Longitude
+        metadata[originalIndex] = static_cast<uint32_t>(nodeIndex);       // Original index
+    });
 }
 
 size_t Dim2Tree::size() const {
     return _points.size() / 2;
 }
 
-size_t Dim2Tree::computeLeftSubtreeSize(size_t currentNodeIndex) {
-    size_t totalNumPoints = _points.size() / 2;
+size_t Dim2Tree::memoryBytes() const {
+    return _points.size() * sizeof(int32_t) + _metadata.size() * sizeof(uint32_t);
+}
 
-    // Find the height of the largest complete binary tree that fits
-    size_t totalCapacity = 0;
-    size_t layerCapacity = 1;
+TreeLayout Dim2Tree::layout() const {
+    return _layout;
+}
 
-    for (size_t i = currentNodeIndex * 2 + 1; i < totalNumPoints; i = i * 2 + 1) {
-        layerCapacity = std::min(layerCapacity, totalNumPoints - i);
-        totalCapacity += layerCapacity;
+void Dim2Tree::computeLayout() {
+    // Every level above the last is full, so it can be laid out as a complete tree
+    _layoutDepth = (size() == 0) ? 0 : std::bit_width(size()) - 1;
 
-        layerCapacity *= 2;
+    if (_layout == TreeLayout::VanEmdeBoas) {
+        computeLayoutCuts(0, _layoutDepth);
     }
+}
+
+void Dim2Tree::computeLayoutCuts(size_t topDepth, size_t height) {
+    if (height < 2) {
+        return;
+    }
+
+    size_t topHeight = height / 2;
+    size_t bottomHeight = height - topHeight;
 
-    return totalCapacity;
+    _layoutCuts[topDepth + topHeight] = {
+        topDepth,
+        (size_t(1) << topHeight) - 1,
+        (size_t(1) << bottomHeight) - 1
+    };
+
+    computeLayoutCuts(topDepth, topHeight);
+    computeLayoutCuts(topDepth + topHeight, bottomHeight);
 }
 
-size_t Dim2Tree::approximateNearestPoint(float latitude, float longitude) {
-    // Initialize best distance to infinity and best index to invalid
-    float bestDist = std::numeric_limits<float>::max();
-    size_t bestIndex = 0;
-    
-    // Start the search from the root node (index 0, axis 0)
-    searchNearest(0, latitude, longitude, bestIndex, bestDist, 0);
-    
-    return bestIndex;
+void Dim2Tree::applyLayout() {
+    computeLayout();
+
+    if (_layout == TreeLayout::Heap) {
+        return;
+    }
+
+    // A node's ancestors come before it in heap order, so one pass fills in every slot
+    size_t numPoints = size();
+    vector<size_t> slots(numPoints);
+
+    for (size_t heapIndex = 0; heapIndex < numPoints; heapIndex++) {
+        size_t depth = std::bit_width(heapIndex + 1) - 1;
+
+        if (depth == 0 || depth >= _layoutDepth) {
+            slots[heapIndex] = heapIndex;
+            continue;
+        }
+
+        size_t topIndex = ((heapIndex + 1) >> (depth - _layoutCuts[depth].topDepth)) - 1;
+        slots[heapIndex] = bottomSlot(heapIndex, depth, slots[topIndex]);
+    }
+
+    ListWithSize<int32_t> points = ListWithSize<int32_t>(numPoints * 2);
+    for (size_t heapIndex = 0; heapIndex < numPoints; heapIndex++) {
+        points[slots[heapIndex] * 2] = _points[heapIndex * 2];
+        points[slots[heapIndex] * 2 + 1] = _points[heapIndex * 2 + 1];
+    }
+    _points = std::move(points);
+
+    for (size_t i = 0; i < numPoints; i++) {
+        _metadata[i] = static_cast<uint32_t>(slots[_metadata[i]]);
+    }
+}
+
+size_t Dim2Tree::bottomSlot(size_t heapIndex, size_t depth, size_t topSlot) const {
+    // The bottom subtrees follow the top subtree left to right, in the order given by the low bits
+    // of the path from the top subtree's root
+    const LayoutCut &cut = _layoutCuts[depth];
+    size_t path = (heapIndex + 1) & ((size_t(1) << (depth - cut.topDepth)) - 1);
+
+    return topSlot + cut.topSize + path * cut.bottomSize;
+}
+
+inline size_t Dim2Tree::slotOf(size_t heapIndex, size_t depth, const size_t *slots) const {
+    if (_layout == TreeLayout::Heap || depth == 0 || depth >= _layoutDepth) {
+        return heapIndex;
+    }
+
+    return bottomSlot(heapIndex, depth, slots[_layoutCuts[depth].topDepth]);
+}
+
+size_t Dim2Tree::nearestPoint(float latitude, float longitude) const {
+    if (size() == 0) {
+        throw out_of_range("Nearest point query on an empty Dim2Tree");
+    }
+
+    return search().nearestPoint(microdegreePoint(latitude, longitude));
+}
+
+void Dim2Tree::nearestBatch(span<const float> lats, span<const float> lons, span<size_t> nearest,
+                            ThreadPool *pool) const {
+    if (lats.size() != lons.size() || lats.size() != nearest.size()) {
+        throw invalid_argument("Batch nearest point spans must all have the same length");
+    }
+
+    if (lats.size() > std::numeric_limits<uint32_t>::max()) {
+        throw invalid_argument("Batch nearest point queries are limited to 2^32 per call");
+    }
+
+    if (lats.empty()) {
+        return;
+    }
+
+    if (size() == 0) {
+        throw out_of_range("Nearest point query on an empty Dim2Tree");
+    }
+
+    auto [minLat, maxLat] = std::minmax_element(lats.begin(), lats.end());
+    auto [minLon, maxLon] = std::minmax_element(lons.begin(), lons.end());
+    float latScale = (*maxLat > *minLat) ? 65535.0f / (*maxLat - *minLat) : 0.0f;
+    float lonScale = (*maxLon > *minLon) ? 65535.0f / (*maxLon - *minLon) : 0.0f;
+
+    // Sort by curve position (high half) and keep the query position (low half)
+    vector<uint64_t> keys(lats.size());
+    for (size_t i = 0; i < lats.size(); i++) {
+        uint32_t code = mortonIndex(lats[i], lons[i], *minLat, *minLon, latScale, lonScale);
+        keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+    }
+    radixSortByHighHalf(keys);
+
+    vector<uint32_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        order[i] = static_cast<uint32_t>(keys[i]);
+    }
+
+    size_t numGroups = (order.size() + BATCH_GROUP_SIZE - 1) / BATCH_GROUP_SIZE;
+    auto runGroups = [&](size_t firstGroup, size_t lastGroup) {
+        for (size_t group = firstGroup; group < lastGroup; group++) {
+            size_t first = group * BATCH_GROUP_SIZE;
+            size_t count = std::min(BATCH_GROUP_SIZE, order.size() - first);
+
+            // The previous group lies just behind this one on the curve, so its answers are close
+            // to this group's and make good starting bounds
+            const uint32_t *seeds = (group > firstGroup) ? order.data() + first - BATCH_GROUP_SIZE : nullptr;
+            nearestGroup(lats, lons, order.data() + first, count, seeds, nearest);
+        }
+    };
+
+    // Hand out runs of groups, so each thread also keeps the locality of the sort
+    const size_t groupsPerBlock = 64;
+    size_t numBlocks = (numGroups + groupsPerBlock - 1) / groupsPerBlock;
+
+    if (pool == nullptr || numBlocks < 2) {
+        runGroups(0, numGroups);
+        return;
+    }
+
+    pool->parallelFor(numBlocks, [&](size_t, size_t block) {
+        runGroups(block * groupsPerBlock, std::min(numGroups, (block + 1) * groupsPerBlock));
+    });
+}
+
+void Dim2Tree::kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const {
+    search().kNearest(microdegreePoint(latitude, longitude), k, result);
+}
+
+void Dim2Tree::pointsWithinRadius(float latitude, float longitude, float radius,
+                                  vector<size_t> &result) const {
+    Distance radiusMicrodegrees = static_cast<Distance>(radius) * MICRODEGREES_PER_DEGREE;
+    search().pointsWithinRadius(microdegreePoint(latitude, longitude), radiusMicrodegrees, result);
+}
+
+void Dim2Tree::pointsInBox(float minLatitude, float minLongitude,
+                           float maxLatitude, float maxLongitude,
+                           vector<size_t> &result) const {
+    search().pointsInBox(microdegreePoint(minLatitude, minLongitude), microdegreePoint(maxLatitude, maxLongitude), result);
+}
+
+Dim2Tree::Search Dim2Tree::search() const {
+    // Node indices are always in range, so the searches skip ListWithSize's bounds checks
+    return Search(_points.data(), size(), Slots{this});
 }
 
 pair<float, float> Dim2Tree::operator[](size_t index) const {
-    if (index >= _points.size()) {
-        throw out_of_range(format("Attempt to access element {} in Dim2Tree of size {}", index, _points.size() / 2));
+    auto [lat, lon] = microdegrees(index);
+    return pair<float, float>(microdegreesToDegrees(lat), microdegreesToDegrees(lon));
+}
+
+pair<int32_t, int32_t> Dim2Tree::microdegrees(size_t index) const {
+    if (index >= size()) {
+        throw out_of_range(format("Attempt to access element {} in Dim2Tree of size {}", index, size()));
     }
 
-    return pair<float, float>(_points[index * 2], _points[index * 2 + 1]);
+    return pair<int32_t, int32_t>(_points[index * 2], _points[index * 2 + 1]);
 }
 
 namespace utils {
     istream &operator>>(istream &input, Dim2Tree &tree) {
         input >> tree._points;
         input >> tree._metadata;
+        input.read(reinterpret_cast<char*>(&tree._layout), sizeof(tree._layout));
+        tree.computeLayout();
 
         return input;
     }
@@ -122,71 +441,121 @@ namespace utils {
     ostream &operator<<(ostream &output, const Dim2Tree &tree) {
         output << tree._points;
         output << tree._metadata;
+        output.write(reinterpret_cast<const char*>(&tree._layout), sizeof(tree._layout));
 
         return output;
     }
 }
 
-size_t Dim2Tree::searchNearest(size_t nodeIndex, float lat, float lon, 
-                              size_t& bestIndex, float& bestDist,
-                              size_t splitDim) const {
+void Dim2Tree::nearestGroup(span<const float> lats, span<const float> lons, const uint32_t *queries,
+                            size_t count, const uint32_t *seeds, span<size_t> nearest) const {
+    static_assert(BATCH_GROUP_SIZE == GROUP_LANES);
 
-    // If we've gone beyond the tree size, return
-    if (nodeIndex >= _points.size() / 2) {
-        return bestIndex;
-    }
-    
-    // Get the current node's point
-    float nodeLat = _points[nodeIndex * 2];
-    float nodeLon = _points[nodeIndex * 2 + 1];
-    
-    // Calculate distance to the current node
-    float dist = distanceSquared(lat, lon, nodeLat, nodeLon);
-    
-    // Update best distance if this node is closer
-    if (dist < bestDist) {
-        bestDist = dist;
-        bestIndex = nodeIndex;
+    // Unused lanes repeat the first query, so they never widen the search
+    alignas(16) int32_t queryLats[GROUP_LANES];
+    alignas(16) int32_t queryLons[GROUP_LANES];
+    alignas(16) Distance best[GROUP_LANES];
+    size_t bestIndex[GROUP_LANES];
+
+    for (size_t lane = 0; lane < GROUP_LANES; lane++) {
+        size_t query = queries[lane < count ? lane : 0];
+        queryLats[lane] = clampToMicrodegrees(lats[query]);
+        queryLons[lane] = clampToMicrodegrees(lons[query]);
+        best[lane] = std::numeric_limits<Distance>::infinity();
+        bestIndex[lane] = 0;
     }
-    
-    // Determine which child to search first based on the splitting dimension
-    float targetValue = (splitDim == 0) ? lat : lon;
-    float nodeValue = (splitDim == 0) ? nodeLat : nodeLon;
-    
-    size_t childToSearch;
-    if (targetValue < nodeValue) {
-        childToSearch = leftChild(nodeIndex);
-    } else {
-        childToSearch = rightChild(nodeIndex);
+
+    // Node indices below are always in range, so skip ListWithSize's bounds checks
+    const int32_t *points = _points.data();
+
+    if (seeds != nullptr) {
+        for (size_t seed = 0; seed < BATCH_GROUP_SIZE; seed++) {
+            size_t slot = nearest[seeds[seed]];
+            visitLanes(queryLats, queryLons, points[slot * 2], points[slot * 2 + 1], slot, best, bestIndex);
+        }
+
+        // When the queries are sparser than the points, the lanes sit further apart than their
+        // nearest points and a shared traversal would visit the union of their paths. Finish each
+        // lane on its own instead, still starting from the seeded bound.
+        auto [minLat, maxLat] = std::minmax_element(queryLats, queryLats + GROUP_LANES);
+        auto [minLon, maxLon] = std::minmax_element(queryLons, queryLons + GROUP_LANES);
+        Distance latSpread = static_cast<Distance>(*maxLat - *minLat);
+        Distance lonSpread = static_cast<Distance>(*maxLon - *minLon);
+        Distance spread = latSpread * latSpread + lonSpread * lonSpread;
+
+        if (spread > SPREAD_FACTOR * *std::max_element(best, best + GROUP_LANES)) {
+            Search laneSearch = search();
+
+            for (size_t lane = 0; lane < count; lane++) {
+                laneSearch.searchNearest(
+                    {queryLats[lane], queryLons[lane]},
+                    [&](size_t nodeIndex, Distance dist) {
+                        if (dist < best[lane]) {
+                            best[lane] = dist;
+                            bestIndex[lane] = nodeIndex;
+                        }
+                    },
+                    [&]() { return best[lane]; }
+                );
+
+                nearest[queries[lane]] = bestIndex[lane];
+            }
+
+            return;
+        }
     }
 
-    size_t newSplitDim = (splitDim + 1) % 2;
-    
-    // Search the first subtree
-    searchNearest(childToSearch, lat, lon, bestIndex, bestDist, newSplitDim);
-    
-    // Calculate the distance to the splitting plane
-    float planeDist = targetValue - nodeValue;
-    planeDist = planeDist * planeDist; // Square it
-    
-    return bestIndex;
-}
+    size_t numPoints = size();
+    array<PendingGroupSubtree, MAX_PENDING_SUBTREES> pending;
+    array<size_t, MAX_PENDING_SUBTREES> slots;
+    size_t numPending = 0;
+    pending[numPending++] = {0, 0, 0, false};
 
-float Dim2Tree::distanceSquared(float lat1, float lon1, float lat2, float lon2) const {
-    // Simple Euclidean distance squared
-    float dLat = lat1 - lat2;
-    float dLon = lon1 - lon2;
-    return dLat * dLat + dLon * dLon;
-}
+    while (numPending > 0) {
+        PendingGroupSubtree subtree = pending[--numPending];
 
-size_t Dim2Tree::getNewIndex(size_t nodeIndex) const {
-    return _metadata[nodeIndex];
-}
+        // Every lane's bound may have shrunk since this subtree was deferred. The split that
+        // separates it is its parent's, on the other axis.
+        if (subtree.nodeIndex != 0
+            && !anyLaneReaches(subtree.depth % 2 == 0 ? queryLons : queryLats, subtree.splitValue, subtree.isRight, best)) {
+            continue;
+        }
+
+        size_t nodeIndex = subtree.nodeIndex;
+        size_t depth = subtree.depth;
+
+        // Descend the side most lanes fall on, deferring the other side
+        while (nodeIndex < numPoints) {
+            size_t slot = slotOf(nodeIndex, depth, slots.data());
+            slots[depth] = slot;
+            int32_t nodeLat = points[slot * 2];
+            int32_t nodeLon = points[slot * 2 + 1];
 
-size_t Dim2Tree::leftChild(size_t nodeIndex) const {
-    return 2 * nodeIndex + 1;
+            visitLanes(queryLats, queryLons, nodeLat, nodeLon, slot, best, bestIndex);
+
+            size_t splitDim = depth % 2;
+            const int32_t *queryValues = (splitDim == 0) ? queryLats : queryLons;
+            int32_t splitValue = (splitDim == 0) ? nodeLat : nodeLon;
+
+            bool goLeft = 2 * lanesBelow(queryValues, splitValue) > GROUP_LANES;
+            size_t nearChild = goLeft ? 2 * nodeIndex + 1 : 2 * nodeIndex + 2;
+            size_t farChild = goLeft ? 2 * nodeIndex + 2 : 2 * nodeIndex + 1;
+
+            if (farChild < numPoints && anyLaneReaches(queryValues, splitValue, goLeft, best)) {
+                // The far subtree is checked against the split of its parent, on the parent's axis
+                pending[numPending++] = {farChild, depth + 1, splitValue, goLeft};
+            }
+
+            depth++;
+            nodeIndex = nearChild;
+        }
+    }
+
+    for (size_t lane = 0; lane < count; lane++) {
+        nearest[queries[lane]] = bestIndex[lane];
+    }
 }
 
-size_t Dim2Tree::rightChild(size_t nodeIndex) const {
-    return 2 * nodeIndex + 2;
+size_t Dim2Tree::getNewIndex(size_t nodeIndex) const {
+    return _metadata[nodeIndex];
 }
@@ -1,79 +1,182 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <limits>
+#include <span>
 #include <utility>
 #include <vector>
 
+#include "models/util/kdTree.h"
 #include "models/util/listWithSize.h"
+#include "models/util/microdegrees.h"
+#include "models/util/threadPool.h"
 
+using std::array;
 using std::istream;
 using std::ostream;
 using std::pair;
+using std::span;
 using std::vector;
 using utils::ListWithSize;
+using utils::ThreadPool;
 
 namespace utils {
+    // Order of a Dim2Tree's nodes in memory. Queries, indices and serialization behave the same
+    // with either; only the cache behaviour differs.
+    enum class TreeLayout : uint8_t {
+        // Node i's children are at 2i + 1 and 2i + 2, so each level below the first few is a new cache line
+        Heap,
+
+        // The tree is cut at half its height and stored as the top subtree followed by each bottom
+        // subtree, recursively, so a search touches O(log_B n) blocks of any size B. The last
+        // level stays in heap order.
+        VanEmdeBoas
+    };
+
+    /**
+    * KD-Tree over 2D points, for snapping locations to graph nodes.
+    *
+    * Points are stored as fixed point microdegrees (see microdegrees.h). Queries are rounded to a
+    * microdegree too and run on KdSearch, which differences the integers exactly and squares them
+    * in double, so results are ranked by the stored coordinates exactly. operator[] decodes a
+    * point back to degrees.
+    */
     class Dim2Tree {
     public:
         // Constructor that builds a KD-Tree from a vector of 2D points
         Dim2Tree() = default;
-        Dim2Tree(vector<pair<float, float>> points);
+        // Points are rounded to the nearest microdegree, so double coordinates keep about 0.1 m of
+        // their precision where float ones have already lost up to a metre
+        Dim2Tree(const vector<pair<double, double>> &points, ThreadPool *pool = nullptr,
+                 TreeLayout layout = TreeLayout::Heap);
+        Dim2Tree(const vector<pair<float, float>> &points, ThreadPool *pool = nullptr,
+                 TreeLayout layout = TreeLayout::Heap);
+
+        // Same, from separate latitude and longitude arrays of equal length
+        // Coordinates must be within MAX_FIXED_POINT_DEGREES, and there can be at most 2^32 points
+        // With a pool, the top levels split their ranges in parallel and the subtrees below are built as parallel tasks
+        // The tree is built in heap order and then permuted into the requested layout
+        Dim2Tree(span<const double> latitudes, span<const double> longitudes, ThreadPool *pool = nullptr,
+                 TreeLayout layout = TreeLayout::Heap);
+        Dim2Tree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool = nullptr,
+                 TreeLayout layout = TreeLayout::Heap);
+
+        // Find the nearest point to the given coordinates (Euclidean distance in degrees)
+        // Returns the index of the nearest point in the tree. The tree must not be empty.
+        // Query coordinates are clamped to MAX_FIXED_POINT_DEGREES, here and in the queries below.
+        size_t nearestPoint(float latitude, float longitude) const;
+
+        // Nearest point for every (lats[i], lons[i]), written to nearest[i]. Same results as nearestPoint,
+        // up to ties. All three spans must have the same length.
+        // Queries are sorted along a Morton curve and searched in groups of BATCH_GROUP_SIZE that share
+        // one traversal, with SIMD distances across the group. Each group starts from the previous
+        // group's answers as bounds; a group spread wider than those bounds searches per query instead.
+        // Runs of groups are spread over the pool's threads when one is given.
+        void nearestBatch(span<const float> lats, span<const float> lons, span<size_t> nearest,
+                          ThreadPool *pool = nullptr) const;
+
+        // Find the k nearest points, closest first (fewer if the tree is smaller)
+        // Indices are appended to result, which doubles as the search heap
+        void kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const;
+
+        // Find all points within radius degrees of the given coordinates (inclusive)
+        // Indices are appended to result, in no particular order
+        void pointsWithinRadius(float latitude, float longitude, float radius,
+                                vector<size_t> &result) const;
 
-        // Find the approximate nearest point to the given coordinates
-        // Returns the index of the nearest point in the vector
-        size_t approximateNearestPoint(float latitude, float longitude);
+        // Find all points inside the bounding box (inclusive on all sides)
+        // Indices are appended to result, so a buffer can be reused across queries
+        void pointsInBox(float minLatitude, float minLongitude,
+                         float maxLatitude, float maxLongitude,
+                         vector<size_t> &result) const;
         
         // Get the new index of a point in the input vector
         size_t getNewIndex(size_t nodeIndex) const;
 
+        // Location of a point, decoded to degrees
         pair<float, float> operator[](size_t index) const;
 
+        // Location of a point as stored, in microdegrees
+        pair<int32_t, int32_t> microdegrees(size_t index) const;
+
         friend istream &operator>>(istream &input, Dim2Tree &tree);
         friend ostream &operator<<(ostream &output, const Dim2Tree &tree);
 
         size_t size() const;
 
+        // Bytes held by the tree's arrays
+        size_t memoryBytes() const;
+
+        TreeLayout layout() const;
+
     private:
-        // Flat array representation of the KD-Tree
+        // Flat array representation of the KD-Tree, in microdegrees
         // Format: [point0_lat, point0_lon, point1_lat, point1_lon, ...]
-        ListWithSize<float> _points = ListWithSize<float>(0);
-        
-        // Metadata for each node in the tree
-        // Format: [original_index]
-        ListWithSize<size_t> _metadata = ListWithSize<size_t>(0);
-        
-        // Helper method to build the KD-Tree recursively
-        // start and end define the range of points to consider
-        // depth determines the splitting dimension (depth % 2)
-        // nodeIndex is the index of the current node in the flat array
-        // Returns the number of nodes in the subtree
-        size_t buildTree(vector<pair<float, float>>& points, 
-                         vector<size_t>& indices,
-                         size_t start, size_t end, 
-                         size_t depth, size_t nodeIndex);
-
-        size_t computeLeftSubtreeSize(size_t currentNodeIndex);
-        
-        // Helper method for nearest neighbor search
-        // Returns the index of the nearest point in the original input vector
-        size_t searchNearest(size_t nodeIndex, float lat, float lon, 
-                            size_t& bestIndex, float& bestDist,
-                            size_t splitDim) const;
-        
-        // Calculate squared Euclidean distance between two points
-        float distanceSquared(float lat1, float lon1, float lat2, float lon2) const;
+        ListWithSize<int32_t> _points = ListWithSize<int32_t>(0);
         
-        // Get the splitting dimension of a node (0 for latitude, 1 for longitude)
-        int getSplitDimension(size_t nodeIndex) const;
-        
-        // Get the left child index of a node
-        size_t leftChild(size_t nodeIndex) const;
+        // Slot of each input point in the tree, by input index
+        // Trees are limited to 2^32 points, so 4 bytes per point is enough
+        ListWithSize<uint32_t> _metadata = ListWithSize<uint32_t>(0);
+
+        TreeLayout _layout = TreeLayout::Heap;
+
+        // Van Emde Boas layout: one cut per depth that starts a bottom subtree, giving the depth
+        // of the top subtree's root and the sizes of the top subtree and of each bottom subtree
+        struct LayoutCut {
+            size_t topDepth;
+            size_t topSize;
+            size_t bottomSize;
+        };
+
+        // Levels stored in _layout order; the last level is always in heap order
+        size_t _layoutDepth = 0;
+        array<LayoutCut, 64> _layoutCuts = array<LayoutCut, 64>();
         
-        // Get the right child index of a node
-        size_t rightChild(size_t nodeIndex) const;
+        template <typename Coordinate>
+        void buildTree(span<const Coordinate> lats, span<const Coordinate> lons, ThreadPool *pool);
+
+        // Fill in _layoutDepth and _layoutCuts for the current size and _layout
+        void computeLayout();
+        void computeLayoutCuts(size_t topDepth, size_t height);
+
+        // Move the nodes from heap order into _layout
+        void applyLayout();
+
+        // Slot in _points of the node at heapIndex, given the slot of its ancestor at the
+        // cut's top depth
+        size_t bottomSlot(size_t heapIndex, size_t depth, size_t topSlot) const;
+
+        // Slot in _points of the node at heapIndex. Searches walk heap indices and keep the slots
+        // of the current path in slots, by depth.
+        size_t slotOf(size_t heapIndex, size_t depth, const size_t *slots) const;
+
+        // slotOf as a KdSearch layout
+        struct Slots {
+            const Dim2Tree *tree;
+
+            size_t operator()(size_t heapIndex, size_t depth, const size_t *slots) const {
+                return tree->slotOf(heapIndex, depth, slots);
+            }
+        };
+
+        using Search = KdSearch<2, int32_t, Slots>;
+
+        // Searches over _points, in _layout order
+        Search search() const;
+
+        // Deferred subtrees of a group traversal. The tree is balanced, so at most one per level.
+        static constexpr size_t MAX_PENDING_SUBTREES = 64;
+        static constexpr size_t BATCH_GROUP_SIZE = 4;
+
+        // Helper method for nearestBatch: one shared traversal for up to BATCH_GROUP_SIZE queries,
+        // given by their positions in the input spans. seeds, if not null, are BATCH_GROUP_SIZE
+        // already answered queries whose results bound the search from the start.
+        void nearestGroup(span<const float> lats, span<const float> lons, const uint32_t *queries,
+                          size_t count, const uint32_t *seeds, span<size_t> nearest) const;
     };
 
     istream &operator>>(istream &input, Dim2Tree &tree);
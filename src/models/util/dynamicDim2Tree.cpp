@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <stdexcept>
+
+#include "dynamicDim2Tree.h"
+#include "microdegrees.h"
+
+using std::array;
+using std::invalid_argument;
+using std::make_shared;
+using std::out_of_range;
+using std::shared_lock;
+using std::unique_lock;
+using utils::DynamicDim2Tree;
+
+DynamicDim2Tree::DynamicDim2Tree(ThreadPool *pool) : _pool(pool) {}
+
+DynamicDim2Tree::DynamicDim2Tree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool)
+    : _pool(pool) {
+    if (latitudes.size() != longitudes.size()) {
+        throw invalid_argument("DynamicDim2Tree latitude and longitude arrays must have the same length");
+    }
+
+    if (latitudes.size() > MAX_IDS) {
+        throw invalid_argument(format("DynamicDim2Tree of {} points can't give them all ids", latitudes.size()));
+    }
+
+    _slots = vector<Slot>(latitudes.size());
+    vector<BufferedPoint> points(latitudes.size());
+
+    for (size_t i = 0; i < latitudes.size(); i++) {
+        int32_t lat = toMicrodegrees(latitudes[i]);
+        int32_t lon = toMicrodegrees(longitudes[i]);
+
+        _slots[i] = {lat, lon, 1, true};
+        points[i] = {lat, lon, {static_cast<uint32_t>(i), 1}};
+    }
+
+    if (!points.empty()) {
+        _trees.push_back(buildTree(points, pool));
+    }
+
+    _size = points.size();
+    _storedPoints = points.size();
+}
+
+DynamicDim2Tree::~DynamicDim2Tree() {
+    waitForMerges();
+}
+
+void DynamicDim2Tree::insert(size_t id, float latitude, float longitude) {
+    if (id >= MAX_IDS) {
+        throw invalid_argument(format("Id {} is too large for a DynamicDim2Tree", id));
+    }
+
+    // Convert before locking, so a bad coordinate leaves the tree untouched
+    int32_t lat = toMicrodegrees(latitude);
+    int32_t lon = toMicrodegrees(longitude);
+
+    unique_lock<shared_mutex> lock(_mutex);
+
+    if (id >= _slots.size()) {
+        _slots.resize(id + 1);
+    }
+
+    // A new version tombstones any copy of the old location
+    Slot &slot = _slots[id];
+    if (!slot.present) {
+        _size++;
+    }
+    slot = {lat, lon, slot.version + 1, true};
+
+    _buffer.push_back({lat, lon, {static_cast<uint32_t>(id), slot.version}});
+    _storedPoints++;
+
+    if (_buffer.size() >= BUFFER_CAPACITY) {
+        flushBuffer();
+    }
+}
+
+bool DynamicDim2Tree::remove(size_t id) {
+    unique_lock<shared_mutex> lock(_mutex);
+
+    if (id >= _slots.size() || !_slots[id].present) {
+        return false;
+    }
+
+    _slots[id].present = false;
+    _size--;
+
+    // May be due for a compaction
+    scheduleMerges();
+
+    return true;
+}
+
+bool DynamicDim2Tree::contains(size_t id) const {
+    shared_lock<shared_mutex> lock(_mutex);
+    return id < _slots.size() && _slots[id].present;
+}
+
+size_t DynamicDim2Tree::nearestPoint(float latitude, float longitude) const {
+    shared_lock<shared_mutex> lock(_mutex);
+
+    if (_size == 0) {
+        throw out_of_range("Nearest point query on an empty DynamicDim2Tree");
+    }
+
+    Tree::Distance bestDist = std::numeric_limits<Tree::Distance>::infinity();
+    size_t bestId = 0;
+
+    searchNearest(
+        clampToMicrodegrees(latitude), clampToMicrodegrees(longitude),
+        [&](const Entry &entry, Tree::Distance dist) {
+            if (dist < bestDist) {
+                bestDist = dist;
+                bestId = entry.id;
+            }
+        },
+        [&]() { return bestDist; }
+    );
+
+    return bestId;
+}
+
+void DynamicDim2Tree::kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const {
+    if (k == 0) {
+        return;
+    }
+
+    shared_lock<shared_mutex> lock(_mutex);
+
+    // Max-heap on distance, so the worst of the k best is always on top. Each id has one live
+    // copy, so there are no duplicates to weed out.
+    vector<pair<Tree::Distance, uint32_t>> best;
+    Tree::Distance worstDist = std::numeric_limits<Tree::Distance>::infinity();
+
+    searchNearest(
+        clampToMicrodegrees(latitude), clampToMicrodegrees(longitude),
+        [&](const Entry &entry, Tree::Distance dist) {
+            if (best.size() == k) {
+                if (dist >= worstDist) {
+                    return;
+                }
+
+                std::pop_heap(best.begin(), best.end());
+                best.back() = {dist, entry.id};
+            } else {
+                best.push_back({dist, entry.id});
+            }
+
+            std::push_heap(best.begin(), best.end());
+
+            if (best.size() == k) {
+                worstDist = best.front().first;
+            }
+        },
+        [&]() { return worstDist; }
+    );
+
+    std::sort_heap(best.begin(), best.end());
+    for (const auto &[dist, id] : best) {
+        result.push_back(id);
+    }
+}
+
+void DynamicDim2Tree::pointsWithinRadius(float latitude, float longitude, float radius,
+                                         vector<size_t> &result) const {
+    Tree::Distance radiusMicrodegrees = static_cast<Tree::Distance>(radius) * MICRODEGREES_PER_DEGREE;
+    Tree::Distance radiusSquared = radiusMicrodegrees * radiusMicrodegrees;
+
+    shared_lock<shared_mutex> lock(_mutex);
+
+    searchNearest(
+        clampToMicrodegrees(latitude), clampToMicrodegrees(longitude),
+        [&](const Entry &entry, Tree::Distance dist) {
+            if (dist <= radiusSquared) {
+                result.push_back(entry.id);
+            }
+        },
+        [&]() { return radiusSquared; }
+    );
+}
+
+void DynamicDim2Tree::pointsInBox(float minLatitude, float minLongitude,
+                                  float maxLatitude, float maxLongitude,
+                                  vector<size_t> &result) const {
+    array<int32_t, 2> low = {clampToMicrodegrees(minLatitude), clampToMicrodegrees(minLongitude)};
+    array<int32_t, 2> high = {clampToMicrodegrees(maxLatitude), clampToMicrodegrees(maxLongitude)};
+
+    shared_lock<shared_mutex> lock(_mutex);
+
+    for (const BufferedPoint &point : _buffer) {
+        if (point.lat >= low[0] && point.lat <= high[0] && point.lon >= low[1] && point.lon <= high[1]
+            && isLive(point.entry)) {
+            result.push_back(point.entry.id);
+        }
+    }
+
+    vector<size_t> nodes;
+    for (const shared_ptr<const Tree> &tree : _trees) {
+        nodes.clear();
+        tree->pointsInBox(low, high, nodes);
+
+        for (size_t node : nodes) {
+            if (isLive(tree->payload(node))) {
+                result.push_back(tree->payload(node).id);
+            }
+        }
+    }
+}
+
+pair<float, float> DynamicDim2Tree::operator[](size_t id) const {
+    shared_lock<shared_mutex> lock(_mutex);
+
+    if (id >= _slots.size() || !_slots[id].present) {
+        throw out_of_range(format("Id {} is not in the DynamicDim2Tree", id));
+    }
+
+    const Slot &slot = _slots[id];
+    return pair<float, float>(microdegreesToDegrees(slot.lat), microdegreesToDegrees(slot.lon));
+}
+
+size_t DynamicDim2Tree::size() const {
+    shared_lock<shared_mutex> lock(_mutex);
+    return _size;
+}
+
+size_t DynamicDim2Tree::treeCount() const {
+    shared_lock<shared_mutex> lock(_mutex);
+    return _trees.size();
+}
+
+size_t DynamicDim2Tree::memoryBytes() const {
+    shared_lock<shared_mutex> lock(_mutex);
+
+    size_t bytes = _slots.capacity() * sizeof(Slot) + _buffer.capacity() * sizeof(BufferedPoint);
+    for (const shared_ptr<const Tree> &tree : _trees) {
+        bytes += tree->memoryBytes();
+    }
+
+    return bytes;
+}
+
+void DynamicDim2Tree::waitForMerges() {
+    unique_lock<shared_mutex> lock(_mutex);
+    _mergeDone.wait(lock, [this]() { return _mergingRun == nullptr; });
+}
+
+bool DynamicDim2Tree::isLive(const Entry &entry) const {
+    const Slot &slot = _slots[entry.id];
+    return slot.present && slot.version == entry.version;
+}
+
+shared_ptr<const DynamicDim2Tree::Tree> DynamicDim2Tree::buildTree(const vector<BufferedPoint> &points,
+                                                                   ThreadPool *pool) {
+    vector<array<int32_t, 2>> locations(points.size());
+    vector<Entry> entries(points.size());
+
+    for (size_t i = 0; i < points.size(); i++) {
+        locations[i] = {points[i].lat, points[i].lon};
+        entries[i] = points[i].entry;
+    }
+
+    return make_shared<const Tree>(locations, entries, pool);
+}
+
+vector<DynamicDim2Tree::BufferedPoint> DynamicDim2Tree::liveCopies(span<const shared_ptr<const Tree>> trees) const {
+    vector<BufferedPoint> copies;
+
+    for (const shared_ptr<const Tree> &tree : trees) {
+        for (size_t node = 0; node < tree->size(); node++) {
+            const Entry &entry = tree->payload(node);
+
+            if (isLive(entry)) {
+                auto [lat, lon] = (*tree)[node];
+                copies.push_back({lat, lon, entry});
+            }
+        }
+    }
+
+    return copies;
+}
+
+void DynamicDim2Tree::replaceRun(size_t start, size_t count, shared_ptr<const Tree> merged) {
+    for (size_t i = start; i < start + count; i++) {
+        _storedPoints -= _trees[i]->size();
+    }
+
+    _trees.erase(_trees.begin() + start, _trees.begin() + start + count);
+
+    if (merged->size() > 0) {
+        _storedPoints += merged->size();
+        _trees.insert(_trees.begin() + start, std::move(merged));
+    }
+}
+
+void DynamicDim2Tree::flushBuffer() {
+    vector<BufferedPoint> live;
+    for (const BufferedPoint &point : _buffer) {
+        if (isLive(point.entry)) {
+            live.push_back(point);
+        }
+    }
+
+    _storedPoints -= _buffer.size();
+    _buffer.clear();
+
+    if (!live.empty()) {
+        _trees.insert(_trees.begin(), buildTree(live, nullptr));
+        _storedPoints += live.size();
+    }
+
+    scheduleMerges();
+}
+
+void DynamicDim2Tree::scheduleMerges() {
+    while (true) {
+        size_t count = mergeCount();
+        if (count == 0) {
+            return;
+        }
+
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++) {
+            total += _trees[i]->size();
+        }
+
+        if (_pool != nullptr && total > INLINE_MERGE_SIZE) {
+            if (_mergingRun == nullptr) {
+                vector<shared_ptr<const Tree>> run(_trees.begin(), _trees.begin() + count);
+                _mergingRun = run[0].get();
+                _pool->submit([this, run]() { mergeInBackground(run); });
+                return;
+            }
+
+            // One merge on the pool at a time, and the next is scheduled when it finishes. Until
+            // then, merge what's due among the newest trees that fit inline, so they don't pile up.
+            count = mergeCount(INLINE_MERGE_SIZE);
+            if (count == 0) {
+                return;
+            }
+        }
+
+        vector<BufferedPoint> copies = liveCopies(span(_trees.data(), count));
+        replaceRun(0, count, buildTree(copies, nullptr));
+    }
+}
+
+size_t DynamicDim2Tree::mergeCount(size_t maxPoints) const {
+    if (_mergingRun == nullptr && !_trees.empty() && _storedPoints > 2 * _size + BUFFER_CAPACITY) {
+        return _trees.size();
+    }
+
+    // Trees behind a running merge are left alone
+    size_t limit = _trees.size();
+    if (_mergingRun != nullptr) {
+        limit = std::find_if(_trees.begin(), _trees.end(), [this](const shared_ptr<const Tree> &tree) {
+            return tree.get() == _mergingRun;
+        }) - _trees.begin();
+    }
+
+    // Each tree should hold at least twice as many points as all newer trees together, which keeps
+    // the forest logarithmic. Merge the newest trees up to the last one that breaks this, like
+    // carries in a binary counter. Dropping tombstones can break it anywhere, not only at the front.
+    size_t count = 0;
+    size_t total = 0;
+    for (size_t i = 0; i < limit && total + _trees[i]->size() <= maxPoints; i++) {
+        if (i > 0 && 2 * total > _trees[i]->size()) {
+            count = i + 1;
+        }
+        total += _trees[i]->size();
+    }
+
+    return (count >= 2) ? count : 0;
+}
+
+void DynamicDim2Tree::mergeInBackground(const vector<shared_ptr<const Tree>> &run) {
+    // Copy the live points under a shared lock, then build without blocking anyone. Points removed
+    // in the meantime become tombstones in the merged tree.
+    vector<BufferedPoint> copies;
+    {
+        shared_lock<shared_mutex> lock(_mutex);
+        copies = liveCopies(run);
+    }
+
+    shared_ptr<const Tree> merged = buildTree(copies, nullptr);
+
+    unique_lock<shared_mutex> lock(_mutex);
+
+    // Only this merge removes trees from the run, and newer trees are only added in front of it
+    size_t start = std::find(_trees.begin(), _trees.end(), run[0]) - _trees.begin();
+    replaceRun(start, run.size(), merged);
+
+    _mergingRun = nullptr;
+    scheduleMerges();
+    _mergeDone.notify_all();
+}
+
+template <typename Visit, typename Bound>
+void DynamicDim2Tree::searchNearest(int32_t lat, int32_t lon, Visit &&visit, Bound &&bound) const {
+    // Liveness is a lookup in the slot table, so it's only checked for copies within the bound.
+    // The oldest trees are the largest, and searching them first tightens the bound soonest.
+    array<int32_t, 2> query = {lat, lon};
+
+    for (auto tree = _trees.rbegin(); tree != _trees.rend(); tree++) {
+        (*tree)->searchNearest(
+            query,
+            [&](size_t nodeIndex, Tree::Distance dist) {
+                const Entry &entry = (*tree)->payload(nodeIndex);
+                if (dist <= bound() && isLive(entry)) {
+                    visit(entry, dist);
+                }
+            },
+            bound
+        );
+    }
+
+    for (const BufferedPoint &point : _buffer) {
+        Tree::Distance dLat = static_cast<Tree::Distance>(static_cast<int64_t>(point.lat) - lat);
+        Tree::Distance dLon = static_cast<Tree::Distance>(static_cast<int64_t>(point.lon) - lon);
+        Tree::Distance dist = dLat * dLat + dLon * dLon;
+
+        if (dist <= bound() && isLive(point.entry)) {
+            visit(point.entry, dist);
+        }
+    }
+}
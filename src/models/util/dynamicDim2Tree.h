@@ -0,0 +1,178 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "models/util/kdTree.h"
+#include "models/util/threadPool.h"
+
+using std::condition_variable_any;
+using std::pair;
+using std::shared_mutex;
+using std::shared_ptr;
+using std::span;
+using std::vector;
+using utils::KdTree;
+using utils::ThreadPool;
+
+namespace utils {
+    /**
+    * Dim2Tree counterpart that takes inserts, moves and removals, for map updates and moving
+    * vehicles. Points are named by caller chosen ids, which index a dense table and so should be
+    * small integers (vertex or vehicle numbers); queries return ids.
+    *
+    * Points are stored in fixed point microdegrees and ranked by the same exact integer
+    * differences, squared in double, as in Dim2Tree. They are kept in a logarithmic forest: a
+    * small unsorted buffer of the newest points and a list of static trees whose sizes roughly
+    * double from newest to oldest. A full buffer becomes a new tree, and runs of similar sized
+    * trees are merged like a binary counter, so each point is rebuilt O(log n) times. Removing
+    * or moving a point leaves a tombstone: every stored copy carries the version of its id it was
+    * inserted with, and copies of older versions are skipped by queries and dropped by the next
+    * merge that reaches them.
+    *
+    * Queries and updates may run concurrently from any number of threads. Queries share a lock
+    * and updates take it exclusively: most only append to the buffer, and merges of up to
+    * INLINE_MERGE_SIZE points run inline under it. Larger merges run on the pool given to the
+    * constructor, one at a time and outside the lock; without a pool every merge runs inline.
+    */
+    class DynamicDim2Tree {
+        public:
+        DynamicDim2Tree(ThreadPool *pool = nullptr);
+
+        // Bulk load, with ids equal to input indices. Same range rules as Dim2Tree.
+        DynamicDim2Tree(span<const float> latitudes, span<const float> longitudes, ThreadPool *pool = nullptr);
+
+        // Waits for a running merge
+        ~DynamicDim2Tree();
+
+        DynamicDim2Tree(const DynamicDim2Tree &other) = delete;
+        DynamicDim2Tree &operator=(const DynamicDim2Tree &other) = delete;
+
+        // Insert a point, or move it if the id is already present
+        // Coordinates must be within MAX_FIXED_POINT_DEGREES, and ids below MAX_IDS
+        void insert(size_t id, float latitude, float longitude);
+
+        // Remove a point. Returns false if the id wasn't present.
+        bool remove(size_t id);
+
+        bool contains(size_t id) const;
+
+        // Find the id of the nearest point (Euclidean distance in degrees). Must not be empty.
+        // Query coordinates are clamped to MAX_FIXED_POINT_DEGREES, here and in the queries below.
+        size_t nearestPoint(float latitude, float longitude) const;
+
+        // Find the ids of the k nearest points, closest first (fewer if there are fewer points),
+        // appended to result
+        void kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const;
+
+        // Find the ids of all points within radius degrees (inclusive), appended to result in no
+        // particular order
+        void pointsWithinRadius(float latitude, float longitude, float radius, vector<size_t> &result) const;
+
+        // Find the ids of all points inside the bounding box (inclusive on all sides), appended to result
+        void pointsInBox(float minLatitude, float minLongitude,
+                         float maxLatitude, float maxLongitude,
+                         vector<size_t> &result) const;
+
+        // Location of a present id, decoded to degrees
+        pair<float, float> operator[](size_t id) const;
+
+        // Number of points present
+        size_t size() const;
+
+        // Number of static trees, not counting the buffer
+        size_t treeCount() const;
+
+        // Bytes held by the table, the buffer and the trees
+        size_t memoryBytes() const;
+
+        // Block until no merge is running
+        void waitForMerges();
+
+        static constexpr size_t MAX_IDS = std::numeric_limits<uint32_t>::max();
+
+        // Points buffered before they are built into a tree. The buffer is scanned by every query.
+        static constexpr size_t BUFFER_CAPACITY = 256;
+
+        // Merges of up to this many points run inline in the update that triggers them
+        static constexpr size_t INLINE_MERGE_SIZE = 1 << 12;
+
+        private:
+        // Stored copy of a point: its id and the version of the id it was inserted with
+        struct Entry {
+            uint32_t id;
+            uint32_t version;
+        };
+
+        using Tree = KdTree<2, int32_t, Entry>;
+
+        struct BufferedPoint {
+            int32_t lat;
+            int32_t lon;
+            Entry entry;
+        };
+
+        // Current state of an id. Copies of other versions are tombstoned.
+        struct Slot {
+            int32_t lat = 0;
+            int32_t lon = 0;
+            uint32_t version = 0;
+            bool present = false;
+        };
+
+        mutable shared_mutex _mutex;
+        condition_variable_any _mergeDone;
+
+        vector<Slot> _slots = vector<Slot>();
+        vector<BufferedPoint> _buffer = vector<BufferedPoint>();
+
+        // Newest first. Trees are immutable once built, so a merge can read them outside the lock.
+        vector<shared_ptr<const Tree>> _trees = vector<shared_ptr<const Tree>>();
+
+        size_t _size = 0;
+
+        // Points stored in the buffer and trees, including tombstoned copies
+        size_t _storedPoints = 0;
+
+        ThreadPool *_pool = nullptr;
+
+        // Newest tree of the run being merged on the pool, if any. Only trees in front of it are
+        // merged meanwhile.
+        const Tree *_mergingRun = nullptr;
+
+        bool isLive(const Entry &entry) const;
+
+        static shared_ptr<const Tree> buildTree(const vector<BufferedPoint> &points, ThreadPool *pool);
+
+        // Live copies in the given trees. With the lock held or shared.
+        vector<BufferedPoint> liveCopies(span<const shared_ptr<const Tree>> trees) const;
+
+        // Replace count trees from start with merged, or with nothing if it is empty. With the lock held.
+        void replaceRun(size_t start, size_t count, shared_ptr<const Tree> merged);
+
+        // Turn the buffer into a tree and merge as needed. With the lock held.
+        void flushBuffer();
+
+        // Run the merges that are due, inline or on the pool. With the lock held.
+        void scheduleMerges();
+
+        // Number of newest trees to merge into one, or 0 for none, among the newest trees that
+        // hold at most maxPoints together. All the trees are merged once tombstoned copies
+        // outnumber the points present.
+        size_t mergeCount(size_t maxPoints = std::numeric_limits<size_t>::max()) const;
+
+        // Merge a run of trees on a pool thread, then schedule any merges that became due
+        void mergeInBackground(const vector<shared_ptr<const Tree>> &run);
+
+        // Calls visit(entry, distanceSquared) for every live copy that could be within the
+        // (shrinking) squared distance bound(), in square microdegrees. With the lock held or shared.
+        template <typename Visit, typename Bound>
+        void searchNearest(int32_t lat, int32_t lon, Visit &&visit, Bound &&bound) const;
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace utils {
+    // Position of the cell (x, y) along a Hilbert curve over a 65536 x 65536 grid. Cells that are
+    // close on the curve are close on the grid, and unlike Morton order the curve never jumps, so
+    // runs of consecutive cells stay compact.
+    // https://en.wikipedia.org/wiki/Hilbert_curve#Applications_and_mapping_algorithms
+    inline uint32_t hilbertIndex(uint32_t x, uint32_t y) {
+        uint32_t index = 0;
+
+        for (uint32_t half = 1u << 15; half > 0; half >>= 1) {
+            uint32_t right = (x & half) > 0;
+            uint32_t up = (y & half) > 0;
+            index += half * half * ((3 * right) ^ up);
+
+            // Rotate the quadrant, so the curve inside it starts where the previous one ended
+            if (up == 0) {
+                if (right == 1) {
+                    x = 0xFFFF - x;
+                    y = 0xFFFF - y;
+                }
+                std::swap(x, y);
+            }
+        }
+
+        return index;
+    }
+
+    // Hilbert index of a location, on a grid with its lower corner at (minLat, minLon) and latScale
+    // and lonScale cells per degree. Locations outside the grid are clamped to its edge.
+    inline uint32_t hilbertIndex(float latitude, float longitude, float minLat, float minLon, float latScale, float lonScale) {
+        float lat = std::clamp((latitude - minLat) * latScale, 0.0f, 65535.0f);
+        float lon = std::clamp((longitude - minLon) * lonScale, 0.0f, 65535.0f);
+
+        return hilbertIndex(static_cast<uint32_t>(lon), static_cast<uint32_t>(lat));
+    }
+}
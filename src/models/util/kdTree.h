@@ -0,0 +1,631 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "models/util/listWithSize.h"
+#include "models/util/threadPool.h"
+
+using std::array;
+using std::invalid_argument;
+using std::istream;
+using std::ostream;
+using std::out_of_range;
+using std::pair;
+using std::span;
+using std::vector;
+using utils::ListWithSize;
+using utils::ThreadPool;
+
+namespace utils {
+    // Number of nodes in the left subtree of nodeIndex, in a balanced tree of numNodes nodes stored
+    // in heap order (children of i at 2i + 1 and 2i + 2, every level full except the last, which
+    // fills from the left)
+    inline size_t leftSubtreeSize(size_t nodeIndex, size_t numNodes) {
+        // Find the height of the largest complete binary tree that fits
+        size_t totalCapacity = 0;
+        size_t layerCapacity = 1;
+
+        for (size_t i = nodeIndex * 2 + 1; i < numNodes; i = i * 2 + 1) {
+            layerCapacity = std::min(layerCapacity, numNodes - i);
+            totalCapacity += layerCapacity;
+
+            layerCapacity *= 2;
+        }
+
+        return totalCapacity;
+    }
+
+    // Build a balanced KD-Tree in heap order over points given as one column per axis (spans or
+    // vectors of any comparable type), all of the same length. Nodes at depth d split on axis
+    // d % columns.size(). Calls place(nodeIndex,
+    // inputIndex) once per point, with the median of each range at the range's node; points equal
+    // to a median may end up on either side of it.
+    //
+    // With a pool, the top levels split their ranges in parallel and the subtrees below are built
+    // as parallel tasks. Ranges never overlap, so place is never called twice for one node, but it
+    // is called from several threads at once.
+    template <typename Columns, typename Place>
+    void buildKdHeap(const Columns &columns, ThreadPool *pool, Place &&place) {
+        // A subtree still to be built: inputs [start, end) of the permutation under nodeIndex
+        struct BuildRange {
+            size_t start;
+            size_t end;
+            size_t depth;
+            size_t nodeIndex;
+        };
+
+        size_t numPoints = columns.empty() ? 0 : columns[0].size();
+        if (numPoints == 0) {
+            return;
+        }
+
+        vector<size_t> indices(numPoints);
+        for (size_t i = 0; i < numPoints; i++) {
+            indices[i] = i;
+        }
+
+        // Select the median of the range along its axis in O(n), place it and return the ranges of
+        // its two children (empty if start == end)
+        auto placeMedian = [&](const BuildRange &range) -> pair<BuildRange, BuildRange> {
+            const auto &axis = columns[range.depth % columns.size()];
+
+            size_t medianIdx = range.start + leftSubtreeSize(range.nodeIndex, numPoints);
+            std::nth_element(indices.begin() + range.start, indices.begin() + medianIdx, indices.begin() + range.end,
+                             [&axis](size_t a, size_t b) { return axis[a] < axis[b]; });
+
+            place(range.nodeIndex, indices[medianIdx]);
+
+            return {
+                {range.start, medianIdx, range.depth + 1, 2 * range.nodeIndex + 1},
+                {medianIdx + 1, range.end, range.depth + 1, 2 * range.nodeIndex + 2}
+            };
+        };
+
+        // Build a whole subtree on the calling thread
+        auto buildSubtree = [&](const BuildRange &range) {
+            vector<BuildRange> pending = {range};
+
+            while (!pending.empty()) {
+                BuildRange current = pending.back();
+                pending.pop_back();
+
+                auto [left, right] = placeMedian(current);
+
+                if (right.start < right.end) pending.push_back(right);
+                if (left.start < left.end) pending.push_back(left);
+            }
+        };
+
+        // Split the top levels one level at a time, with the ranges of each level in parallel,
+        // until there are a few subtrees per thread
+        size_t numTasks = (pool == nullptr) ? 1 : 4 * pool->size();
+        vector<BuildRange> level = {{0, numPoints, 0, 0}};
+
+        while (pool != nullptr && level.size() < numTasks) {
+            vector<pair<BuildRange, BuildRange>> children(level.size());
+            pool->parallelFor(level.size(), [&](size_t, size_t i) {
+                children[i] = placeMedian(level[i]);
+            });
+
+            vector<BuildRange> nextLevel;
+            for (const auto &[left, right] : children) {
+                if (left.start < left.end) nextLevel.push_back(left);
+                if (right.start < right.end) nextLevel.push_back(right);
+            }
+
+            if (nextLevel.empty()) {
+                return;
+            }
+
+            level = std::move(nextLevel);
+        }
+
+        if (pool == nullptr) {
+            buildSubtree(level[0]);
+            return;
+        }
+
+        pool->parallelFor(level.size(), [&](size_t, size_t i) {
+            buildSubtree(level[i]);
+        });
+    }
+
+    // Node order of a tree stored in heap order: every node's slot is its heap index
+    struct HeapLayout {
+        size_t operator()(size_t heapIndex, size_t, const size_t *) const {
+            return heapIndex;
+        }
+    };
+
+    /**
+    * Searches over the nodes of a balanced tree built by buildKdHeap, for the trees that own them
+    * (KdTree, Dim2Tree). Each node has Dims coordinates, and nodes at depth d split on axis d % Dims.
+    *
+    * The searches walk heap indices and read each node from the slot layout(heapIndex, depth,
+    * pathSlots) of coordinates, where pathSlots holds the slots of the node's ancestors by depth.
+    * HeapLayout keeps every node at its heap index; other layouts reorder nodes for the cache.
+    * Indices returned by the queries are slots.
+    *
+    * Distances are computed in Distance: float for float coordinates, double otherwise. Integer
+    * coordinates are differenced exactly, and a double holds the squared distance between any
+    * two int32_t points to within a part in 2^53, where a float would round off whole units.
+    */
+    template <size_t Dims, typename Scalar, typename Layout = HeapLayout>
+    class KdSearch {
+        public:
+        using Point = array<Scalar, Dims>;
+        using Distance = std::conditional_t<std::is_same_v<Scalar, float>, float, double>;
+
+        KdSearch(const Scalar *coordinates, size_t numPoints, Layout layout = Layout());
+
+        // Nearest point to the query. There must be at least one point.
+        size_t nearestPoint(const Point &query) const;
+
+        // The k nearest points, closest first (fewer if there are fewer points), appended to result
+        void kNearest(const Point &query, size_t k, vector<size_t> &result) const;
+
+        // All points within radius of the query (inclusive), appended to result in no particular order
+        void pointsWithinRadius(const Point &query, Distance radius, vector<size_t> &result) const;
+
+        // All points inside the box from low to high (inclusive on all sides), appended to result
+        void pointsInBox(const Point &low, const Point &high, vector<size_t> &result) const;
+
+        // Visits every point that could be within the (shrinking) squared distance bound() and
+        // calls visit(slot, distanceSquared) for it. The queries above are built on this.
+        template <typename Visit, typename Bound>
+        void searchNearest(const Point &query, Visit &&visit, Bound &&bound) const;
+
+        // Signed difference a - b along one axis
+        static Distance difference(Scalar a, Scalar b);
+
+        // Squared distance from the query to the node at slot, unrolled over the axes
+        Distance distanceSquared(const Point &query, size_t slot) const;
+
+        // Axis split by the nodes one level below those splitting on axis
+        static constexpr size_t nextAxis(size_t axis) {
+            return (axis + 1 == Dims) ? 0 : axis + 1;
+        }
+
+        private:
+        const Scalar *_coordinates = nullptr;
+        size_t _numPoints = 0;
+        Layout _layout = Layout();
+
+        // Subtree deferred by the searches, by heap index. Depths on the stack strictly increase
+        // from bottom to top, and the tree is balanced, so it never holds more than 64 entries.
+        struct PendingSubtree {
+            size_t nodeIndex;
+            size_t slot;
+            size_t depth;
+            // Squared distance from the query to the splitting plane that separates this subtree
+            Distance planeDistance;
+        };
+
+        static constexpr size_t MAX_PENDING_SUBTREES = 64;
+    };
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    KdSearch<Dims, Scalar, Layout>::KdSearch(const Scalar *coordinates, size_t numPoints, Layout layout)
+        : _coordinates(coordinates), _numPoints(numPoints), _layout(layout) {}
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    size_t KdSearch<Dims, Scalar, Layout>::nearestPoint(const Point &query) const {
+        Distance bestDist = std::numeric_limits<Distance>::infinity();
+        size_t bestIndex = 0;
+
+        searchNearest(
+            query,
+            [&](size_t slot, Distance dist) {
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    bestIndex = slot;
+                }
+            },
+            [&]() { return bestDist; }
+        );
+
+        return bestIndex;
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    void KdSearch<Dims, Scalar, Layout>::kNearest(const Point &query, size_t k, vector<size_t> &result) const {
+        if (k == 0) {
+            return;
+        }
+
+        // Max-heap on distance in the tail of result, so the worst of the k best is always on top
+        size_t first = result.size();
+        auto fartherThan = [&](size_t a, size_t b) {
+            return distanceSquared(query, a) < distanceSquared(query, b);
+        };
+
+        Distance worstDist = std::numeric_limits<Distance>::infinity();
+
+        searchNearest(
+            query,
+            [&](size_t slot, Distance dist) {
+                if (result.size() - first == k) {
+                    if (dist >= worstDist) {
+                        return;
+                    }
+
+                    std::pop_heap(result.begin() + first, result.end(), fartherThan);
+                    result.back() = slot;
+                } else {
+                    result.push_back(slot);
+                }
+
+                std::push_heap(result.begin() + first, result.end(), fartherThan);
+
+                if (result.size() - first == k) {
+                    worstDist = distanceSquared(query, result[first]);
+                }
+            },
+            [&]() { return worstDist; }
+        );
+
+        std::sort_heap(result.begin() + first, result.end(), fartherThan);
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    void KdSearch<Dims, Scalar, Layout>::pointsWithinRadius(const Point &query, Distance radius, vector<size_t> &result) const {
+        Distance radiusSquared = radius * radius;
+
+        searchNearest(
+            query,
+            [&](size_t slot, Distance dist) {
+                if (dist <= radiusSquared) {
+                    result.push_back(slot);
+                }
+            },
+            [&]() { return radiusSquared; }
+        );
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    void KdSearch<Dims, Scalar, Layout>::pointsInBox(const Point &low, const Point &high, vector<size_t> &result) const {
+        array<PendingSubtree, MAX_PENDING_SUBTREES> pending;
+        array<size_t, MAX_PENDING_SUBTREES> slots;
+        size_t numPending = 0;
+
+        if (_numPoints > 0) {
+            pending[numPending++] = {0, _layout(0, 0, slots.data()), 0, Distance(0)};
+        }
+
+        while (numPending > 0) {
+            PendingSubtree subtree = pending[--numPending];
+            size_t nodeIndex = subtree.nodeIndex;
+            size_t depth = subtree.depth;
+            size_t axis = depth % Dims;
+            slots[depth] = subtree.slot;
+
+            // Walk down one path, deferring the right child whenever the box straddles the split
+            while (nodeIndex < _numPoints) {
+                size_t slot = slots[depth];
+                const Scalar *node = _coordinates + slot * Dims;
+
+                bool inside = true;
+                for (size_t i = 0; i < Dims; i++) {
+                    inside = inside && node[i] >= low[i] && node[i] <= high[i];
+                }
+                if (inside) {
+                    result.push_back(slot);
+                }
+
+                // Points equal to the split value can land on either side, so both checks are inclusive
+                bool searchLeft = low[axis] <= node[axis];
+                bool searchRight = high[axis] >= node[axis];
+                axis = nextAxis(axis);
+
+                if (searchLeft && searchRight && 2 * nodeIndex + 2 < _numPoints) {
+                    size_t rightSlot = _layout(2 * nodeIndex + 2, depth + 1, slots.data());
+                    pending[numPending++] = {2 * nodeIndex + 2, rightSlot, depth + 1, Distance(0)};
+                }
+
+                if (searchLeft) {
+                    nodeIndex = 2 * nodeIndex + 1;
+                } else if (searchRight) {
+                    nodeIndex = 2 * nodeIndex + 2;
+                } else {
+                    break;
+                }
+
+                depth++;
+                slots[depth] = _layout(nodeIndex, depth, slots.data());
+            }
+        }
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    template <typename Visit, typename Bound>
+    void KdSearch<Dims, Scalar, Layout>::searchNearest(const Point &query, Visit &&visit, Bound &&bound) const {
+        array<PendingSubtree, MAX_PENDING_SUBTREES> pending;
+        array<size_t, MAX_PENDING_SUBTREES> slots;
+        size_t numPending = 0;
+
+        if (_numPoints > 0) {
+            pending[numPending++] = {0, _layout(0, 0, slots.data()), 0, Distance(0)};
+        }
+
+        while (numPending > 0) {
+            PendingSubtree subtree = pending[--numPending];
+
+            // The bound may have shrunk since this subtree was deferred
+            if (subtree.planeDistance > bound()) {
+                continue;
+            }
+
+            size_t nodeIndex = subtree.nodeIndex;
+            size_t slot = subtree.slot;
+            size_t depth = subtree.depth;
+            size_t axis = depth % Dims;
+
+            // Descend towards the query, deferring the far side of every split. Everything explored
+            // before a deferred subtree is popped lies below its parent, so the slots of its
+            // ancestors are still on record.
+            while (nodeIndex < _numPoints) {
+                slots[depth] = slot;
+
+                // Both children's slots only depend on the path, so work them out while the node loads
+                size_t leftSlot = _layout(2 * nodeIndex + 1, depth + 1, slots.data());
+                size_t rightSlot = _layout(2 * nodeIndex + 2, depth + 1, slots.data());
+
+                visit(slot, distanceSquared(query, slot));
+
+                Distance planeDist = difference(query[axis], _coordinates[slot * Dims + axis]);
+                size_t nearChild = planeDist < 0 ? 2 * nodeIndex + 1 : 2 * nodeIndex + 2;
+                size_t farChild = planeDist < 0 ? 2 * nodeIndex + 2 : 2 * nodeIndex + 1;
+                size_t nearSlot = planeDist < 0 ? leftSlot : rightSlot;
+                size_t farSlot = planeDist < 0 ? rightSlot : leftSlot;
+                axis = nextAxis(axis);
+                depth++;
+
+                if (farChild < _numPoints && planeDist * planeDist <= bound()) {
+                    pending[numPending++] = {farChild, farSlot, depth, planeDist * planeDist};
+                }
+
+                nodeIndex = nearChild;
+                slot = nearSlot;
+            }
+        }
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    typename KdSearch<Dims, Scalar, Layout>::Distance KdSearch<Dims, Scalar, Layout>::difference(Scalar a, Scalar b) {
+        if constexpr (std::is_integral_v<Scalar>) {
+            return static_cast<Distance>(static_cast<int64_t>(a) - static_cast<int64_t>(b));
+        } else {
+            return static_cast<Distance>(a - b);
+        }
+    }
+
+    template <size_t Dims, typename Scalar, typename Layout>
+    typename KdSearch<Dims, Scalar, Layout>::Distance KdSearch<Dims, Scalar, Layout>::distanceSquared(const Point &query, size_t slot) const {
+        const Scalar *node = _coordinates + slot * Dims;
+
+        return [&]<size_t... Axes>(std::index_sequence<Axes...>) {
+            return ((difference(query[Axes], node[Axes]) * difference(query[Axes], node[Axes])) + ...);
+        }(std::make_index_sequence<Dims>());
+    }
+
+    /**
+    * KD-Tree over points with Dims coordinates of type Scalar and Euclidean distance, in heap
+    * order, with a Payload stored next to each point. For indexes that don't need Dim2Tree's
+    * fixed point degrees, layouts or batched queries: unit vectors on the sphere (see
+    * geo::SphereIndex), points of interest, GPS candidates.
+    *
+    * Indices returned by queries are positions in the tree; payload() gives what was stored
+    * with each. Without explicit payloads, an integral Payload holds each point's input index,
+    * so uint32_t (the default) costs half of a size_t per point.
+    *
+    * Queries run on KdSearch, so distances are computed in its Distance type.
+    */
+    template <size_t Dims, typename Scalar = float, typename Payload = uint32_t>
+    class KdTree {
+        public:
+        using Point = array<Scalar, Dims>;
+        using Distance = typename KdSearch<Dims, Scalar>::Distance;
+
+        static_assert(Dims >= 1, "A KdTree needs at least one dimension");
+
+        KdTree() = default;
+
+        // Payloads are the input indices, which must fit in Payload
+        KdTree(span<const Point> points, ThreadPool *pool = nullptr) requires std::is_integral_v<Payload>;
+
+        // One payload per point
+        KdTree(span<const Point> points, span<const Payload> payloads, ThreadPool *pool = nullptr);
+
+        // Nearest point to the query. The tree must not be empty.
+        size_t nearestPoint(const Point &query) const;
+
+        // The k nearest points, closest first (fewer if the tree is smaller), appended to result
+        void kNearest(const Point &query, size_t k, vector<size_t> &result) const;
+
+        // All points within radius of the query (inclusive), appended to result in no particular order
+        void pointsWithinRadius(const Point &query, Distance radius, vector<size_t> &result) const;
+
+        // All points inside the box from low to high (inclusive on all sides), appended to result
+        void pointsInBox(const Point &low, const Point &high, vector<size_t> &result) const;
+
+        // Visits every point that could be within the (shrinking) squared distance bound() and
+        // calls visit(nodeIndex, distanceSquared) for it. The queries above are built on this;
+        // indexes made of several trees call it directly to share one bound across them.
+        template <typename Visit, typename Bound>
+        void searchNearest(const Point &query, Visit &&visit, Bound &&bound) const;
+
+        const Payload &payload(size_t index) const;
+        Point operator[](size_t index) const;
+
+        size_t size() const;
+
+        // Bytes held by the tree's arrays
+        size_t memoryBytes() const;
+
+        // Axis split by the nodes one level below those splitting on axis
+        static constexpr size_t nextAxis(size_t axis) {
+            return KdSearch<Dims, Scalar>::nextAxis(axis);
+        }
+
+        template <size_t D, typename S, typename P>
+        friend istream &operator>>(istream &input, KdTree<D, S, P> &tree);
+
+        template <size_t D, typename S, typename P>
+        friend ostream &operator<<(ostream &output, const KdTree<D, S, P> &tree);
+
+        private:
+        // Dims coordinates per node, in heap order
+        ListWithSize<Scalar> _coordinates = ListWithSize<Scalar>(0);
+
+        // Payload of each node, in heap order
+        ListWithSize<Payload> _payloads = ListWithSize<Payload>(0);
+
+        // Fill _coordinates in heap order, calling place(nodeIndex, inputIndex) for each point
+        template <typename Place>
+        void build(span<const Point> points, ThreadPool *pool, Place &&place);
+
+        KdSearch<Dims, Scalar> search() const;
+    };
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    KdTree<Dims, Scalar, Payload>::KdTree(span<const Point> points, ThreadPool *pool)
+        requires std::is_integral_v<Payload> {
+        if (points.size() > 0 && points.size() - 1 > static_cast<size_t>(std::numeric_limits<Payload>::max())) {
+            throw invalid_argument(format("KdTree of {} points can't number them in its payload type", points.size()));
+        }
+
+        _payloads = ListWithSize<Payload>(points.size());
+        Payload *payloads = _payloads.data();
+
+        build(points, pool, [payloads](size_t nodeIndex, size_t inputIndex) {
+            payloads[nodeIndex] = static_cast<Payload>(inputIndex);
+        });
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    KdTree<Dims, Scalar, Payload>::KdTree(span<const Point> points, span<const Payload> payloads, ThreadPool *pool) {
+        if (points.size() != payloads.size()) {
+            throw invalid_argument("KdTree points and payloads must have the same length");
+        }
+
+        _payloads = ListWithSize<Payload>(points.size());
+        Payload *nodePayloads = _payloads.data();
+
+        build(points, pool, [nodePayloads, payloads](size_t nodeIndex, size_t inputIndex) {
+            nodePayloads[nodeIndex] = payloads[inputIndex];
+        });
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    template <typename Place>
+    void KdTree<Dims, Scalar, Payload>::build(span<const Point> points, ThreadPool *pool, Place &&place) {
+        _coordinates = ListWithSize<Scalar>(points.size() * Dims);
+
+        // The builder takes one column per axis
+        array<vector<Scalar>, Dims> columns;
+        for (size_t axis = 0; axis < Dims; axis++) {
+            columns[axis] = vector<Scalar>(points.size());
+            for (size_t i = 0; i < points.size(); i++) {
+                columns[axis][i] = points[i][axis];
+            }
+        }
+
+        Scalar *coordinates = _coordinates.data();
+
+        buildKdHeap(columns, pool, [&](size_t nodeIndex, size_t inputIndex) {
+            std::copy(points[inputIndex].begin(), points[inputIndex].end(), coordinates + nodeIndex * Dims);
+            place(nodeIndex, inputIndex);
+        });
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    size_t KdTree<Dims, Scalar, Payload>::nearestPoint(const Point &query) const {
+        if (size() == 0) {
+            throw out_of_range("Nearest point query on an empty KdTree");
+        }
+
+        return search().nearestPoint(query);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    void KdTree<Dims, Scalar, Payload>::kNearest(const Point &query, size_t k, vector<size_t> &result) const {
+        search().kNearest(query, k, result);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    void KdTree<Dims, Scalar, Payload>::pointsWithinRadius(const Point &query, Distance radius, vector<size_t> &result) const {
+        search().pointsWithinRadius(query, radius, result);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    void KdTree<Dims, Scalar, Payload>::pointsInBox(const Point &low, const Point &high, vector<size_t> &result) const {
+        search().pointsInBox(low, high, result);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    const Payload &KdTree<Dims, Scalar, Payload>::payload(size_t index) const {
+        return _payloads[index];
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    typename KdTree<Dims, Scalar, Payload>::Point KdTree<Dims, Scalar, Payload>::operator[](size_t index) const {
+        if (index >= size()) {
+            throw out_of_range(format("Attempt to access element {} in KdTree of size {}", index, size()));
+        }
+
+        Point point = Point();
+        std::copy(_coordinates.data() + index * Dims, _coordinates.data() + (index + 1) * Dims, point.begin());
+        return point;
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    size_t KdTree<Dims, Scalar, Payload>::size() const {
+        return _payloads.size();
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    size_t KdTree<Dims, Scalar, Payload>::memoryBytes() const {
+        return _coordinates.size() * sizeof(Scalar) + _payloads.size() * sizeof(Payload);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    template <typename Visit, typename Bound>
+    void KdTree<Dims, Scalar, Payload>::searchNearest(const Point &query, Visit &&visit, Bound &&bound) const {
+        search().searchNearest(query, visit, bound);
+    }
+
+    template <size_t Dims, typename Scalar, typename Payload>
+    KdSearch<Dims, Scalar> KdTree<Dims, Scalar, Payload>::search() const {
+        // Node indices are always in range, so the searches skip ListWithSize's bounds checks
+        return KdSearch<Dims, Scalar>(_coordinates.data(), size());
+    }
+
+    template <size_t D, typename S, typename P>
+    istream &operator>>(istream &input, KdTree<D, S, P> &tree) {
+        static_assert(std::is_trivially_copyable_v<P>, "Only trivially copyable payloads can be read back");
+
+        input >> tree._coordinates;
+        input >> tree._payloads;
+
+        return input;
+    }
+
+    template <size_t D, typename S, typename P>
+    ostream &operator<<(ostream &output, const KdTree<D, S, P> &tree) {
+        static_assert(std::is_trivially_copyable_v<P>, "Only trivially copyable payloads can be written out");
+
+        output << tree._coordinates;
+        output << tree._payloads;
+
+        return output;
+    }
+}
@@ -34,7 +34,9 @@ namespace utils {
         ListWithSize &operator=(const ListWithSize &other);
         ~ListWithSize();
 
-        T &operator[](size_t index) const;
+        // Const access returns const references, so a const list can be shared between threads
+        T &operator[](size_t index);
+        const T &operator[](size_t index) const;
         
         template<typename I>
         friend istream &operator>>(istream &input, ListWithSize<I> &list);
@@ -43,7 +45,8 @@ namespace utils {
         friend ostream &operator<<(ostream &output, const ListWithSize<O> &list);
 
         size_t size() const;
-        T* data() const;
+        T* data();
+        const T* data() const;
 
         private:
         size_t _num_items;
@@ -102,7 +105,16 @@ namespace utils {
     }
 
     template<typename T>
-    T &ListWithSize<T>::operator[](size_t index) const {
+    T &ListWithSize<T>::operator[](size_t index) {
+        if (index >= _num_items) {
+            throw out_of_range(format("Attempt to access element {} in ListWithSize of size {}", index, _num_items));
+        }
+
+        return _items[index];
+    }
+
+    template<typename T>
+    const T &ListWithSize<T>::operator[](size_t index) const {
         if (index >= _num_items) {
             throw out_of_range(format("Attempt to access element {} in ListWithSize of size {}", index, _num_items));
         }
@@ -116,7 +128,12 @@ namespace utils {
     }
 
     template<typename T>
-    T* ListWithSize<T>::data() const {
+    T* ListWithSize<T>::data() {
+        return _items;
+    }
+
+    template<typename T>
+    const T* ListWithSize<T>::data() const {
         return _items;
     }
 
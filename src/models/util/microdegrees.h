@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+using std::invalid_argument;
+
+namespace utils {
+    // Fixed point coordinates in millionths of a degree. One step is about 0.11 m of latitude
+    // anywhere on the globe, where a float degree value is only good to about 1 m at longitudes
+    // past 90 degrees.
+    constexpr double MICRODEGREES_PER_DEGREE = 1e6;
+
+    // Largest magnitude that can be stored. The difference of two stored values (or of a stored
+    // value and a clamped query) always fits in an int32_t.
+    constexpr double MAX_FIXED_POINT_DEGREES = 1000.0;
+
+    // Nearest microdegree to a coordinate. Throws for values beyond MAX_FIXED_POINT_DEGREES (and NaN).
+    inline int32_t toMicrodegrees(double degrees) {
+        if (!(std::abs(degrees) <= MAX_FIXED_POINT_DEGREES)) {
+            throw invalid_argument("Coordinate out of range for fixed point storage");
+        }
+
+        // Round half away from zero, like std::lround but without the library call. The fraction
+        // is exact, since the scaled value is well below 2^52.
+        double scaled = degrees * MICRODEGREES_PER_DEGREE;
+        int64_t whole = static_cast<int64_t>(scaled);
+        double fraction = scaled - whole;
+
+        return static_cast<int32_t>(whole + (fraction >= 0.5) - (fraction <= -0.5));
+    }
+
+    // Same, clamped to the storable range instead, for query locations
+    inline int32_t clampToMicrodegrees(double degrees) {
+        return toMicrodegrees(std::clamp(degrees, -MAX_FIXED_POINT_DEGREES, MAX_FIXED_POINT_DEGREES));
+    }
+
+    inline double microdegreesToDegrees(int32_t microdegrees) {
+        return microdegrees / MICRODEGREES_PER_DEGREE;
+    }
+}
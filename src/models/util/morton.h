@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace utils {
+    // Spread the low 16 bits of value to the even bit positions
+    inline uint32_t spreadBits(uint32_t value) {
+        value &= 0xFFFF;
+        value = (value | (value << 8)) & 0x00FF00FF;
+        value = (value | (value << 4)) & 0x0F0F0F0F;
+        value = (value | (value << 2)) & 0x33333333;
+        value = (value | (value << 1)) & 0x55555555;
+        return value;
+    }
+
+    // Position of the cell (row, column) along a Morton (Z-order) curve, with the bits of row and
+    // column interleaved and row's above column's. Cheaper than hilbertIndex, but the curve jumps
+    // at the edge of every power of 2 block.
+    inline uint64_t mortonIndex(uint32_t row, uint32_t column) {
+        uint64_t low = (spreadBits(row) << 1) | spreadBits(column);
+        uint64_t high = (spreadBits(row >> 16) << 1) | spreadBits(column >> 16);
+        return (high << 32) | low;
+    }
+
+    // Morton index of a location at 16 bits per axis, on a grid with its lower corner at
+    // (minLat, minLon) and latScale and lonScale cells per degree. Locations outside the grid are
+    // clamped to its edge.
+    inline uint32_t mortonIndex(float latitude, float longitude, float minLat, float minLon, float latScale, float lonScale) {
+        float lat = std::clamp((latitude - minLat) * latScale, 0.0f, 65535.0f);
+        float lon = std::clamp((longitude - minLon) * lonScale, 0.0f, 65535.0f);
+
+        return static_cast<uint32_t>(mortonIndex(static_cast<uint32_t>(lat), static_cast<uint32_t>(lon)));
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using std::unique_ptr;
+using std::vector;
+
+namespace utils {
+    // Chunked arena that hands out stable 32-bit handles instead of pointers.
+    // Objects are never moved, so handles stay valid until clear() is called.
+    // clear() keeps the chunks around, so a pool can back many short-lived searches
+    // without going back to the system allocator.
+    template <typename T>
+    class ObjectPool {
+        public:
+        // Each chunk holds 2^chunkBits objects
+        ObjectPool(uint32_t chunkBits = 12);
+
+        // Returns the handle of a default-constructed object
+        uint32_t allocate();
+
+        T &operator[](uint32_t handle);
+        const T &operator[](uint32_t handle) const;
+
+        // Invalidate every handle. Memory is retained for reuse.
+        void clear();
+
+        // Number of objects handed out since the last clear()
+        size_t size() const;
+
+        // Number of objects that fit without allocating another chunk
+        size_t capacity() const;
+
+        private:
+        uint32_t _chunkBits;
+        uint32_t _chunkMask;
+        uint32_t _size = 0;
+
+        vector<unique_ptr<T[]>> _chunks = vector<unique_ptr<T[]>>();
+    };
+
+    template<typename T>
+    ObjectPool<T>::ObjectPool(uint32_t chunkBits) {
+        _chunkBits = chunkBits;
+        _chunkMask = (1u << chunkBits) - 1;
+    }
+
+    template<typename T>
+    uint32_t ObjectPool<T>::allocate() {
+        uint32_t chunk = _size >> _chunkBits;
+
+        if (chunk == _chunks.size()) {
+            _chunks.emplace_back(new T[1u << _chunkBits]);
+        }
+
+        uint32_t handle = _size++;
+        (*this)[handle] = T();
+
+        return handle;
+    }
+
+    template<typename T>
+    T &ObjectPool<T>::operator[](uint32_t handle) {
+        return _chunks[handle >> _chunkBits][handle & _chunkMask];
+    }
+
+    template<typename T>
+    const T &ObjectPool<T>::operator[](uint32_t handle) const {
+        return _chunks[handle >> _chunkBits][handle & _chunkMask];
+    }
+
+    template<typename T>
+    void ObjectPool<T>::clear() {
+        _size = 0;
+    }
+
+    template<typename T>
+    size_t ObjectPool<T>::size() const {
+        return _size;
+    }
+
+    template<typename T>
+    size_t ObjectPool<T>::capacity() const {
+        return _chunks.size() << _chunkBits;
+    }
+}
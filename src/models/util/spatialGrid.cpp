@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "spatialGrid.h"
+#include "models/util/morton.h"
+
+using std::invalid_argument;
+using std::istream;
+using std::ostream;
+using std::out_of_range;
+using utils::GridBlock;
+using utils::mortonIndex;
+using utils::SpatialGrid;
+
+namespace {
+    // Cell assignment rounds, so searches allow for points this fraction of a cell outside their own
+    constexpr float CELL_TOLERANCE = 1e-3f;
+
+    // Cells of a block in Morton order, as row * columns + column
+    vector<uint32_t> mortonOrder(uint32_t rows, uint32_t columns) {
+        vector<pair<uint64_t, uint32_t>> keyed;
+        keyed.reserve(static_cast<size_t>(rows) * columns);
+
+        for (uint32_t row = 0; row < rows; row++) {
+            for (uint32_t column = 0; column < columns; column++) {
+                keyed.push_back({mortonIndex(row, column), row * columns + column});
+            }
+        }
+        std::sort(keyed.begin(), keyed.end());
+
+        vector<uint32_t> order(keyed.size());
+        for (size_t i = 0; i < keyed.size(); i++) {
+            order[i] = keyed[i].second;
+        }
+
+        return order;
+    }
+
+    // Cell row and column of a location, clamped to the block. Both are monotonic in the coordinate.
+    uint32_t rowIn(const GridBlock &block, float latitude) {
+        float row = std::clamp((latitude - block.minLatitude) / block.cellSize, 0.0f, static_cast<float>(block.rows - 1));
+        return static_cast<uint32_t>(row);
+    }
+
+    uint32_t columnIn(const GridBlock &block, float longitude) {
+        float column = std::clamp((longitude - block.minLongitude) / block.cellSize, 0.0f, static_cast<float>(block.columns - 1));
+        return static_cast<uint32_t>(column);
+    }
+
+    // Squared distance from a location to the block's rectangle, less the rounding tolerance
+    float distanceToBlock(const GridBlock &block, float latitude, float longitude) {
+        float slack = CELL_TOLERANCE * block.cellSize;
+        float maxLatitude = block.minLatitude + block.rows * block.cellSize;
+        float maxLongitude = block.minLongitude + block.columns * block.cellSize;
+
+        float dLat = std::max({block.minLatitude - latitude, latitude - maxLatitude, 0.0f});
+        float dLon = std::max({block.minLongitude - longitude, longitude - maxLongitude, 0.0f});
+        dLat = std::max(dLat - slack, 0.0f);
+        dLon = std::max(dLon - slack, 0.0f);
+
+        return dLat * dLat + dLon * dLon;
+    }
+}
+
+SpatialGrid::SpatialGrid(span<const float> latitudes, span<const float> longitudes, size_t pointsPerCell) {
+    if (latitudes.size() != longitudes.size()) {
+        throw invalid_argument("SpatialGrid latitude and longitude arrays must have the same length");
+    }
+
+    if (latitudes.size() > std::numeric_limits<uint32_t>::max() / 2) {
+        throw invalid_argument("SpatialGrid is limited to 2^31 points");
+    }
+
+    if (pointsPerCell == 0) {
+        throw invalid_argument("SpatialGrid needs at least one point per cell");
+    }
+
+    size_t numPoints = latitudes.size();
+    if (numPoints == 0) {
+        return;
+    }
+
+    auto [minLat, maxLat] = std::minmax_element(latitudes.begin(), latitudes.end());
+    auto [minLon, maxLon] = std::minmax_element(longitudes.begin(), longitudes.end());
+    double latSpan = *maxLat - *minLat;
+    double lonSpan = *maxLon - *minLon;
+
+    // Coarse cells for an even spread over the bounding box, or along a line when the box is flat
+    double coarseSize = std::max({
+        std::sqrt(latSpan * lonSpan * POINTS_PER_BLOCK / numPoints),
+        std::max(latSpan, lonSpan) * POINTS_PER_BLOCK / numPoints,
+        1e-6
+    });
+
+    _coarse = {
+        *minLat, *minLon, static_cast<float>(coarseSize),
+        static_cast<uint32_t>(latSpan / coarseSize + 1), static_cast<uint32_t>(lonSpan / coarseSize + 1), 0
+    };
+
+    size_t numBlocks = static_cast<size_t>(_coarse.rows) * _coarse.columns;
+    vector<uint32_t> blockCounts(numBlocks, 0);
+    for (size_t i = 0; i < numPoints; i++) {
+        blockCounts[rowIn(_coarse, latitudes[i]) * _coarse.columns + columnIn(_coarse, longitudes[i])]++;
+    }
+
+    // Split the crowded coarse cells, numbering fine cells block by block in Morton order
+    vector<uint32_t> blockOrder = mortonOrder(_coarse.rows, _coarse.columns);
+    vector<GridBlock> blocks(numBlocks);
+    uint32_t numCells = 0;
+
+    for (uint32_t block : blockOrder) {
+        uint32_t row = block / _coarse.columns;
+        uint32_t column = block % _coarse.columns;
+        uint32_t splits = 1;
+
+        if (blockCounts[block] > 2 * pointsPerCell) {
+            splits = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(blockCounts[block]) / pointsPerCell)));
+        }
+
+        blocks[block] = {
+            _coarse.minLatitude + row * _coarse.cellSize,
+            _coarse.minLongitude + column * _coarse.cellSize,
+            _coarse.cellSize / splits,
+            splits, splits, numCells
+        };
+        numCells += splits * splits;
+    }
+    _blocks = ListWithSize<GridBlock>(blocks);
+
+    vector<uint32_t> cells(numPoints);
+    vector<uint32_t> cellCounts(numCells, 0);
+    for (size_t i = 0; i < numPoints; i++) {
+        cells[i] = cellOf(latitudes[i], longitudes[i]);
+        cellCounts[cells[i]]++;
+    }
+
+    // Pack the cells in the same order they were numbered, with Morton order inside each block
+    vector<uint32_t> cellRanges(2 * numCells);
+    uint32_t offset = 0;
+
+    for (uint32_t block : blockOrder) {
+        const GridBlock &grid = blocks[block];
+        for (uint32_t local : mortonOrder(grid.rows, grid.columns)) {
+            uint32_t cell = grid.firstCell + local;
+            cellRanges[2 * cell] = offset;
+            offset += cellCounts[cell];
+            cellRanges[2 * cell + 1] = offset;
+        }
+    }
+
+    // Scatter the points into their cells, in input order within each cell
+    vector<uint32_t> next(numCells);
+    for (size_t cell = 0; cell < numCells; cell++) {
+        next[cell] = cellRanges[2 * cell];
+    }
+
+    vector<float> packedLatitudes(numPoints);
+    vector<float> packedLongitudes(numPoints);
+    vector<uint32_t> originals(numPoints);
+    vector<uint32_t> positions(numPoints);
+
+    for (size_t i = 0; i < numPoints; i++) {
+        uint32_t position = next[cells[i]]++;
+        packedLatitudes[position] = latitudes[i];
+        packedLongitudes[position] = longitudes[i];
+        originals[position] = static_cast<uint32_t>(i);
+        positions[i] = position;
+    }
+
+    _cellRanges = ListWithSize<uint32_t>(cellRanges);
+    _latitudes = ListWithSize<float>(packedLatitudes);
+    _longitudes = ListWithSize<float>(packedLongitudes);
+    _originals = ListWithSize<uint32_t>(originals);
+    _positions = ListWithSize<uint32_t>(positions);
+}
+
+uint32_t SpatialGrid::cellOf(float latitude, float longitude) const {
+    const GridBlock &block = _blocks[rowIn(_coarse, latitude) * _coarse.columns + columnIn(_coarse, longitude)];
+    return block.firstCell + rowIn(block, latitude) * block.columns + columnIn(block, longitude);
+}
+
+size_t SpatialGrid::nearestPoint(float latitude, float longitude) const {
+    if (size() == 0) {
+        throw out_of_range("Nearest point query on an empty SpatialGrid");
+    }
+
+    float bestDist = std::numeric_limits<float>::infinity();
+    size_t bestIndex = 0;
+
+    searchNearest(
+        latitude, longitude,
+        [&](size_t index, float dist) {
+            if (dist < bestDist) {
+                bestDist = dist;
+                bestIndex = index;
+            }
+        },
+        [&]() { return bestDist; }
+    );
+
+    return bestIndex;
+}
+
+void SpatialGrid::kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const {
+    if (k == 0) {
+        return;
+    }
+
+    const float *lats = _latitudes.data();
+    const float *lons = _longitudes.data();
+    auto distanceTo = [&](size_t index) {
+        return (lats[index] - latitude) * (lats[index] - latitude) + (lons[index] - longitude) * (lons[index] - longitude);
+    };
+
+    // Max-heap on distance in the tail of result, so the worst of the k best is always on top
+    size_t first = result.size();
+    auto fartherThan = [&](size_t a, size_t b) { return distanceTo(a) < distanceTo(b); };
+    float worstDist = std::numeric_limits<float>::infinity();
+
+    searchNearest(
+        latitude, longitude,
+        [&](size_t index, float dist) {
+            if (result.size() - first == k) {
+                if (dist >= worstDist) {
+                    return;
+                }
+
+                std::pop_heap(result.begin() + first, result.end(), fartherThan);
+                result.back() = index;
+            } else {
+                result.push_back(index);
+            }
+
+            std::push_heap(result.begin() + first, result.end(), fartherThan);
+
+            if (result.size() - first == k) {
+                worstDist = distanceTo(result[first]);
+            }
+        },
+        [&]() { return worstDist; }
+    );
+
+    std::sort_heap(result.begin() + first, result.end(), fartherThan);
+}
+
+void SpatialGrid::pointsWithinRadius(float latitude, float longitude, float radius, vector<size_t> &result) const {
+    const float *lats = _latitudes.data();
+    const float *lons = _longitudes.data();
+    float radiusSquared = radius * radius;
+
+    // Box scan, filtered to the circle
+    size_t first = result.size();
+    pointsInBox(latitude - radius, longitude - radius, latitude + radius, longitude + radius, result);
+
+    auto outside = std::remove_if(result.begin() + first, result.end(), [&](size_t index) {
+        float dLat = lats[index] - latitude;
+        float dLon = lons[index] - longitude;
+        return dLat * dLat + dLon * dLon > radiusSquared;
+    });
+    result.erase(outside, result.end());
+}
+
+void SpatialGrid::pointsInBox(float minLatitude, float minLongitude,
+                              float maxLatitude, float maxLongitude,
+                              vector<size_t> &result) const {
+    if (size() == 0) {
+        return;
+    }
+
+    // Indices below are always in range, so skip ListWithSize's bounds checks
+    const GridBlock *blocks = _blocks.data();
+    const uint32_t *cellRanges = _cellRanges.data();
+    const float *lats = _latitudes.data();
+    const float *lons = _longitudes.data();
+
+    // Cell assignment is monotonic in each coordinate, so the cells of the box's corners bound
+    // the cells of every point inside it, at both levels
+    visitCells(_coarse, rowIn(_coarse, minLatitude), rowIn(_coarse, maxLatitude),
+               columnIn(_coarse, minLongitude), columnIn(_coarse, maxLongitude), false,
+               [&](size_t blockRow, size_t blockColumn) {
+        const GridBlock &block = blocks[blockRow * _coarse.columns + blockColumn];
+
+        visitCells(block, rowIn(block, minLatitude), rowIn(block, maxLatitude),
+                   columnIn(block, minLongitude), columnIn(block, maxLongitude), false,
+                   [&](size_t row, size_t column) {
+            size_t cell = block.firstCell + row * block.columns + column;
+
+            for (size_t index = cellRanges[2 * cell]; index < cellRanges[2 * cell + 1]; index++) {
+                if (lats[index] >= minLatitude && lats[index] <= maxLatitude
+                    && lons[index] >= minLongitude && lons[index] <= maxLongitude) {
+                    result.push_back(index);
+                }
+            }
+        });
+    });
+}
+
+template <typename Visit>
+void SpatialGrid::visitCells(const GridBlock &block, int64_t firstRow, int64_t lastRow, int64_t firstColumn,
+                             int64_t lastColumn, bool ringOnly, Visit &&visit) const {
+    int64_t rowBegin = std::max<int64_t>(firstRow, 0);
+    int64_t rowEnd = std::min<int64_t>(lastRow, block.rows - 1);
+    int64_t columnBegin = std::max<int64_t>(firstColumn, 0);
+    int64_t columnEnd = std::min<int64_t>(lastColumn, block.columns - 1);
+
+    for (int64_t row = rowBegin; row <= rowEnd; row++) {
+        // Inside rows of a ring only have their two end cells
+        if (!ringOnly || row == firstRow || row == lastRow) {
+            for (int64_t column = columnBegin; column <= columnEnd; column++) {
+                visit(row, column);
+            }
+        } else {
+            if (firstColumn >= 0) visit(row, firstColumn);
+            if (lastColumn <= columnEnd) visit(row, lastColumn);
+        }
+    }
+}
+
+template <typename Visit, typename Bound>
+void SpatialGrid::searchRings(const GridBlock &block, float latitude, float longitude, Visit &&visit, Bound &&bound) const {
+    int64_t row = rowIn(block, latitude);
+    int64_t column = columnIn(block, longitude);
+    int64_t lastRow = block.rows - 1;
+    int64_t lastColumn = block.columns - 1;
+    float slack = CELL_TOLERANCE * block.cellSize;
+
+    for (int64_t ring = 0; ; ring++) {
+        visitCells(block, row - ring, row + ring, column - ring, column + ring, ring > 0, visit);
+
+        if (row - ring <= 0 && row + ring >= lastRow && column - ring <= 0 && column + ring >= lastColumn) {
+            return;
+        }
+
+        // Distance to the nearest cell outside the rings so far, on the sides where the block goes on
+        float gap = std::numeric_limits<float>::infinity();
+        if (row - ring > 0) gap = std::min(gap, latitude - (block.minLatitude + (row - ring) * block.cellSize));
+        if (row + ring < lastRow) gap = std::min(gap, block.minLatitude + (row + ring + 1) * block.cellSize - latitude);
+        if (column - ring > 0) gap = std::min(gap, longitude - (block.minLongitude + (column - ring) * block.cellSize));
+        if (column + ring < lastColumn) gap = std::min(gap, block.minLongitude + (column + ring + 1) * block.cellSize - longitude);
+        gap = std::max(gap - slack, 0.0f);
+
+        if (gap * gap >= bound()) {
+            return;
+        }
+    }
+}
+
+template <typename Visit, typename Bound>
+void SpatialGrid::searchNearest(float latitude, float longitude, Visit &&visit, Bound &&bound) const {
+    if (size() == 0) {
+        return;
+    }
+
+    // Indices below are always in range, so skip ListWithSize's bounds checks
+    const GridBlock *blocks = _blocks.data();
+    const uint32_t *cellRanges = _cellRanges.data();
+    const float *lats = _latitudes.data();
+    const float *lons = _longitudes.data();
+
+    // Rings of coarse cells, and within each coarse cell that could still hold a closer point,
+    // rings of its own cells
+    searchRings(_coarse, latitude, longitude, [&](size_t blockRow, size_t blockColumn) {
+        const GridBlock &block = blocks[blockRow * _coarse.columns + blockColumn];
+        if (distanceToBlock(block, latitude, longitude) >= bound()) {
+            return;
+        }
+
+        searchRings(block, latitude, longitude, [&](size_t row, size_t column) {
+            size_t cell = block.firstCell + row * block.columns + column;
+
+            for (size_t index = cellRanges[2 * cell]; index < cellRanges[2 * cell + 1]; index++) {
+                float dLat = lats[index] - latitude;
+                float dLon = lons[index] - longitude;
+                visit(index, dLat * dLat + dLon * dLon);
+            }
+        }, bound);
+    }, bound);
+}
+
+size_t SpatialGrid::getNewIndex(size_t nodeIndex) const {
+    return _positions[nodeIndex];
+}
+
+size_t SpatialGrid::originalIndex(size_t index) const {
+    return _originals[index];
+}
+
+pair<float, float> SpatialGrid::operator[](size_t index) const {
+    if (index >= size()) {
+        throw out_of_range(format("Attempt to access element {} in SpatialGrid of size {}", index, size()));
+    }
+
+    return {_latitudes[index], _longitudes[index]};
+}
+
+size_t SpatialGrid::size() const {
+    return _latitudes.size();
+}
+
+size_t SpatialGrid::numCells() const {
+    return _cellRanges.size() / 2;
+}
+
+float SpatialGrid::cellSizeAt(float latitude, float longitude) const {
+    if (size() == 0) {
+        throw out_of_range("Cell size query on an empty SpatialGrid");
+    }
+
+    return _blocks[rowIn(_coarse, latitude) * _coarse.columns + columnIn(_coarse, longitude)].cellSize;
+}
+
+size_t SpatialGrid::memoryBytes() const {
+    return _blocks.size() * sizeof(GridBlock) + _cellRanges.size() * sizeof(uint32_t)
+        + (_latitudes.size() + _longitudes.size()) * sizeof(float)
+        + (_originals.size() + _positions.size()) * sizeof(uint32_t);
+}
+
+namespace utils {
+    istream &operator>>(istream &input, SpatialGrid &grid) {
+        input.read(reinterpret_cast<char*>(&grid._coarse), sizeof(grid._coarse));
+
+        input >> grid._blocks;
+        input >> grid._cellRanges;
+        input >> grid._latitudes;
+        input >> grid._longitudes;
+        input >> grid._originals;
+        input >> grid._positions;
+
+        return input;
+    }
+
+    ostream &operator<<(ostream &output, const SpatialGrid &grid) {
+        output.write(reinterpret_cast<const char*>(&grid._coarse), sizeof(grid._coarse));
+
+        output << grid._blocks;
+        output << grid._cellRanges;
+        output << grid._latitudes;
+        output << grid._longitudes;
+        output << grid._originals;
+        output << grid._positions;
+
+        return output;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "models/util/listWithSize.h"
+
+using std::istream;
+using std::ostream;
+using std::pair;
+using std::span;
+using std::vector;
+using utils::ListWithSize;
+
+namespace utils {
+    // A rows x columns grid of square cells, with its lower left corner at (minLatitude, minLongitude)
+    struct GridBlock {
+        float minLatitude;
+        float minLongitude;
+        float cellSize;
+        uint32_t rows;
+        uint32_t columns;
+
+        // Index of the block's first cell in SpatialGrid's cell ranges; cell (row, column) follows
+        // at firstCell + row * columns + column
+        uint32_t firstCell;
+    };
+
+    /**
+    * Two level grid over the points' bounding box, an alternative to Dim2Tree for snapping in dense
+    * areas: a query reads the cells around it, ring by ring, with no tree descent.
+    *
+    * The top level is a uniform grid of coarse cells, sized for about POINTS_PER_BLOCK points per
+    * cell if the points were spread evenly. Each coarse cell holding more than twice pointsPerCell
+    * points is split into its own finer grid of about pointsPerCell points per cell, so cell sizes
+    * follow the density: a downtown block gets small cells, open country a single large one.
+    *
+    * Points are packed by cell, in Morton order of the coarse cells and of the fine cells within
+    * each, so neighbouring cells are usually close in memory. Indices returned by queries are
+    * positions in that packed order; getNewIndex and originalIndex translate from and to input
+    * indices, like Dim2Tree.
+    */
+    class SpatialGrid {
+        public:
+        static constexpr size_t DEFAULT_POINTS_PER_CELL = 8;
+        static constexpr size_t POINTS_PER_BLOCK = 256;
+
+        SpatialGrid() = default;
+        SpatialGrid(span<const float> latitudes, span<const float> longitudes,
+                    size_t pointsPerCell = DEFAULT_POINTS_PER_CELL);
+
+        // Nearest point by Euclidean distance in degrees. The grid must not be empty.
+        size_t nearestPoint(float latitude, float longitude) const;
+
+        // The k nearest points, closest first (fewer if the grid is smaller), appended to result
+        void kNearest(float latitude, float longitude, size_t k, vector<size_t> &result) const;
+
+        // All points within radius degrees (inclusive), appended to result in no particular order
+        void pointsWithinRadius(float latitude, float longitude, float radius, vector<size_t> &result) const;
+
+        // All points inside the bounding box (inclusive on all sides), appended to result
+        void pointsInBox(float minLatitude, float minLongitude,
+                         float maxLatitude, float maxLongitude,
+                         vector<size_t> &result) const;
+
+        // Position of an input point, and the input index of a position
+        size_t getNewIndex(size_t nodeIndex) const;
+        size_t originalIndex(size_t index) const;
+
+        pair<float, float> operator[](size_t index) const;
+
+        size_t size() const;
+
+        // Number of cells over both levels
+        size_t numCells() const;
+
+        // Side of the fine cell holding a location, in degrees
+        float cellSizeAt(float latitude, float longitude) const;
+
+        // Bytes held by the grid's arrays
+        size_t memoryBytes() const;
+
+        friend istream &operator>>(istream &input, SpatialGrid &grid);
+        friend ostream &operator<<(ostream &output, const SpatialGrid &grid);
+
+        private:
+        // The coarse grid; its firstCell is unused
+        GridBlock _coarse = GridBlock();
+
+        // The fine grid of each coarse cell, one cell if it was not split
+        ListWithSize<GridBlock> _blocks = ListWithSize<GridBlock>(0);
+
+        // Points of fine cell c are at [_cellRanges[2c], _cellRanges[2c + 1])
+        ListWithSize<uint32_t> _cellRanges = ListWithSize<uint32_t>(0);
+
+        // Packed points, by cell in Morton order
+        ListWithSize<float> _latitudes = ListWithSize<float>(0);
+        ListWithSize<float> _longitudes = ListWithSize<float>(0);
+
+        // Input index of each position, and position of each input index
+        ListWithSize<uint32_t> _originals = ListWithSize<uint32_t>(0);
+        ListWithSize<uint32_t> _positions = ListWithSize<uint32_t>(0);
+
+        // Fine cell of a location, as an index into _cellRanges
+        uint32_t cellOf(float latitude, float longitude) const;
+
+        // Call visit(row, column) for every cell of the block in rows [firstRow, lastRow] and columns
+        // [firstColumn, lastColumn], or only those on the boundary of that range when ringOnly is set
+        template <typename Visit>
+        void visitCells(const GridBlock &block, int64_t firstRow, int64_t lastRow, int64_t firstColumn,
+                        int64_t lastColumn, bool ringOnly, Visit &&visit) const;
+
+        // Call visit(row, column) for the block's cells in growing rings around the location, until
+        // bound() is no more than the squared distance to any cell not yet visited
+        template <typename Visit, typename Bound>
+        void searchRings(const GridBlock &block, float latitude, float longitude, Visit &&visit, Bound &&bound) const;
+
+        // Call visit(index, distanceSquared) for every point that could be within the (shrinking)
+        // squared distance bound()
+        template <typename Visit, typename Bound>
+        void searchNearest(float latitude, float longitude, Visit &&visit, Bound &&bound) const;
+    };
+
+    istream &operator>>(istream &input, SpatialGrid &grid);
+    ostream &operator<<(ostream &output, const SpatialGrid &grid);
+}
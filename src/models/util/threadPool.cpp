@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <latch>
+
+#include "threadPool.h"
+
+using std::atomic;
+using std::exception_ptr;
+using std::function;
+using std::latch;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+using utils::ThreadPool;
+
+ThreadPool::ThreadPool(size_t numThreads) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < numThreads; i++) {
+        _workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _taskAvailable.notify_all();
+
+    for (thread &worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _tasks.push(std::move(task));
+    }
+    _taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    unique_lock<mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _tasks.empty() && _running == 0; });
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t slot, size_t index)> &body) {
+    atomic<size_t> next = 0;
+    size_t numSlots = std::min(size(), count);
+    latch done(numSlots);
+
+    // The first exception thrown by body is rethrown on the calling thread
+    mutex errorMutex;
+    exception_ptr error = nullptr;
+
+    // One long-running task per slot, each pulling indices until they run out
+    for (size_t slot = 0; slot < numSlots; slot++) {
+        submit([&, slot] {
+            try {
+                for (size_t index = next++; index < count; index = next++) {
+                    body(slot, index);
+                }
+            } catch (...) {
+                lock_guard<mutex> lock(errorMutex);
+                if (error == nullptr) {
+                    error = std::current_exception();
+                }
+
+                // Stop handing out indices to the other slots
+                next = count;
+            }
+
+            done.count_down();
+        });
+    }
+
+    done.wait();
+
+    if (error != nullptr) {
+        std::rethrow_exception(error);
+    }
+}
+
+size_t ThreadPool::size() const {
+    return _workers.size();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+
+        {
+            unique_lock<mutex> lock(_mutex);
+            _taskAvailable.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+            if (_stopping && _tasks.empty()) {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop();
+            _running++;
+        }
+
+        task();
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            _running--;
+
+            if (_tasks.empty() && _running == 0) {
+                _idle.notify_all();
+            }
+        }
+    }
+}
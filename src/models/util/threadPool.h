@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using std::condition_variable;
+using std::function;
+using std::mutex;
+using std::queue;
+using std::thread;
+using std::vector;
+
+namespace utils {
+    /**
+    * Fixed set of worker threads fed from a shared FIFO queue.
+    * The pool is meant to be created once and reused across batches.
+    */
+    class ThreadPool {
+        public:
+        // numThreads = 0 uses the hardware concurrency
+        ThreadPool(size_t numThreads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &other) = delete;
+        ThreadPool &operator=(const ThreadPool &other) = delete;
+
+        void submit(function<void()> task);
+
+        // Block until the queue is empty and no task is running
+        void wait();
+
+        // Run body(slot, index) for every index in [0, count) and wait for all of them.
+        // Indices are handed out dynamically. slot is in [0, size()) and no two calls with the
+        // same slot overlap, so callers can keep per-slot state (e.g. one search workspace each).
+        // The first exception thrown by body is rethrown here once every slot has stopped.
+        // Must not be called from inside a task of the same pool.
+        void parallelFor(size_t count, const function<void(size_t slot, size_t index)> &body);
+
+        size_t size() const;
+
+        private:
+        vector<thread> _workers = vector<thread>();
+        queue<function<void()>> _tasks = queue<function<void()>>();
+
+        mutex _mutex;
+        condition_variable _taskAvailable;
+        condition_variable _idle;
+        size_t _running = 0;
+        bool _stopping = false;
+
+        void workerLoop();
+    };
+}
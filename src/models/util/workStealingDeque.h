@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using std::atomic;
+using std::unique_ptr;
+using std::vector;
+
+namespace utils {
+    // Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+    // The owning thread pushes and pops at the bottom without locks; any other thread
+    // may steal from the top. T must be trivially copyable (typically a pointer).
+    // The ring buffer doubles when full. Old buffers are kept until destruction,
+    // since a concurrent thief may still be reading from them.
+    template <typename T>
+    class WorkStealingDeque {
+        public:
+        // capacity is rounded up to a power of 2
+        WorkStealingDeque(size_t capacity = 64);
+
+        WorkStealingDeque(const WorkStealingDeque &other) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque &other) = delete;
+
+        // Owner only
+        void push(T item);
+
+        // Owner only. Takes the most recently pushed item.
+        bool pop(T &item);
+
+        // Any thread. Takes the oldest item. May fail spuriously when racing another thief or the owner.
+        bool steal(T &item);
+
+        // Approximate when other threads are active
+        size_t size() const;
+
+        private:
+        struct Buffer {
+            int64_t mask;
+            unique_ptr<atomic<T>[]> items;
+
+            Buffer(int64_t capacity) : mask(capacity - 1), items(new atomic<T>[capacity]) {}
+
+            T load(int64_t index) const {
+                return items[index & mask].load(std::memory_order_relaxed);
+            }
+
+            void store(int64_t index, T item) {
+                items[index & mask].store(item, std::memory_order_relaxed);
+            }
+        };
+
+        alignas(64) atomic<int64_t> _top = 0;
+        alignas(64) atomic<int64_t> _bottom = 0;
+        atomic<Buffer *> _buffer = nullptr;
+
+        // Every buffer ever allocated, owned here so thieves never read freed memory
+        vector<unique_ptr<Buffer>> _buffers = vector<unique_ptr<Buffer>>();
+    };
+
+    template<typename T>
+    WorkStealingDeque<T>::WorkStealingDeque(size_t capacity) {
+        int64_t rounded = 1;
+        while (rounded < static_cast<int64_t>(capacity)) {
+            rounded <<= 1;
+        }
+
+        _buffers.push_back(std::make_unique<Buffer>(rounded));
+        _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    void WorkStealingDeque<T>::push(T item) {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_acquire);
+        Buffer *buffer = _buffer.load(std::memory_order_relaxed);
+
+        if (bottom - top > buffer->mask) {
+            auto grown = std::make_unique<Buffer>(2 * (buffer->mask + 1));
+            for (int64_t i = top; i < bottom; i++) {
+                grown->store(i, buffer->load(i));
+            }
+
+            buffer = grown.get();
+            _buffers.push_back(std::move(grown));
+            _buffer.store(buffer, std::memory_order_release);
+        }
+
+        buffer->store(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    bool WorkStealingDeque<T>::pop(T &item) {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        Buffer *buffer = _buffer.load(std::memory_order_relaxed);
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = _top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            // Empty
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = buffer->load(bottom);
+        if (top < bottom) {
+            return true;
+        }
+
+        // Last item: race the thieves for it
+        bool won = _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    template<typename T>
+    bool WorkStealingDeque<T>::steal(T &item) {
+        int64_t top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom) {
+            return false;
+        }
+
+        Buffer *buffer = _buffer.load(std::memory_order_acquire);
+        item = buffer->load(top);
+
+        return _top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    size_t WorkStealingDeque<T>::size() const {
+        int64_t bottom = _bottom.load(std::memory_order_relaxed);
+        int64_t top = _top.load(std::memory_order_relaxed);
+        return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+    }
+}
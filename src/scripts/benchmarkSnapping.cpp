@@ -0,0 +1,79 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "models/util/dim2Tree.h"
+#include "models/util/threadPool.h"
+
+using std::cout;
+using std::endl;
+using std::function;
+using std::pair;
+using std::vector;
+using utils::Dim2Tree;
+using utils::ThreadPool;
+
+// Points per second for one run of snap over all queries
+double measure(const char *name, size_t numQueries, const function<void()> &snap) {
+    auto start = std::chrono::steady_clock::now();
+    snap();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double pointsPerSecond = numQueries / seconds;
+    cout << name << ": " << pointsPerSecond / 1e6 << " M points/s" << endl;
+    return pointsPerSecond;
+}
+
+int main() {
+    // Road-network density over a metro area: 1M nodes, 1M snaps
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> latitude(41.6f, 42.1f);
+    std::uniform_real_distribution<float> longitude(-88.0f, -87.5f);
+
+    vector<pair<float, float>> points(1000000);
+    for (pair<float, float> &point : points) {
+        point = {latitude(generator), longitude(generator)};
+    }
+
+    vector<float> lats(1000000);
+    vector<float> lons(1000000);
+    for (size_t i = 0; i < lats.size(); i++) {
+        lats[i] = latitude(generator);
+        lons[i] = longitude(generator);
+    }
+
+    ThreadPool pool;
+    Dim2Tree tree;
+
+    measure("Dim2Tree build, 1 thread", points.size(), [&] {
+        tree = Dim2Tree(points);
+    });
+
+    measure("Dim2Tree build, thread pool", points.size(), [&] {
+        tree = Dim2Tree(points, &pool);
+    });
+
+    vector<size_t> nearest(lats.size());
+
+    double single = measure("nearestPoint, one at a time", lats.size(), [&] {
+        for (size_t i = 0; i < lats.size(); i++) {
+            nearest[i] = tree.nearestPoint(lats[i], lons[i]);
+        }
+    });
+
+    double batch = measure("nearestBatch, 1 thread", lats.size(), [&] {
+        tree.nearestBatch(lats, lons, nearest);
+    });
+
+    double parallel = measure("nearestBatch, thread pool", lats.size(), [&] {
+        tree.nearestBatch(lats, lons, nearest, &pool);
+    });
+
+    cout << "Batch speedup: " << batch / single << "x (1 thread), "
+         << parallel / single << "x (" << pool.size() << " threads)" << endl;
+
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/util/bucketKdTree.h"
+#include "models/util/dim2Tree.h"
+#include "models/util/dynamicDim2Tree.h"
+#include "models/util/spatialGrid.h"
+#include "models/util/threadPool.h"
+
+using geo::Graph;
+using std::atomic;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::string;
+using std::thread;
+using std::vector;
+using utils::BucketKdTree;
+using utils::Dim2Tree;
+using utils::DynamicDim2Tree;
+using utils::SpatialGrid;
+using utils::ThreadPool;
+using utils::TreeLayout;
+
+struct PointCloud {
+    string name;
+    vector<float> lats;
+    vector<float> lons;
+};
+
+// Build time, single query latency and memory of one index over one point cloud
+template <typename Build>
+void benchmark(const string &name, const vector<float> &queryLats, const vector<float> &queryLons, Build &&build) {
+    auto start = std::chrono::steady_clock::now();
+    auto index = build();
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queryLats.size(); i++) {
+        checksum += index.nearestPoint(queryLats[i], queryLons[i]);
+    }
+    double querySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    cout << "  " << name << ": build " << buildSeconds * 1e3 << " ms, "
+         << querySeconds / queryLats.size() * 1e9 << " ns/query, "
+         << index.memoryBytes() / 1e6 << " MB"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+// Moves of random points to random locations in the cloud's bounding box
+struct Moves {
+    vector<size_t> ids;
+    vector<float> lats;
+    vector<float> lons;
+};
+
+Moves randomMoves(const PointCloud &cloud, size_t count, std::mt19937 &generator) {
+    auto [minLat, maxLat] = std::minmax_element(cloud.lats.begin(), cloud.lats.end());
+    auto [minLon, maxLon] = std::minmax_element(cloud.lons.begin(), cloud.lons.end());
+    std::uniform_real_distribution<float> latitude(*minLat, *maxLat);
+    std::uniform_real_distribution<float> longitude(*minLon, *maxLon);
+    std::uniform_int_distribution<size_t> pick(0, cloud.lats.size() - 1);
+
+    Moves moves = {vector<size_t>(count), vector<float>(count), vector<float>(count)};
+    for (size_t i = 0; i < count; i++) {
+        moves.ids[i] = pick(generator);
+        moves.lats[i] = latitude(generator);
+        moves.lons[i] = longitude(generator);
+    }
+
+    return moves;
+}
+
+// Move throughput, then query latency over what the moves leave behind
+void benchmarkUpdates(const PointCloud &cloud, const vector<float> &queryLats, const vector<float> &queryLons,
+                      const Moves &moves, ThreadPool &pool) {
+    DynamicDim2Tree tree(cloud.lats, cloud.lons, &pool);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < moves.ids.size(); i++) {
+        tree.insert(moves.ids[i], moves.lats[i], moves.lons[i]);
+    }
+    double updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    tree.waitForMerges();
+
+    size_t checksum = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < queryLats.size(); i++) {
+        checksum += tree.nearestPoint(queryLats[i], queryLons[i]);
+    }
+    double querySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    cout << "  DynamicDim2Tree, after " << moves.ids.size() << " moves: "
+         << moves.ids.size() / updateSeconds / 1e6 << " M moves/s, "
+         << querySeconds / queryLats.size() * 1e9 << " ns/query, "
+         << tree.treeCount() << " trees, "
+         << tree.memoryBytes() / 1e6 << " MB"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+// Move throughput of one updating thread while queryThreads other threads query nonstop, and the
+// query rate they keep up meanwhile. Updates take the tree's lock exclusively, so this is what
+// bounds live vehicle updates under snapping load.
+void benchmarkConcurrentUpdates(const PointCloud &cloud, const vector<float> &queryLats, const vector<float> &queryLons,
+                                const Moves &moves, size_t queryThreads, ThreadPool &pool) {
+    DynamicDim2Tree tree(cloud.lats, cloud.lons, &pool);
+
+    atomic<bool> updating = true;
+    atomic<size_t> numQueries = 0;
+    atomic<size_t> checksum = 0;
+
+    vector<thread> readers;
+    for (size_t t = 0; t < queryThreads; t++) {
+        readers.emplace_back([&, t] {
+            size_t done = 0;
+            size_t sum = 0;
+
+            for (size_t i = t; updating.load(std::memory_order_relaxed); i = (i + queryThreads) % queryLats.size()) {
+                sum += tree.nearestPoint(queryLats[i], queryLons[i]);
+                done++;
+            }
+
+            numQueries += done;
+            checksum += sum;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < moves.ids.size(); i++) {
+        tree.insert(moves.ids[i], moves.lats[i], moves.lons[i]);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    updating = false;
+    for (thread &reader : readers) {
+        reader.join();
+    }
+    tree.waitForMerges();
+
+    cout << "  DynamicDim2Tree, " << moves.ids.size() << " moves with " << queryThreads
+         << (queryThreads == 1 ? " query thread: " : " query threads: ")
+         << moves.ids.size() / seconds / 1e6 << " M moves/s, "
+         << numQueries / seconds / 1e6 << " M queries/s"
+         << " (checksum " << checksum << ")" << endl;
+}
+
+int main() {
+    std::mt19937 generator(1);
+    vector<PointCloud> clouds;
+
+    // Uniform over a metro area
+    PointCloud uniform = {"uniform, 2M points", vector<float>(2000000), vector<float>(2000000)};
+    std::uniform_real_distribution<float> latitude(41.6f, 42.1f);
+    std::uniform_real_distribution<float> longitude(-88.0f, -87.5f);
+    for (size_t i = 0; i < uniform.lats.size(); i++) {
+        uniform.lats[i] = latitude(generator);
+        uniform.lons[i] = longitude(generator);
+    }
+    clouds.push_back(uniform);
+
+    // Towns of different sizes with open country between them, like a regional road network
+    PointCloud clustered = {"clustered, 2M points", vector<float>(), vector<float>()};
+    std::exponential_distribution<float> townSize(1.0f);
+    std::normal_distribution<float> spread(0.0f, 1.0f);
+    while (clustered.lats.size() < 2000000) {
+        float centerLat = latitude(generator);
+        float centerLon = longitude(generator);
+        float radius = 0.002f + 0.01f * townSize(generator);
+        size_t numPoints = std::min<size_t>(2000000 - clustered.lats.size(), 5000 + 40000 * townSize(generator));
+
+        for (size_t i = 0; i < numPoints; i++) {
+            clustered.lats.push_back(centerLat + radius * spread(generator));
+            clustered.lons.push_back(centerLon + radius * spread(generator));
+        }
+    }
+    clouds.push_back(clustered);
+
+    // Real road network nodes, if a graph has been converted (see graphJsonToBinary)
+    if (std::filesystem::exists("data/nodes.bin")) {
+        Graph graph = Graph();
+        ifstream input("data/nodes.bin", std::ios::binary);
+        input >> graph;
+
+        PointCloud osm = {"OSM nodes from data/nodes.bin", vector<float>(graph.size()), vector<float>(graph.size())};
+        for (size_t i = 0; i < graph.size(); i++) {
+            osm.lats[i] = graph.locationOf(i).first;
+            osm.lons[i] = graph.locationOf(i).second;
+        }
+        clouds.push_back(osm);
+    } else {
+        cout << "data/nodes.bin not found, skipping the OSM point cloud" << endl;
+    }
+
+    ThreadPool pool;
+
+    for (const PointCloud &cloud : clouds) {
+        // Queries near the cloud's points, as snapping requests are
+        std::uniform_int_distribution<size_t> pick(0, cloud.lats.size() - 1);
+        std::uniform_real_distribution<float> jitter(-0.001f, 0.001f);
+
+        vector<float> queryLats(500000);
+        vector<float> queryLons(500000);
+        for (size_t i = 0; i < queryLats.size(); i++) {
+            size_t point = pick(generator);
+            queryLats[i] = cloud.lats[point] + jitter(generator);
+            queryLons[i] = cloud.lons[point] + jitter(generator);
+        }
+
+        cout << cloud.name << endl;
+        benchmark("Dim2Tree, heap layout", queryLats, queryLons, [&] {
+            return Dim2Tree(cloud.lats, cloud.lons, &pool);
+        });
+        benchmark("Dim2Tree, van Emde Boas layout", queryLats, queryLons, [&] {
+            return Dim2Tree(cloud.lats, cloud.lons, &pool, TreeLayout::VanEmdeBoas);
+        });
+        benchmark("SpatialGrid", queryLats, queryLons, [&] {
+            return SpatialGrid(cloud.lats, cloud.lons);
+        });
+        benchmark("DynamicDim2Tree, bulk loaded", queryLats, queryLons, [&] {
+            return DynamicDim2Tree(cloud.lats, cloud.lons, &pool);
+        });
+
+        Moves moves = randomMoves(cloud, 2000000, generator);
+        benchmarkUpdates(cloud, queryLats, queryLons, moves, pool);
+
+        // The updater has a core of its own, and the readers get the rest
+        size_t maxQueryThreads = std::max<size_t>(2, thread::hardware_concurrency()) - 1;
+        vector<size_t> queryThreadCounts;
+        for (size_t queryThreads = 1; queryThreads < maxQueryThreads; queryThreads *= 2) {
+            queryThreadCounts.push_back(queryThreads);
+        }
+        queryThreadCounts.push_back(maxQueryThreads);
+
+        for (size_t queryThreads : queryThreadCounts) {
+            benchmarkConcurrentUpdates(cloud, queryLats, queryLons, moves, queryThreads, pool);
+        }
+
+        benchmark("BucketKdTree<16>", queryLats, queryLons, [&] {
+            return BucketKdTree<16>(cloud.lats, cloud.lons, &pool);
+        });
+        benchmark("BucketKdTree<32>", queryLats, queryLons, [&] {
+            return BucketKdTree<32>(cloud.lats, cloud.lons, &pool);
+        });
+        benchmark("BucketKdTree<64>", queryLats, queryLons, [&] {
+            return BucketKdTree<64>(cloud.lats, cloud.lons, &pool);
+        });
+    }
+
+    return 0;
+}
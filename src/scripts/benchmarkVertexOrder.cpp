@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/searchWorkspace.h"
+
+using geo::Graph;
+using geo::GraphNode;
+using geo::SearchWorkspace;
+using geo::VertexOrder;
+using std::cout;
+using std::endl;
+using std::optional;
+using std::pair;
+using std::to_string;
+using std::vector;
+
+// A city grid of two-way streets, listed in random order like the nodes of an OSM extract
+vector<GraphNode> createCity(size_t side, std::mt19937 &generator) {
+    std::uniform_real_distribution<float> jitter(-0.0002f, 0.0002f);
+
+    vector<GraphNode> nodes(side * side);
+    for (size_t row = 0; row < side; row++) {
+        for (size_t column = 0; column < side; column++) {
+            GraphNode &node = nodes[row * side + column];
+            node.nodeId = to_string(row * side + column);
+            node.location = {41.6f + row * 0.001f + jitter(generator), -88.0f + column * 0.001f + jitter(generator)};
+
+            if (row > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row - 1) * side + column), 9.0f);
+            if (row + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row + 1) * side + column), 9.0f);
+            if (column > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column - 1), 7.0f);
+            if (column + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column + 1), 7.0f);
+        }
+    }
+
+    std::shuffle(nodes.begin(), nodes.end(), generator);
+    return nodes;
+}
+
+// Routes per second over all queries, and the mean gap between the ids at either end of an entry
+void measure(const char *name, const Graph &graph, const vector<pair<pair<float, float>, pair<float, float>>> &queries) {
+    double gapSum = 0.0;
+    for (size_t entry = 0; entry < graph.edges().numEntries(); entry++) {
+        size_t from = graph.edges().rowOfEntry(entry);
+        size_t to = graph.edges().columnOfEntry(entry);
+        gapSum += (from > to) ? from - to : to - from;
+    }
+
+    SearchWorkspace workspace;
+    size_t routeNodes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &[origin, dest] : queries) {
+        optional<vector<GraphNode>> route = graph.generateRoute(origin, dest, workspace);
+        routeNodes += route.has_value() ? route->size() : 0;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    cout << "  " << name << ": " << queries.size() / seconds << " routes/s, "
+         << seconds / queries.size() * 1e3 << " ms/route, mean id gap per entry "
+         << gapSum / graph.edges().numEntries() << " (checksum " << routeNodes << ")" << endl;
+}
+
+// Route over the same city with either vertex order. Pass "tree" or "hilbert" to run only that
+// one, e.g. under `perf stat -e cache-misses,cache-references` to count the misses themselves.
+int main(int argc, char **argv) {
+    const size_t side = 400;
+    bool runTree = argc < 2 || std::strcmp(argv[1], "tree") == 0;
+    bool runHilbert = argc < 2 || std::strcmp(argv[1], "hilbert") == 0;
+
+    std::mt19937 generator(1);
+    vector<GraphNode> nodes = createCity(side, generator);
+
+    // Across town, so every search settles a good part of the graph
+    std::uniform_real_distribution<float> latitude(41.6f, 41.6f + side * 0.001f);
+    std::uniform_real_distribution<float> longitude(-88.0f, -88.0f + side * 0.001f);
+
+    vector<pair<pair<float, float>, pair<float, float>>> queries(200);
+    for (auto &[origin, dest] : queries) {
+        origin = {latitude(generator), longitude(generator)};
+        dest = {latitude(generator), longitude(generator)};
+    }
+
+    cout << nodes.size() << " nodes, " << queries.size() << " routes" << endl;
+
+    if (runTree) {
+        Graph graph(nodes, VertexOrder::Tree);
+        measure("Dim2Tree order", graph, queries);
+    }
+
+    if (runHilbert) {
+        Graph graph(nodes, VertexOrder::Hilbert);
+        measure("Hilbert order", graph, queries);
+    }
+
+    return 0;
+}
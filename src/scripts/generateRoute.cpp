@@ -8,6 +8,7 @@
 
 using geo::Graph;
 using geo::GraphNode;
+using geo::SERVING_SNAP_CACHE_SLOTS;
 using std::cout;
 using std::endl;
 using std::ifstream;
@@ -19,6 +20,7 @@ int main() {
     
     ifstream input("data/nodes.bin", std::ios::binary);
     input >> graph;
+    graph.setSnapCacheSize(SERVING_SNAP_CACHE_SLOTS);
 
     optional<vector<GraphNode>> route = graph.generateRoute(
         {41.9837686,-87.850425},
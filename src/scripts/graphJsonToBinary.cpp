@@ -6,16 +6,24 @@
 #include "models/geo/geoData.h"
 #include "models/geo/geoGraph.h"
 
+using geo::ChainCompressionStats;
 using geo::Graph;
 using geo::GraphNode;
+using geo::VertexOrder;
 using std::cout;
 using std::endl;
 using std::ofstream;
 using std::optional;
 using std::vector;
+using utils::ThreadPool;
 
 int main() {
-    Graph graph = Graph("data/nodes.json");
+    ThreadPool pool = ThreadPool();
+    Graph graph = Graph("data/nodes.json", VertexOrder::Hilbert, &pool);
+
+    ChainCompressionStats stats = graph.compressChains();
+    cout << "Compressed " << stats.shapeNodes << " shape nodes: "
+        << stats.entriesBefore << " -> " << stats.entriesAfter << " edges" << endl;
 
     ofstream output("data/nodes.bin", std::ios::binary);
     output << graph;
@@ -28,9 +28,12 @@ for node_id, data in G.nodes(data=True):
             continue  # Skip self-loops
 
         travel_time = edge_data.get('travel_time', 1.0)  # Fallback to 1 sec if missing
+        length = edge_data.get('length', 0.0)  # Fallback to the straight line distance if missing
         neighbors.append({
             "node_id": neighbor_id,
-            "transit_time_sec": round(travel_time, 2) if travel_time else 1.0
+            "transit_time_sec": round(travel_time, 2) if travel_time else 1.0,
+            "length_m": round(length, 1) if length else 0.0,
+            "toll": edge_data.get('toll') == 'yes'
         })
 
     node_data.append({
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "models/geo/geoGraph.h"
+
+using geo::Graph;
+using geo::SnapIndex;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ofstream;
+using std::pair;
+using std::vector;
+
+// Best of a few runs, in nanoseconds per snap
+double measure(const char *name, Graph &graph, SnapIndex index, const vector<pair<float, float>> &queries) {
+    graph.setSnapIndex(index);
+
+    double best = std::numeric_limits<double>::infinity();
+    size_t checksum = 0;
+
+    for (size_t run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (const pair<float, float> &query : queries) {
+            checksum += graph.snapToNode(query);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, seconds / queries.size() * 1e9);
+    }
+
+    cout << "  " << name << ": " << best << " ns/snap (checksum " << checksum << ")" << endl;
+    return best;
+}
+
+// Snap with each index over the graph in data/nodes.bin, and save it back with the fastest one
+// selected. Run once per region's graph.
+int main() {
+    ifstream input("data/nodes.bin", std::ios::binary);
+    if (!input) {
+        cout << "data/nodes.bin not found, convert a graph first (see graphJsonToBinary)" << endl;
+        return 1;
+    }
+
+    Graph graph = Graph();
+    input >> graph;
+    input.close();
+
+    if (graph.size() == 0) {
+        cout << "data/nodes.bin holds an empty graph" << endl;
+        return 1;
+    }
+
+    // Most snapping requests are GPS fixes near a road; some come from anywhere in the region
+    float minLat = std::numeric_limits<float>::max();
+    float maxLat = std::numeric_limits<float>::lowest();
+    float minLon = std::numeric_limits<float>::max();
+    float maxLon = std::numeric_limits<float>::lowest();
+    for (size_t node = 0; node < graph.size(); node++) {
+        auto [lat, lon] = graph.locationOf(node);
+        minLat = std::min(minLat, lat);
+        maxLat = std::max(maxLat, lat);
+        minLon = std::min(minLon, lon);
+        maxLon = std::max(maxLon, lon);
+    }
+
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<size_t> pickNode(0, graph.size() - 1);
+    std::uniform_real_distribution<float> gpsNoise(-0.0005f, 0.0005f);
+    std::uniform_real_distribution<float> anyLat(minLat, maxLat);
+    std::uniform_real_distribution<float> anyLon(minLon, maxLon);
+
+    vector<pair<float, float>> queries(200000);
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (i % 10 == 0) {
+            queries[i] = {anyLat(generator), anyLon(generator)};
+        } else {
+            auto [lat, lon] = graph.locationOf(pickNode(generator));
+            queries[i] = {lat + gpsNoise(generator), lon + gpsNoise(generator)};
+        }
+    }
+
+    cout << graph.size() << " nodes, " << queries.size() << " snaps" << endl;
+    double tree = measure("Dim2Tree", graph, SnapIndex::Tree, queries);
+    double grid = measure("SpatialGrid", graph, SnapIndex::Grid, queries);
+    double sphere = measure("SphereIndex", graph, SnapIndex::Sphere, queries);
+    cout << "  memory: Dim2Tree " << graph._vertices.memoryBytes() / 1e6 << " MB, SpatialGrid "
+         << graph._grid.memoryBytes() / 1e6 << " MB, SphereIndex " << graph._sphere.memoryBytes() / 1e6 << " MB" << endl;
+
+    // Snaps where the planar indices pick a node that isn't the nearest on the sphere. A few are
+    // ties; many mean the region is far enough north (or wraps the antimeridian) to prefer Sphere.
+    size_t differing = 0;
+    for (const pair<float, float> &query : queries) {
+        graph.setSnapIndex(SnapIndex::Tree);
+        size_t planar = graph.snapToNode(query);
+        graph.setSnapIndex(SnapIndex::Sphere);
+        differing += graph.snapToNode(query) != planar;
+    }
+    cout << "  " << 100.0 * differing / queries.size() << "% of snaps differ between Dim2Tree and SphereIndex" << endl;
+
+    SnapIndex selected = SnapIndex::Tree;
+    const char *selectedName = "Dim2Tree";
+    if (grid < std::min(tree, sphere)) {
+        selected = SnapIndex::Grid;
+        selectedName = "SpatialGrid";
+    } else if (sphere < tree) {
+        selected = SnapIndex::Sphere;
+        selectedName = "SphereIndex";
+    }
+
+    graph.setSnapIndex(selected);
+    cout << "Selected " << selectedName << endl;
+
+    ofstream output("data/nodes.bin", std::ios::binary);
+    output << graph;
+    output.close();
+
+    return 0;
+}
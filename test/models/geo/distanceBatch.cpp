@@ -0,0 +1,90 @@
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/distanceBatch.h"
+#include "models/geo/geoData.h"
+
+using geo::DistanceKernel;
+using geo::distanceBatch;
+using geo::distanceKernelSupported;
+using geo::greatCircleMetres;
+using geo::greatCircleMetresBatch;
+using std::invalid_argument;
+using std::pair;
+using std::vector;
+
+// Points all over the globe, and points within a few hundred metres of the origin.
+// 1003 is not a multiple of any vector width, so the masked tails are covered too.
+void createPoints(const pair<float, float> &origin, vector<float> &lats, vector<float> &lons) {
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> latitude(-90.0f, 90.0f);
+    std::uniform_real_distribution<float> longitude(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> offset(-0.003f, 0.003f);
+
+    for (size_t i = 0; i < 1003; i++) {
+        if (i % 2 == 0) {
+            lats.push_back(latitude(generator));
+            lons.push_back(longitude(generator));
+        } else {
+            lats.push_back(origin.first + offset(generator));
+            lons.push_back(origin.second + offset(generator));
+        }
+    }
+
+    // Coincident and antipodal points
+    lats.push_back(origin.first);
+    lons.push_back(origin.second);
+    lats.push_back(-origin.first);
+    lons.push_back(origin.second - 180.0f);
+}
+
+TEST_CASE("Vector distance kernels match the scalar reference", "[DistanceBatch]") {
+    pair<float, float> origin = {41.88f, -87.63f};
+    vector<float> lats, lons;
+    createPoints(origin, lats, lons);
+
+    vector<float> reference(lats.size());
+    greatCircleMetresBatch(origin, lats, lons, reference, DistanceKernel::Scalar);
+
+    // The scalar kernel agrees with the single-pair haversine
+    for (size_t i = 0; i < lats.size(); i++) {
+        REQUIRE(reference[i] == Approx(greatCircleMetres(origin, {lats[i], lons[i]})).margin(1.0).epsilon(1e-4));
+    }
+
+    for (DistanceKernel kernel : {DistanceKernel::Avx2, DistanceKernel::Avx512}) {
+        if (!distanceKernelSupported(kernel)) {
+            continue;
+        }
+
+        vector<float> metres(lats.size());
+        greatCircleMetresBatch(origin, lats, lons, metres, kernel);
+
+        for (size_t i = 0; i < lats.size(); i++) {
+            REQUIRE(std::abs(metres[i] - reference[i]) <= 0.5f + 1e-5f * reference[i]);
+        }
+    }
+}
+
+TEST_CASE("distanceBatch matches geo::distance", "[DistanceBatch]") {
+    pair<float, float> origin = {-33.87f, 151.21f};
+    vector<float> lats, lons;
+    createPoints(origin, lats, lons);
+
+    vector<float> seconds(lats.size());
+    distanceBatch(origin, lats, lons, seconds);
+
+    // geo::distance itself loses precision near the antipode, so the antipodal point is left out
+    for (size_t i = 0; i + 1 < lats.size(); i++) {
+        REQUIRE(seconds[i] == Approx(geo::distance(origin, {lats[i], lons[i]})).margin(0.05).epsilon(1e-4));
+    }
+}
+
+TEST_CASE("Batch distances reject mismatched spans", "[DistanceBatch]") {
+    vector<float> lats(4), lons(3), metres(4);
+
+    REQUIRE_THROWS_AS(greatCircleMetresBatch({0.0f, 0.0f}, lats, lons, metres), invalid_argument);
+}
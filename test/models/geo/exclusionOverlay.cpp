@@ -0,0 +1,91 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/exclusionOverlay.h"
+#include "models/geo/geoGraph.h"
+#include "models/geo/testGraphs.h"
+
+using geo::ExclusionOverlay;
+using geo::Graph;
+using geo::GraphNode;
+using std::optional;
+using std::pair;
+using std::string;
+using std::to_string;
+using std::vector;
+
+bool routeVisits(const vector<GraphNode> &route, const pair<float, float> &location) {
+    for (const GraphNode &node : route) {
+        if (node.location == pair<double, double>(location)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+TEST_CASE("ExclusionOverlay closed edges force a detour", "[ExclusionOverlay]") {
+    Graph graph(createStreetGrid(3, 10.0f, 10.0f));
+    ExclusionOverlay overlay(graph);
+
+    size_t corner = graph.nodeOfInput(0);
+    size_t edgeMiddle = graph.nodeOfInput(1);
+
+    REQUIRE(overlay.closeEdge(corner, edgeMiddle));
+    REQUIRE_FALSE(overlay.closeEdge(corner, graph.nodeOfInput(8)));
+    REQUIRE(overlay.numClosedEntries() == 1);
+
+    size_t otherCorner = graph.nodeOfInput(2);
+    optional<vector<GraphNode>> open = graph.generateRouteBetweenNodes(corner, otherCorner);
+    optional<vector<GraphNode>> detour = graph.generateRouteBetweenNodes(corner, otherCorner, &overlay);
+
+    REQUIRE(open.has_value());
+    REQUIRE(open->size() == 3);
+
+    REQUIRE(detour.has_value());
+    REQUIRE(detour->size() == 5);
+
+    // The overlay must not affect the reverse direction
+    optional<vector<GraphNode>> reverse = graph.generateRouteBetweenNodes(edgeMiddle, corner, &overlay);
+    REQUIRE(reverse.has_value());
+    REQUIRE(reverse->size() == 2);
+}
+
+TEST_CASE("ExclusionOverlay avoid polygons keep routes out of the area", "[ExclusionOverlay]") {
+    Graph graph(createStreetGrid(3, 10.0f, 10.0f));
+    ExclusionOverlay overlay(graph);
+
+    // Square around the centre node only
+    overlay.avoidPolygon({{0.0005f, 0.0005f}, {0.0005f, 0.0015f}, {0.0015f, 0.0015f}, {0.0015f, 0.0005f}});
+
+    REQUIRE(overlay.numExcludedNodes() == 1);
+    REQUIRE(overlay.nodeExcluded(graph.nodeOfInput(4)));
+
+    // Every road into the centre is closed
+    REQUIRE(overlay.numClosedEntries() == 4);
+
+    optional<vector<GraphNode>> route = graph.generateRouteBetweenNodes(
+        graph.nodeOfInput(3),
+        graph.nodeOfInput(5),
+        &overlay
+    );
+
+    REQUIRE(route.has_value());
+    REQUIRE(route->size() == 5);
+    REQUIRE_FALSE(routeVisits(*route, {0.001f, 0.001f}));
+}
+
+TEST_CASE("ExclusionOverlay can make a destination unreachable", "[ExclusionOverlay]") {
+    Graph graph(createStreetGrid(3, 10.0f, 10.0f));
+    ExclusionOverlay overlay(graph);
+
+    overlay.avoidNode(graph.nodeOfInput(8));
+
+    size_t corner = graph.nodeOfInput(0);
+    size_t otherCorner = graph.nodeOfInput(8);
+
+    REQUIRE_FALSE(graph.generateRouteBetweenNodes(corner, otherCorner, &overlay).has_value());
+    REQUIRE(graph.generateRouteBetweenNodes(corner, otherCorner).has_value());
+}
@@ -1,15 +1,40 @@
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "catch/catch.hpp"
+#include "models/geo/exclusionOverlay.h"
 #include "models/geo/geoGraph.h"
+#include "models/geo/testGraphs.h"
 
+using geo::ChainCompressionStats;
+using geo::EntryPosition;
+using geo::ExclusionOverlay;
 using geo::Graph;
+using geo::NO_ENTRY;
+using geo::PhantomNode;
+using geo::RouteQuery;
+using geo::SearchWorkspace;
+using geo::SERVING_SNAP_CACHE_SLOTS;
+using geo::SnapIndex;
 using geo::GraphNode;
+using geo::VertexOrder;
 using std::cout;
 using std::endl;
+using std::optional;
+using std::runtime_error;
+using std::string;
+using std::stringstream;
+using std::to_string;
+using utils::ThreadPool;
 using std::unordered_map;
 using std::unordered_set;
 using std::vector;
@@ -21,12 +46,12 @@ TEST_CASE("Graph neighbors are correctly preserved after Dim2Tree reordering", "
     // Node 0 → neighbors: 1, 2
     nodes[0].nodeId = "0";
     nodes[0].location = {1.0f, 1.0f};
-    nodes[0].outboundAccessibleNodes = {"1", "2"};
+    nodes[0].outboundAccessibleNodesWithTime = {{"1", 1.0f}, {"2", 1.0f}};
 
     // Node 1 → neighbor: 2
     nodes[1].nodeId = "1";
     nodes[1].location = {2.0f, 2.0f};
-    nodes[1].outboundAccessibleNodes = {"2"};
+    nodes[1].outboundAccessibleNodesWithTime = {{"2", 1.0f}};
 
     // Node 2 → no neighbors
     nodes[2].nodeId = "2";
@@ -38,7 +63,7 @@ TEST_CASE("Graph neighbors are correctly preserved after Dim2Tree reordering", "
     // --- Step 3: Build original → new index mapping
     unordered_map<size_t, size_t> originalToNew;
     for (size_t originalIdx = 0; originalIdx < nodes.size(); ++originalIdx) {
-        size_t newIdx = graph._vertices.getNewIndex(originalIdx);
+        size_t newIdx = graph.nodeOfInput(originalIdx);
         originalToNew[originalIdx] = newIdx;
     }
 
@@ -62,3 +87,609 @@ TEST_CASE("Graph neighbors are correctly preserved after Dim2Tree reordering", "
         REQUIRE(actualNeighbors == expectedNeighbors[originalIdx]);
     }
 }
+
+TEST_CASE("Graph fails fast between unconnected components", "[GeoGraph]") {
+    // Two-way roads 5 <-> 0 <-> 1 -> 2 (one-way stub), and an island 3 <-> 4
+    vector<GraphNode> nodes(6);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i].nodeId = std::to_string(i);
+        nodes[i].location = {0.0f, i * 0.001f};
+    }
+    nodes[5].location = {0.001f, 0.0f};
+
+    nodes[0].outboundAccessibleNodesWithTime = {{"1", 10.0f}, {"5", 10.0f}};
+    nodes[5].outboundAccessibleNodesWithTime = {{"0", 10.0f}};
+    nodes[1].outboundAccessibleNodesWithTime = {{"0", 10.0f}, {"2", 10.0f}};
+    nodes[3].outboundAccessibleNodesWithTime = {{"4", 10.0f}};
+    nodes[4].outboundAccessibleNodesWithTime = {{"3", 10.0f}};
+
+    Graph graph(nodes);
+    size_t n0 = graph.nodeOfInput(0);
+    size_t n1 = graph.nodeOfInput(1);
+    size_t n2 = graph.nodeOfInput(2);
+    size_t n3 = graph.nodeOfInput(3);
+
+    REQUIRE(graph.mayReach(n0, n1));
+    REQUIRE(graph.mayReach(n0, n2));
+    REQUIRE_FALSE(graph.mayReach(n2, n0));
+    REQUIRE_FALSE(graph.mayReach(n0, n3));
+    REQUIRE_FALSE(graph.mayReach(n3, n0));
+
+    REQUIRE(graph.generateRouteBetweenNodes(n0, n2).has_value());
+    REQUIRE_FALSE(graph.generateRouteBetweenNodes(n0, n3).has_value());
+
+    // The island is nearer, but it is not part of the largest component
+    REQUIRE(graph.snapToNode({0.0f, 0.0031f}) == n3);
+    REQUIRE(graph.snapToNode({0.0f, 0.0031f}, true) == n1);
+}
+
+// A two-way road A - S1 - S2 - B, and a one-way loop back B -> C -> T -> A.
+// S1, S2, C and T are shape nodes.
+vector<GraphNode> createChains() {
+    vector<GraphNode> nodes(6);
+
+    nodes[0].nodeId = "A";
+    nodes[0].location = {0.0f, 0.0f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"S1", 10.0f}};
+
+    nodes[1].nodeId = "S1";
+    nodes[1].location = {0.0f, 0.001f};
+    nodes[1].outboundAccessibleNodesWithTime = {{"A", 10.0f}, {"S2", 10.0f}};
+
+    nodes[2].nodeId = "S2";
+    nodes[2].location = {0.0f, 0.002f};
+    nodes[2].outboundAccessibleNodesWithTime = {{"S1", 10.0f}, {"B", 10.0f}};
+
+    nodes[3].nodeId = "B";
+    nodes[3].location = {0.0f, 0.003f};
+    nodes[3].outboundAccessibleNodesWithTime = {{"S2", 10.0f}, {"C", 5.0f}};
+
+    nodes[4].nodeId = "C";
+    nodes[4].location = {0.001f, 0.003f};
+    nodes[4].outboundAccessibleNodesWithTime = {{"T", 7.0f}};
+
+    nodes[5].nodeId = "T";
+    nodes[5].location = {0.001f, 0.0015f};
+    nodes[5].outboundAccessibleNodesWithTime = {{"A", 8.0f}};
+
+    return nodes;
+}
+
+TEST_CASE("Graph compresses chains of shape nodes", "[GeoGraph]") {
+    Graph graph(createChains());
+    size_t a = graph.nodeOfInput(0);
+    size_t s1 = graph.nodeOfInput(1);
+    size_t b = graph.nodeOfInput(3);
+
+    ChainCompressionStats stats = graph.compressChains();
+
+    REQUIRE(stats.shapeNodes == 4);
+    REQUIRE(stats.entriesBefore == 9);
+    REQUIRE(stats.entriesAfter == 3);
+    REQUIRE(graph.isShapeNode(s1));
+    REQUIRE_FALSE(graph.isShapeNode(a));
+
+    REQUIRE(graph._edges(a, b) == 30);
+    REQUIRE(graph._edgeLengths[graph._edges.rowOffset(a)] == Approx(333.6f).epsilon(0.01));
+
+    // Compressing again changes nothing
+    REQUIRE(graph.compressChains().entriesAfter == 3);
+
+    // Routes are expanded back to every node along the way. Route points carry Graph::locationOf,
+    // which is in float, so they compare equal to float literals.
+    optional<vector<GraphNode>> there = graph.generateRouteBetweenNodes(a, b);
+    REQUIRE(there.has_value());
+    REQUIRE(there->size() == 4);
+    REQUIRE(there->at(1).location == pair<double, double>{0.0f, 0.001f});
+    REQUIRE(there->at(2).location == pair<double, double>{0.0f, 0.002f});
+
+    optional<vector<GraphNode>> back = graph.generateRouteBetweenNodes(b, a);
+    REQUIRE(back.has_value());
+    REQUIRE(back->size() == 4);
+    REQUIRE(back->at(1).location == pair<double, double>{0.001f, 0.003f});
+    REQUIRE(back->at(2).location == pair<double, double>{0.001f, 0.0015f});
+
+    // Locations near a shape node snap to the nearer end of its chain
+    REQUIRE(graph.snapToNode({0.0f, 0.0011f}) == a);
+
+    // The compressed graph survives serialization
+    stringstream buffer;
+    buffer << graph;
+    Graph loaded;
+    buffer >> loaded;
+
+    REQUIRE(loaded.isShapeNode(s1));
+    REQUIRE(loaded.generateRouteBetweenNodes(b, a)->size() == 4);
+}
+
+TEST_CASE("Overlay closures apply to whole compressed chains", "[GeoGraph]") {
+    Graph graph(createChains());
+    size_t a = graph.nodeOfInput(0);
+    size_t b = graph.nodeOfInput(3);
+    size_t c = graph.nodeOfInput(4);
+    size_t t = graph.nodeOfInput(5);
+
+    graph.compressChains();
+
+    ExclusionOverlay overlay(graph);
+    REQUIRE(overlay.closeEdge(c, t));
+    REQUIRE_FALSE(overlay.closeEdge(t, c));
+    REQUIRE(overlay.numClosedEntries() == 1);
+
+    optional<vector<GraphNode>> detour = graph.generateRouteBetweenNodes(b, a, &overlay);
+    REQUIRE(detour.has_value());
+    REQUIRE(detour->at(1).location == pair<double, double>{0.0f, 0.002f});
+
+    // Avoiding a shape node closes every chain through it
+    overlay.avoidNode(graph.nodeOfInput(2));
+    REQUIRE_FALSE(graph.generateRouteBetweenNodes(b, a, &overlay).has_value());
+    REQUIRE_FALSE(graph.generateRouteBetweenNodes(a, b, &overlay).has_value());
+}
+
+TEST_CASE("Graph routes a batch of queries concurrently", "[GeoGraph]") {
+    const Graph graph(createStreetGrid(10, 12.0f, 10.0f));
+    vector<RouteQuery> queries = createGridQueries(200);
+
+    ThreadPool pool(4);
+    vector<optional<vector<GraphNode>>> routes = graph.routeBatch(queries, pool);
+
+    REQUIRE(routes.size() == queries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        optional<vector<GraphNode>> expected = graph.generateRoute(queries[i].origin, queries[i].dest);
+
+        REQUIRE(routes[i].has_value());
+        REQUIRE(routes[i]->size() == expected->size());
+        for (size_t j = 0; j < expected->size(); j++) {
+            REQUIRE(routes[i]->at(j).location == expected->at(j).location);
+        }
+    }
+}
+
+TEST_CASE("Graph snaps with either index and saves the choice", "[GeoGraph]") {
+    // Two dense towns joined by one long road
+    vector<GraphNode> nodes;
+    for (size_t town = 0; town < 2; town++) {
+        for (size_t i = 0; i < 200; i++) {
+            GraphNode node;
+            node.nodeId = to_string(nodes.size());
+            node.location = {town * 0.5f + (i / 20) * 0.0005f, town * 0.5f + (i % 20) * 0.0005f};
+            if (i > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string(nodes.size() - 1), 5.0f);
+            nodes.push_back(node);
+        }
+    }
+    nodes[200].outboundAccessibleNodesWithTime.emplace_back("199", 600.0f);
+
+    Graph graph(nodes);
+    REQUIRE(graph.snapIndex() == SnapIndex::Tree);
+    REQUIRE(graph._grid.size() == 0);
+
+    vector<pair<float, float>> locations;
+    vector<size_t> snapped;
+    for (size_t i = 0; i < 500; i++) {
+        locations.push_back({(i % 50) * 0.0123f - 0.01f, (i * 7 % 50) * 0.0119f - 0.01f});
+        snapped.push_back(graph.snapToNode(locations.back()));
+    }
+
+    graph.setSnapIndex(SnapIndex::Grid);
+    for (size_t i = 0; i < locations.size(); i++) {
+        REQUIRE(graph.locationOf(graph.snapToNode(locations[i])) == graph.locationOf(snapped[i]));
+    }
+
+    stringstream buffer;
+    buffer << graph;
+    Graph loaded;
+    buffer >> loaded;
+
+    REQUIRE(loaded.snapIndex() == SnapIndex::Grid);
+    for (size_t i = 0; i < locations.size(); i++) {
+        REQUIRE(loaded.snapToNode(locations[i]) == graph.snapToNode(locations[i]));
+    }
+}
+
+TEST_CASE("Graph keeps node locations to the microdegree", "[GeoGraph]") {
+    // Both coordinates are a few microdegrees off once rounded to float
+    vector<GraphNode> nodes(2);
+    nodes[0].nodeId = "0";
+    nodes[0].location = {45.1234567, -122.6543210};
+    nodes[1].nodeId = "1";
+    nodes[1].location = {45.1244567, -122.6543210};
+    nodes[0].outboundAccessibleNodesWithTime.emplace_back("1", 10.0f);
+
+    Graph graph(nodes);
+
+    vector<pair<int32_t, int32_t>> stored;
+    for (size_t point = 0; point < graph._vertices.size(); point++) {
+        stored.push_back(graph._vertices.microdegrees(point));
+    }
+
+    REQUIRE(std::count(stored.begin(), stored.end(), pair<int32_t, int32_t>{45123457, -122654321}) == 1);
+    REQUIRE(std::count(stored.begin(), stored.end(), pair<int32_t, int32_t>{45124457, -122654321}) == 1);
+}
+
+TEST_CASE("Graph snaps by great circle distance with the sphere index", "[GeoGraph]") {
+    // At 70 degrees north a degree of longitude is a third as long as a degree of latitude,
+    // so the node half a degree east is closer than the one a fifth of a degree north
+    vector<GraphNode> nodes(3);
+    nodes[0].nodeId = "east";
+    nodes[0].location = {70.0f, 0.5f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"north", 60.0f}};
+    nodes[1].nodeId = "north";
+    nodes[1].location = {70.2f, 0.0f};
+    nodes[1].outboundAccessibleNodesWithTime = {{"dateline", 60.0f}};
+    nodes[2].nodeId = "dateline";
+    nodes[2].location = {0.0f, -179.95f};
+    nodes[2].outboundAccessibleNodesWithTime = {{"east", 60.0f}};
+
+    Graph graph(nodes);
+    size_t east = graph.nodeOfInput(0);
+    size_t north = graph.nodeOfInput(1);
+    size_t dateline = graph.nodeOfInput(2);
+
+    REQUIRE(graph.snapToNode({70.0f, 0.0f}) == north);
+
+    graph.setSnapIndex(SnapIndex::Sphere);
+    REQUIRE(graph.snapToNode({70.0f, 0.0f}) == east);
+
+    // Across the antimeridian, rather than half way around the world
+    REQUIRE(graph.snapToNode({0.0f, 179.9f}) == dateline);
+
+    stringstream buffer;
+    buffer << graph;
+    Graph loaded;
+    buffer >> loaded;
+
+    REQUIRE(loaded.snapIndex() == SnapIndex::Sphere);
+    REQUIRE(loaded.snapToNode({70.0f, 0.0f}) == east);
+}
+
+// A long one-way road W -> E, a one-way loop back E -> S -> W, and a two-way side road W - N - E.
+// N is the node nearest to the middle of W -> E, but it is not on that road.
+vector<GraphNode> createLongRoad() {
+    vector<GraphNode> nodes(4);
+
+    nodes[0].nodeId = "W";
+    nodes[0].location = {0.0f, 0.0f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"E", 100.0f}, {"N", 30.0f}};
+
+    nodes[1].nodeId = "E";
+    nodes[1].location = {0.0f, 0.01f};
+    nodes[1].outboundAccessibleNodesWithTime = {{"S", 40.0f}, {"N", 50.0f}};
+
+    nodes[2].nodeId = "S";
+    nodes[2].location = {-0.003f, 0.005f};
+    nodes[2].outboundAccessibleNodesWithTime = {{"W", 40.0f}};
+
+    nodes[3].nodeId = "N";
+    nodes[3].location = {0.0015f, 0.005f};
+    nodes[3].outboundAccessibleNodesWithTime = {{"W", 30.0f}, {"E", 50.0f}};
+
+    return nodes;
+}
+
+TEST_CASE("Graph snaps onto roads and routes from part-way along them", "[GeoGraph]") {
+    Graph graph(createLongRoad());
+    size_t w = graph.nodeOfInput(0);
+    size_t e = graph.nodeOfInput(1);
+    size_t n = graph.nodeOfInput(3);
+
+    // Beside the middle of the long road: the nearest node is on the side road
+    REQUIRE(graph.snapToNode({0.0002f, 0.005f}) == n);
+
+    optional<PhantomNode> middle = graph.snapToRoad({0.0002f, 0.005f});
+    REQUIRE(middle.has_value());
+    REQUIRE(graph._edges.rowOfEntry(middle->forward.entry) == w);
+    REQUIRE(graph._edges.columnOfEntry(middle->forward.entry) == e);
+    REQUIRE(middle->forward.fraction == Approx(0.5f));
+    REQUIRE(middle->backward.entry == NO_ENTRY);
+    REQUIRE(middle->location.first == Approx(0.0f).margin(1e-6));
+    REQUIRE(middle->snapMetres == Approx(22.2f).epsilon(0.01));
+
+    // Ahead on the same road: straight there
+    optional<vector<GraphNode>> ahead = graph.generateRoute({0.0002f, 0.002f}, {0.0002f, 0.008f});
+    REQUIRE(ahead.has_value());
+    REQUIRE(ahead->size() == 2);
+    REQUIRE(ahead->at(0).location.second == Approx(0.002f));
+    REQUIRE(ahead->at(1).location.second == Approx(0.008f));
+
+    // Behind on a one-way road: around the loop
+    optional<vector<GraphNode>> behind = graph.generateRoute({0.0002f, 0.008f}, {0.0002f, 0.002f});
+    REQUIRE(behind.has_value());
+    REQUIRE(behind->size() == 5);
+    REQUIRE(behind->at(1).location == pair<double, double>(graph.locationOf(e)));
+    REQUIRE(behind->at(3).location == pair<double, double>(graph.locationOf(w)));
+
+    // From the middle of the two-way side road, which is left by whichever end is faster: N, then W
+    optional<PhantomNode> side = graph.snapToRoad({0.00075f, 0.0075f});
+    REQUIRE(side->forward.entry != NO_ENTRY);
+    REQUIRE(side->backward.entry != NO_ENTRY);
+    REQUIRE(side->forward.fraction + side->backward.fraction == Approx(1.0f));
+
+    optional<vector<GraphNode>> fromSide = graph.generateRoute({0.00075f, 0.0075f}, {0.0002f, 0.008f});
+    REQUIRE(fromSide.has_value());
+    REQUIRE(fromSide->size() == 4);
+    REQUIRE(fromSide->at(1).location == pair<double, double>(graph.locationOf(n)));
+    REQUIRE(fromSide->at(2).location == pair<double, double>(graph.locationOf(w)));
+
+    // The segment index is saved with the graph
+    stringstream buffer;
+    buffer << graph;
+    Graph loaded;
+    buffer >> loaded;
+
+    REQUIRE(loaded.snapToRoad({0.0002f, 0.005f})->forward.entry == middle->forward.entry);
+    REQUIRE(loaded.generateRoute({0.0002f, 0.008f}, {0.0002f, 0.002f})->size() == 5);
+}
+
+TEST_CASE("Graph snaps onto compressed chains", "[GeoGraph]") {
+    Graph graph(createChains());
+    size_t a = graph.nodeOfInput(0);
+    size_t b = graph.nodeOfInput(3);
+    graph.compressChains();
+
+    // Half way between S1 and S2, the middle hop of the chain A -> B
+    optional<PhantomNode> phantom = graph.snapToRoad({0.0001f, 0.0015f});
+    REQUIRE(phantom.has_value());
+
+    const EntryPosition &towardsB = (graph._edges.rowOfEntry(phantom->forward.entry) == a) ? phantom->forward : phantom->backward;
+    REQUIRE(graph._edges.rowOfEntry(towardsB.entry) == a);
+    REQUIRE(graph._edges.columnOfEntry(towardsB.entry) == b);
+    REQUIRE(towardsB.hop == 1);
+    REQUIRE(towardsB.fraction == Approx(0.5f));
+
+    // Along the chain in either direction, through the shape node in between
+    optional<vector<GraphNode>> there = graph.generateRoute({0.0001f, 0.0015f}, {0.0001f, 0.0025f});
+    REQUIRE(there.has_value());
+    REQUIRE(there->size() == 3);
+    REQUIRE(there->at(1).location == pair<double, double>{0.0f, 0.002f});
+
+    optional<vector<GraphNode>> back = graph.generateRoute({0.0001f, 0.0025f}, {0.0001f, 0.0005f});
+    REQUIRE(back.has_value());
+    REQUIRE(back->size() == 4);
+    REQUIRE(back->at(1).location == pair<double, double>{0.0f, 0.002f});
+    REQUIRE(back->at(2).location == pair<double, double>{0.0f, 0.001f});
+
+    // Routes carry locations only, shape nodes and phantom ends alike
+    for (const GraphNode &point : *back) {
+        REQUIRE(point.nodeId.empty());
+    }
+}
+
+TEST_CASE("Graph caches snaps until it changes", "[GeoGraph]") {
+    Graph graph(createChains());
+    size_t a = graph.nodeOfInput(0);
+    size_t s1 = graph.nodeOfInput(1);
+
+    // Two locations beside S1, less than half a metre apart and in the same cell
+    pair<float, float> first = {0.000025f, 0.001005f};
+    pair<float, float> second = {0.000028f, 0.001008f};
+
+    // Caching is off until it is asked for
+    REQUIRE(graph.snapToNode(first) == s1);
+    REQUIRE(graph.snapToNode(second) == s1);
+    REQUIRE(graph.snapCacheStats().capacity == 0);
+    REQUIRE(graph.snapCacheStats().hits + graph.snapCacheStats().misses == 0);
+
+    graph.setSnapCacheSize(SERVING_SNAP_CACHE_SLOTS);
+    REQUIRE(graph.snapCacheStats().capacity >= SERVING_SNAP_CACHE_SLOTS);
+
+    REQUIRE(graph.snapToNode(first) == s1);
+    REQUIRE(graph.snapToNode(second) == s1);
+    REQUIRE(graph.snapToNode(second, true) == s1);
+    REQUIRE(graph.snapCacheStats().hits == 1);
+    REQUIRE(graph.snapCacheStats().misses == 2);
+    REQUIRE(graph.snapCacheStats().hitRate() == Approx(1.0 / 3));
+
+    // Compressing makes S1 a shape node, which snaps to the nearer end of its chain instead
+    graph.compressChains();
+    REQUIRE(graph.snapCacheStats().hits == 0);
+    REQUIRE(graph.snapToNode(first) == a);
+
+    optional<PhantomNode> phantom = graph.snapToRoad(first);
+    REQUIRE(graph.snapToRoad(second)->location == phantom->location);
+    REQUIRE(graph.snapCacheStats().hits == 1);
+
+    // Reloading over the graph drops everything it cached
+    stringstream buffer;
+    buffer << graph;
+    buffer >> graph;
+    REQUIRE(graph.snapCacheStats().hits + graph.snapCacheStats().misses == 0);
+
+    graph.setSnapCacheSize(0);
+    REQUIRE(graph.snapToNode(first) == a);
+    REQUIRE(graph.snapToNode(first) == a);
+    REQUIRE(graph.snapCacheStats().hits + graph.snapCacheStats().misses == 0);
+    REQUIRE(graph.snapCacheStats().capacity == 0);
+}
+
+TEST_CASE("Graph routes from the best of several snapping candidates", "[GeoGraph]") {
+    // The nearest node to the origin is a car park exit that leads the long way round;
+    // another 30 m away leads straight to the destination
+    vector<GraphNode> nodes(4);
+    nodes[0].nodeId = "exit";
+    nodes[0].location = {0.0f, 0.0f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"detour", 300.0f}};
+    nodes[1].nodeId = "gate";
+    nodes[1].location = {0.0f, 0.0004f};
+    nodes[1].outboundAccessibleNodesWithTime = {{"dest", 60.0f}};
+    nodes[2].nodeId = "detour";
+    nodes[2].location = {-0.01f, 0.0f};
+    nodes[2].outboundAccessibleNodesWithTime = {{"dest", 300.0f}};
+    nodes[3].nodeId = "dest";
+    nodes[3].location = {0.01f, 0.0f};
+    nodes[3].outboundAccessibleNodesWithTime = {{"exit", 60.0f}, {"gate", 60.0f}};
+
+    Graph graph(nodes);
+    size_t exit = graph.nodeOfInput(0);
+    size_t gate = graph.nodeOfInput(1);
+    size_t dest = graph.nodeOfInput(3);
+    SearchWorkspace workspace;
+
+    optional<vector<GraphNode>> single = graph.generateRouteFromCandidates({0.0f, 0.0001f}, {0.01f, 0.0f}, 1, workspace);
+    REQUIRE(single.has_value());
+    REQUIRE(single->size() == 3);
+    REQUIRE(single->front().location == pair<double, double>(graph.locationOf(exit)));
+
+    optional<vector<GraphNode>> several = graph.generateRouteFromCandidates({0.0f, 0.0001f}, {0.01f, 0.0f}, 2, workspace);
+    REQUIRE(several.has_value());
+    REQUIRE(several->size() == 2);
+    REQUIRE(several->front().location == pair<double, double>(graph.locationOf(gate)));
+    REQUIRE(several->back().location == pair<double, double>(graph.locationOf(dest)));
+
+    // Unless walking to the farther node costs more than the detour
+    optional<vector<GraphNode>> slowWalk = graph.generateRouteFromCandidates({0.0f, 0.0001f}, {0.01f, 0.0f}, 2, workspace, nullptr, 100.0f);
+    REQUIRE(slowWalk->front().location == pair<double, double>(graph.locationOf(exit)));
+}
+
+TEST_CASE("Graph candidate routing matches every pair of candidates", "[GeoGraph]") {
+    // 12x12 grid with random times, one-way eastbound on every third row
+    std::mt19937 generator(47);
+    Graph graph(createRandomStreetGrid(12, generator));
+    SearchWorkspace workspace;
+    std::uniform_real_distribution<float> coordinate(0.0f, 0.011f);
+    const float secondsPerMetre = 0.1f;
+
+    for (size_t query = 0; query < 50; query++) {
+        pair<float, float> origin = {coordinate(generator), coordinate(generator)};
+        pair<float, float> dest = {coordinate(generator), coordinate(generator)};
+
+        vector<size_t> sources;
+        vector<size_t> targets;
+        graph._vertices.kNearest(origin.first, origin.second, 4, sources);
+        graph._vertices.kNearest(dest.first, dest.second, 4, targets);
+        for (size_t &point : sources) point = graph._nodeOfPoint[point];
+        for (size_t &point : targets) point = graph._nodeOfPoint[point];
+
+        // Every pair on its own
+        float expected = std::numeric_limits<float>::infinity();
+        vector<float> costs;
+        for (size_t source : sources) {
+            graph.boundedOneToMany(source, targets, std::numeric_limits<float>::infinity(), workspace, costs);
+
+            for (size_t j = 0; j < targets.size(); j++) {
+                float total = geo::greatCircleMetres(origin, graph.locationOf(source)) * secondsPerMetre + costs[j]
+                    + geo::greatCircleMetres(dest, graph.locationOf(targets[j])) * secondsPerMetre;
+                expected = std::min(expected, total);
+            }
+        }
+
+        optional<vector<GraphNode>> route = graph.generateRouteFromCandidates(origin, dest, 4, workspace, nullptr, secondsPerMetre);
+        REQUIRE(route.has_value());
+
+        size_t start = graph.snapToNode(route->front().location);
+        size_t end = graph.snapToNode(route->back().location);
+        REQUIRE(std::find(sources.begin(), sources.end(), start) != sources.end());
+        REQUIRE(std::find(targets.begin(), targets.end(), end) != targets.end());
+
+        graph.boundedOneToMany(start, {end}, std::numeric_limits<float>::infinity(), workspace, costs);
+        float actual = geo::greatCircleMetres(origin, graph.locationOf(start)) * secondsPerMetre + costs[0]
+            + geo::greatCircleMetres(dest, graph.locationOf(end)) * secondsPerMetre;
+        REQUIRE(actual == Approx(expected));
+    }
+}
+
+TEST_CASE("Graph numbers nodes along a Hilbert curve", "[GeoGraph]") {
+    // A 30 x 30 grid of two-way streets, listed in random order
+    std::mt19937 generator(49);
+    const size_t side = 30;
+
+    vector<GraphNode> nodes = createStreetGrid(side, 9.0f, 7.0f);
+    std::shuffle(nodes.begin(), nodes.end(), generator);
+
+    Graph hilbert(nodes);
+    Graph tree(nodes, VertexOrder::Tree);
+
+    // Either way every input node gets its own id, with its location and roads
+    for (const Graph *graph : {&hilbert, &tree}) {
+        vector<bool> seen(graph->size(), false);
+
+        for (size_t i = 0; i < nodes.size(); i++) {
+            size_t node = graph->nodeOfInput(i);
+            REQUIRE_FALSE(seen[node]);
+            seen[node] = true;
+
+            REQUIRE(graph->locationOf(node).first == Approx(nodes[i].location.first).margin(1e-6));
+            REQUIRE(graph->locationOf(node).second == Approx(nodes[i].location.second).margin(1e-6));
+            REQUIRE(graph->_edges.valuesInRow(node).first.num_items == nodes[i].outboundAccessibleNodesWithTime.size());
+        }
+    }
+
+    // Roads mostly join nodes with nearby ids
+    auto meanGap = [](const Graph &graph) {
+        double gaps = 0.0;
+        for (size_t entry = 0; entry < graph._edges.numEntries(); entry++) {
+            size_t from = graph._edges.rowOfEntry(entry);
+            size_t to = graph._edges.columnOfEntry(entry);
+            gaps += (from > to) ? from - to : to - from;
+        }
+        return gaps / graph._edges.numEntries();
+    };
+    REQUIRE(meanGap(hilbert) * 5 < meanGap(tree));
+
+    // Snapping and routing don't depend on the numbering
+    std::uniform_real_distribution<float> coordinate(0.0f, (side - 1) * 0.001f);
+    for (size_t query = 0; query < 100; query++) {
+        pair<float, float> origin = {coordinate(generator), coordinate(generator)};
+        pair<float, float> dest = {coordinate(generator), coordinate(generator)};
+
+        REQUIRE(hilbert.locationOf(hilbert.snapToNode(origin)) == tree.locationOf(tree.snapToNode(origin)));
+
+        optional<vector<GraphNode>> hilbertRoute = hilbert.generateRoute(origin, dest);
+        optional<vector<GraphNode>> treeRoute = tree.generateRoute(origin, dest);
+        REQUIRE(hilbertRoute->size() == treeRoute->size());
+
+        // Segments of two-way roads run from the lower id, so projections may round differently
+        REQUIRE(hilbertRoute->front().location.first == Approx(treeRoute->front().location.first).margin(1e-6));
+        REQUIRE(hilbertRoute->front().location.second == Approx(treeRoute->front().location.second).margin(1e-6));
+        REQUIRE(hilbertRoute->back().location.first == Approx(treeRoute->back().location.first).margin(1e-6));
+        REQUIRE(hilbertRoute->back().location.second == Approx(treeRoute->back().location.second).margin(1e-6));
+    }
+
+    // The numbering is saved with the graph
+    stringstream buffer;
+    buffer << hilbert;
+    Graph loaded;
+    buffer >> loaded;
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        REQUIRE(loaded.nodeOfInput(i) == hilbert.nodeOfInput(i));
+        REQUIRE(loaded.locationOf(loaded.nodeOfInput(i)) == hilbert.locationOf(hilbert.nodeOfInput(i)));
+    }
+    REQUIRE(loaded._heuristic.lowerBoundSeconds(0, side * side - 1) == hilbert._heuristic.lowerBoundSeconds(0, side * side - 1));
+
+    // Files of another format version are refused rather than misread
+    stringstream saved;
+    saved << hilbert;
+    string bytes = saved.str();
+    bytes[sizeof(uint32_t)]++;
+
+    stringstream stale(bytes);
+    REQUIRE_THROWS_AS(stale >> loaded, runtime_error);
+    REQUIRE(loaded.size() == hilbert.size());
+}
+
+TEST_CASE("Graph builds the same on a pool as without one", "[GeoGraph]") {
+    std::mt19937 generator(37);
+    vector<GraphNode> nodes = createRandomStreetGrid(30, generator);
+
+    ThreadPool pool = ThreadPool(4);
+    Graph serial(nodes);
+    Graph parallel(nodes, VertexOrder::Hilbert, &pool);
+
+    REQUIRE(parallel.size() == serial.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        REQUIRE(parallel.nodeOfInput(i) == serial.nodeOfInput(i));
+        REQUIRE(parallel.locationOf(i) == serial.locationOf(i));
+    }
+
+    REQUIRE(parallel.edges().numEntries() == serial.edges().numEntries());
+    for (size_t entry = 0; entry < serial.edges().numEntries(); entry++) {
+        REQUIRE(parallel.edges().rowOfEntry(entry) == serial.edges().rowOfEntry(entry));
+        REQUIRE(parallel.edges().columnOfEntry(entry) == serial.edges().columnOfEntry(entry));
+        REQUIRE(parallel.edges().valueOfEntry(entry) == serial.edges().valueOfEntry(entry));
+    }
+
+    for (const RouteQuery &query : createGridQueries(50)) {
+        REQUIRE(parallel.snapToNode(query.origin) == serial.snapToNode(query.origin));
+        REQUIRE(parallel.generateRoute(query.origin, query.dest)->size() == serial.generateRoute(query.origin, query.dest)->size());
+    }
+}
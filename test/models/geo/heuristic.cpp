@@ -0,0 +1,138 @@
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/geoData.h"
+#include "models/geo/geoGraph.h"
+#include "models/geo/heuristic.h"
+
+using geo::EARTH_RADIUS_METRES;
+using geo::FASTEST_SPEED_METRES_PER_SECOND;
+using geo::Graph;
+using geo::GraphNode;
+using geo::SearchWorkspace;
+using geo::TravelTimeHeuristic;
+using std::numeric_limits;
+using std::optional;
+using std::pair;
+using std::string;
+using std::to_string;
+using std::vector;
+using utils::Dim2Tree;
+
+// Reference haversine in double precision
+double referenceMetres(const pair<float, float> &loc1, const pair<float, float> &loc2) {
+    const double degrees = std::numbers::pi / 180.0;
+    double dLat = (loc2.first - loc1.first) * degrees;
+    double dLon = (loc2.second - loc1.second) * degrees;
+
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2)
+        + std::cos(loc1.first * degrees) * std::cos(loc2.first * degrees) * std::sin(dLon / 2) * std::sin(dLon / 2);
+
+    return EARTH_RADIUS_METRES * 2 * std::asin(std::sqrt(std::min(a, 1.0)));
+}
+
+TEST_CASE("TravelTimeHeuristic never overestimates the great circle distance", "[TravelTimeHeuristic]") {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> latitude(-89.0f, 89.0f);
+    std::uniform_real_distribution<float> longitude(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> offset(-0.0005f, 0.0005f);
+
+    // Pairs of points anywhere on the globe, and pairs within a few tens of metres
+    vector<pair<float, float>> points;
+    for (size_t i = 0; i < 2000; i++) {
+        pair<float, float> point = {latitude(generator), longitude(generator)};
+        points.push_back(point);
+        points.push_back({point.first + offset(generator), point.second + offset(generator)});
+    }
+    points.push_back({0.0f, 0.0f});
+    points.push_back({0.0f, 180.0f});
+
+    Dim2Tree tree(points);
+    TravelTimeHeuristic heuristic(tree);
+    REQUIRE(heuristic.size() == points.size());
+
+    for (size_t i = 0; i + 1 < points.size(); i += 2) {
+        size_t from = tree.getNewIndex(i);
+        size_t to = tree.getNewIndex(i + 1);
+        double metres = referenceMetres(points[i], points[i + 1]);
+
+        REQUIRE(heuristic.lowerBoundMetres(from, to) <= metres);
+        REQUIRE(heuristic.lowerBoundMetres(to, from) <= metres);
+        REQUIRE(heuristic.lowerBoundSeconds(from, to) <= metres / FASTEST_SPEED_METRES_PER_SECOND);
+
+        // The bound stays tight: the chord is within 0.1% of the arc up to ~600 km, less the slack and rounding
+        if (metres < 600000.0) {
+            REQUIRE(heuristic.lowerBoundMetres(from, to) >= metres * 0.999 - 3.0);
+        }
+    }
+
+    REQUIRE(heuristic.lowerBoundMetres(tree.getNewIndex(3998), tree.getNewIndex(3998)) == 0.0f);
+}
+
+TEST_CASE("A* with the unit vector heuristic finds shortest routes", "[TravelTimeHeuristic]") {
+    // Random road network in a ~5 km square. Each edge takes at least as long as driving its
+    // great circle distance at the speed bound, which is the admissibility precondition. Times
+    // are fractional, so the graph must round them up rather than down when it loads them.
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> coordinate(0.0f, 0.05f);
+    std::uniform_int_distribution<size_t> pick(0, 149);
+    std::uniform_real_distribution<float> slowdown(1.0f, 1.1f);
+
+    vector<GraphNode> nodes(150);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i].nodeId = to_string(i);
+        nodes[i].location = {41.8f + coordinate(generator), -87.7f + coordinate(generator)};
+    }
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (size_t j = 0; j < 4; j++) {
+            size_t neighbor = pick(generator);
+            if (neighbor == i) {
+                continue;
+            }
+
+            double seconds = referenceMetres(nodes[i].location, nodes[neighbor].location) / FASTEST_SPEED_METRES_PER_SECOND;
+            nodes[i].outboundAccessibleNodesWithTime.emplace_back(to_string(neighbor), static_cast<float>(seconds * slowdown(generator)));
+        }
+    }
+
+    Graph graph(nodes);
+    SearchWorkspace workspace;
+    vector<float> costs;
+    size_t dest = graph.nodeOfInput(0);
+
+    // Consistency: h(u) <= w(u, v) + h(v) for every edge, which implies admissibility
+    for (size_t node = 0; node < graph.size(); node++) {
+        auto [times, neighbors] = graph._edges.valuesInRow(node);
+
+        for (size_t i = 0; i < times.num_items; i++) {
+            REQUIRE(graph._heuristic.lowerBoundSeconds(node, dest)
+                <= times.items[i] + graph._heuristic.lowerBoundSeconds(neighbors.items[i], dest));
+        }
+    }
+
+    // Admissibility against exact Dijkstra costs, and A* route cost equal to the Dijkstra cost
+    for (size_t origin = 0; origin < graph.size(); origin++) {
+        graph.boundedOneToMany(origin, {dest}, numeric_limits<float>::infinity(), workspace, costs);
+
+        optional<vector<GraphNode>> route = graph.generateRouteBetweenNodes(origin, dest, workspace);
+
+        if (costs[0] == numeric_limits<float>::infinity()) {
+            REQUIRE_FALSE(route.has_value());
+            continue;
+        }
+
+        REQUIRE(graph._heuristic.lowerBoundSeconds(origin, dest) <= costs[0]);
+        REQUIRE(route.has_value());
+
+        // The workspace still holds the A* search
+        REQUIRE(workspace.cost(dest) == costs[0]);
+    }
+}
@@ -0,0 +1,156 @@
+#include <string>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/geoGraph.h"
+#include "models/geo/mapMatcher.h"
+#include "models/util/threadPool.h"
+
+using geo::GpsTrace;
+using geo::Graph;
+using geo::GraphNode;
+using geo::MapMatcher;
+using geo::MapMatchResult;
+using geo::MapMatchStats;
+using geo::SearchWorkspace;
+using std::string;
+using std::to_string;
+using std::vector;
+using utils::ThreadPool;
+
+// Two parallel east-west roads, 0.001 degrees (~111 m) between nodes.
+// The north road (ids 0-5) is two-way, the south road (ids 6-11) is one-way westbound.
+vector<GraphNode> createTwoRoads() {
+    vector<GraphNode> nodes;
+
+    for (size_t i = 0; i < 12; i++) {
+        GraphNode node;
+        node.nodeId = to_string(i);
+
+        bool north = i < 6;
+        size_t column = i % 6;
+        node.location = {north ? 0.003f : 0.0f, column * 0.001f};
+
+        if (north) {
+            if (column > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string(i - 1), 10.0f);
+            if (column < 5) node.outboundAccessibleNodesWithTime.emplace_back(to_string(i + 1), 10.0f);
+        } else if (column > 0) {
+            node.outboundAccessibleNodesWithTime.emplace_back(to_string(i - 1), 10.0f);
+        }
+
+        nodes.push_back(node);
+    }
+
+    return nodes;
+}
+
+TEST_CASE("MapMatcher snaps a noisy eastbound trace to the two-way road", "[MapMatcher]") {
+    vector<GraphNode> nodes = createTwoRoads();
+    Graph graph(nodes);
+    MapMatcher matcher(graph);
+
+    // Pings are closer to the south road, but it is westbound only
+    GpsTrace trace = {
+        {0.00140f, 0.00000f},
+        {0.00145f, 0.00102f},
+        {0.00138f, 0.00197f},
+        {0.00142f, 0.00300f},
+        {0.00140f, 0.00403f}
+    };
+
+    SearchWorkspace workspace(graph.size());
+    MapMatchResult result = matcher.match(trace, workspace);
+
+    REQUIRE(result.nodes.size() == trace.size());
+    REQUIRE(result.breaks == 0);
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        REQUIRE(result.nodes[i] == graph.nodeOfInput(i));
+    }
+}
+
+TEST_CASE("MapMatcher matches pings partway along compressed chains", "[MapMatcher]") {
+    vector<GraphNode> nodes = createTwoRoads();
+    Graph graph(nodes);
+    MapMatcher matcher(graph);
+
+    // Both roads become single chains, so only their end nodes keep edges of their own
+    graph.compressChains();
+    REQUIRE(graph.isShapeNode(graph.nodeOfInput(2)));
+
+    GpsTrace trace = {
+        {0.00140f, 0.00000f},
+        {0.00145f, 0.00102f},
+        {0.00138f, 0.00197f},
+        {0.00142f, 0.00300f},
+        {0.00140f, 0.00403f},
+        {0.00140f, 0.00500f}
+    };
+
+    SearchWorkspace workspace(graph.size());
+    MapMatchResult result = matcher.match(trace, workspace);
+
+    REQUIRE(result.breaks == 0);
+
+    for (size_t i = 0; i < trace.size(); i++) {
+        REQUIRE(result.nodes[i] == graph.nodeOfInput(i));
+    }
+}
+
+TEST_CASE("MapMatcher leaves pings far from any road unmatched", "[MapMatcher]") {
+    vector<GraphNode> nodes = createTwoRoads();
+    Graph graph(nodes);
+    MapMatcher matcher(graph);
+
+    GpsTrace trace = {
+        {0.003f, 0.000f},
+        {0.050f, 0.050f},
+        {0.003f, 0.001f}
+    };
+
+    SearchWorkspace workspace(graph.size());
+    MapMatchResult result = matcher.match(trace, workspace);
+
+    REQUIRE(result.nodes[0] == graph.nodeOfInput(0));
+    REQUIRE(result.nodes[1] == geo::UNMATCHED);
+    REQUIRE(result.nodes[2] == graph.nodeOfInput(1));
+}
+
+TEST_CASE("MapMatcher batch matching agrees with single trace matching", "[MapMatcher]") {
+    vector<GraphNode> nodes = createTwoRoads();
+    Graph graph(nodes);
+
+    MapMatcher matcher(graph);
+
+    vector<GpsTrace> traces;
+    for (size_t i = 0; i < 10; i++) {
+        GpsTrace trace;
+        for (size_t j = 0; j < 6; j++) {
+            float lat = (i % 2 == 0) ? 0.0028f : 0.0002f;
+            float lon = (i % 2 == 0) ? j * 0.001f : (5 - j) * 0.001f;
+            trace.emplace_back(lat, lon);
+        }
+        traces.push_back(trace);
+    }
+
+    ThreadPool pool(3);
+    MapMatchStats stats;
+    vector<MapMatchResult> results = matcher.matchBatch(traces, &pool, &stats);
+
+    REQUIRE(results.size() == traces.size());
+    REQUIRE(stats.traces == traces.size());
+    REQUIRE(stats.points == 60);
+    REQUIRE(stats.threads == 3);
+
+    SearchWorkspace workspace(graph.size());
+    for (size_t i = 0; i < traces.size(); i++) {
+        MapMatchResult expected = matcher.match(traces[i], workspace);
+        REQUIRE(results[i].nodes == expected.nodes);
+    }
+
+    vector<MapMatchResult> serial = matcher.matchBatch(traces, nullptr, &stats);
+    REQUIRE(stats.threads == 1);
+    for (size_t i = 0; i < traces.size(); i++) {
+        REQUIRE(serial[i].nodes == results[i].nodes);
+    }
+}
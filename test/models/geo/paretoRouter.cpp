@@ -0,0 +1,143 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/geoGraph.h"
+#include "models/geo/paretoRouter.h"
+
+using geo::EdgeCriteria;
+using geo::Graph;
+using geo::GraphNode;
+using geo::ParetoOptions;
+using geo::ParetoResult;
+using geo::ParetoRouter;
+using geo::ParetoWorkspace;
+using std::invalid_argument;
+using std::string;
+using std::vector;
+
+// Four ways from A to B:
+// - highway: 20 s, 800 m, tolled
+// - via E:   40 s, 900 m, toll free
+// - via C:   60 s, 500 m, toll free
+// - via D:   70 s, 600 m, toll free (dominated by the route via C)
+vector<GraphNode> createAlternatives() {
+    vector<GraphNode> nodes(5);
+
+    nodes[0].nodeId = "A";
+    nodes[0].location = {0.0f, 0.0f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"B", 20.0f}, {"C", 30.0f}, {"D", 35.0f}, {"E", 20.0f}};
+    nodes[0].outboundEdgeCriteria = {{800.0f, true}, {250.0f, false}, {300.0f, false}, {450.0f, false}};
+
+    nodes[1].nodeId = "B";
+    nodes[1].location = {0.0f, 0.004f};
+
+    nodes[2].nodeId = "C";
+    nodes[2].location = {0.001f, 0.002f};
+    nodes[2].outboundAccessibleNodesWithTime = {{"B", 30.0f}};
+    nodes[2].outboundEdgeCriteria = {{250.0f, false}};
+
+    nodes[3].nodeId = "D";
+    nodes[3].location = {-0.001f, 0.002f};
+    nodes[3].outboundAccessibleNodesWithTime = {{"B", 35.0f}};
+    nodes[3].outboundEdgeCriteria = {{300.0f, false}};
+
+    nodes[4].nodeId = "E";
+    nodes[4].location = {0.002f, 0.002f};
+    nodes[4].outboundAccessibleNodesWithTime = {{"B", 20.0f}};
+    nodes[4].outboundEdgeCriteria = {{450.0f, false}};
+
+    return nodes;
+}
+
+TEST_CASE("ParetoRouter returns all non-dominated routes over three criteria", "[ParetoRouter]") {
+    Graph graph(createAlternatives());
+
+    ParetoOptions options;
+    options.maxTimeSlack = 3.0f;
+    ParetoRouter router(graph, options);
+
+    ParetoWorkspace workspace;
+    ParetoResult result = router.route({0.0f, 0.0f}, {0.0f, 0.004f}, workspace);
+
+    REQUIRE_FALSE(result.truncated);
+    REQUIRE(result.routes.size() == 3);
+
+    REQUIRE(result.routes[0].criteria.seconds == 20.0f);
+    REQUIRE(result.routes[0].criteria.metres == 800.0f);
+    REQUIRE(result.routes[0].criteria.tolls == 1.0f);
+    REQUIRE(result.routes[0].nodes.size() == 2);
+
+    REQUIRE(result.routes[1].criteria.seconds == 40.0f);
+    REQUIRE(result.routes[1].criteria.metres == 900.0f);
+    REQUIRE(result.routes[1].nodes[1] == graph.nodeOfInput(4));
+
+    REQUIRE(result.routes[2].criteria.seconds == 60.0f);
+    REQUIRE(result.routes[2].criteria.metres == 500.0f);
+    REQUIRE(result.routes[2].nodes[1] == graph.nodeOfInput(2));
+}
+
+TEST_CASE("ParetoRouter ignores tolls with two criteria", "[ParetoRouter]") {
+    Graph graph(createAlternatives());
+
+    ParetoOptions options;
+    options.numCriteria = 2;
+    options.maxTimeSlack = 3.0f;
+    ParetoRouter router(graph, options);
+
+    ParetoWorkspace workspace;
+    ParetoResult result = router.route({0.0f, 0.0f}, {0.0f, 0.004f}, workspace);
+
+    REQUIRE(result.routes.size() == 2);
+    REQUIRE(result.routes[0].criteria.seconds == 20.0f);
+    REQUIRE(result.routes[1].criteria.seconds == 60.0f);
+
+    // Only time and length, or all three criteria, are supported
+    for (size_t numCriteria : {0, 1, 4}) {
+        options.numCriteria = numCriteria;
+        REQUIRE_THROWS_AS(ParetoRouter(graph, options), invalid_argument);
+    }
+}
+
+TEST_CASE("ParetoRouter time slack prunes slow alternatives", "[ParetoRouter]") {
+    Graph graph(createAlternatives());
+
+    ParetoOptions options;
+    options.maxTimeSlack = 1.0f;
+    ParetoRouter router(graph, options);
+
+    // Reusing a workspace across queries must not leak labels between them
+    ParetoWorkspace workspace;
+    router.route({0.0f, 0.0f}, {0.0f, 0.004f}, workspace);
+    ParetoResult result = router.route({0.0f, 0.0f}, {0.0f, 0.004f}, workspace);
+
+    REQUIRE(result.routes.size() == 2);
+    REQUIRE(result.routes[1].criteria.seconds == 40.0f);
+}
+
+TEST_CASE("ParetoRouter reports no routes when the destination is unreachable", "[ParetoRouter]") {
+    Graph graph(createAlternatives());
+    ParetoRouter router(graph);
+
+    ParetoWorkspace workspace;
+    ParetoResult result = router.route({0.0f, 0.004f}, {0.0f, 0.0f}, workspace);
+
+    REQUIRE(result.routes.empty());
+}
+
+TEST_CASE("Graph fills in missing edge lengths from coordinates", "[GeoGraph]") {
+    vector<GraphNode> nodes(2);
+    nodes[0].nodeId = "0";
+    nodes[0].location = {0.0f, 0.0f};
+    nodes[0].outboundAccessibleNodesWithTime = {{"1", 10.0f}};
+
+    nodes[1].nodeId = "1";
+    nodes[1].location = {0.001f, 0.0f};
+
+    Graph graph(nodes);
+
+    REQUIRE(graph._edgeLengths.size() == 1);
+    REQUIRE(graph._edgeLengths[0] == Approx(111.19f).epsilon(0.01));
+    REQUIRE(graph._edgeTolls[0] == 0);
+}
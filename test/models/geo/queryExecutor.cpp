@@ -0,0 +1,118 @@
+#include <atomic>
+#include <future>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/geo/geoGraph.h"
+#include "models/geo/queryExecutor.h"
+#include "models/geo/testGraphs.h"
+
+using geo::ExecutorOptions;
+using geo::ExecutorStats;
+using geo::Graph;
+using geo::GraphNode;
+using geo::QueryExecutor;
+using geo::RouteQuery;
+using geo::SearchWorkspace;
+using geo::SERVING_SNAP_CACHE_SLOTS;
+using std::atomic;
+using std::future;
+using std::numeric_limits;
+using std::optional;
+using std::pair;
+using std::runtime_error;
+using std::to_string;
+using std::vector;
+
+TEST_CASE("QueryExecutor answers routes, matrices, isochrones and snaps", "[QueryExecutor]") {
+    Graph graph(createStreetGrid(10, 12.0f, 10.0f));
+    graph.setSnapCacheSize(SERVING_SNAP_CACHE_SLOTS);
+    QueryExecutor executor(graph, ExecutorOptions{4, true});
+    REQUIRE(executor.size() == 4);
+
+    vector<RouteQuery> queries = createGridQueries(200);
+    vector<future<optional<vector<GraphNode>>>> routes;
+    for (const RouteQuery &query : queries) {
+        routes.push_back(executor.route(query));
+    }
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        optional<vector<GraphNode>> route = routes[i].get();
+        optional<vector<GraphNode>> expected = graph.generateRoute(queries[i].origin, queries[i].dest);
+
+        REQUIRE(route.has_value());
+        REQUIRE(route->size() == expected->size());
+        for (size_t j = 0; j < expected->size(); j++) {
+            REQUIRE(route->at(j).location == expected->at(j).location);
+        }
+    }
+
+    // The queries only start and end at a hundred locations
+    REQUIRE(executor.stats().snapCacheHitRate > 0.5);
+
+    // Corner to corner is 9 rows and 9 columns away
+    size_t corner = graph.nodeOfInput(0);
+    size_t farCorner = graph.nodeOfInput(99);
+    REQUIRE(executor.snap({0.0001f, -0.0001f}).get() == corner);
+
+    vector<float> costs = executor.matrix({corner, farCorner}, {corner, farCorner, corner}).get();
+    REQUIRE(costs == vector<float>{0.0f, 198.0f, 0.0f, 198.0f, 0.0f, 198.0f});
+
+    REQUIRE(executor.matrix({}, {corner}).get().empty());
+    REQUIRE(executor.matrix({corner}, {farCorner}, 100.0f).get()[0] == numeric_limits<float>::infinity());
+
+    // Within 22 s of the corner: itself, two steps along the row, one down the column, and the diagonal
+    vector<pair<size_t, float>> reached = executor.isochrone(corner, 22.0f).get();
+    REQUIRE(reached.size() == 5);
+    REQUIRE(reached[0] == pair<size_t, float>{corner, 0.0f});
+    REQUIRE(reached[4].second == 22.0f);
+}
+
+TEST_CASE("QueryExecutor runs nested tasks, callbacks and reports stats", "[QueryExecutor]") {
+    const Graph graph(createStreetGrid(10, 12.0f, 10.0f));
+    QueryExecutor executor(graph, ExecutorOptions{3, false});
+
+    // Each outer task fans out inner tasks onto its own deque, for idle workers to steal
+    atomic<size_t> inner = 0;
+    for (size_t i = 0; i < 20; i++) {
+        executor.post([&executor, &inner](const Graph &graph, SearchWorkspace &workspace) {
+            for (size_t j = 0; j < 50; j++) {
+                executor.post([&inner, j](const Graph &graph, SearchWorkspace &workspace) {
+                    graph.generateRouteBetweenNodes(j % graph.size(), (j * 37) % graph.size(), workspace);
+                    inner++;
+                });
+            }
+            graph.generateRouteBetweenNodes(0, graph.size() - 1, workspace);
+        });
+    }
+
+    executor.wait();
+    REQUIRE(inner == 1000);
+
+    future<size_t> size = executor.submit([](const Graph &graph, SearchWorkspace &) { return graph.size(); });
+    REQUIRE(size.get() == 100);
+
+    // Exceptions reach the caller through the future, and count as failed for posted tasks
+    future<void> failing = executor.submit([](const Graph &, SearchWorkspace &) { throw runtime_error("failed"); });
+    REQUIRE_THROWS_AS(failing.get(), runtime_error);
+
+    executor.post([](const Graph &, SearchWorkspace &) { throw runtime_error("failed"); });
+    executor.wait();
+
+    ExecutorStats stats = executor.stats();
+    REQUIRE(stats.threads == 3);
+    REQUIRE(stats.tasksCompleted == 1023);
+    REQUIRE(stats.tasksFailed == 1);
+    REQUIRE(stats.tasksPerSecond() > 0.0);
+    REQUIRE(stats.p50LatencyMs <= stats.p99LatencyMs);
+    REQUIRE(stats.p99LatencyMs <= stats.maxLatencyMs);
+
+    executor.resetStats();
+    REQUIRE(executor.stats().tasksCompleted == 0);
+}
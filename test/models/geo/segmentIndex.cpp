@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/geoData.h"
+#include "models/geo/segmentIndex.h"
+#include "models/util/threadPool.h"
+
+using geo::convertToRadians;
+using geo::SegmentIndex;
+using geo::SegmentProjection;
+using std::invalid_argument;
+using std::optional;
+using std::pair;
+using std::stringstream;
+using std::vector;
+using utils::ThreadPool;
+
+// Squared distance from the location to the segment, in the plane the index ranks by
+float planeDistance(pair<float, float> location, pair<float, float> start, pair<float, float> end) {
+    float lonScale = std::cos(convertToRadians(location.first));
+    float startY = start.first - location.first;
+    float startX = (start.second - location.second) * lonScale;
+    float dY = end.first - start.first;
+    float dX = (end.second - start.second) * lonScale;
+
+    float lengthSquared = dX * dX + dY * dY;
+    float fraction = (lengthSquared > 0.0f) ? std::clamp(-(startX * dX + startY * dY) / lengthSquared, 0.0f, 1.0f) : 0.0f;
+    float y = startY + fraction * dY;
+    float x = startX + fraction * dX;
+    return x * x + y * y;
+}
+
+TEST_CASE("SegmentIndex finds the nearest segment", "[SegmentIndex]") {
+    std::mt19937 generator(46);
+    std::uniform_real_distribution<float> coordinate(40.0f, 41.0f);
+    std::uniform_real_distribution<float> step(-0.01f, 0.01f);
+
+    // Short roads, plus a few long ones that cross many leaves
+    vector<pair<float, float>> starts;
+    vector<pair<float, float>> ends;
+    for (size_t i = 0; i < 20000; i++) {
+        pair<float, float> start = {coordinate(generator), coordinate(generator)};
+        float length = (i % 1000 == 0) ? 50.0f : 1.0f;
+        starts.push_back(start);
+        ends.push_back({start.first + step(generator) * length, start.second + step(generator) * length});
+    }
+
+    ThreadPool pool(3);
+    SegmentIndex serial(starts, ends);
+    SegmentIndex parallel(starts, ends, &pool);
+    REQUIRE(serial.size() == starts.size());
+
+    for (size_t query = 0; query < 300; query++) {
+        pair<float, float> location = {coordinate(generator), coordinate(generator)};
+
+        float expected = std::numeric_limits<float>::infinity();
+        float expectedEven = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < starts.size(); i++) {
+            float distance = planeDistance(location, starts[i], ends[i]);
+            expected = std::min(expected, distance);
+            if (i % 2 == 0) {
+                expectedEven = std::min(expectedEven, distance);
+            }
+        }
+
+        for (const SegmentIndex *index : {&serial, &parallel}) {
+            optional<SegmentProjection> nearest = index->nearest(location);
+            REQUIRE(nearest.has_value());
+            REQUIRE(planeDistance(location, starts[nearest->segment], ends[nearest->segment]) == Approx(expected).epsilon(1e-4));
+            REQUIRE(nearest->fraction >= 0.0f);
+            REQUIRE(nearest->fraction <= 1.0f);
+
+            // The projection lies on the segment, at the given fraction
+            const pair<float, float> &start = starts[nearest->segment];
+            const pair<float, float> &end = ends[nearest->segment];
+            REQUIRE(nearest->location.first == Approx(start.first + nearest->fraction * (end.first - start.first)));
+            REQUIRE(nearest->location.second == Approx(start.second + nearest->fraction * (end.second - start.second)));
+            REQUIRE(nearest->metres == Approx(geo::greatCircleMetres(location, nearest->location)));
+
+            optional<SegmentProjection> even = index->nearest(location, [](size_t segment) {
+                return segment % 2 == 0;
+            });
+            REQUIRE(even->segment % 2 == 0);
+            REQUIRE(planeDistance(location, starts[even->segment], ends[even->segment]) == Approx(expectedEven).epsilon(1e-4));
+        }
+    }
+
+    // Both builds pack the same tree, which survives serialization
+    stringstream buffer;
+    buffer << parallel;
+    SegmentIndex loaded;
+    buffer >> loaded;
+
+    REQUIRE(loaded.memoryBytes() == serial.memoryBytes());
+    for (size_t query = 0; query < 100; query++) {
+        pair<float, float> location = {coordinate(generator), coordinate(generator)};
+        REQUIRE(loaded.nearest(location)->segment == serial.nearest(location)->segment);
+    }
+}
+
+TEST_CASE("SegmentIndex handles degenerate input", "[SegmentIndex]") {
+    SegmentIndex empty;
+    REQUIRE_FALSE(empty.nearest({0.0f, 0.0f}).has_value());
+
+    // A single segment, and one of zero length
+    vector<pair<float, float>> starts = {{0.0f, 0.0f}, {1.0f, 1.0f}};
+    vector<pair<float, float>> ends = {{0.0f, 0.002f}, {1.0f, 1.0f}};
+    SegmentIndex index(starts, ends);
+
+    optional<SegmentProjection> middle = index.nearest({0.0005f, 0.0015f});
+    REQUIRE(middle->segment == 0);
+    REQUIRE(middle->fraction == Approx(0.75f));
+    REQUIRE(middle->metres == Approx(55.6f).epsilon(0.01));
+
+    optional<SegmentProjection> point = index.nearest({1.1f, 1.0f});
+    REQUIRE(point->segment == 1);
+    REQUIRE(point->fraction == 0.0f);
+
+    REQUIRE_FALSE(index.nearest({0.0f, 0.0f}, [](size_t) { return false; }).has_value());
+
+    vector<pair<float, float>> tooFew = {{0.0f, 0.0f}};
+    REQUIRE_THROWS_AS(SegmentIndex(starts, tooFew), invalid_argument);
+}
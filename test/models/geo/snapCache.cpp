@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/snapCache.h"
+
+using geo::SnapCache;
+using geo::SnapCacheStats;
+using std::atomic;
+using std::optional;
+using std::pair;
+using std::thread;
+using std::vector;
+
+// Wider than a word, so a torn read would show as mismatched copies
+struct CachedKey {
+    uint64_t copies[3];
+};
+
+TEST_CASE("SnapCache keys locations by cells of about a metre", "[SnapCache]") {
+    using Cache = SnapCache<size_t>;
+
+    uint64_t key = Cache::cellKey({41.878113f, -87.629799f});
+    REQUIRE(Cache::cellKey({41.878113f, -87.629799f}) == key);
+    REQUIRE(Cache::cellKey({41.878113f, -87.629799f}, true) != key);
+
+    // A cell over in either direction
+    REQUIRE(Cache::cellKey({41.878123f, -87.629799f}) != key);
+    REQUIRE(Cache::cellKey({41.878113f, -87.629809f}) != key);
+    REQUIRE(Cache::cellKey({-41.878113f, -87.629799f}) != key);
+    REQUIRE(Cache::cellKey({41.878113f, 87.629799f}) != key);
+
+    REQUIRE(Cache::cellKey({std::nanf(""), 0.0f}) == Cache::NO_KEY);
+    REQUIRE(Cache::cellKey({0.0f, std::numeric_limits<float>::infinity()}) == Cache::NO_KEY);
+}
+
+TEST_CASE("SnapCache stays within its capacity", "[SnapCache]") {
+    SnapCache<size_t> cache(100);
+    REQUIRE(cache.stats().capacity == 128);
+
+    // Far more cells than slots: every value found is the one stored for its key, and the latest always is
+    for (size_t i = 0; i < 5000; i++) {
+        pair<float, float> location = {(i % 70) * 0.001f, (i / 70) * 0.001f};
+        uint64_t key = SnapCache<size_t>::cellKey(location);
+        cache.insert(key, i);
+        REQUIRE(cache.find(key) == optional<size_t>(i));
+    }
+
+    size_t found = 0;
+    for (size_t i = 0; i < 5000; i++) {
+        pair<float, float> location = {(i % 70) * 0.001f, (i / 70) * 0.001f};
+        optional<size_t> value = cache.find(SnapCache<size_t>::cellKey(location));
+        if (value.has_value()) {
+            REQUIRE(*value == i);
+            found++;
+        }
+    }
+    REQUIRE(found > 64);
+    REQUIRE(found <= 128);
+
+    // findOrCompute only computes on a miss
+    size_t computed = 0;
+    auto compute = [&computed] { return ++computed; };
+    cache.clear();
+    REQUIRE(cache.findOrCompute({1.0f, 1.0f}, false, compute) == 1);
+    REQUIRE(cache.findOrCompute({1.000001f, 1.000001f}, false, compute) == 1);
+    REQUIRE(cache.findOrCompute({1.0f, 1.0f}, true, compute) == 2);
+
+    SnapCacheStats stats = cache.stats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 2);
+
+    cache.clear();
+    REQUIRE(cache.stats().hits == 0);
+    REQUIRE_FALSE(cache.find(SnapCache<size_t>::cellKey({1.0f, 1.0f})).has_value());
+
+    // Copies start empty, and a cache without slots caches nothing
+    SnapCache<size_t> copy = cache;
+    REQUIRE(copy.stats().capacity == 128);
+
+    SnapCache<size_t> disabled;
+    REQUIRE(disabled.findOrCompute({1.0f, 1.0f}, false, compute) == 3);
+    REQUIRE(disabled.findOrCompute({1.0f, 1.0f}, false, compute) == 4);
+    REQUIRE(disabled.stats().misses == 0);
+}
+
+TEST_CASE("SnapCache reads never see a half-written value", "[SnapCache]") {
+    // Few slots and many cells, so writers keep evicting what readers are reading
+    SnapCache<CachedKey> cache(32);
+    atomic<bool> torn = false;
+    atomic<size_t> hits = 0;
+
+    vector<thread> threads;
+    for (size_t t = 0; t < 4; t++) {
+        threads.emplace_back([&cache, &torn, &hits, t] {
+            for (size_t i = 0; i < 20000; i++) {
+                pair<float, float> location = {((i * 7 + t) % 200) * 0.0001f, 0.0f};
+                uint64_t key = SnapCache<CachedKey>::cellKey(location);
+
+                CachedKey value = cache.findOrCompute(location, false, [key] {
+                    return CachedKey{{key, key, key}};
+                });
+
+                if (value.copies[0] != key || value.copies[1] != key || value.copies[2] != key) {
+                    torn = true;
+                }
+            }
+
+            hits += cache.stats().hits;
+        });
+    }
+
+    for (thread &runner : threads) {
+        runner.join();
+    }
+
+    REQUIRE_FALSE(torn);
+    REQUIRE(hits > 0);
+}
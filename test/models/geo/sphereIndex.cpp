@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/geoData.h"
+#include "models/geo/sphereIndex.h"
+
+using geo::EARTH_RADIUS_METRES;
+using geo::SphereIndex;
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+
+// Haversine in double precision
+double sphereReferenceMetres(const pair<float, float> &loc1, const pair<float, float> &loc2) {
+    const double degrees = std::numbers::pi / 180.0;
+    double dLat = (loc2.first - loc1.first) * degrees;
+    double dLon = (loc2.second - loc1.second) * degrees;
+
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2)
+        + std::cos(loc1.first * degrees) * std::cos(loc2.first * degrees) * std::sin(dLon / 2) * std::sin(dLon / 2);
+
+    return EARTH_RADIUS_METRES * 2 * std::asin(std::sqrt(std::min(a, 1.0)));
+}
+
+TEST_CASE("SphereIndex finds the nearest locations by great circle distance", "[SphereIndex]") {
+    std::mt19937 generator(17);
+
+    // Around the north pole and across the antimeridian, where degrees are most distorted
+    std::uniform_real_distribution<float> latitude(75.0f, 90.0f);
+    std::uniform_real_distribution<float> longitude(-180.0f, 180.0f);
+    std::uniform_real_distribution<float> nearDateline(-0.5f, 0.5f);
+
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 3000; i++) {
+        lats.push_back(latitude(generator));
+        lons.push_back(i % 3 == 0 ? std::remainder(180.0f + nearDateline(generator), 360.0f) : longitude(generator));
+    }
+
+    SphereIndex index(lats, lons);
+    REQUIRE(index.size() == lats.size());
+
+    // Float unit vectors are good to well under a metre on the ground
+    const double slackMetres = 1.0;
+
+    for (size_t query = 0; query < 300; query++) {
+        pair<float, float> location = {latitude(generator), std::remainder(180.0f + nearDateline(generator) * (query % 4 + 1), 360.0f)};
+
+        vector<double> expected;
+        for (size_t i = 0; i < lats.size(); i++) {
+            expected.push_back(sphereReferenceMetres(location, {lats[i], lons[i]}));
+        }
+        vector<double> sorted = expected;
+        std::sort(sorted.begin(), sorted.end());
+
+        REQUIRE(expected[index.nearest(location)] <= sorted[0] + slackMetres);
+
+        vector<size_t> nearest = {99999};
+        index.kNearest(location, 5, nearest);
+        REQUIRE(nearest.size() == 6);
+        REQUIRE(nearest[0] == 99999);
+        for (size_t i = 1; i < nearest.size(); i++) {
+            REQUIRE(std::abs(expected[nearest[i]] - sorted[i - 1]) <= slackMetres);
+        }
+
+        // Everything well inside the radius is found, and nothing well outside it
+        float radius = 20000.0f;
+        vector<size_t> within;
+        index.withinMetres(location, radius, within);
+        for (size_t i : within) {
+            REQUIRE(expected[i] <= radius + slackMetres);
+        }
+
+        size_t inside = std::count_if(expected.begin(), expected.end(), [&](double metres) { return metres <= radius - slackMetres; });
+        REQUIRE(within.size() >= inside);
+    }
+
+    // A radius past half the circumference covers the globe
+    vector<size_t> everything;
+    index.withinMetres({-45.0f, 0.0f}, 1e8f, everything);
+    REQUIRE(everything.size() == lats.size());
+}
+
+TEST_CASE("SphereIndex rejects bad input", "[SphereIndex]") {
+    REQUIRE_THROWS_AS(SphereIndex(vector<float>(3), vector<float>(2)), invalid_argument);
+    REQUIRE_THROWS_AS(SphereIndex().nearest({0.0f, 0.0f}), out_of_range);
+}
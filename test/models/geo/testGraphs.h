@@ -0,0 +1,71 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "models/geo/geoData.h"
+#include "models/geo/geoGraph.h"
+
+using geo::GraphNode;
+using geo::RouteQuery;
+using std::pair;
+using std::to_string;
+using std::vector;
+
+// Grid of two-way streets, side x side, 0.001 degrees (~111 m) apart. Node id is row * side + column.
+// Streets between rows take rowSeconds, and streets between columns take columnSeconds.
+inline vector<GraphNode> createStreetGrid(size_t side, float rowSeconds, float columnSeconds) {
+    vector<GraphNode> nodes(side * side);
+
+    for (size_t row = 0; row < side; row++) {
+        for (size_t column = 0; column < side; column++) {
+            GraphNode &node = nodes[row * side + column];
+            node.nodeId = to_string(row * side + column);
+            node.location = {row * 0.001f, column * 0.001f};
+
+            if (row > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row - 1) * side + column), rowSeconds);
+            if (row + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row + 1) * side + column), rowSeconds);
+            if (column > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column - 1), columnSeconds);
+            if (column + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column + 1), columnSeconds);
+        }
+    }
+
+    return nodes;
+}
+
+// The same grid with random times between 5 and 30 seconds. Every third row is one-way
+// eastbound, so drive times to and from a node differ.
+inline vector<GraphNode> createRandomStreetGrid(size_t side, std::mt19937 &generator) {
+    std::uniform_int_distribution<int> seconds(5, 30);
+    vector<GraphNode> nodes(side * side);
+
+    for (size_t row = 0; row < side; row++) {
+        for (size_t column = 0; column < side; column++) {
+            GraphNode &node = nodes[row * side + column];
+            node.nodeId = to_string(row * side + column);
+            node.location = {row * 0.001f, column * 0.001f};
+
+            if (column + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column + 1), seconds(generator));
+            if (column > 0 && row % 3 != 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string(row * side + column - 1), seconds(generator));
+            if (row + 1 < side) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row + 1) * side + column), seconds(generator));
+            if (row > 0) node.outboundAccessibleNodesWithTime.emplace_back(to_string((row - 1) * side + column), seconds(generator));
+        }
+    }
+
+    return nodes;
+}
+
+// Queries between nodes of a 10 x 10 street grid, spread over the whole grid
+inline vector<RouteQuery> createGridQueries(size_t count) {
+    vector<RouteQuery> queries;
+
+    for (size_t i = 0; i < count; i++) {
+        queries.push_back(RouteQuery{
+            {(i % 10) * 0.001f, (i * 7 % 10) * 0.001f},
+            {(i * 3 % 10) * 0.001f, (i / 20 % 10) * 0.001f}
+        });
+    }
+
+    return queries;
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/geo/exclusionOverlay.h"
+#include "models/geo/geoGraph.h"
+#include "models/geo/testGraphs.h"
+#include "models/geo/vehicleIndex.h"
+
+using geo::ExclusionOverlay;
+using geo::Graph;
+using geo::GraphNode;
+using geo::NearbyVehicle;
+using geo::NOT_PLACED;
+using geo::SearchWorkspace;
+using geo::VehicleIndex;
+using geo::VehicleIndexOptions;
+using std::pair;
+using std::to_string;
+using std::vector;
+using utils::ThreadPool;
+
+TEST_CASE("VehicleIndex finds the vehicles with the shortest drive times", "[VehicleIndex]") {
+    std::mt19937 generator(45);
+    Graph graph(createRandomStreetGrid(20, generator));
+    VehicleIndex vehicles(graph, 100);
+
+    std::uniform_real_distribution<float> coordinate(0.0f, 0.019f);
+    for (size_t vehicle = 0; vehicle < 100; vehicle += 2) {
+        REQUIRE(vehicles.update(vehicle, {coordinate(generator), coordinate(generator)}));
+    }
+    REQUIRE(vehicles.size() == 50);
+
+    // Close a few streets, which the reverse search must honour in the forward direction
+    ExclusionOverlay overlay(graph);
+    for (size_t i = 0; i < 30; i++) {
+        auto [times, neighbors] = graph._edges.valuesInRow(i * 7);
+        overlay.closeEdge(i * 7, neighbors.items[0]);
+    }
+
+    SearchWorkspace workspace(graph.size());
+    vector<const ExclusionOverlay *> overlays = {nullptr, &overlay};
+    for (const ExclusionOverlay *closures : overlays) {
+        for (size_t query = 0; query < 20; query++) {
+            pair<float, float> incident = {coordinate(generator), coordinate(generator)};
+            size_t incidentNode = graph.snapToNode(incident, true);
+
+            // Brute force: a forward search from every vehicle
+            vector<float> expected;
+            vector<float> cost;
+            for (size_t vehicle = 0; vehicle < 100; vehicle += 2) {
+                graph.boundedOneToMany(vehicles.nodeOf(vehicle), {incidentNode}, std::numeric_limits<float>::infinity(),
+                                       workspace, cost, closures);
+                expected.push_back(cost[0]);
+            }
+            std::sort(expected.begin(), expected.end());
+
+            vector<NearbyVehicle> nearest = {{999, 0.0f}};
+            vehicles.nearestByDriveTime(incident, 5, workspace, nearest, std::numeric_limits<float>::infinity(), closures);
+            REQUIRE(nearest.size() == 6);
+
+            for (size_t i = 1; i < nearest.size(); i++) {
+                REQUIRE(nearest[i].vehicle % 2 == 0);
+                REQUIRE(nearest[i].seconds == expected[i - 1]);
+
+                graph.boundedOneToMany(vehicles.nodeOf(nearest[i].vehicle), {incidentNode},
+                                       std::numeric_limits<float>::infinity(), workspace, cost, closures);
+                REQUIRE(cost[0] == nearest[i].seconds);
+            }
+
+            // The time limit cuts the list short
+            vector<NearbyVehicle> bounded;
+            vehicles.nearestByDriveTimeToNode(incidentNode, 50, workspace, bounded, expected[2], closures);
+            REQUIRE(bounded.size() == size_t(std::upper_bound(expected.begin(), expected.end(), expected[2]) - expected.begin()));
+        }
+    }
+}
+
+TEST_CASE("VehicleIndex only snaps vehicles again once they have moved far enough", "[VehicleIndex]") {
+    std::mt19937 generator(46);
+    Graph graph(createRandomStreetGrid(5, generator));
+
+    VehicleIndexOptions options;
+    options.resnapMetres = 50.0f;
+    VehicleIndex vehicles(graph, 3, options);
+
+    REQUIRE(vehicles.nodeOf(0) == NOT_PLACED);
+    REQUIRE(vehicles.update(0, {0.0f, 0.0f}));
+    size_t start = vehicles.nodeOf(0);
+    REQUIRE(start == graph.snapToNode({0.0f, 0.0f}));
+
+    // About 44 m, past the midpoint between nodes but within the threshold
+    REQUIRE_FALSE(vehicles.update(0, {0.0f, 0.0004f}));
+    REQUIRE(vehicles.nodeOf(0) == start);
+
+    REQUIRE(vehicles.update(0, {0.0f, 0.0009f}));
+    REQUIRE(vehicles.nodeOf(0) == graph.snapToNode({0.0f, 0.001f}));
+
+    // Two vehicles on one node, then one leaves
+    REQUIRE(vehicles.update(1, {0.0f, 0.001f}));
+    REQUIRE(vehicles.size() == 2);
+
+    SearchWorkspace workspace(graph.size());
+    vector<NearbyVehicle> nearest;
+    vehicles.nearestByDriveTimeToNode(vehicles.nodeOf(0), 5, workspace, nearest);
+    REQUIRE(nearest.size() == 2);
+    REQUIRE(nearest[0].seconds == 0.0f);
+    REQUIRE(nearest[1].seconds == 0.0f);
+
+    REQUIRE(vehicles.remove(0));
+    REQUIRE_FALSE(vehicles.remove(0));
+    REQUIRE(vehicles.size() == 1);
+
+    nearest.clear();
+    vehicles.nearestByDriveTimeToNode(vehicles.nodeOf(1), 5, workspace, nearest);
+    REQUIRE(nearest.size() == 1);
+    REQUIRE(nearest[0].vehicle == 1);
+
+    REQUIRE_THROWS_AS(vehicles.update(3, {0.0f, 0.0f}), std::out_of_range);
+}
+
+TEST_CASE("VehicleIndex answers queries while vehicles move", "[VehicleIndex]") {
+    std::mt19937 generator(47);
+    Graph graph(createRandomStreetGrid(30, generator));
+    VehicleIndexOptions options;
+    options.resnapMetres = 0.0f;
+    VehicleIndex vehicles(graph, 2000, options);
+    ThreadPool pool(2);
+
+    std::uniform_real_distribution<float> coordinate(0.0f, 0.029f);
+    vector<size_t> ids(2000);
+    vector<pair<float, float>> locations(2000);
+    for (size_t i = 0; i < ids.size(); i++) {
+        ids[i] = i;
+        locations[i] = {coordinate(generator), coordinate(generator)};
+    }
+    REQUIRE(vehicles.updateBatch(ids, locations, pool) == 2000);
+
+    std::atomic<bool> done = false;
+    std::thread mover([&]() {
+        std::mt19937 moverGenerator(48);
+        for (size_t round = 0; round < 20; round++) {
+            for (pair<float, float> &location : locations) {
+                location = {coordinate(moverGenerator), coordinate(moverGenerator)};
+            }
+            vehicles.updateBatch(ids, locations, pool);
+        }
+        done = true;
+    });
+
+    SearchWorkspace workspace(graph.size());
+    size_t queries = 0;
+    while (!done || queries < 100) {
+        vector<NearbyVehicle> nearest;
+        vehicles.nearestByDriveTime({coordinate(generator), coordinate(generator)}, 10, workspace, nearest);
+
+        REQUIRE(nearest.size() == 10);
+        for (size_t i = 1; i < nearest.size(); i++) {
+            REQUIRE(nearest[i - 1].seconds <= nearest[i].seconds);
+            for (size_t j = 0; j < i; j++) {
+                REQUIRE(nearest[j].vehicle != nearest[i].vehicle);
+            }
+        }
+        queries++;
+    }
+
+    mover.join();
+    REQUIRE(vehicles.size() == 2000);
+}
@@ -0,0 +1,120 @@
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/linalg/components.h"
+#include "models/linalg/csr.h"
+#include "models/util/threadPool.h"
+
+using linalg::ComponentAnalysis;
+using linalg::CsrMatrix;
+using linalg::MutableCsrMatrix;
+using std::vector;
+using utils::ThreadPool;
+
+// Every edge must go forward (or stay) in the topological numbering
+void requireTopologicalOrder(const CsrMatrix &matrix, const ComponentAnalysis &analysis) {
+    for (size_t row = 0; row < matrix.numRows(); row++) {
+        auto columns = matrix.valuesInRow(row).second;
+        for (size_t i = 0; i < columns.num_items; i++) {
+            REQUIRE(analysis.componentOf[row] <= analysis.componentOf[columns.items[i]]);
+        }
+    }
+}
+
+TEST_CASE("Strongly connected components of a small graph", "[Components]") {
+    // 0 <-> 1 -> 2 <-> 3, and an isolated pair 4 <-> 5
+    vector<vector<uint16_t>> dense = {
+        {0, 1, 0, 0, 0, 0},
+        {1, 0, 1, 0, 0, 0},
+        {0, 0, 0, 1, 0, 0},
+        {0, 0, 1, 0, 0, 0},
+        {0, 0, 0, 0, 0, 1},
+        {0, 0, 0, 0, 1, 0}
+    };
+
+    CsrMatrix matrix(dense);
+    ThreadPool pool(2);
+    ComponentAnalysis analysis = linalg::analyzeComponents(matrix, &pool);
+
+    REQUIRE(analysis.componentSize.size() == 3);
+    REQUIRE(analysis.componentOf[0] == analysis.componentOf[1]);
+    REQUIRE(analysis.componentOf[2] == analysis.componentOf[3]);
+    REQUIRE(analysis.componentOf[4] == analysis.componentOf[5]);
+    REQUIRE(analysis.componentOf[0] < analysis.componentOf[2]);
+    REQUIRE(analysis.componentSize[analysis.componentOf[0]] == 2);
+
+    uint32_t first = analysis.componentOf[0];
+    uint32_t second = analysis.componentOf[2];
+    uint32_t island = analysis.componentOf[4];
+    REQUIRE(analysis.weakComponentOf[first] == analysis.weakComponentOf[second]);
+    REQUIRE(analysis.weakComponentOf[first] != analysis.weakComponentOf[island]);
+
+    requireTopologicalOrder(matrix, analysis);
+}
+
+TEST_CASE("Trimmed nodes are not searched again", "[Components]") {
+    // 0 <-> 1 -> 2, where 2 has no way out and is trimmed before the search
+    vector<vector<uint16_t>> dense = {
+        {0, 1, 0},
+        {1, 0, 1},
+        {0, 0, 0}
+    };
+
+    CsrMatrix matrix(dense);
+    ComponentAnalysis analysis = linalg::analyzeComponents(matrix);
+
+    REQUIRE(analysis.componentSize.size() == 2);
+    for (uint32_t size : analysis.componentSize) {
+        REQUIRE(size > 0);
+    }
+
+    REQUIRE(analysis.componentOf[0] == analysis.componentOf[1]);
+    REQUIRE(analysis.componentOf[2] != analysis.componentOf[0]);
+    requireTopologicalOrder(matrix, analysis);
+}
+
+TEST_CASE("Strongly connected components of a large graph use the parallel split", "[Components]") {
+    // Two large rings joined by a one-way bridge, with a one-way tail hanging off the second ring
+    const size_t ringSize = 20000;
+    const size_t tailSize = 100;
+    const size_t numNodes = 2 * ringSize + tailSize;
+
+    MutableCsrMatrix edges(numNodes, numNodes);
+    for (size_t ring = 0; ring < 2; ring++) {
+        size_t base = ring * ringSize;
+        for (size_t i = 0; i < ringSize; i++) {
+            edges.addEntry(base + i, base + (i + 1) % ringSize, 1);
+        }
+    }
+
+    edges.addEntry(0, ringSize, 1);
+
+    edges.addEntry(ringSize + 5, 2 * ringSize, 1);
+    for (size_t i = 0; i + 1 < tailSize; i++) {
+        edges.addEntry(2 * ringSize + i, 2 * ringSize + i + 1, 1);
+    }
+
+    CsrMatrix matrix(edges);
+    ThreadPool pool(4);
+    ComponentAnalysis analysis = linalg::analyzeComponents(matrix, &pool);
+
+    REQUIRE(analysis.componentSize.size() == 2 + tailSize);
+    for (uint32_t size : analysis.componentSize) {
+        REQUIRE(size > 0);
+    }
+
+    for (size_t i = 1; i < ringSize; i++) {
+        REQUIRE(analysis.componentOf[i] == analysis.componentOf[0]);
+        REQUIRE(analysis.componentOf[ringSize + i] == analysis.componentOf[ringSize]);
+    }
+
+    REQUIRE(analysis.componentOf[0] < analysis.componentOf[ringSize]);
+    REQUIRE(analysis.componentSize[analysis.largestComponent] == ringSize);
+
+    for (size_t i = 0; i < tailSize; i++) {
+        REQUIRE(analysis.componentSize[analysis.componentOf[2 * ringSize + i]] == 1);
+    }
+
+    requireTopologicalOrder(matrix, analysis);
+}
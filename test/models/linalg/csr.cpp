@@ -103,3 +103,41 @@ TEST_CASE("Conversion from MutableCsrMatrix to CsrMatrix", "[CsrMatrix][MutableC
     REQUIRE(immutableMatrix(3, 2) == 0);
     REQUIRE(immutableMatrix(3, 3) == 0);
 }
+
+TEST_CASE("CsrMatrix transpose", "[CsrMatrix]") {
+    vector<vector<uint16_t>> denseMatrix = {
+        {0, 0, 1, 0},
+        {2, 3, 0, 4},
+        {0, 0, 0, 0}
+    };
+
+    CsrMatrix transposed = CsrMatrix(denseMatrix).transpose();
+
+    REQUIRE(transposed.numRows() == 4);
+    REQUIRE(transposed.numCols() == 3);
+    REQUIRE(transposed.numEntries() == 4);
+
+    for (size_t row = 0; row < denseMatrix.size(); row++) {
+        for (size_t col = 0; col < denseMatrix[row].size(); col++) {
+            REQUIRE(transposed(col, row) == denseMatrix[row][col]);
+        }
+    }
+}
+
+TEST_CASE("CsrMatrix locates entries across empty rows", "[CsrMatrix]") {
+    vector<vector<uint16_t>> denseMatrix = {
+        {0, 0, 1, 0},
+        {2, 3, 0, 4},
+        {0, 0, 0, 0},
+        {0, 5, 0, 0}
+    };
+
+    CsrMatrix matrix(denseMatrix);
+
+    REQUIRE(matrix.rowOfEntry(0) == 0);
+    REQUIRE(matrix.rowOfEntry(1) == 1);
+    REQUIRE(matrix.rowOfEntry(3) == 1);
+    REQUIRE(matrix.rowOfEntry(4) == 3);
+    REQUIRE(matrix.columnOfEntry(4) == 1);
+    REQUIRE(matrix.valueOfEntry(4) == 5);
+}
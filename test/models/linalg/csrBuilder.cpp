@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/linalg/csr.h"
+#include "models/linalg/csrBuilder.h"
+#include "models/util/threadPool.h"
+
+using linalg::CsrBuilder;
+using linalg::CsrMatrix;
+using linalg::DuplicatePolicy;
+using linalg::MutableCsrMatrix;
+using std::tuple;
+using std::vector;
+using utils::ThreadPool;
+
+// Row, column and value of every entry, in storage order
+vector<tuple<size_t, size_t, uint16_t>> entriesOf(const CsrMatrix &matrix) {
+    vector<tuple<size_t, size_t, uint16_t>> entries;
+    for (size_t entry = 0; entry < matrix.numEntries(); entry++) {
+        entries.emplace_back(matrix.rowOfEntry(entry), matrix.columnOfEntry(entry), matrix.valueOfEntry(entry));
+    }
+
+    return entries;
+}
+
+TEST_CASE("CsrBuilder matches MutableCsrMatrix", "[CsrBuilder]") {
+    // Rows out of order, a row added to twice, and empty rows at either end
+    vector<tuple<size_t, size_t, uint16_t>> triples = {
+        {3, 1, 7}, {1, 4, 2}, {3, 0, 5}, {2, 2, 9}, {1, 0, 4}, {3, 4, 1}, {1, 3, 8}
+    };
+
+    MutableCsrMatrix mutableMatrix = MutableCsrMatrix(5, 5);
+    CsrBuilder builder = CsrBuilder(5, 5);
+
+    for (const auto &[row, col, value] : triples) {
+        mutableMatrix.addEntry(row, col, value);
+        builder.addEntry(row, col, value);
+    }
+
+    REQUIRE(builder.numEntries() == 7);
+
+    CsrMatrix expected = CsrMatrix(mutableMatrix);
+    CsrMatrix matrix = builder.build();
+
+    REQUIRE(builder.numEntries() == 0);
+    REQUIRE(matrix.numRows() == 5);
+    REQUIRE(matrix.numCols() == 5);
+    REQUIRE(entriesOf(matrix) == entriesOf(expected));
+
+    // Rows keep the order their entries were added in
+    REQUIRE(matrix.rowOffset(0) == 0);
+    REQUIRE(matrix.rowOffset(1) == 0);
+    REQUIRE(matrix.columnOfEntry(0) == 4);
+    REQUIRE(matrix.columnOfEntry(1) == 0);
+    REQUIRE(matrix.columnOfEntry(2) == 3);
+    REQUIRE(matrix.rowOffset(4) == 7);
+
+    REQUIRE_THROWS_AS(builder.addEntry(5, 0, 1), std::out_of_range);
+    REQUIRE_THROWS_AS(builder.addEntry(0, 5, 1), std::out_of_range);
+
+    CsrMatrix empty = CsrBuilder(0, 0).build();
+    REQUIRE(empty.numEntries() == 0);
+}
+
+TEST_CASE("CsrBuilder sorts rows and merges duplicate entries", "[CsrBuilder]") {
+    auto fill = [](CsrBuilder &builder) {
+        builder.addEntry(0, 2, 10);
+        builder.addEntry(0, 1, 3);
+        builder.addEntry(0, 2, 4);
+        builder.addEntry(1, 0, 60000);
+        builder.addEntry(1, 0, 60000);
+        builder.addEntry(2, 1, 5);
+        builder.addEntry(0, 2, 6);
+    };
+
+    CsrBuilder keep = CsrBuilder(3, 3);
+    fill(keep);
+    CsrMatrix sorted = keep.build(true);
+
+    // Equal columns stay in the order they were added in
+    vector<tuple<size_t, size_t, uint16_t>> expected = {
+        {0, 1, 3}, {0, 2, 10}, {0, 2, 4}, {0, 2, 6}, {1, 0, 60000}, {1, 0, 60000}, {2, 1, 5}
+    };
+    REQUIRE(entriesOf(sorted) == expected);
+
+    CsrBuilder min = CsrBuilder(3, 3);
+    fill(min);
+    CsrMatrix minimum = min.build(false, DuplicatePolicy::Min);
+
+    expected = {{0, 1, 3}, {0, 2, 4}, {1, 0, 60000}, {2, 1, 5}};
+    REQUIRE(entriesOf(minimum) == expected);
+    REQUIRE(minimum(0, 2) == 4);
+
+    // Sums saturate rather than wrap around
+    CsrBuilder sum = CsrBuilder(3, 3);
+    fill(sum);
+    CsrMatrix total = sum.build(false, DuplicatePolicy::Sum);
+
+    expected = {{0, 1, 3}, {0, 2, 20}, {1, 0, UINT16_MAX}, {2, 1, 5}};
+    REQUIRE(entriesOf(total) == expected);
+    REQUIRE(total.rowOffset(3) == 4);
+}
+
+TEST_CASE("CsrBuilder gives the same matrix on a pool as without one", "[CsrBuilder]") {
+    // Enough entries for several blocks, and enough rows for several to a bucket
+    const size_t rows = 30000;
+    const size_t numEntries = 400000;
+
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<size_t> row(0, rows - 1);
+    std::uniform_int_distribution<size_t> col(0, 99);
+    std::uniform_int_distribution<uint16_t> value(1, 1000);
+
+    vector<tuple<size_t, size_t, uint16_t>> triples(numEntries);
+    for (auto &[r, c, v] : triples) {
+        r = row(generator);
+        c = col(generator);
+        v = value(generator);
+    }
+
+    ThreadPool pool = ThreadPool(4);
+
+    for (bool sortRows : {false, true}) {
+        for (DuplicatePolicy duplicates : {DuplicatePolicy::Keep, DuplicatePolicy::Min, DuplicatePolicy::Sum}) {
+            CsrBuilder serial = CsrBuilder(rows, 100);
+            CsrBuilder parallel = CsrBuilder(rows, 100);
+            parallel.reserve(numEntries);
+
+            for (const auto &[r, c, v] : triples) {
+                serial.addEntry(r, c, v);
+                parallel.addEntry(r, c, v);
+            }
+
+            vector<tuple<size_t, size_t, uint16_t>> expected = entriesOf(serial.build(sortRows, duplicates));
+            REQUIRE(entriesOf(parallel.build(sortRows, duplicates, &pool)) == expected);
+
+            if (duplicates == DuplicatePolicy::Keep && !sortRows) {
+                // A stable sort by row of the triples as added
+                vector<tuple<size_t, size_t, uint16_t>> byRow = triples;
+                std::stable_sort(byRow.begin(), byRow.end(), [](const auto &a, const auto &b) {
+                    return std::get<0>(a) < std::get<0>(b);
+                });
+
+                REQUIRE(expected == byRow);
+            } else if (duplicates != DuplicatePolicy::Keep) {
+                // One entry per row and column, in column order
+                for (size_t i = 1; i < expected.size(); i++) {
+                    auto [previousRow, previousCol, previousValue] = expected[i - 1];
+                    auto [r, c, v] = expected[i];
+                    REQUIRE((previousRow < r || (previousRow == r && previousCol < c)));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#include "catch/catch.hpp"
+
+#include "models/util/bitset.h"
+
+using utils::Bitset;
+
+TEST_CASE("Bitset set, reset and test", "[Bitset]") {
+    Bitset bits(130);
+
+    REQUIRE(bits.size() == 130);
+    REQUIRE(bits.count() == 0);
+
+    bits.set(0);
+    bits.set(63);
+    bits.set(64);
+    bits.set(129);
+
+    REQUIRE(bits.test(0));
+    REQUIRE(bits.test(63));
+    REQUIRE(bits.test(64));
+    REQUIRE(bits.test(129));
+    REQUIRE_FALSE(bits.test(1));
+    REQUIRE_FALSE(bits.test(128));
+    REQUIRE(bits.count() == 4);
+
+    bits.reset(63);
+    REQUIRE_FALSE(bits.test(63));
+    REQUIRE(bits.test(64));
+    REQUIRE(bits.count() == 3);
+
+    bits.clear();
+    REQUIRE(bits.count() == 0);
+    REQUIRE(bits.size() == 130);
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/util/bucketKdTree.h"
+#include "models/util/threadPool.h"
+
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+using utils::BucketKdTree;
+using utils::ThreadPool;
+
+// Random points with many exact ties, checked against brute force
+template <size_t LeafSize>
+void checkAgainstBruteForce(size_t numPoints, ThreadPool *pool) {
+    std::mt19937 generator(static_cast<unsigned>(numPoints + LeafSize));
+    std::uniform_real_distribution<float> coordinate(0.0f, 1.0f);
+
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < numPoints; i++) {
+        lats.push_back(std::floor(coordinate(generator) * 200.0f) / 200.0f);
+        lons.push_back(coordinate(generator));
+    }
+
+    BucketKdTree<LeafSize> tree(lats, lons, pool);
+    REQUIRE(tree.size() == numPoints);
+
+    for (size_t i = 0; i < numPoints; i++) {
+        REQUIRE(tree[tree.getNewIndex(i)] == pair<float, float>{lats[i], lons[i]});
+    }
+
+    auto distanceTo = [&](pair<float, float> location, float lat, float lon) {
+        return (location.first - lat) * (location.first - lat) + (location.second - lon) * (location.second - lon);
+    };
+
+    vector<size_t> result;
+    for (size_t query = 0; query < 300; query++) {
+        float lat = coordinate(generator) * 1.2f - 0.1f;
+        float lon = coordinate(generator) * 1.2f - 0.1f;
+
+        float best = std::numeric_limits<float>::infinity();
+        size_t inRadius = 0;
+        size_t inBox = 0;
+        for (size_t i = 0; i < numPoints; i++) {
+            float dist = distanceTo({lats[i], lons[i]}, lat, lon);
+            best = std::min(best, dist);
+            inRadius += dist <= 0.05f * 0.05f;
+            inBox += lats[i] >= lat && lats[i] <= lat + 0.1f && lons[i] >= lon && lons[i] <= lon + 0.05f;
+        }
+
+        REQUIRE(distanceTo(tree[tree.nearestPoint(lat, lon)], lat, lon) == best);
+
+        result.clear();
+        tree.pointsWithinRadius(lat, lon, 0.05f, result);
+        REQUIRE(result.size() == inRadius);
+
+        result.clear();
+        tree.pointsInBox(lat, lon, lat + 0.1f, lon + 0.05f, result);
+        REQUIRE(result.size() == inBox);
+    }
+}
+
+TEST_CASE("BucketKdTree queries match brute force", "[BucketKdTree]") {
+    ThreadPool pool(3);
+
+    checkAgainstBruteForce<4>(1, nullptr);
+    checkAgainstBruteForce<4>(1000, nullptr);
+    checkAgainstBruteForce<16>(5003, &pool);
+    checkAgainstBruteForce<32>(33, nullptr);
+    checkAgainstBruteForce<64>(20000, &pool);
+}
+
+TEST_CASE("BucketKdTree leaves stay within the leaf size", "[BucketKdTree]") {
+    vector<float> lats(1000, 1.0f);
+    vector<float> lons(1000);
+    for (size_t i = 0; i < lons.size(); i++) {
+        lons[i] = static_cast<float>(i);
+    }
+
+    // 1000 points in leaves of at most 16: 63 leaves round up to 64
+    BucketKdTree<16> tree(lats, lons);
+    REQUIRE(tree.numLeaves() == 64);
+    REQUIRE(tree.memoryBytes() >= 1000 * (2 * sizeof(float) + sizeof(size_t)));
+
+    REQUIRE(tree.nearestPoint(1.0f, 500.2f) == tree.getNewIndex(500));
+
+    BucketKdTree<16> empty;
+    REQUIRE(empty.size() == 0);
+    REQUIRE_THROWS_AS(empty.nearestPoint(0.0f, 0.0f), out_of_range);
+    REQUIRE_THROWS_AS(BucketKdTree<16>(lats, vector<float>(3)), invalid_argument);
+}
@@ -1,16 +1,28 @@
 #include <cmath>
 #include <iostream>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <vector>
 #include <utility>
 
 #include "catch/catch.hpp"
 #include "models/util/dim2Tree.h"
+#include "models/util/threadPool.h"
 
 using std::cout;
 using std::endl;
+using std::invalid_argument;
+using std::out_of_range;
 using std::pair;
+using std::span;
 using std::vector;
 using utils::Dim2Tree;
+using utils::microdegreesToDegrees;
+using utils::ThreadPool;
+using utils::toMicrodegrees;
+using utils::TreeLayout;
 
 // Helper function to create a test tree with a simple set of points
 Dim2Tree createTestTree() {
@@ -25,16 +37,16 @@ Dim2Tree createTestTree() {
     return Dim2Tree(points);
 }
 
-void validateApproximateNearestPoint(
+void validateNearestPoint(
     Dim2Tree tree,
     float inputLat, float inputLon,
     float expectedLat, float expectedLon
 ) {
-    size_t approximateNearestPoint = tree.approximateNearestPoint(inputLat, inputLon);
-    pair<float, float> approximateLocation = tree[approximateNearestPoint];
+    size_t nearestPoint = tree.nearestPoint(inputLat, inputLon);
+    pair<float, float> nearestLocation = tree[nearestPoint];
     
-    REQUIRE(approximateLocation.first == expectedLat);
-    REQUIRE(approximateLocation.second == expectedLon);
+    REQUIRE(nearestLocation.first == expectedLat);
+    REQUIRE(nearestLocation.second == expectedLon);
 }
 
 TEST_CASE("Dim2Tree construction", "[Dim2Tree]") {
@@ -45,37 +57,37 @@ TEST_CASE("Dim2Tree construction", "[Dim2Tree]") {
 TEST_CASE("Dim2Tree nearest point search - exact matches", "[Dim2Tree]") {
     Dim2Tree tree = createTestTree();
     
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         2.0f, 3.0f, // input
         2.0f, 3.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         5.0f, 4.0f, // input
         5.0f, 4.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         9.0f, 6.0f, // input
         9.0f, 6.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         4.0f, 7.0f, // input
         4.0f, 7.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         8.0f, 1.0f, // input
         8.0f, 1.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         7.0f, 2.0f, // input
         7.0f, 2.0f // output
@@ -84,37 +96,37 @@ TEST_CASE("Dim2Tree nearest point search - exact matches", "[Dim2Tree]") {
 
 TEST_CASE("Dim2Tree nearest point search - approximate matches", "[Dim2Tree]") {
     Dim2Tree tree = createTestTree();
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         2.1f, 3.1f, // input
         2.0f, 3.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         5.2f, 4.1f, // input
         5.0f, 4.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         8.8f, 5.9f, // input
         9.0f, 6.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         4.2f, 6.8f, // input
         4.0f, 7.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         7.9f, 1.2f, // input
         8.0f, 1.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         6.8f, 2.2f, // input
         7.0f, 2.0f // output
@@ -124,13 +136,13 @@ TEST_CASE("Dim2Tree nearest point search - approximate matches", "[Dim2Tree]") {
 TEST_CASE("Dim2Tree nearest point search - distant points", "[Dim2Tree]") {
     Dim2Tree tree = createTestTree();
     
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         0.0f, 0.0f, // input
         2.0f, 3.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         10.0f, 10.0f, // input
         9.0f, 6.0f // output
@@ -143,19 +155,19 @@ TEST_CASE("Dim2Tree with single point", "[Dim2Tree]") {
     Dim2Tree tree(points);
     
     // Any query should return the only point
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         0.0f, 0.0f, // input
         1.0f, 1.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         10.0f, 10.0f, // input
         1.0f, 1.0f // output
     );
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         1.0f, 1.0f, // input
         1.0f, 1.0f // output
@@ -173,7 +185,7 @@ TEST_CASE("Dim2Tree with many points - power of 2", "[Dim2Tree]") {
 
     Dim2Tree tree(points);
 
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         1.1f, 2.2f, // input
         1.0f, 2.0f // output
@@ -191,15 +203,342 @@ TEST_CASE("Dim2Tree with many points - not a power of 2", "[Dim2Tree]") {
 
     Dim2Tree tree(points);
     
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         1.1f, 2.2f, // input
-        1.0f, 3.0f // output
+        1.0f, 2.0f // output
     );
     
-    validateApproximateNearestPoint(
+    validateNearestPoint(
         tree,
         5.6f, 7.8f, // input
-        5.0f, 8.0f // output
+        6.0f, 8.0f // output
     );
 }
+
+TEST_CASE("Dim2Tree bounding box query", "[Dim2Tree]") {
+    vector<pair<float, float>> points;
+    for (float x = 0.0f; x < 10.0f; x += 1.0f) {
+        for (float y = 0.0f; y < 10.0f; y += 1.0f) {
+            points.push_back({x, y});
+        }
+    }
+
+    Dim2Tree tree(points);
+
+    vector<size_t> result;
+    tree.pointsInBox(2.0f, 3.5f, 4.0f, 5.0f, result);
+
+    // x in {2, 3, 4}, y in {4, 5}
+    REQUIRE(result.size() == 6);
+    for (size_t index : result) {
+        pair<float, float> location = tree[index];
+        REQUIRE(location.first >= 2.0f);
+        REQUIRE(location.first <= 4.0f);
+        REQUIRE(location.second >= 3.5f);
+        REQUIRE(location.second <= 5.0f);
+    }
+
+    // Results are appended, not replaced
+    tree.pointsInBox(20.0f, 20.0f, 30.0f, 30.0f, result);
+    REQUIRE(result.size() == 6);
+}
+
+// Squared distance as the tree measures it: from the query rounded to microdegrees to the stored
+// point, in square microdegrees
+double treeDistance(const Dim2Tree &tree, size_t index, float lat, float lon) {
+    auto [pointLat, pointLon] = tree.microdegrees(index);
+    double dLat = static_cast<double>(pointLat - toMicrodegrees(lat));
+    double dLon = static_cast<double>(pointLon - toMicrodegrees(lon));
+    return dLat * dLat + dLon * dLon;
+}
+
+// Brute force reference for the queries below
+vector<pair<double, size_t>> sortedByDistance(const Dim2Tree &tree, float lat, float lon) {
+    vector<pair<double, size_t>> distances;
+    for (size_t i = 0; i < tree.size(); i++) {
+        distances.push_back({treeDistance(tree, i, lat, lon), i});
+    }
+
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+TEST_CASE("Dim2Tree nearest, k nearest and radius queries are exact", "[Dim2Tree]") {
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+
+    // Clustered and duplicated points stress the pruning
+    vector<pair<float, float>> points;
+    for (size_t i = 0; i < 1000; i++) {
+        points.push_back({coordinate(generator), coordinate(generator) * 0.1f});
+    }
+    points.push_back(points[5]);
+    points.push_back(points[5]);
+
+    Dim2Tree tree(points);
+    vector<size_t> result;
+
+    for (size_t query = 0; query < 200; query++) {
+        float lat = coordinate(generator) * 1.2f;
+        float lon = coordinate(generator) * 0.2f;
+        vector<pair<double, size_t>> expected = sortedByDistance(tree, lat, lon);
+
+        auto distanceTo = [&](size_t index) {
+            return treeDistance(tree, index, lat, lon);
+        };
+
+        // Compare distances rather than indices, since ties may resolve either way
+        REQUIRE(distanceTo(tree.nearestPoint(lat, lon)) == expected[0].first);
+
+        result.clear();
+        tree.kNearest(lat, lon, 10, result);
+        REQUIRE(result.size() == 10);
+        for (size_t i = 0; i < result.size(); i++) {
+            REQUIRE(distanceTo(result[i]) == expected[i].first);
+        }
+
+        result.clear();
+        float radius = 0.5f;
+        tree.pointsWithinRadius(lat, lon, radius, result);
+
+        size_t inside = 0;
+        double radiusMicrodegrees = radius * utils::MICRODEGREES_PER_DEGREE;
+        while (inside < expected.size() && expected[inside].first <= radiusMicrodegrees * radiusMicrodegrees) {
+            inside++;
+        }
+        REQUIRE(result.size() == inside);
+    }
+
+    // k larger than the tree returns everything, appended after what is already in the buffer
+    result = {42};
+    tree.kNearest(0.0f, 0.0f, 5000, result);
+    REQUIRE(result.size() == points.size() + 1);
+    REQUIRE(result[0] == 42);
+
+    REQUIRE_THROWS_AS(Dim2Tree().nearestPoint(0.0f, 0.0f), out_of_range);
+}
+
+TEST_CASE("Dim2Tree ranks far points by their exact squared distance", "[Dim2Tree]") {
+    // 50 degrees from the query, the two squared distances differ by 19998 square microdegrees,
+    // well below the spacing of floats near 2.5e15
+    vector<pair<double, double>> points = {{50.0, 0.0}, {49.999999, 0.009999}};
+    vector<float> lats = {0.0f};
+    vector<float> lons = {0.0f};
+
+    for (TreeLayout layout : {TreeLayout::Heap, TreeLayout::VanEmdeBoas}) {
+        for (size_t first = 0; first < 2; first++) {
+            vector<pair<double, double>> ordered = {points[first], points[1 - first]};
+            Dim2Tree tree(ordered, nullptr, layout);
+            size_t closer = tree.getNewIndex(1 - first);
+
+            REQUIRE(tree.nearestPoint(0.0f, 0.0f) == closer);
+
+            vector<size_t> result;
+            tree.kNearest(0.0f, 0.0f, 2, result);
+            REQUIRE(result[0] == closer);
+
+            vector<size_t> nearest(1);
+            tree.nearestBatch(lats, lons, nearest);
+            REQUIRE(nearest[0] == closer);
+        }
+    }
+}
+
+TEST_CASE("Dim2Tree batch nearest point search matches single queries", "[Dim2Tree]") {
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> latitude(41.6f, 42.1f);
+    std::uniform_real_distribution<float> longitude(-88.0f, -87.5f);
+
+    vector<pair<float, float>> points;
+    for (size_t i = 0; i < 5000; i++) {
+        points.push_back({latitude(generator), longitude(generator)});
+    }
+    Dim2Tree tree(points);
+
+    // Some queries fall outside the points' bounding box, and the count is not a multiple of the group size
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 20003; i++) {
+        lats.push_back(latitude(generator) + (i % 100 == 0 ? 1.0f : 0.0f));
+        lons.push_back(longitude(generator));
+    }
+
+    auto distanceTo = [&](size_t index, size_t query) {
+        return treeDistance(tree, index, lats[query], lons[query]);
+    };
+
+    ThreadPool pool(4);
+    vector<size_t> nearest(lats.size());
+    vector<size_t> nearestParallel(lats.size());
+
+    tree.nearestBatch(lats, lons, nearest);
+    tree.nearestBatch(lats, lons, nearestParallel, &pool);
+
+    // Far fewer queries than points takes the one-query-at-a-time path inside each group
+    vector<size_t> nearestSparse(200);
+    tree.nearestBatch(span(lats).first(200), span(lons).first(200), nearestSparse);
+
+    for (size_t i = 0; i < lats.size(); i++) {
+        double expected = distanceTo(tree.nearestPoint(lats[i], lons[i]), i);
+        REQUIRE(distanceTo(nearest[i], i) == expected);
+        REQUIRE(distanceTo(nearestParallel[i], i) == expected);
+
+        if (i < nearestSparse.size()) {
+            REQUIRE(distanceTo(nearestSparse[i], i) == expected);
+        }
+    }
+
+    vector<size_t> tooShort(3);
+    REQUIRE_THROWS_AS(tree.nearestBatch(lats, lons, tooShort), invalid_argument);
+}
+
+TEST_CASE("Dim2Tree builds the same tree in parallel", "[Dim2Tree]") {
+    std::mt19937 generator(9);
+    std::uniform_real_distribution<float> coordinate(0.0f, 1.0f);
+
+    // Coarse coordinates give many ties along both axes
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 30011; i++) {
+        lats.push_back(std::floor(coordinate(generator) * 50.0f));
+        lons.push_back(coordinate(generator));
+    }
+
+    ThreadPool pool(4);
+    Dim2Tree serial(lats, lons);
+    Dim2Tree parallel(lats, lons, &pool);
+
+    REQUIRE(parallel.size() == lats.size());
+    for (size_t i = 0; i < lats.size(); i++) {
+        REQUIRE(parallel.getNewIndex(i) == serial.getNewIndex(i));
+        REQUIRE(parallel.microdegrees(parallel.getNewIndex(i)) == pair<int32_t, int32_t>{toMicrodegrees(lats[i]), toMicrodegrees(lons[i])});
+    }
+
+    // Every query still finds a point at the true nearest distance
+    for (size_t query = 0; query < 500; query++) {
+        float lat = coordinate(generator) * 50.0f;
+        float lon = coordinate(generator);
+
+        double foundDistance = treeDistance(parallel, parallel.nearestPoint(lat, lon), lat, lon);
+        REQUIRE(foundDistance == sortedByDistance(parallel, lat, lon)[0].first);
+    }
+
+    REQUIRE(Dim2Tree(vector<float>(), vector<float>(), &pool).size() == 0);
+    REQUIRE_THROWS_AS(Dim2Tree(lats, vector<float>(3)), invalid_argument);
+}
+
+TEST_CASE("Dim2Tree van Emde Boas layout answers like the heap layout", "[Dim2Tree]") {
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> coordinate(-5.0f, 5.0f);
+
+    // Sizes around full levels, where the layout's last level starts and ends
+    for (size_t numPoints : {1, 2, 3, 7, 8, 255, 256, 1000, 4097}) {
+        vector<float> lats;
+        vector<float> lons;
+        for (size_t i = 0; i < numPoints; i++) {
+            lats.push_back(coordinate(generator));
+            lons.push_back(coordinate(generator));
+        }
+
+        Dim2Tree heap(lats, lons);
+        Dim2Tree blocked(lats, lons, nullptr, TreeLayout::VanEmdeBoas);
+        REQUIRE(blocked.layout() == TreeLayout::VanEmdeBoas);
+        REQUIRE(blocked.size() == numPoints);
+
+        // Every point has its own slot
+        vector<bool> used(numPoints);
+        for (size_t i = 0; i < numPoints; i++) {
+            size_t slot = blocked.getNewIndex(i);
+            REQUIRE(!used[slot]);
+            used[slot] = true;
+            REQUIRE(blocked.microdegrees(slot) == pair<int32_t, int32_t>{toMicrodegrees(lats[i]), toMicrodegrees(lons[i])});
+        }
+
+        vector<float> queryLats;
+        vector<float> queryLons;
+        for (size_t query = 0; query < 200; query++) {
+            float lat = coordinate(generator);
+            float lon = coordinate(generator);
+            queryLats.push_back(lat);
+            queryLons.push_back(lon);
+
+            REQUIRE(blocked[blocked.nearestPoint(lat, lon)] == heap[heap.nearestPoint(lat, lon)]);
+
+            vector<size_t> heapNearest;
+            vector<size_t> blockedNearest;
+            heap.kNearest(lat, lon, 5, heapNearest);
+            blocked.kNearest(lat, lon, 5, blockedNearest);
+            REQUIRE(blockedNearest.size() == heapNearest.size());
+            for (size_t i = 0; i < heapNearest.size(); i++) {
+                REQUIRE(blocked[blockedNearest[i]] == heap[heapNearest[i]]);
+            }
+
+            vector<size_t> heapBox;
+            vector<size_t> blockedBox;
+            heap.pointsInBox(lat - 1.0f, lon - 1.0f, lat + 1.0f, lon + 1.0f, heapBox);
+            blocked.pointsInBox(lat - 1.0f, lon - 1.0f, lat + 1.0f, lon + 1.0f, blockedBox);
+            REQUIRE(blockedBox.size() == heapBox.size());
+        }
+
+        vector<size_t> batch(queryLats.size());
+        blocked.nearestBatch(queryLats, queryLons, batch);
+        for (size_t query = 0; query < queryLats.size(); query++) {
+            REQUIRE(blocked[batch[query]] == heap[heap.nearestPoint(queryLats[query], queryLons[query])]);
+        }
+
+        // The layout is saved with the tree
+        std::stringstream stream;
+        stream << blocked;
+        Dim2Tree loaded;
+        stream >> loaded;
+
+        REQUIRE(loaded.layout() == TreeLayout::VanEmdeBoas);
+        for (size_t query = 0; query < queryLats.size(); query++) {
+            REQUIRE(loaded.nearestPoint(queryLats[query], queryLons[query]) == blocked.nearestPoint(queryLats[query], queryLons[query]));
+        }
+    }
+}
+
+TEST_CASE("Dim2Tree stores points to within half a microdegree", "[Dim2Tree]") {
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<float> latitude(-90.0f, 90.0f);
+    std::uniform_real_distribution<float> longitude(-180.0f, 180.0f);
+
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 10000; i++) {
+        lats.push_back(latitude(generator));
+        lons.push_back(longitude(generator));
+    }
+
+    // The ends of the range round to themselves
+    lats.push_back(-90.0f);
+    lons.push_back(180.0f);
+
+    Dim2Tree tree(lats, lons);
+    REQUIRE(tree.memoryBytes() == lats.size() * (2 * sizeof(int32_t) + sizeof(uint32_t)));
+
+    for (size_t i = 0; i < lats.size(); i++) {
+        auto [lat, lon] = tree.microdegrees(tree.getNewIndex(i));
+        REQUIRE(std::abs(lat - lats[i] * utils::MICRODEGREES_PER_DEGREE) <= 0.5);
+        REQUIRE(std::abs(lon - lons[i] * utils::MICRODEGREES_PER_DEGREE) <= 0.5);
+
+        // Decoding to float adds at most half a float ulp
+        pair<float, float> location = tree[tree.getNewIndex(i)];
+        REQUIRE(location.first == static_cast<float>(microdegreesToDegrees(lat)));
+        REQUIRE(location.second == static_cast<float>(microdegreesToDegrees(lon)));
+
+        // Every point finds itself, or a point stored at the same microdegrees
+        REQUIRE(tree.microdegrees(tree.nearestPoint(lats[i], lons[i])) == pair<int32_t, int32_t>{lat, lon});
+    }
+
+    REQUIRE(tree.microdegrees(tree.getNewIndex(lats.size() - 1)) == pair<int32_t, int32_t>{-90000000, 180000000});
+
+    // Queries past the fixed point range are clamped to it
+    REQUIRE(tree[tree.nearestPoint(1e9f, 0.0f)].first > 89.0f);
+
+    vector<float> tooFar = {0.0f, 1001.0f};
+    REQUIRE_THROWS_AS(Dim2Tree(tooFar, vector<float>(2)), invalid_argument);
+    REQUIRE_THROWS_AS(Dim2Tree(vector<float>{std::nanf("")}, vector<float>{0.0f}), invalid_argument);
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/util/dynamicDim2Tree.h"
+#include "models/util/microdegrees.h"
+#include "models/util/threadPool.h"
+
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+using utils::DynamicDim2Tree;
+using utils::ThreadPool;
+using utils::toMicrodegrees;
+
+// Squared distance the index ranks by, in square microdegrees
+float microdegreeDistance(pair<float, float> point, float lat, float lon) {
+    float dLat = static_cast<float>(toMicrodegrees(point.first) - toMicrodegrees(lat));
+    float dLon = static_cast<float>(toMicrodegrees(point.second) - toMicrodegrees(lon));
+    return dLat * dLat + dLon * dLon;
+}
+
+// Inserts, moves and removes at random, checking every query against a brute force copy
+void checkAgainstBruteForce(ThreadPool *pool) {
+    std::mt19937 generator(44);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+    std::uniform_int_distribution<size_t> pickId(0, 4999);
+
+    DynamicDim2Tree tree(pool);
+    vector<pair<float, float>> locations(5000);
+    vector<bool> present(5000, false);
+
+    for (size_t step = 0; step < 60000; step++) {
+        size_t id = pickId(generator);
+
+        if (generator() % 4 == 0) {
+            REQUIRE(tree.remove(id) == present[id]);
+            present[id] = false;
+        } else {
+            locations[id] = {coordinate(generator), coordinate(generator)};
+            present[id] = true;
+            tree.insert(id, locations[id].first, locations[id].second);
+        }
+
+        if (step % 500 != 499) {
+            continue;
+        }
+
+        float lat = coordinate(generator);
+        float lon = coordinate(generator);
+
+        vector<float> expected;
+        for (size_t i = 0; i < present.size(); i++) {
+            if (present[i]) {
+                expected.push_back(microdegreeDistance(locations[i], lat, lon));
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+
+        REQUIRE(tree.size() == expected.size());
+        REQUIRE(microdegreeDistance(locations[tree.nearestPoint(lat, lon)], lat, lon) == expected[0]);
+
+        vector<size_t> nearest;
+        tree.kNearest(lat, lon, 10, nearest);
+        REQUIRE(nearest.size() == 10);
+        for (size_t i = 0; i < nearest.size(); i++) {
+            REQUIRE(present[nearest[i]]);
+            REQUIRE(microdegreeDistance(locations[nearest[i]], lat, lon) == expected[i]);
+        }
+
+        vector<size_t> within;
+        tree.pointsWithinRadius(lat, lon, 0.1f, within);
+        float radius = 0.1f * 1e6f;
+        REQUIRE(within.size() == size_t(std::upper_bound(expected.begin(), expected.end(), radius * radius) - expected.begin()));
+
+        vector<size_t> inBox;
+        tree.pointsInBox(lat - 0.1f, lon - 0.2f, lat + 0.1f, lon + 0.2f, inBox);
+        size_t expectedInBox = 0;
+        for (size_t i = 0; i < present.size(); i++) {
+            auto [pointLat, pointLon] = locations[i];
+            expectedInBox += present[i] && pointLat >= lat - 0.1f && pointLat <= lat + 0.1f
+                             && pointLon >= lon - 0.2f && pointLon <= lon + 0.2f;
+        }
+        REQUIRE(inBox.size() == expectedInBox);
+    }
+
+    // Tombstones don't pile up, and the forest stays logarithmic
+    tree.waitForMerges();
+    REQUIRE(tree.treeCount() <= 16);
+
+    for (size_t id = 0; id < present.size(); id++) {
+        REQUIRE(tree.contains(id) == present[id]);
+        if (present[id]) {
+            REQUIRE(tree[id] == std::make_pair(toMicrodegrees(locations[id].first) / 1e6f, toMicrodegrees(locations[id].second) / 1e6f));
+        }
+    }
+}
+
+TEST_CASE("DynamicDim2Tree matches brute force through updates", "[DynamicDim2Tree]") {
+    checkAgainstBruteForce(nullptr);
+
+    ThreadPool pool(2);
+    checkAgainstBruteForce(&pool);
+}
+
+TEST_CASE("DynamicDim2Tree answers queries during updates", "[DynamicDim2Tree]") {
+    // Fixed points on a grid, and vehicles that move around far away from them
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 100; i++) {
+        lats.push_back(static_cast<float>(i / 10));
+        lons.push_back(static_cast<float>(i % 10));
+    }
+
+    ThreadPool pool(2);
+    DynamicDim2Tree tree(lats, lons, &pool);
+    REQUIRE(tree.size() == 100);
+
+    std::atomic<bool> done = false;
+    std::thread updater([&]() {
+        std::mt19937 generator(45);
+        std::uniform_real_distribution<float> coordinate(50.0f, 60.0f);
+
+        for (size_t step = 0; step < 200000; step++) {
+            size_t vehicle = 100 + step % 5000;
+            if (step % 7 == 0) {
+                tree.remove(vehicle);
+            } else {
+                tree.insert(vehicle, coordinate(generator), coordinate(generator));
+            }
+        }
+        done = true;
+    });
+
+    std::mt19937 generator(46);
+    std::uniform_int_distribution<size_t> pick(0, 99);
+    size_t queries = 0;
+    while (!done || queries < 1000) {
+        size_t point = pick(generator);
+        REQUIRE(tree.nearestPoint(lats[point] + 0.1f, lons[point] - 0.1f) == point);
+        queries++;
+    }
+
+    updater.join();
+    REQUIRE(tree.nearestPoint(55.0f, 55.0f) >= 100);
+}
+
+TEST_CASE("DynamicDim2Tree rejects bad input", "[DynamicDim2Tree]") {
+    DynamicDim2Tree tree;
+    REQUIRE_THROWS_AS(tree.nearestPoint(0.0f, 0.0f), out_of_range);
+    REQUIRE_THROWS_AS(tree.insert(0, 2000.0f, 0.0f), invalid_argument);
+    REQUIRE_THROWS_AS(tree.insert(DynamicDim2Tree::MAX_IDS, 0.0f, 0.0f), invalid_argument);
+    REQUIRE(tree.size() == 0);
+
+    tree.insert(3, 1.0f, 1.0f);
+    REQUIRE(tree.nearestPoint(0.0f, 0.0f) == 3);
+    REQUIRE_FALSE(tree.remove(2));
+    REQUIRE_THROWS_AS(tree[2], out_of_range);
+
+    REQUIRE(tree.remove(3));
+    REQUIRE_FALSE(tree.remove(3));
+    REQUIRE_THROWS_AS(tree.nearestPoint(0.0f, 0.0f), out_of_range);
+
+    vector<float> lats = {1.0f, 2.0f};
+    vector<float> lons = {1.0f};
+    REQUIRE_THROWS_AS(DynamicDim2Tree(lats, lons), invalid_argument);
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/util/kdTree.h"
+#include "models/util/threadPool.h"
+
+using std::array;
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+using utils::KdTree;
+using utils::ThreadPool;
+
+using Point3 = array<float, 3>;
+
+float distanceSquared3(const Point3 &a, const Point3 &b) {
+    float dx = a[0] - b[0];
+    float dy = a[1] - b[1];
+    float dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+TEST_CASE("KdTree queries are exact in three dimensions", "[KdTree]") {
+    std::mt19937 generator(19);
+    std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+
+    // Flattened along z, with duplicates, to stress the pruning
+    vector<Point3> points;
+    for (size_t i = 0; i < 2000; i++) {
+        points.push_back({coordinate(generator), coordinate(generator), coordinate(generator) * 0.01f});
+    }
+    points.push_back(points[7]);
+    points.push_back(points[7]);
+
+    ThreadPool pool(4);
+    KdTree<3> tree(points);
+    KdTree<3> parallel(points, &pool);
+    REQUIRE(tree.size() == points.size());
+
+    for (size_t i = 0; i < tree.size(); i++) {
+        REQUIRE(tree[i] == points[tree.payload(i)]);
+        REQUIRE(parallel.payload(i) == tree.payload(i));
+    }
+
+    for (size_t query = 0; query < 200; query++) {
+        Point3 location = {coordinate(generator) * 1.2f, coordinate(generator) * 1.2f, coordinate(generator) * 0.1f};
+
+        vector<float> expected;
+        for (const Point3 &point : points) {
+            expected.push_back(distanceSquared3(point, location));
+        }
+        std::sort(expected.begin(), expected.end());
+
+        REQUIRE(distanceSquared3(tree[tree.nearestPoint(location)], location) == expected[0]);
+
+        vector<size_t> nearest;
+        tree.kNearest(location, 8, nearest);
+        REQUIRE(nearest.size() == 8);
+        for (size_t i = 0; i < nearest.size(); i++) {
+            REQUIRE(distanceSquared3(tree[nearest[i]], location) == expected[i]);
+        }
+
+        float radius = 0.3f;
+        vector<size_t> within;
+        tree.pointsWithinRadius(location, radius, within);
+        REQUIRE(within.size() == size_t(std::upper_bound(expected.begin(), expected.end(), radius * radius) - expected.begin()));
+
+        Point3 low = {location[0] - 0.2f, location[1] - 0.3f, location[2] - 0.005f};
+        Point3 high = {location[0] + 0.2f, location[1] + 0.3f, location[2] + 0.005f};
+        vector<size_t> inBox;
+        tree.pointsInBox(low, high, inBox);
+
+        size_t expectedInBox = 0;
+        for (const Point3 &point : points) {
+            bool inside = true;
+            for (size_t axis = 0; axis < 3; axis++) {
+                inside = inside && point[axis] >= low[axis] && point[axis] <= high[axis];
+            }
+            expectedInBox += inside;
+        }
+        REQUIRE(inBox.size() == expectedInBox);
+    }
+}
+
+TEST_CASE("KdTree serializes and handles small trees", "[KdTree]") {
+    vector<array<float, 1>> points = {{3.0f}, {1.0f}, {2.0f}};
+    KdTree<1> tree(points);
+
+    std::stringstream stream;
+    stream << tree;
+    KdTree<1> loaded;
+    stream >> loaded;
+
+    REQUIRE(loaded.size() == 3);
+    REQUIRE(loaded.payload(loaded.nearestPoint({2.9f})) == 0);
+    REQUIRE(loaded.payload(loaded.nearestPoint({-5.0f})) == 1);
+
+    vector<size_t> all;
+    loaded.kNearest({0.0f}, 10, all);
+    REQUIRE(all.size() == 3);
+
+    REQUIRE_THROWS_AS(KdTree<2>().nearestPoint({0.0f, 0.0f}), out_of_range);
+    REQUIRE_THROWS_AS(tree[3], out_of_range);
+
+    // Every level but the last is full, and the last fills from the left
+    REQUIRE(utils::leftSubtreeSize(0, 1) == 0);
+    REQUIRE(utils::leftSubtreeSize(0, 6) == 3);
+    REQUIRE(utils::leftSubtreeSize(0, 10) == 6);
+    REQUIRE(utils::leftSubtreeSize(1, 10) == 3);
+    REQUIRE(utils::leftSubtreeSize(2, 10) == 1);
+}
+
+TEST_CASE("KdTree carries payloads and other coordinate types", "[KdTree]") {
+    struct PointOfInterest {
+        uint32_t id;
+        char category;
+    };
+
+    vector<array<float, 2>> locations = {{0.0f, 0.0f}, {1.0f, 1.0f}, {-2.0f, 0.5f}, {4.0f, -3.0f}};
+    vector<PointOfInterest> places = {{10, 'f'}, {11, 'h'}, {12, 'f'}, {13, 'p'}};
+
+    KdTree<2, float, PointOfInterest> poi(locations, places);
+    const PointOfInterest &closest = poi.payload(poi.nearestPoint({-1.8f, 0.4f}));
+    REQUIRE(closest.id == 12);
+    REQUIRE(closest.category == 'f');
+
+    vector<PointOfInterest> tooFew = {{10, 'f'}};
+    REQUIRE_THROWS_AS((KdTree<2, float, PointOfInterest>(locations, tooFew)), invalid_argument);
+
+    // Input indices must fit in the payload type
+    vector<array<float, 1>> many(300, {0.0f});
+    REQUIRE_THROWS_AS((KdTree<1, float, uint8_t>(many)), invalid_argument);
+    REQUIRE(KdTree<1, float, uint16_t>(many).size() == 300);
+
+    // Integer coordinates whose differences overflow int32_t
+    vector<array<int32_t, 2>> fixedPoint = {{2000000000, 0}, {-2000000000, 0}, {0, 5}};
+    KdTree<2, int32_t> integers(fixedPoint);
+    REQUIRE(integers.payload(integers.nearestPoint({1999999990, 0})) == 0);
+    REQUIRE(integers.payload(integers.nearestPoint({-1999999990, 1})) == 1);
+
+    vector<size_t> within;
+    integers.pointsWithinRadius({0, 0}, 5.0f, within);
+    REQUIRE(within.size() == 1);
+    REQUIRE(integers.payload(within[0]) == 2);
+
+    // Double coordinates keep their precision in distances
+    vector<array<double, 1>> precise = {{1.0}, {1.0 + 1e-12}};
+    KdTree<1, double> doubles(precise);
+    REQUIRE(doubles.payload(doubles.nearestPoint({1.0 + 0.9e-12})) == 1);
+
+    REQUIRE(KdTree<3>::nextAxis(2) == 0);
+    REQUIRE(KdTree<3>::nextAxis(0) == 1);
+}
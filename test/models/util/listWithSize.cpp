@@ -1,3 +1,5 @@
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "catch/catch.hpp"
@@ -70,4 +72,15 @@ TEST_CASE("ListWithSize copy assignment operator", "[ListWithSize]") {
     REQUIRE(copyAssigned[4] == 8);
 }
 
-// TODO: Copy and move constructor tests to ensure the memory is reallocated
\ No newline at end of file
+// TODO: Copy and move constructor tests to ensure the memory is reallocated
+TEST_CASE("ListWithSize const access is read-only", "[ListWithSize]") {
+    static_assert(std::is_same_v<decltype(std::declval<const ListWithSize<int> &>()[0]), const int &>);
+    static_assert(std::is_same_v<decltype(std::declval<const ListWithSize<int> &>().data()), const int *>);
+
+    ListWithSize<int> list = makeList();
+    list[0] = 9;
+
+    const ListWithSize<int> &view = list;
+    REQUIRE(view[0] == 9);
+    REQUIRE(view.data()[4] == 8);
+}
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "catch/catch.hpp"
+#include "models/util/spatialGrid.h"
+
+using std::invalid_argument;
+using std::out_of_range;
+using std::pair;
+using std::vector;
+using utils::SpatialGrid;
+
+// Brute force reference: squared distance to every point, closest first
+vector<float> sortedDistances(const SpatialGrid &grid, float lat, float lon) {
+    vector<float> distances;
+    for (size_t i = 0; i < grid.size(); i++) {
+        auto [pointLat, pointLon] = grid[i];
+        distances.push_back((pointLat - lat) * (pointLat - lat) + (pointLon - lon) * (pointLon - lon));
+    }
+
+    std::sort(distances.begin(), distances.end());
+    return distances;
+}
+
+float distanceTo(const SpatialGrid &grid, size_t index, float lat, float lon) {
+    auto [pointLat, pointLon] = grid[index];
+    return (pointLat - lat) * (pointLat - lat) + (pointLon - lon) * (pointLon - lon);
+}
+
+void checkAgainstBruteForce(const vector<float> &lats, const vector<float> &lons, std::mt19937 &generator) {
+    SpatialGrid grid(lats, lons);
+    REQUIRE(grid.size() == lats.size());
+
+    for (size_t i = 0; i < lats.size(); i++) {
+        REQUIRE(grid.originalIndex(grid.getNewIndex(i)) == i);
+        REQUIRE(grid[grid.getNewIndex(i)] == pair<float, float>{lats[i], lons[i]});
+    }
+
+    // Queries inside and well outside the points' bounding box
+    auto [minLat, maxLat] = std::minmax_element(lats.begin(), lats.end());
+    auto [minLon, maxLon] = std::minmax_element(lons.begin(), lons.end());
+    std::uniform_real_distribution<float> queryLat(*minLat - 1.0f, *maxLat + 1.0f);
+    std::uniform_real_distribution<float> queryLon(*minLon - 1.0f, *maxLon + 1.0f);
+
+    for (size_t query = 0; query < 300; query++) {
+        float lat = queryLat(generator);
+        float lon = queryLon(generator);
+        vector<float> expected = sortedDistances(grid, lat, lon);
+
+        REQUIRE(distanceTo(grid, grid.nearestPoint(lat, lon), lat, lon) == expected[0]);
+
+        vector<size_t> nearest = {1234};
+        grid.kNearest(lat, lon, 7, nearest);
+        REQUIRE(nearest.size() == 1 + std::min<size_t>(7, lats.size()));
+        REQUIRE(nearest[0] == 1234);
+        for (size_t i = 1; i < nearest.size(); i++) {
+            REQUIRE(distanceTo(grid, nearest[i], lat, lon) == expected[i - 1]);
+        }
+
+        float radius = 0.2f;
+        vector<size_t> within;
+        grid.pointsWithinRadius(lat, lon, radius, within);
+        REQUIRE(within.size() == size_t(std::upper_bound(expected.begin(), expected.end(), radius * radius) - expected.begin()));
+
+        vector<size_t> inBox;
+        grid.pointsInBox(lat - 0.3f, lon - 0.1f, lat + 0.3f, lon + 0.1f, inBox);
+        size_t expectedInBox = 0;
+        for (size_t i = 0; i < lats.size(); i++) {
+            expectedInBox += lats[i] >= lat - 0.3f && lats[i] <= lat + 0.3f && lons[i] >= lon - 0.1f && lons[i] <= lon + 0.1f;
+        }
+        REQUIRE(inBox.size() == expectedInBox);
+    }
+}
+
+TEST_CASE("SpatialGrid queries are exact on uniform and clustered points", "[SpatialGrid]") {
+    std::mt19937 generator(21);
+    std::uniform_real_distribution<float> uniform(0.0f, 4.0f);
+    std::normal_distribution<float> spread(0.0f, 0.01f);
+
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 3000; i++) {
+        lats.push_back(uniform(generator));
+        lons.push_back(uniform(generator));
+    }
+    checkAgainstBruteForce(lats, lons, generator);
+
+    // A few dense towns in a mostly empty region
+    lats.clear();
+    lons.clear();
+    for (size_t town = 0; town < 5; town++) {
+        float centerLat = uniform(generator);
+        float centerLon = uniform(generator);
+        for (size_t i = 0; i < 1000; i++) {
+            lats.push_back(centerLat + spread(generator));
+            lons.push_back(centerLon + spread(generator));
+        }
+    }
+    checkAgainstBruteForce(lats, lons, generator);
+
+    // Points on a line, and repeated points
+    checkAgainstBruteForce({1.0f, 1.0f, 1.0f, 1.0f}, {0.0f, 0.5f, 0.75f, 2.0f}, generator);
+    checkAgainstBruteForce({3.0f, 3.0f, 3.0f}, {3.0f, 3.0f, 3.0f}, generator);
+    checkAgainstBruteForce({5.0f}, {6.0f}, generator);
+}
+
+TEST_CASE("SpatialGrid adapts its cells to clustered points", "[SpatialGrid]") {
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    vector<float> lats;
+    vector<float> lons;
+    for (size_t i = 0; i < 10000; i++) {
+        lats.push_back(uniform(generator));
+        lons.push_back(uniform(generator));
+    }
+    SpatialGrid spread(lats, lons);
+
+    // Same bounding box, but all but two corner points packed into a hundredth of its width
+    for (size_t i = 2; i < lats.size(); i++) {
+        lats[i] = 0.5f + lats[i] * 0.01f;
+        lons[i] = 0.5f + lons[i] * 0.01f;
+    }
+    lats[0] = lons[0] = 0.0f;
+    lats[1] = lons[1] = 1.0f;
+    SpatialGrid clustered(lats, lons);
+
+    // Small cells in the cluster, large ones around the empty corners
+    REQUIRE(clustered.cellSizeAt(0.505f, 0.505f) < spread.cellSizeAt(0.505f, 0.505f) / 4);
+    REQUIRE(clustered.cellSizeAt(0.0f, 0.0f) > spread.cellSizeAt(0.0f, 0.0f));
+    REQUIRE(clustered.numCells() <= lats.size());
+}
+
+TEST_CASE("SpatialGrid serializes and rejects bad input", "[SpatialGrid]") {
+    vector<float> lats = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f};
+    vector<float> lons = {4.0f, 3.0f, 2.0f, 1.0f, 0.0f};
+    SpatialGrid grid(lats, lons, 1);
+
+    std::stringstream stream;
+    stream << grid;
+    SpatialGrid loaded;
+    stream >> loaded;
+
+    REQUIRE(loaded.size() == grid.size());
+    REQUIRE(loaded.numCells() == grid.numCells());
+    for (size_t i = 0; i < lats.size(); i++) {
+        REQUIRE(loaded.getNewIndex(i) == grid.getNewIndex(i));
+        REQUIRE(loaded.nearestPoint(lats[i] + 0.1f, lons[i]) == grid.getNewIndex(i));
+    }
+
+    SpatialGrid empty = SpatialGrid(vector<float>(), vector<float>());
+    REQUIRE(empty.size() == 0);
+    REQUIRE_THROWS_AS(empty.nearestPoint(0.0f, 0.0f), out_of_range);
+
+    vector<size_t> result;
+    empty.kNearest(0.0f, 0.0f, 3, result);
+    empty.pointsInBox(-1.0f, -1.0f, 1.0f, 1.0f, result);
+    REQUIRE(result.empty());
+
+    REQUIRE_THROWS_AS(SpatialGrid(lats, vector<float>(2)), invalid_argument);
+    REQUIRE_THROWS_AS(SpatialGrid(lats, lons, 0), invalid_argument);
+}
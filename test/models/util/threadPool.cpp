@@ -0,0 +1,68 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/util/threadPool.h"
+
+using std::atomic;
+using std::runtime_error;
+using std::vector;
+using utils::ThreadPool;
+
+TEST_CASE("ThreadPool parallelFor visits every index once", "[ThreadPool]") {
+    ThreadPool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    vector<atomic<int>> visits(1000);
+    vector<atomic<int>> slotsInUse(pool.size());
+    atomic<bool> overlapped = false;
+
+    pool.parallelFor(visits.size(), [&](size_t slot, size_t index) {
+        // No two calls may share a slot at the same time
+        if (slotsInUse[slot]++ != 0) {
+            overlapped = true;
+        }
+
+        visits[index]++;
+        slotsInUse[slot]--;
+    });
+
+    REQUIRE_FALSE(overlapped);
+    for (const atomic<int> &count : visits) {
+        REQUIRE(count == 1);
+    }
+
+    // The pool is reusable, including for empty batches
+    pool.parallelFor(0, [](size_t, size_t) {});
+    pool.parallelFor(2, [&](size_t, size_t index) { visits[index]++; });
+    REQUIRE(visits[1] == 2);
+}
+
+TEST_CASE("ThreadPool submit and wait", "[ThreadPool]") {
+    ThreadPool pool(2);
+    atomic<int> total = 0;
+
+    for (int i = 1; i <= 100; i++) {
+        pool.submit([&total, i] { total += i; });
+    }
+
+    pool.wait();
+    REQUIRE(total == 5050);
+}
+
+TEST_CASE("ThreadPool parallelFor rethrows exceptions", "[ThreadPool]") {
+    ThreadPool pool(3);
+
+    REQUIRE_THROWS_AS(pool.parallelFor(100, [](size_t, size_t index) {
+        if (index == 42) {
+            throw runtime_error("failed");
+        }
+    }), runtime_error);
+
+    // Still usable afterwards
+    atomic<int> count = 0;
+    pool.parallelFor(10, [&](size_t, size_t) { count++; });
+    REQUIRE(count == 10);
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "catch/catch.hpp"
+
+#include "models/util/workStealingDeque.h"
+
+using std::atomic;
+using std::thread;
+using std::vector;
+using utils::WorkStealingDeque;
+
+TEST_CASE("WorkStealingDeque pops newest and steals oldest", "[WorkStealingDeque]") {
+    // Start small so the buffer has to grow
+    WorkStealingDeque<size_t> deque(2);
+    size_t item = 0;
+
+    REQUIRE_FALSE(deque.pop(item));
+    REQUIRE_FALSE(deque.steal(item));
+
+    for (size_t i = 0; i < 100; i++) {
+        deque.push(i);
+    }
+    REQUIRE(deque.size() == 100);
+
+    REQUIRE(deque.pop(item));
+    REQUIRE(item == 99);
+    REQUIRE(deque.steal(item));
+    REQUIRE(item == 0);
+    REQUIRE(deque.steal(item));
+    REQUIRE(item == 1);
+    REQUIRE(deque.size() == 97);
+
+    for (size_t i = 0; i < 97; i++) {
+        REQUIRE(deque.pop(item));
+        REQUIRE(item == 98 - i);
+    }
+
+    REQUIRE_FALSE(deque.pop(item));
+    REQUIRE(deque.size() == 0);
+}
+
+TEST_CASE("WorkStealingDeque hands every item to exactly one thread", "[WorkStealingDeque]") {
+    const size_t numItems = 200000;
+    WorkStealingDeque<size_t> deque(16);
+
+    vector<atomic<int>> taken(numItems);
+    atomic<bool> ownerDone = false;
+
+    vector<thread> thieves;
+    for (size_t t = 0; t < 3; t++) {
+        thieves.emplace_back([&] {
+            size_t item = 0;
+            while (!ownerDone || deque.size() > 0) {
+                if (deque.steal(item)) {
+                    taken[item]++;
+                }
+            }
+        });
+    }
+
+    // The owner interleaves pushes and pops, so both ends are contended and the buffer grows under thieves
+    size_t item = 0;
+    for (size_t i = 0; i < numItems; i++) {
+        deque.push(i);
+        if (i % 3 == 0 && deque.pop(item)) {
+            taken[item]++;
+        }
+    }
+
+    while (deque.pop(item)) {
+        taken[item]++;
+    }
+    ownerDone = true;
+
+    for (thread &thief : thieves) {
+        thief.join();
+    }
+
+    for (const atomic<int> &count : taken) {
+        REQUIRE(count == 1);
+    }
+}